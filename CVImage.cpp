@@ -8,6 +8,12 @@
 
 #include "CVImage.h"
 
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 /*****************************************************************************
 *********************** Class DCVImage Implementation ************************
 *****************************************************************************/
@@ -75,88 +81,235 @@ void DCVImage::Show(wxDC& DC, int x, int y, int /* w */, int /* h */,
 
    } // End of function DCVImage::Show
 #endif
+/*****************************************************************************
+*
+*  BandsForRows
+*
+*  Number of row bands to hand cv::parallel_for_ for an image of nRows rows
+*  of nRowBytes each.  Bands are sized to move around 256KB apiece so small
+*  images don't pay for waking up the thread pool.
+*
+*****************************************************************************/
+
+static double BandsForRows(int nRows, size_t nRowBytes)
+   {
+   const size_t nBandBytes = 256 * 1024;
+   size_t nBands = (static_cast<size_t>(nRows) * nRowBytes) / nBandBytes;
+   nBands = std::min(nBands, static_cast<size_t>(nRows));
+
+   return (static_cast<double>(std::max<size_t>(nBands, 1)));
+
+   } // End of function BandsForRows
+
+/*****************************************************************************
+*
+*  class DCombineRows
+*
+*  Parallel body for DCVImage::CombineGrid.  Each band of destination rows is
+*  assembled straight from the source rows.  Gaps and dividers are copied
+*  from a prebuilt row of the fill color so every byte is written once.
+*
+*****************************************************************************/
+
+class DCombineRows : public cv::ParallelLoopBody
+   {
+   public :
+      DCombineRows(DCVImage& Dst, const std::vector<const DCVImage*>& Images, int nGridCols,
+            const std::vector<int>& ColX, const std::vector<int>& RowY, const std::vector<int>& RowHeights,
+            const cv::Mat& FillRow)
+            : m_Dst(Dst), m_Images(Images), m_nGridCols(nGridCols), m_ColX(ColX), m_RowY(RowY),
+              m_RowHeights(RowHeights), m_FillRow(FillRow), m_nPixelSize(Dst.GetPixelSize()),
+              m_nRowBytes(Dst.GetPixelSize() * Dst.GetWidth())
+         {
+         return;
+         }
+
+      virtual void operator()(const cv::Range& Rows) const
+         {
+         for (int r = Rows.start ; r < Rows.end ; r++)
+            {
+            unsigned char* pRow = m_Dst.GetRow(r);
+            size_t nDone = 0;
+
+            // Find the grid row this line falls in (the grid is only a few rows high)
+            int g = static_cast<int>(std::upper_bound(m_RowY.begin(), m_RowY.end(), r) - m_RowY.begin()) - 1;
+            int nLine = r - m_RowY[g];
+            if (nLine < m_RowHeights[g])
+               {
+               for (int c = 0 ; c < m_nGridCols ; c++)
+                  {
+                  size_t nIndex = (g * m_nGridCols) + c;
+                  if (nIndex >= m_Images.size())
+                     {
+                     break;
+                     } // end if
+
+                  const DCVImage* pImage = m_Images[nIndex];
+                  if ((pImage != nullptr) && (nLine < pImage->GetHeight()))
+                     {
+                     size_t nStart = m_ColX[c] * m_nPixelSize;
+                     size_t nBytes = pImage->GetWidth() * m_nPixelSize;
+                     Fill(pRow, nDone, nStart);
+                     memcpy(pRow + nStart, pImage->GetRow(nLine), nBytes);
+                     nDone = nStart + nBytes;
+                     } // end if
+                  } // end for
+               } // end if
+
+            Fill(pRow, nDone, m_nRowBytes);
+            } // end for
+
+         return;
+         }
+
+   protected :
+      DCVImage& m_Dst;
+      const std::vector<const DCVImage*>& m_Images;
+      int m_nGridCols;
+      const std::vector<int>& m_ColX;
+      const std::vector<int>& m_RowY;
+      const std::vector<int>& m_RowHeights;
+      const cv::Mat& m_FillRow;
+      size_t m_nPixelSize;
+      size_t m_nRowBytes;
+
+      // Paint bytes [nFrom, nTo) of a row with the fill color
+      void Fill(unsigned char* pRow, size_t nFrom, size_t nTo) const
+         {
+         if (nTo > nFrom)
+            {
+            memcpy(pRow + nFrom, m_FillRow.ptr() + nFrom, nTo - nFrom);
+            } // end if
+
+         return;
+         }
+
+   private :
+   };  // End of class DCombineRows
+
 /*****************************************************************************
 *
 *  DCVImage::Combine
 *
+*  Place two images side by side or stacked with an optional divider.  This
+*  is just the two image case of CombineGrid.
+*
 *****************************************************************************/
 
 bool DCVImage::Combine(const DCVImage* pImage1, const DCVImage* pImage2,
       DCVImage::ECombine eCombine /* = eSideBySide */, int nDivider /* = 0 */,
       cv::Scalar FillColor /* = CV_RGB(0, 0, 0) */)
    {
-   bool bRet = true;
-   
-   // Size the image to fit both input images
-   if (eCombine == ECombine::eSideBySide)
+   std::vector<const DCVImage*> Images { pImage1, pImage2 };
+   int nGridCols = (eCombine == ECombine::eSideBySide) ? 2 : 1;
+
+   return (CombineGrid(Images, nGridCols, nDivider, FillColor));
+
+   } // End of function DCVImage::Combine 
+
+/*****************************************************************************
+*
+*  DCVImage::CombineGrid
+*
+*  Build a mosaic of images laid out row major in a grid.  Each grid column
+*  is as wide as its widest image and each grid row as high as its highest.
+*  Null entries leave an empty cell.  All the images must have the same type.
+*  Anything not covered by an image, including the dividers, is painted with
+*  the fill color.
+*
+*  This image is only reallocated if it isn't already the size and type of
+*  the mosaic so per frame mosaics reuse the same buffer.  The rows are built
+*  in parallel bands.
+*
+*****************************************************************************/
+
+bool DCVImage::CombineGrid(const std::vector<const DCVImage*>& Images, int nGridCols /* = 0 */,
+      int nDivider /* = 0 */, cv::Scalar FillColor /* = CV_RGB(0, 0, 0) */)
+   {
+   // The first real image determines the type of the mosaic
+   const DCVImage* pFirst = nullptr;
+   bool bAliased = false;
+   for (const DCVImage* pImage : Images)
       {
-      Create(pImage1->GetWidth() + pImage2->GetWidth() + nDivider,
-            MAX(pImage1->GetHeight(), pImage2->GetHeight()),
-            pImage1->GetType());
+      if ((pImage != nullptr) && pImage->IsValid())
+         {
+         if (pFirst == nullptr)
+            {
+            pFirst = pImage;
+            } // end if
+
+         bAliased = bAliased || (pImage == this) || (pImage->datastart == datastart);
          } // end if
-   else if (eCombine == ECombine::eStacked)
+      } // end for
+
+   bool bRet = (pFirst != nullptr) && (nDivider >= 0);
+   for (size_t i = 0 ; bRet && (i < Images.size()) ; i++)
       {
-      Create(MAX(pImage1->GetWidth(), pImage2->GetWidth()),
-            pImage1->GetHeight() + pImage2->GetHeight() + nDivider,
-            pImage1->GetType());
-   } // end else if
+      bRet = (Images[i] == nullptr) || !Images[i]->IsValid() || (Images[i]->GetType() == pFirst->GetType());
+      } // end for
 
-   // Copy the pixels into the appropriate spots
    if (bRet)
       {
-      // Copy image 1 on the left or top
-      for (int r = 0 ; r < pImage1->GetHeight() ; r++)
+      int nImages = static_cast<int>(Images.size());
+      if (nGridCols <= 0)
          {
-         unsigned char* pRow = GetRow(r);
-         const unsigned char* pRow1 = pImage1->GetRow(r);
-         memcpy(pRow, pRow1, pImage1->GetPixelSize() * pImage1->GetWidth());
-         } // end for
+         nGridCols = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(nImages))));
+         } // end if
+      int nGridRows = (nImages + nGridCols - 1) / nGridCols;
 
-      // Copy image 2 to the proper position
-      if (eCombine == ECombine::eSideBySide)
+      // Size the grid cells
+      std::vector<int> ColWidths(nGridCols, 0);
+      std::vector<int> RowHeights(nGridRows, 0);
+      for (int i = 0 ; i < nImages ; i++)
          {
-         // Copy image 2 on the right
-         size_t nOffset = pImage1->GetPixelSize() * (pImage1->GetWidth() + nDivider);
-         for (int r = 0 ; r < pImage2->GetHeight() ; r++)
+         if ((Images[i] != nullptr) && Images[i]->IsValid())
             {
-            unsigned char* pRow = GetRow(r) + nOffset;
-            const unsigned char* pRow2 = pImage2->GetRow(r);
-            memcpy(pRow, pRow2, pImage2->GetPixelSize() *
-            pImage2->GetWidth());
-            } // end for
-
-         // Color the divider
-         if (nDivider > 0)
-            {
-            RectangleFilled(cv::Point(pImage1->GetWidth(), 0),
-                  cv::Point(pImage1->GetWidth() + nDivider - 1,
-                  GetHeight() - 1), FillColor);
+            ColWidths[i % nGridCols] = std::max(ColWidths[i % nGridCols], Images[i]->GetWidth());
+            RowHeights[i / nGridCols] = std::max(RowHeights[i / nGridCols], Images[i]->GetHeight());
             } // end if
-         } // end if
-      else if (eCombine == ECombine::eStacked)
+         } // end for
+
+      // Position the cells with the dividers between them
+      std::vector<int> ColX(nGridCols);
+      int nWidth = 0;
+      for (int c = 0 ; c < nGridCols ; c++)
          {
-         // Copy image 2 on the bottom
-         for (int r = 0 ; r < pImage2->GetHeight() ; r++)
-            {
-            unsigned char* pRow = GetRow(r + pImage1->GetHeight() + nDivider);
-            const unsigned char* pRow2 = pImage2->GetRow(r);
-            memcpy(pRow, pRow2, pImage2->GetPixelSize() *
-                  pImage2->GetWidth());
-            } // end for
+         ColX[c] = nWidth;
+         nWidth += ColWidths[c] + ((c + 1 < nGridCols) ? nDivider : 0);
+         } // end for
 
-         // Color the divider
-         if (nDivider > 0)
-            {
-            RectangleFilled(cv::Point(0, pImage1->GetHeight()),
-                  cv::Point(GetWidth() - 1, pImage1->GetHeight() + nDivider),
-                  FillColor);
-            } // end if
-         } // end else if
+      std::vector<int> RowY(nGridRows);
+      int nHeight = 0;
+      for (int r = 0 ; r < nGridRows ; r++)
+         {
+         RowY[r] = nHeight;
+         nHeight += RowHeights[r] + ((r + 1 < nGridRows) ? nDivider : 0);
+         } // end for
+
+      // Build in a temporary if one of the inputs is this image
+      DCVImage Temp;
+      DCVImage* pDst = bAliased ? &Temp : this;
+      if ((pDst->GetWidth() != nWidth) || (pDst->GetHeight() != nHeight) ||
+            (pDst->GetType() != pFirst->GetType()))
+         {
+         pDst->Create(nWidth, nHeight, pFirst->GetType());
+         } // end if
+
+      cv::Mat FillRow(1, nWidth, pFirst->GetType(), FillColor);
+
+      DCombineRows Body(*pDst, Images, nGridCols, ColX, RowY, RowHeights, FillRow);
+      cv::parallel_for_(cv::Range(0, nHeight), Body,
+            BandsForRows(nHeight, pDst->GetPixelSize() * nWidth));
+
+      if (bAliased)
+         {
+         *this = Temp;
+         } // end if
       } // end if
- 
+
    return (bRet);
 
-   } // End of function DCVImage::Combine 
+   } // End of function DCVImage::CombineGrid
 
 #if 0
 /*****************************************************************************
@@ -305,143 +458,299 @@ void DCVImage::CopyPixelsToRGB(unsigned char* pPixelsOut) const
 
 /*****************************************************************************
 *
-*  DCVImage::CopyPixelsToRGB
+*  DRGBPlanes
 *
-*  Copy the pixels to the format RGB with 3 bytes per pixel and one byte
-*  per channel.  Probably should make it more robust to other depths and
-*  number of channels.
+*  Load 16 pixels of a row as 8 bit blue, green and red planes.  STORAGE is
+*  the unsigned storage type of a channel and CN the number of channels.
+*  Gray images replicate the single plane and the alpha of BGRA is dropped.
+*  16 bit channels keep their high byte the same as U16ToU8.
 *
 *****************************************************************************/
 
-void DCVImage::CopyPixelsToRGB(unsigned char* pPixelsOut) const
+#if CV_SIMD128
+template <typename STORAGE, int CN>
+struct DRGBPlanes;
+
+template <>
+struct DRGBPlanes<unsigned char, 1>
+   {
+   static void Load(const unsigned char* p, cv::v_uint8x16& b, cv::v_uint8x16& g, cv::v_uint8x16& r)
+      {
+      b = g = r = cv::v_load(p);
+
+      return;
+      }
+   };
+
+template <>
+struct DRGBPlanes<unsigned char, 3>
    {
-   if (GetNumChannels() == 1)
+   static void Load(const unsigned char* p, cv::v_uint8x16& b, cv::v_uint8x16& g, cv::v_uint8x16& r)
       {
-      // Handle gray images
-      if (GetPixelDepth() == 8)
+      cv::v_load_deinterleave(p, b, g, r);
+
+      return;
+      }
+   };
+
+template <>
+struct DRGBPlanes<unsigned char, 4>
+   {
+   static void Load(const unsigned char* p, cv::v_uint8x16& b, cv::v_uint8x16& g, cv::v_uint8x16& r)
+      {
+      cv::v_uint8x16 a;
+      cv::v_load_deinterleave(p, b, g, r, a);
+
+      return;
+      }
+   };
+
+template <>
+struct DRGBPlanes<unsigned short, 1>
+   {
+   static void Load(const unsigned short* p, cv::v_uint8x16& b, cv::v_uint8x16& g, cv::v_uint8x16& r)
+      {
+      cv::v_uint16x8 Lo = cv::v_load(p);
+      cv::v_uint16x8 Hi = cv::v_load(p + 8);
+      b = g = r = cv::v_pack(cv::v_shr<8>(Lo), cv::v_shr<8>(Hi));
+
+      return;
+      }
+   };
+
+template <>
+struct DRGBPlanes<unsigned short, 3>
+   {
+   static void Load(const unsigned short* p, cv::v_uint8x16& b, cv::v_uint8x16& g, cv::v_uint8x16& r)
+      {
+      cv::v_uint16x8 b0, g0, r0, b1, g1, r1;
+      cv::v_load_deinterleave(p, b0, g0, r0);
+      cv::v_load_deinterleave(p + 24, b1, g1, r1);
+      b = cv::v_pack(cv::v_shr<8>(b0), cv::v_shr<8>(b1));
+      g = cv::v_pack(cv::v_shr<8>(g0), cv::v_shr<8>(g1));
+      r = cv::v_pack(cv::v_shr<8>(r0), cv::v_shr<8>(r1));
+
+      return;
+      }
+   };
+
+template <>
+struct DRGBPlanes<unsigned short, 4>
+   {
+   static void Load(const unsigned short* p, cv::v_uint8x16& b, cv::v_uint8x16& g, cv::v_uint8x16& r)
+      {
+      cv::v_uint16x8 b0, g0, r0, a0, b1, g1, r1, a1;
+      cv::v_load_deinterleave(p, b0, g0, r0, a0);
+      cv::v_load_deinterleave(p + 32, b1, g1, r1, a1);
+      b = cv::v_pack(cv::v_shr<8>(b0), cv::v_shr<8>(b1));
+      g = cv::v_pack(cv::v_shr<8>(g0), cv::v_shr<8>(g1));
+      r = cv::v_pack(cv::v_shr<8>(r0), cv::v_shr<8>(r1));
+
+      return;
+      }
+   };
+#endif
+
+/*****************************************************************************
+*
+*  HighByte
+*
+*  Scalar counterpart of DRGBPlanes for the leftover pixels of a row.
+*
+*****************************************************************************/
+
+static inline unsigned char HighByte(unsigned char n)
+   {
+   return (n);
+   }
+
+static inline unsigned char HighByte(unsigned short n)
+   {
+   return (static_cast<unsigned char>(n >> 8));
+   }
+
+/*****************************************************************************
+*
+*  ToRGBRow
+*
+*  Convert one row of nWidth gray, BGR or BGRA pixels to packed 8 bit RGB.
+*  Signed data is moved to the unsigned display range by flipping the top bit
+*  of the 8 bit result, which is exactly what S8ToU8 and S16ToU8 compute.
+*
+*****************************************************************************/
+
+template <typename STORAGE, int CN, bool SIGNED>
+static void ToRGBRow(const STORAGE* pSrc, unsigned char* pDst, int nWidth)
+   {
+   const unsigned char nBias = SIGNED ? 0x80 : 0;
+   int c = 0;
+
+#if CV_SIMD128
+   const cv::v_uint8x16 vBias = cv::v_setall_u8(nBias);
+   for ( ; c <= nWidth - 16 ; c += 16)
+      {
+      cv::v_uint8x16 b, g, r;
+      DRGBPlanes<STORAGE, CN>::Load(pSrc + (c * CN), b, g, r);
+      if (SIGNED)
          {
-         // 8 bit pixels
-         if (IsPixelDataSigned())
-            {
-            // 8 bit signed (rescale 0 to 255)
-            for (int r = 0 ; r < GetHeight() ; r++)
-               {
-               const unsigned char* pRow = GetRow(r);
-      
-               for (int c = 0 ; c < GetWidth() ; c++)
-                  {
-                  const unsigned char* pPixel = GetPixel(pRow, c);
-             
-                  pPixelsOut[0] = pPixelsOut[1] = pPixelsOut[2] =
-                        S8ToU8(*pPixel);
-                  pPixelsOut += 3;   
-                  } // end for column
-               } // end for row
-            } // end if
-         else
-            {
-            // 8 bit unsigned
-            for (int r = 0 ; r < GetHeight() ; r++)
-               {
-               const unsigned char* pRow = GetRow(r);
-      
-               for (int c = 0 ; c < GetWidth() ; c++)
-                  {
-                  const unsigned char* pPixel = GetPixel(pRow, c);
-                  pPixelsOut[0] = pPixelsOut[1] = pPixelsOut[2] = *pPixel;
-                  pPixelsOut += 3;
-                  } // end for column
-               } // end for row
-            } // end else
+         b = b ^ vBias;
+         g = g ^ vBias;
+         r = r ^ vBias;
          } // end if
-      else if (GetPixelDepth() == 16)
-         {
-         if (IsPixelDataSigned())
-            {
-            // 16 bit signed (rescale 0 to 255)
-            for (int r = 0 ; r < GetHeight() ; r++)
-               {
-               const unsigned char* pRow = GetRow(r);
-      
-               for (int c = 0 ; c < GetWidth() ; c++)
-                  {
-                  const short* pPixel =
-                        reinterpret_cast<const short*>(GetPixel(pRow, c));
-             
-                  pPixelsOut[0] = pPixelsOut[1] = pPixelsOut[2] =
-                        S16ToU8(*pPixel);
-                  pPixelsOut += 3;   
-                  } // end for column
-               } // end for row
-            
-            } // end if
-         else
-            {
-            // 16 bit unsigned
-            for (int r = 0 ; r < GetHeight() ; r++)
-               {
-               const unsigned char* pRow = GetRow(r);
-      
-               for (int c = 0 ; c < GetWidth() ; c++)
-                  {
-                  const unsigned short* pPixel = reinterpret_cast<
-                        const unsigned short*>(GetPixel(pRow, c));
-                  pPixelsOut[0] = pPixelsOut[1] = pPixelsOut[2] =
-                        U16ToU8(*pPixel);
-                  pPixelsOut += 3;
-                  } // end for column
-               } // end for row
-            
-            } // end else
-         } // end else if
-      } // end if
-   else if (GetNumChannels() == 3)
+
+      cv::v_store_interleave(pDst + (c * 3), r, g, b);
+      } // end for
+#endif
+
+   // Finish off the row a pixel at a time
+   for ( ; c < nWidth ; c++)
       {
-      // 3 color images
-      if (GetPixelDepth() == 8)
+      const STORAGE* pPixel = pSrc + (c * CN);
+      unsigned char* pOut = pDst + (c * 3);
+      if (CN == 1)
          {
-         if (IsPixelDataSigned())
-            {
-            // 8 bit unsigned
-            for (int r = 0 ; r < GetHeight() ; r++)
-               {
-               const unsigned char* pRow = GetRow(r);
-      
-               for (int c = 0 ; c < GetWidth() ; c++)
-                  {
-                  const unsigned char* pPixel = GetPixel(pRow, c);
-                  pPixelsOut[0] = S8ToU8(pPixel[eRed]);
-                  pPixelsOut[1] = S8ToU8(pPixel[eGreen]);
-                  pPixelsOut[2] = S8ToU8(pPixel[eBlue]);
-                  pPixelsOut += 3;
-                  } // end for column
-               } // end for row
-            } // end if
-         else
-            {
-            // 8 bit unsigned
-            for (int r = 0 ; r < GetHeight() ; r++)
-               {
-               const unsigned char* pRow = GetRow(r);
-      
-               for (int c = 0 ; c < GetWidth() ; c++)
-                  {
-                  const unsigned char* pPixel = GetPixel(pRow, c);
-                  pPixelsOut[0] = pPixel[eRed];
-                  pPixelsOut[1] = pPixel[eGreen];
-                  pPixelsOut[2] = pPixel[eBlue];
-                  pPixelsOut += 3;
-                  } // end for column
-               } // end for row
-            } // end else
+         pOut[0] = pOut[1] = pOut[2] = HighByte(pPixel[0]) ^ nBias;
          } // end if
-      else if (GetPixelDepth() == 16)
+      else
          {
-         
-         } // end else if
-      } // end else if
-      
+         pOut[0] = HighByte(pPixel[DCVImage::eRed]) ^ nBias;
+         pOut[1] = HighByte(pPixel[DCVImage::eGreen]) ^ nBias;
+         pOut[2] = HighByte(pPixel[DCVImage::eBlue]) ^ nBias;
+         } // end else
+      } // end for
+
    return;
 
-   } // End of function DCVImage::CopyPixelsToRGB 
+   } // End of function ToRGBRow
+
+/*****************************************************************************
+*
+*  class DToRGBRows
+*
+*  Parallel body for DCVImage::CopyPixelsToRGB.  Output rows are packed so
+*  row r starts at r * width * 3 regardless of the source step.
+*
+*****************************************************************************/
+
+template <typename STORAGE, int CN, bool SIGNED>
+class DToRGBRows : public cv::ParallelLoopBody
+   {
+   public :
+      DToRGBRows(const DCVImage& Src, unsigned char* pPixelsOut)
+            : m_Src(Src), m_pPixelsOut(pPixelsOut)
+         {
+         return;
+         }
+
+      virtual void operator()(const cv::Range& Rows) const
+         {
+         const size_t nOutStep = static_cast<size_t>(m_Src.GetNumCols()) * 3;
+         for (int r = Rows.start ; r < Rows.end ; r++)
+            {
+            ToRGBRow<STORAGE, CN, SIGNED>(m_Src.GetRow(r), m_pPixelsOut + (r * nOutStep),
+                  m_Src.GetNumCols());
+            } // end for
+
+         return;
+         }
+
+   protected :
+      DCVImageView<const STORAGE, CN> m_Src;
+      unsigned char* m_pPixelsOut;
+
+   private :
+   };  // End of class DToRGBRows
+
+/*****************************************************************************
+*
+*  ToRGB
+*
+*  Run the row conversion for one pixel format over the whole image.
+*
+*****************************************************************************/
+
+template <typename STORAGE, int CN, bool SIGNED>
+static void ToRGB(const DCVImage& Src, unsigned char* pPixelsOut)
+   {
+   DToRGBRows<STORAGE, CN, SIGNED> Body(Src, pPixelsOut);
+   cv::parallel_for_(cv::Range(0, Src.GetHeight()), Body,
+         BandsForRows(Src.GetHeight(), static_cast<size_t>(Src.GetWidth()) * 3));
+
+   return;
+
+   } // End of function ToRGB
+
+/*****************************************************************************
+*
+*  ToRGBDepth
+*
+*  Pick the conversion for a CN channel image based on its depth.
+*
+*****************************************************************************/
+
+template <int CN>
+static bool ToRGBDepth(const DCVImage& Src, unsigned char* pPixelsOut)
+   {
+   bool bRet = true;
+
+   switch (Src.GetDepth())
+      {
+      case CV_8U:
+         ToRGB<unsigned char, CN, false>(Src, pPixelsOut);
+         break;
+
+      case CV_8S:
+         ToRGB<unsigned char, CN, true>(Src, pPixelsOut);
+         break;
+
+      case CV_16U:
+         ToRGB<unsigned short, CN, false>(Src, pPixelsOut);
+         break;
+
+      case CV_16S:
+         ToRGB<unsigned short, CN, true>(Src, pPixelsOut);
+         break;
+
+      default:
+         bRet = false;
+         break;
+      } // end switch
+
+   return (bRet);
+
+   } // End of function ToRGBDepth
+
+/*****************************************************************************
+*
+*  DCVImage::CopyPixelsToRGB
+*
+*  Copy the pixels to the format RGB with 3 bytes per pixel and one byte
+*  per channel.  Gray, BGR and BGRA images with 8 or 16 bit signed or
+*  unsigned channels are handled.  Other formats leave the output untouched.
+*
+*****************************************************************************/
+
+void DCVImage::CopyPixelsToRGB(unsigned char* pPixelsOut) const
+   {
+   switch (GetNumChannels())
+      {
+      case 1:
+         ToRGBDepth<1>(*this, pPixelsOut);
+         break;
+
+      case 3:
+         ToRGBDepth<3>(*this, pPixelsOut);
+         break;
+
+      case 4:
+         ToRGBDepth<4>(*this, pPixelsOut);
+         break;
+
+      default:
+         break;
+      } // end switch
+
+   return;
+
+   } // End of function DCVImage::CopyPixelsToRGB
 
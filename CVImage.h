@@ -11,12 +11,184 @@
 ******************************  I N C L U D E  *******************************
 *****************************************************************************/
 
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
 //#include "DConfig.h"
 
+/*****************************************************************************
+***************************** class DCVImageView *****************************
+*****************************************************************************/
+
+/*
+   Typed view of an image's pixels.  The channel type T and the number of
+   channels CN are fixed at compile time so the element size and pixel stride
+   are constants instead of run time calls to elemSize() and loops written
+   against the view can be vectorized.  Use a const T to view a const image.
+   The view doesn't own the pixels and is only good as long as the image it
+   was made from keeps the same buffer.
+*/
+
+template <typename T, int CN = 1>
+class DCVImageView
+   {
+   public :
+      using DataType = typename std::remove_const<T>::type;
+      using Byte = typename std::conditional<std::is_const<T>::value, const unsigned char, unsigned char>::type;
+
+      /***********************************************************************
+      ***************************** class DRow *******************************
+      ***********************************************************************/
+
+      // Span of the channel elements of one row
+      class DRow
+         {
+         public :
+            DRow(T* pBegin, int nCols) : m_pBegin(pBegin), m_nCols(nCols)
+               {
+               return;
+               }
+
+            T* begin() const
+               {
+               return (m_pBegin);
+               }
+
+            T* end() const
+               {
+               return (m_pBegin + size());
+               }
+
+            // Number of channel elements in the row
+            int size() const
+               {
+               return (m_nCols * CN);
+               }
+
+            int GetNumCols() const
+               {
+               return (m_nCols);
+               }
+
+            T& operator[](int i) const
+               {
+               return (m_pBegin[i]);
+               }
+
+            T* GetPixel(int nCol) const
+               {
+               return (m_pBegin + (nCol * CN));
+               }
+
+         protected :
+            T* m_pBegin;
+            int m_nCols;
+
+         private :
+         };  // End of class DRow
+
+      DCVImageView() : m_pData(nullptr), m_nStep(0), m_nRows(0), m_nCols(0)
+         {
+         return;
+         }
+
+      explicit DCVImageView(cv::Mat& Image)
+            : m_pData(Image.data), m_nStep(Image.step), m_nRows(Image.rows), m_nCols(Image.cols)
+         {
+         CheckType(Image);
+
+         return;
+         }
+
+      explicit DCVImageView(const cv::Mat& Image)
+            : m_pData(Image.data), m_nStep(Image.step), m_nRows(Image.rows), m_nCols(Image.cols)
+         {
+         static_assert(std::is_const<T>::value, "A view of a const image needs a const channel type");
+         CheckType(Image);
+
+         return;
+         }
+
+      DCVImageView(const DCVImageView& src) = default;
+
+      ~DCVImageView() = default;
+
+      DCVImageView& operator=(const DCVImageView& rhs) = default;
+
+      int GetNumRows() const
+         {
+         return (m_nRows);
+         }
+
+      int GetNumCols() const
+         {
+         return (m_nCols);
+         }
+
+      static int GetNumChannels()
+         {
+         return (CN);
+         }
+
+      // Row step in bytes
+      size_t GetWidthStep() const
+         {
+         return (m_nStep);
+         }
+
+      bool IsContinuous() const
+         {
+         return (m_nStep == (m_nCols * CN * sizeof(T)));
+         }
+
+      T* GetRow(int nRow) const
+         {
+         return (reinterpret_cast<T*>(m_pData + (nRow * m_nStep)));
+         }
+
+      DRow Row(int nRow) const
+         {
+         return (DRow(GetRow(nRow), m_nCols));
+         }
+
+      T* GetPixel(int nRow, int nCol) const
+         {
+         return (GetRow(nRow) + (nCol * CN));
+         }
+
+      T& at(int nRow, int nCol, int nChannel = 0) const
+         {
+         return (GetRow(nRow)[(nCol * CN) + nChannel]);
+         }
+
+   protected :
+      Byte* m_pData;
+      size_t m_nStep;
+      int m_nRows;
+      int m_nCols;
+
+      // Signed and unsigned channels of the same size may share a view
+      static void CheckType(const cv::Mat& Image)
+         {
+         CV_Assert(Image.empty() || ((Image.elemSize1() == sizeof(T)) && (Image.channels() == CN)));
+
+         return;
+         }
+
+   private :
+   };  // End of class DCVImageView
+
+// Lazy element-wise expressions (see CVImageExpr.h)
+template <typename EXPR>
+class DCVImageExpr;
+
 /*****************************************************************************
 ******************************* class DCVImage *******************************
 *****************************************************************************/
@@ -57,6 +229,10 @@ class DCVImage : public cv::Mat
          return;
          }
 
+      // Evaluate a lazy expression in one fused pass (see CVImageExpr.h)
+      template <typename EXPR>
+      DCVImage(const DCVImageExpr<EXPR>& Expr);
+
       ~DCVImage() = default;
 
       // Assignment operators
@@ -88,6 +264,9 @@ class DCVImage : public cv::Mat
          return (*this);
          }
 
+      template <typename EXPR>
+      DCVImage& operator=(const DCVImageExpr<EXPR>& Expr);
+
       // Create the image if it hasn't been already
       void Create(int nWidth, int nHeight, int nType)
          {
@@ -457,6 +636,19 @@ class DCVImage : public cv::Mat
          return (pRow + nCol * GetPixelSize());
          }
 
+      // Typed access with the channel type and count fixed at compile time
+      template <typename T, int CN = 1>
+      DCVImageView<T, CN> GetView()
+         {
+         return (DCVImageView<T, CN>(*this));
+         }
+
+      template <typename T, int CN = 1>
+      DCVImageView<const T, CN> GetView() const
+         {
+         return (DCVImageView<const T, CN>(*this));
+         }
+
       bool CopyPixels(const IplImage* pImage)
          {
          bool bRet = (pImage->imageData != nullptr);
@@ -474,7 +666,9 @@ class DCVImage : public cv::Mat
       /***********************************************************************
       ************************* Algebraic Operations *************************
       ***********************************************************************/
-      /* Generally deprecated in favor of cv::Mat native operations */
+      /* Generally deprecated in favor of cv::Mat native operations.  These are
+         the eager forms, for chains of operations see the lazy expressions in
+         CVImageExpr.h which fuse the chain into a single pass. */
 
       // This matrix contains the result of adding two matrices
       void Add(const cv::Mat& Mat1, const cv::Mat& Mat2, const cv::Mat& Mask = Mat())
@@ -805,31 +999,37 @@ class DCVImage : public cv::Mat
          eInterArea = cv::INTER_AREA,
          eInterBicubic = cv::INTER_CUBIC,
          };
+#endif
 
       /***********************************************************************
       ********************** Gaussian Pyramid Operations *********************
       ***********************************************************************/
 
-       void PyramidUp(cv::Mat& Dst, const cv::Size& DstSize= cv::Size())
+      void PyramidUp(cv::Mat& Dst, const cv::Size& DstSize = cv::Size()) const
          {
          cv::pyrUp(*this, Dst, DstSize);
 
          return;
          }
 
-      void PyramidDown(cv::Mat& Dst, const cv::Size& DstSize= cv::Size())
+      void PyramidDown(cv::Mat& Dst, const cv::Size& DstSize = cv::Size()) const
          {
          cv::pyrDown(*this, Dst, DstSize);
 
          return;
          }
-#endif
+
       // Color order for color images
       enum EColor { eBlue, eGreen, eRed };
 
       bool Combine(const DCVImage* pImage1, const DCVImage* pImage2, ECombine eCombine = ECombine::eSideBySide,
             int nDivider = 0, cv::Scalar FillColor = CV_RGB(0, 0, 0));
 
+      // Build a mosaic of the images laid out row major in a grid nGridCols
+      // wide (0 picks a square grid, ie 4-up is 2x2 and 9-up is 3x3).
+      bool CombineGrid(const std::vector<const DCVImage*>& Images, int nGridCols = 0, int nDivider = 0,
+            cv::Scalar FillColor = CV_RGB(0, 0, 0));
+
    protected :
       // Pixel conversion functions
       // (8 bit unsigned is the most common display)
@@ -924,114 +1124,42 @@ class DCVBinaryImage : public DCVImage
 
       int CountBlackRight(int nRow, int nStartCol) const
          {
-         int nCount = 0;
-         const unsigned char* pPixel = GetPixel(nRow, nStartCol);
-         while ((nStartCol < GetWidth()) && IsBlack(*pPixel))
-            {
-            nStartCol++;
-            pPixel++;
-            nCount++;
-            } // end while
-
-         return (nCount);
+         return (RunRight(nRow, nStartCol, true));
          }
 
       int CountBlackLeft(int nRow, int nStartCol) const
          {
-         int nCount = 0;
-         const unsigned char* pPixel = GetPixel(nRow, nStartCol);
-         while ((nStartCol >= 0) && IsBlack(*pPixel))
-            {
-            nStartCol--;
-            pPixel--;
-            nCount++;
-            } // end while
-
-         return (nCount);
+         return (RunLeft(nRow, nStartCol, true));
          }
 
       int CountWhiteRight(int nRow, int nStartCol) const
          {
-         int nCount = 0;
-         const unsigned char* pPixel = GetPixel(nRow, nStartCol);
-         while ((nStartCol < GetWidth()) && IsWhite(*pPixel))
-            {
-            nStartCol++;
-            pPixel++;
-            nCount++;
-            } // end while
-
-         return (nCount);
+         return (RunRight(nRow, nStartCol, false));
          }
 
       int CountWhiteLeft(int nRow, int nStartCol) const
          {
-         int nCount = 0;
-         const unsigned char* pPixel = GetPixel(nRow, nStartCol);
-         while ((nStartCol >= 0) && IsWhite(*pPixel))
-            {
-            nStartCol--;
-            pPixel--;
-            nCount++;
-            } // end while
-
-         return (nCount);
+         return (RunLeft(nRow, nStartCol, false));
          }
 
       int CountBlackDown(int nStartRow, int nCol) const
          {
-         int nCount = 0;
-         const unsigned char* pPixel = GetPixel(nStartRow, nCol);
-         while ((nStartRow < GetHeight()) && IsBlack(*pPixel))
-            {
-            nStartRow++;
-            pPixel += GetWidthStep();
-            nCount++;
-            } // end while
-
-         return (nCount);
+         return (RunDown(nStartRow, nCol, true));
          }
 
       int CountBlackUp(int nStartRow, int nCol) const
          {
-         int nCount = 0;
-         const unsigned char* pPixel = GetPixel(nStartRow, nCol);
-         while ((nStartRow >= 0) && IsBlack(*pPixel))
-            {
-            nStartRow--;
-            pPixel -= GetWidthStep();
-            nCount++;
-            } // end while
-
-         return (nCount);
+         return (RunUp(nStartRow, nCol, true));
          }
 
       int CountWhiteDown(int nStartRow, int nCol) const
          {
-         int nCount = 0;
-         const unsigned char* pPixel = GetPixel(nStartRow, nCol);
-         while ((nStartRow < GetHeight()) && IsWhite(*pPixel))
-            {
-            nStartRow++;
-            pPixel += GetWidthStep();
-            nCount++;
-            } // end while
-
-         return (nCount);
+         return (RunDown(nStartRow, nCol, false));
          }
 
       int CountWhiteUp(int nStartRow, int nCol) const
          {
-         int nCount = 0;
-         const unsigned char* pPixel = GetPixel(nStartRow, nCol);
-         while ((nStartRow >= 0) && IsWhite(*pPixel))
-            {
-            nStartRow--;
-            pPixel -= GetWidthStep();
-            nCount++;
-            } // end while
-
-         return (nCount);
+         return (RunUp(nStartRow, nCol, false));
          }
 
       /***********************************************************************
@@ -1110,6 +1238,81 @@ class DCVBinaryImage : public DCVImage
       using DPixelRunVector = std::vector<DPixelRun>;
 
    protected :
+      using DView = DCVImageView<const unsigned char>;
+
+      // Length of the black (bBlack) or white run starting at nStartCol
+      // going right.  Rows are scanned in bulk rather than a pixel at a time.
+      int RunRight(int nRow, int nStartCol, bool bBlack) const
+         {
+         int nCount = 0;
+         if (nStartCol < GetWidth())
+            {
+            DView::DRow Row = GetView<unsigned char>().Row(nRow);
+            const unsigned char* pStart = Row.GetPixel(nStartCol);
+            const unsigned char* pEnd = bBlack ? FindNotBlack(pStart, Row.end()) :
+                  std::find(pStart, Row.end(), static_cast<unsigned char>(eBlack));
+            nCount = static_cast<int>(pEnd - pStart);
+            } // end if
+
+         return (nCount);
+         }
+
+      int RunLeft(int nRow, int nStartCol, bool bBlack) const
+         {
+         const unsigned char* pRow = GetView<unsigned char>().GetRow(nRow);
+         int c = nStartCol;
+         while ((c >= 0) && (IsBlack(pRow[c]) == bBlack))
+            {
+            c--;
+            } // end while
+
+         return (nStartCol - c);
+         }
+
+      int RunDown(int nStartRow, int nCol, bool bBlack) const
+         {
+         DView View = GetView<unsigned char>();
+         int r = nStartRow;
+         while ((r < View.GetNumRows()) && (IsBlack(View.at(r, nCol)) == bBlack))
+            {
+            r++;
+            } // end while
+
+         return (r - nStartRow);
+         }
+
+      int RunUp(int nStartRow, int nCol, bool bBlack) const
+         {
+         DView View = GetView<unsigned char>();
+         int r = nStartRow;
+         while ((r >= 0) && (IsBlack(View.at(r, nCol)) == bBlack))
+            {
+            r--;
+            } // end while
+
+         return (nStartRow - r);
+         }
+
+      // First pixel in [p, pEnd) that isn't black, testing 8 pixels at a time
+      static const unsigned char* FindNotBlack(const unsigned char* p, const unsigned char* pEnd)
+         {
+         for ( ; (pEnd - p) >= 8 ; p += 8)
+            {
+            std::uint64_t nPixels;
+            memcpy(&nPixels, p, sizeof(nPixels));
+            if (nPixels != 0)
+               {
+               break;
+               } // end if
+            } // end for
+
+         while ((p < pEnd) && (*p == eBlack))
+            {
+            p++;
+            } // end while
+
+         return (p);
+         }
 
    private :
 
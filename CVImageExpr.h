@@ -0,0 +1,714 @@
+/*****************************************************************************
+******************************* CVImageExpr.h ********************************
+*****************************************************************************/
+
+#if !defined(__CVIMAGEEXPR_H__)
+#define __CVIMAGEEXPR_H__
+
+#pragma once
+
+/*
+   Lazy element-wise expressions over DCVImage.  The eager methods (Add,
+   Subtract, AddWeighted, And, Or, Xor, Not) each make a full pass over
+   memory and write a full size intermediate.  Chaining them, for example
+   subtract the background, and with a mask and scale, costs a pass per step.
+
+   Here the operators only build a small expression tree.  Assigning the tree
+   to a DCVImage evaluates it a band of rows (a tile) at a time.  Every node
+   of the tree is run on the tile before moving on, so the intermediates are
+   tile sized and stay in cache and main memory sees each input read once
+   and the result written once.  The per-tile work is done by the same
+   vectorized OpenCV functions the eager forms use, and the tiles are spread
+   over threads with cv::parallel_for_.
+
+      DCVImage Result;
+      Result = (Lazy(Frame) - Background & Mask) * 2.0;
+
+   Leaves hold a cv::Mat header so the pixels are shared, not copied, and
+   the destination may also appear in the expression.  A tile only reads
+   the rows it writes, so a destination that is exactly one of the operands
+   is evaluated in place.  If the destination only partly overlaps an
+   operand, an ROI of the same image shifted by a few rows for instance,
+   the result goes through a temporary and is copied in at the end.
+   Results have the type of the leftmost operand, the same as the eager
+   forms.
+*/
+
+/*****************************************************************************
+******************************  I N C L U D E  *******************************
+*****************************************************************************/
+
+#include <vector>
+#include <algorithm>
+
+#include "CVImage.h"
+
+/*****************************************************************************
+***************************** class DCVImageExpr *****************************
+*****************************************************************************/
+
+/*
+   Base of all the expression nodes.  Each node EXPR provides
+
+      m_nSlots - number of scratch tiles needed to produce its value
+      GetSize(), GetType() - size and type of the result
+      EvalInto(Rows, Out, pScratch) - compute rows of the result into Out
+      Ref(Rows, pScratch) - rows of the result, computed into a scratch
+            tile unless the node is a leaf
+      Overlaps(Dst) - true if writing Dst a tile at a time could change
+            pixels a leaf still has to read
+*/
+
+template <typename EXPR>
+class DCVImageExpr
+   {
+   public :
+      const EXPR& Self() const
+         {
+         return (static_cast<const EXPR&>(*this));
+         }
+
+   protected :
+
+   private :
+   };  // End of class DCVImageExpr
+
+/*****************************************************************************
+*
+***  DCVImagePartialOverlap
+*
+*  True if the pixels of A and B share memory without being the same
+*  pixels at the same positions.
+*
+*****************************************************************************/
+
+inline bool DCVImagePartialOverlap(const cv::Mat& A, const cv::Mat& B)
+   {
+   bool bRet = false;
+   if (!A.empty() && !B.empty())
+      {
+      const uchar* pAEnd = A.data + (A.step[0] * (A.rows - 1)) + (A.cols * A.elemSize());
+      const uchar* pBEnd = B.data + (B.step[0] * (B.rows - 1)) + (B.cols * B.elemSize());
+      bool bSame = (A.data == B.data) && (A.step[0] == B.step[0]) &&
+            (A.cols * A.elemSize() == B.cols * B.elemSize());
+
+      bRet = !bSame && (A.data < pBEnd) && (B.data < pAEnd);
+      } // end if
+
+   return (bRet);
+
+   } // End of function DCVImagePartialOverlap
+
+/*****************************************************************************
+***************************** class DCVImageTerm *****************************
+*****************************************************************************/
+
+// Leaf of an expression referring to an image
+
+class DCVImageTerm : public DCVImageExpr<DCVImageTerm>
+   {
+   public :
+      static const int m_nSlots = 0;
+
+      explicit DCVImageTerm(const cv::Mat& Image) : m_Image(Image)
+         {
+         return;
+         }
+
+      cv::Size GetSize() const
+         {
+         return (m_Image.size());
+         }
+
+      int GetType() const
+         {
+         return (m_Image.type());
+         }
+
+      void EvalInto(const cv::Range& Rows, cv::Mat& Out, cv::Mat* /* pScratch */) const
+         {
+         m_Image.rowRange(Rows).copyTo(Out);
+
+         return;
+         }
+
+      cv::Mat Ref(const cv::Range& Rows, cv::Mat* /* pScratch */) const
+         {
+         return (m_Image.rowRange(Rows));
+         }
+
+      bool Overlaps(const cv::Mat& Dst) const
+         {
+         return (DCVImagePartialOverlap(m_Image, Dst));
+         }
+
+   protected :
+      cv::Mat m_Image;
+
+   private :
+   };  // End of class DCVImageTerm
+
+/*****************************************************************************
+*************************** class DCVImageNodeExpr ***************************
+*****************************************************************************/
+
+// Common part of the interior nodes: their value always lands in a scratch tile
+
+template <typename EXPR>
+class DCVImageNodeExpr : public DCVImageExpr<EXPR>
+   {
+   public :
+      cv::Mat Ref(const cv::Range& Rows, cv::Mat* pScratch) const
+         {
+         this->Self().EvalInto(Rows, pScratch[0], pScratch + 1);
+
+         return (pScratch[0]);
+         }
+
+   protected :
+
+   private :
+   };  // End of class DCVImageNodeExpr
+
+/*****************************************************************************
+************************** Element-wise operations ***************************
+*****************************************************************************/
+
+struct DCVAddOp
+   {
+   static void Apply(const cv::Mat& A, const cv::Mat& B, cv::Mat& Out)
+      {
+      cv::add(A, B, Out);
+      }
+
+   static void Apply(const cv::Mat& A, const cv::Scalar& s, cv::Mat& Out)
+      {
+      cv::add(A, s, Out);
+      }
+   };
+
+struct DCVSubtractOp
+   {
+   static void Apply(const cv::Mat& A, const cv::Mat& B, cv::Mat& Out)
+      {
+      cv::subtract(A, B, Out);
+      }
+
+   static void Apply(const cv::Mat& A, const cv::Scalar& s, cv::Mat& Out)
+      {
+      cv::subtract(A, s, Out);
+      }
+   };
+
+// Scalar minus image
+struct DCVSubtractFromOp
+   {
+   static void Apply(const cv::Mat& A, const cv::Scalar& s, cv::Mat& Out)
+      {
+      cv::subtract(s, A, Out);
+      }
+   };
+
+struct DCVAbsDiffOp
+   {
+   static void Apply(const cv::Mat& A, const cv::Mat& B, cv::Mat& Out)
+      {
+      cv::absdiff(A, B, Out);
+      }
+
+   static void Apply(const cv::Mat& A, const cv::Scalar& s, cv::Mat& Out)
+      {
+      cv::absdiff(A, s, Out);
+      }
+   };
+
+struct DCVAndOp
+   {
+   static void Apply(const cv::Mat& A, const cv::Mat& B, cv::Mat& Out)
+      {
+      cv::bitwise_and(A, B, Out);
+      }
+
+   static void Apply(const cv::Mat& A, const cv::Scalar& s, cv::Mat& Out)
+      {
+      cv::bitwise_and(A, s, Out);
+      }
+   };
+
+struct DCVOrOp
+   {
+   static void Apply(const cv::Mat& A, const cv::Mat& B, cv::Mat& Out)
+      {
+      cv::bitwise_or(A, B, Out);
+      }
+
+   static void Apply(const cv::Mat& A, const cv::Scalar& s, cv::Mat& Out)
+      {
+      cv::bitwise_or(A, s, Out);
+      }
+   };
+
+struct DCVXorOp
+   {
+   static void Apply(const cv::Mat& A, const cv::Mat& B, cv::Mat& Out)
+      {
+      cv::bitwise_xor(A, B, Out);
+      }
+
+   static void Apply(const cv::Mat& A, const cv::Scalar& s, cv::Mat& Out)
+      {
+      cv::bitwise_xor(A, s, Out);
+      }
+   };
+
+/*****************************************************************************
+************************** class DCVImageBinaryExpr **************************
+*****************************************************************************/
+
+// Two images combined element by element
+
+template <typename L, typename R, typename OP>
+class DCVImageBinaryExpr : public DCVImageNodeExpr<DCVImageBinaryExpr<L, R, OP>>
+   {
+   public :
+      static const int m_nSlots = 1 + L::m_nSlots + R::m_nSlots;
+
+      DCVImageBinaryExpr(const L& Lhs, const R& Rhs) : m_Lhs(Lhs), m_Rhs(Rhs)
+         {
+         CV_Assert(Lhs.GetSize() == Rhs.GetSize());
+
+         return;
+         }
+
+      cv::Size GetSize() const
+         {
+         return (m_Lhs.GetSize());
+         }
+
+      int GetType() const
+         {
+         return (m_Lhs.GetType());
+         }
+
+      void EvalInto(const cv::Range& Rows, cv::Mat& Out, cv::Mat* pScratch) const
+         {
+         cv::Mat A = m_Lhs.Ref(Rows, pScratch);
+         cv::Mat B = m_Rhs.Ref(Rows, pScratch + L::m_nSlots);
+         OP::Apply(A, B, Out);
+
+         return;
+         }
+
+      bool Overlaps(const cv::Mat& Dst) const
+         {
+         return (m_Lhs.Overlaps(Dst) || m_Rhs.Overlaps(Dst));
+         }
+
+   protected :
+      L m_Lhs;
+      R m_Rhs;
+
+   private :
+   };  // End of class DCVImageBinaryExpr
+
+/*****************************************************************************
+************************** class DCVImageScalarExpr **************************
+*****************************************************************************/
+
+// An image combined element by element with a scalar
+
+template <typename E, typename OP>
+class DCVImageScalarExpr : public DCVImageNodeExpr<DCVImageScalarExpr<E, OP>>
+   {
+   public :
+      static const int m_nSlots = 1 + E::m_nSlots;
+
+      DCVImageScalarExpr(const E& Expr, const cv::Scalar& Value) : m_Expr(Expr), m_Value(Value)
+         {
+         return;
+         }
+
+      cv::Size GetSize() const
+         {
+         return (m_Expr.GetSize());
+         }
+
+      int GetType() const
+         {
+         return (m_Expr.GetType());
+         }
+
+      void EvalInto(const cv::Range& Rows, cv::Mat& Out, cv::Mat* pScratch) const
+         {
+         OP::Apply(m_Expr.Ref(Rows, pScratch), m_Value, Out);
+
+         return;
+         }
+
+      bool Overlaps(const cv::Mat& Dst) const
+         {
+         return (m_Expr.Overlaps(Dst));
+         }
+
+   protected :
+      E m_Expr;
+      cv::Scalar m_Value;
+
+   private :
+   };  // End of class DCVImageScalarExpr
+
+/*****************************************************************************
+*************************** class DCVImageNotExpr ****************************
+*****************************************************************************/
+
+template <typename E>
+class DCVImageNotExpr : public DCVImageNodeExpr<DCVImageNotExpr<E>>
+   {
+   public :
+      static const int m_nSlots = 1 + E::m_nSlots;
+
+      explicit DCVImageNotExpr(const E& Expr) : m_Expr(Expr)
+         {
+         return;
+         }
+
+      cv::Size GetSize() const
+         {
+         return (m_Expr.GetSize());
+         }
+
+      int GetType() const
+         {
+         return (m_Expr.GetType());
+         }
+
+      void EvalInto(const cv::Range& Rows, cv::Mat& Out, cv::Mat* pScratch) const
+         {
+         cv::bitwise_not(m_Expr.Ref(Rows, pScratch), Out);
+
+         return;
+         }
+
+      bool Overlaps(const cv::Mat& Dst) const
+         {
+         return (m_Expr.Overlaps(Dst));
+         }
+
+   protected :
+      E m_Expr;
+
+   private :
+   };  // End of class DCVImageNotExpr
+
+/*****************************************************************************
+************************** class DCVImageScaleExpr ***************************
+*****************************************************************************/
+
+// Saturating Alpha * x + Beta keeping the type of x
+
+template <typename E>
+class DCVImageScaleExpr : public DCVImageNodeExpr<DCVImageScaleExpr<E>>
+   {
+   public :
+      static const int m_nSlots = 1 + E::m_nSlots;
+
+      DCVImageScaleExpr(const E& Expr, double dAlpha, double dBeta = 0.0)
+            : m_Expr(Expr), m_dAlpha(dAlpha), m_dBeta(dBeta)
+         {
+         return;
+         }
+
+      cv::Size GetSize() const
+         {
+         return (m_Expr.GetSize());
+         }
+
+      int GetType() const
+         {
+         return (m_Expr.GetType());
+         }
+
+      void EvalInto(const cv::Range& Rows, cv::Mat& Out, cv::Mat* pScratch) const
+         {
+         m_Expr.Ref(Rows, pScratch).convertTo(Out, -1, m_dAlpha, m_dBeta);
+
+         return;
+         }
+
+      // Fold repeated scaling into a single pass
+      DCVImageScaleExpr Scale(double dAlpha, double dBeta) const
+         {
+         return (DCVImageScaleExpr(m_Expr, m_dAlpha * dAlpha, (m_dBeta * dAlpha) + dBeta));
+         }
+
+      bool Overlaps(const cv::Mat& Dst) const
+         {
+         return (m_Expr.Overlaps(Dst));
+         }
+
+   protected :
+      E m_Expr;
+      double m_dAlpha;
+      double m_dBeta;
+
+   private :
+   };  // End of class DCVImageScaleExpr
+
+/*****************************************************************************
+************************* class DCVImageWeightedExpr *************************
+*****************************************************************************/
+
+// Alpha * a + Beta * b + Gamma
+
+template <typename L, typename R>
+class DCVImageWeightedExpr : public DCVImageNodeExpr<DCVImageWeightedExpr<L, R>>
+   {
+   public :
+      static const int m_nSlots = 1 + L::m_nSlots + R::m_nSlots;
+
+      DCVImageWeightedExpr(const L& Lhs, double dAlpha, const R& Rhs, double dBeta, double dGamma)
+            : m_Lhs(Lhs), m_Rhs(Rhs), m_dAlpha(dAlpha), m_dBeta(dBeta), m_dGamma(dGamma)
+         {
+         CV_Assert(Lhs.GetSize() == Rhs.GetSize());
+
+         return;
+         }
+
+      cv::Size GetSize() const
+         {
+         return (m_Lhs.GetSize());
+         }
+
+      int GetType() const
+         {
+         return (m_Lhs.GetType());
+         }
+
+      void EvalInto(const cv::Range& Rows, cv::Mat& Out, cv::Mat* pScratch) const
+         {
+         cv::Mat A = m_Lhs.Ref(Rows, pScratch);
+         cv::Mat B = m_Rhs.Ref(Rows, pScratch + L::m_nSlots);
+         cv::addWeighted(A, m_dAlpha, B, m_dBeta, m_dGamma, Out);
+
+         return;
+         }
+
+      bool Overlaps(const cv::Mat& Dst) const
+         {
+         return (m_Lhs.Overlaps(Dst) || m_Rhs.Overlaps(Dst));
+         }
+
+   protected :
+      L m_Lhs;
+      R m_Rhs;
+      double m_dAlpha;
+      double m_dBeta;
+      double m_dGamma;
+
+   private :
+   };  // End of class DCVImageWeightedExpr
+
+/*****************************************************************************
+************************** class DCVImageExprBody ****************************
+*****************************************************************************/
+
+/*
+   Parallel body evaluating an expression into the destination.  Each band
+   of tiles keeps its own scratch tiles so they are allocated once per band
+   rather than once per tile.
+*/
+
+template <typename EXPR>
+class DCVImageExprBody : public cv::ParallelLoopBody
+   {
+   public :
+      DCVImageExprBody(const EXPR& Expr, cv::Mat& Dst, int nTileRows)
+            : m_Expr(Expr), m_Dst(Dst), m_nTileRows(nTileRows)
+         {
+         return;
+         }
+
+      virtual void operator()(const cv::Range& Tiles) const
+         {
+         std::vector<cv::Mat> Scratch(static_cast<size_t>(EXPR::m_nSlots));
+         for (int t = Tiles.start ; t < Tiles.end ; t++)
+            {
+            cv::Range Rows(t * m_nTileRows, std::min((t + 1) * m_nTileRows, m_Dst.rows));
+            cv::Mat Out = m_Dst.rowRange(Rows);
+            m_Expr.EvalInto(Rows, Out, Scratch.data());
+            } // end for
+
+         return;
+         }
+
+   protected :
+      const EXPR& m_Expr;
+      cv::Mat& m_Dst;
+      int m_nTileRows;
+
+   private :
+   };  // End of class DCVImageExprBody
+
+/*****************************************************************************
+*
+***  DCVImageEvaluate
+*
+*  Evaluate an expression into Dst in one tiled pass.  Dst is only
+*  reallocated if it isn't already the size and type of the result.  When
+*  Dst partly overlaps an operand the pass writes a temporary instead.
+*
+*****************************************************************************/
+
+template <typename EXPR>
+void DCVImageEvaluate(cv::Mat& Dst, const DCVImageExpr<EXPR>& Expr)
+   {
+   const EXPR& E = Expr.Self();
+   Dst.create(E.GetSize(), E.GetType());
+
+   if (E.Overlaps(Dst))
+      {
+      cv::Mat Temp;
+      DCVImageEvaluate(Temp, Expr);
+      Temp.copyTo(Dst);
+      } // end if
+   else if (!Dst.empty())
+      {
+      // Tiles of about 32KB of result keep the scratch tiles of a few
+      // operations in the L2 cache together
+      const size_t nTileBytes = 32 * 1024;
+      int nTileRows = std::max(1, static_cast<int>(nTileBytes / (Dst.cols * Dst.elemSize())));
+      int nTiles = (Dst.rows + nTileRows - 1) / nTileRows;
+
+      DCVImageExprBody<EXPR> Body(E, Dst, nTileRows);
+      cv::parallel_for_(cv::Range(0, nTiles), Body);
+      } // end if
+
+   return;
+
+   } // End of function DCVImageEvaluate
+
+/*****************************************************************************
+*
+***  DCVImage expression members
+*
+*****************************************************************************/
+
+template <typename EXPR>
+DCVImage::DCVImage(const DCVImageExpr<EXPR>& Expr)
+   {
+   DCVImageEvaluate(*this, Expr);
+
+   return;
+
+   } // End of function DCVImage::DCVImage
+
+template <typename EXPR>
+DCVImage& DCVImage::operator=(const DCVImageExpr<EXPR>& Expr)
+   {
+   DCVImageEvaluate(*this, Expr);
+
+   return (*this);
+
+   } // End of function DCVImage::operator=
+
+/*****************************************************************************
+*************************** Expression Operators *****************************
+*****************************************************************************/
+
+// Start an expression from an image
+inline DCVImageTerm Lazy(const cv::Mat& Image)
+   {
+   return (DCVImageTerm(Image));
+   }
+
+#define DCVIMAGEEXPR_BINARY_OPERATOR(OPERATOR, OP)                                                        \
+template <typename L, typename R>                                                                         \
+DCVImageBinaryExpr<L, R, OP> operator OPERATOR(const DCVImageExpr<L>& Lhs, const DCVImageExpr<R>& Rhs)     \
+   {                                                                                                      \
+   return (DCVImageBinaryExpr<L, R, OP>(Lhs.Self(), Rhs.Self()));                                         \
+   }                                                                                                      \
+                                                                                                          \
+template <typename L>                                                                                     \
+DCVImageBinaryExpr<L, DCVImageTerm, OP> operator OPERATOR(const DCVImageExpr<L>& Lhs, const cv::Mat& Rhs) \
+   {                                                                                                      \
+   return (DCVImageBinaryExpr<L, DCVImageTerm, OP>(Lhs.Self(), DCVImageTerm(Rhs)));                       \
+   }                                                                                                      \
+                                                                                                          \
+template <typename R>                                                                                     \
+DCVImageBinaryExpr<DCVImageTerm, R, OP> operator OPERATOR(const cv::Mat& Lhs, const DCVImageExpr<R>& Rhs) \
+   {                                                                                                      \
+   return (DCVImageBinaryExpr<DCVImageTerm, R, OP>(DCVImageTerm(Lhs), Rhs.Self()));                       \
+   }                                                                                                      \
+                                                                                                          \
+template <typename L>                                                                                     \
+DCVImageScalarExpr<L, OP> operator OPERATOR(const DCVImageExpr<L>& Lhs, const cv::Scalar& Rhs)            \
+   {                                                                                                      \
+   return (DCVImageScalarExpr<L, OP>(Lhs.Self(), Rhs));                                                   \
+   }
+
+DCVIMAGEEXPR_BINARY_OPERATOR(+, DCVAddOp)
+DCVIMAGEEXPR_BINARY_OPERATOR(-, DCVSubtractOp)
+DCVIMAGEEXPR_BINARY_OPERATOR(&, DCVAndOp)
+DCVIMAGEEXPR_BINARY_OPERATOR(|, DCVOrOp)
+DCVIMAGEEXPR_BINARY_OPERATOR(^, DCVXorOp)
+
+#undef DCVIMAGEEXPR_BINARY_OPERATOR
+
+// Scalar minus an expression
+template <typename R>
+DCVImageScalarExpr<R, DCVSubtractFromOp> operator-(const cv::Scalar& Lhs, const DCVImageExpr<R>& Rhs)
+   {
+   return (DCVImageScalarExpr<R, DCVSubtractFromOp>(Rhs.Self(), Lhs));
+   }
+
+template <typename E>
+DCVImageNotExpr<E> operator~(const DCVImageExpr<E>& Expr)
+   {
+   return (DCVImageNotExpr<E>(Expr.Self()));
+   }
+
+template <typename E>
+DCVImageScaleExpr<E> operator*(const DCVImageExpr<E>& Expr, double dScale)
+   {
+   return (DCVImageScaleExpr<E>(Expr.Self(), dScale));
+   }
+
+template <typename E>
+DCVImageScaleExpr<E> operator*(double dScale, const DCVImageExpr<E>& Expr)
+   {
+   return (DCVImageScaleExpr<E>(Expr.Self(), dScale));
+   }
+
+template <typename E>
+DCVImageScaleExpr<E> operator*(const DCVImageScaleExpr<E>& Expr, double dScale)
+   {
+   return (Expr.Scale(dScale, 0.0));
+   }
+
+// Saturating Alpha * x + Beta
+template <typename E>
+DCVImageScaleExpr<E> Scale(const DCVImageExpr<E>& Expr, double dAlpha, double dBeta = 0.0)
+   {
+   return (DCVImageScaleExpr<E>(Expr.Self(), dAlpha, dBeta));
+   }
+
+template <typename L, typename R>
+DCVImageBinaryExpr<L, R, DCVAbsDiffOp> AbsDiff(const DCVImageExpr<L>& Lhs, const DCVImageExpr<R>& Rhs)
+   {
+   return (DCVImageBinaryExpr<L, R, DCVAbsDiffOp>(Lhs.Self(), Rhs.Self()));
+   }
+
+template <typename L>
+DCVImageBinaryExpr<L, DCVImageTerm, DCVAbsDiffOp> AbsDiff(const DCVImageExpr<L>& Lhs, const cv::Mat& Rhs)
+   {
+   return (DCVImageBinaryExpr<L, DCVImageTerm, DCVAbsDiffOp>(Lhs.Self(), DCVImageTerm(Rhs)));
+   }
+
+template <typename L, typename R>
+DCVImageWeightedExpr<L, R> AddWeighted(const DCVImageExpr<L>& Lhs, double dAlpha,
+      const DCVImageExpr<R>& Rhs, double dBeta, double dGamma)
+   {
+   return (DCVImageWeightedExpr<L, R>(Lhs.Self(), dAlpha, Rhs.Self(), dBeta, dGamma));
+   }
+
+#endif // __CVIMAGEEXPR_H__
@@ -6,7 +6,14 @@
 #include <boost/filesystem/path.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <limits>
+
 #include "CameraCalibration.h"
+#include "CameraCalibrationFile.h"
+#include "CVImage.h"
 
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
@@ -31,7 +38,9 @@ const std::string CameraCalibrationBoard::m_strSquareSize("SquareSize");
 CameraCalibrationBoard::CameraCalibrationBoard() :
       m_ePattern(EPattern::eChessBoard),
       m_BoardSize(10, 7),
-      m_fSquareSize(1.0f)
+      m_fSquareSize(1.0f),
+      m_eCachedPattern(EPattern::eChessBoard),
+      m_fCachedSquareSize(0.0f)
    {
 
    return;
@@ -51,6 +60,13 @@ CameraCalibrationBoard::CameraCalibrationBoard(
    m_BoardSize = src.m_BoardSize;
    m_fSquareSize = src.m_fSquareSize;
 
+   // The cache is never modified in place so sharing it is safe
+   std::lock_guard<std::mutex> Lock(src.m_CacheMutex);
+   m_ObjectPoints = src.m_ObjectPoints;
+   m_eCachedPattern = src.m_eCachedPattern;
+   m_CachedBoardSize = src.m_CachedBoardSize;
+   m_fCachedSquareSize = src.m_fCachedSquareSize;
+
    return;
 
    } // end of method CameraCalibrationBoard::CameraCalibrationBoard
@@ -69,6 +85,12 @@ CameraCalibrationBoard& CameraCalibrationBoard::operator=(
       m_ePattern = rhs.m_ePattern;
       m_BoardSize = rhs.m_BoardSize;
       m_fSquareSize = rhs.m_fSquareSize;
+
+      std::lock_guard<std::mutex> Lock(rhs.m_CacheMutex);
+      m_ObjectPoints = rhs.m_ObjectPoints;
+      m_eCachedPattern = rhs.m_eCachedPattern;
+      m_CachedBoardSize = rhs.m_CachedBoardSize;
+      m_fCachedSquareSize = rhs.m_fCachedSquareSize;
       } // end if
 
    return (*this);
@@ -160,432 +182,2143 @@ void read(const cv::FileNode& Node, CameraCalibrationBoard& X,
 
    } // end of function read
 
-/*****************************************************************************
- ***  class CameraCalibration
- ****************************************************************************/
-
-// Element serialization names
-const std::string CameraCalibration::m_strID("Calibration_Settings");
-const std::string CameraCalibration::m_strBoard("Chessboard");
-const std::string CameraCalibration::m_strFixAspectRatio("FixAspectRatio");
-const std::string CameraCalibration::m_strFlag("ControlFlags");
-const std::string CameraCalibration::m_strCameraMatrix("CameraMatrix");
-const std::string CameraCalibration::m_strDistortionCoeffs("DistortionCoefficents");
-const std::string CameraCalibration::m_strRVecs("RVecs");
-const std::string CameraCalibration::m_strTVecs("TVecs");
-const std::string CameraCalibration::m_strRMS("RMSError");
-const std::string CameraCalibration::m_strReprojErrors("ReprojectionErrors");
-const std::string CameraCalibration::m_strTotalAvgError("TotalAverageError");
-const std::string CameraCalibration::m_strImagePoints("ImagePoints");
-const std::string CameraCalibration::m_strGoodImages("NumberImagesUsed");
-const std::string CameraCalibration::m_strImageSize("ImageSize");
-const std::string CameraCalibration::m_strSaveImages("SaveImages");
-
 /******************************************************************************
 *
-***  CameraCalibration::CameraCalibration
-*
-******************************************************************************/
-
-CameraCalibration::CameraCalibration() :
-      m_ImageSize(640, 480),
-      m_bFixAspectRatio(false),
-      m_nFlag(0),
-      m_dRMS(0.0),
-      m_dTotalAvgError(0.0),
-      m_nGoodImages(0),
-      m_bSaveImages(true)
-   {
-   m_CameraMatrix = cv::Mat::eye(3, 3, CV_64F);
-   m_DistortionCoeffs = cv::Mat::zeros(8, 1, CV_64F);
-
-   return;
-
-   } // end of method CameraCalibration::CameraCalibration
-
-/******************************************************************************
+***  CameraCalibrationBoard::FindPattern
 *
-***  CameraCalibration::CameraCalibration
+* Find the feature points of the board's pattern in the image.  Chessboard
+* corners are refined to sub-pixel accuracy using the gray image.
 *
 ******************************************************************************/
 
-CameraCalibration::CameraCalibration(const CameraCalibration& src)
+bool CameraCalibrationBoard::FindPattern(const cv::Mat& Image,
+      const cv::Mat& GrayImage, std::vector<cv::Point2f>& Points,
+      int nCoarseWidth /* = 0 */) const
    {
-   m_Board = src.m_Board;
-   m_bFixAspectRatio = src.m_bFixAspectRatio;
-   m_nFlag = src.m_nFlag;
-   m_ImageSize = src. m_ImageSize;
-   m_CameraMatrix = src.m_CameraMatrix;
-   m_DistortionCoeffs = src.m_DistortionCoeffs;
-   m_TVecs = src.m_TVecs;
-   m_RVecs = src.m_RVecs;
-   m_dRMS = src.m_dRMS;
-   m_dTotalAvgError = src. m_dTotalAvgError;
-   m_ReprojErrors = src.m_ReprojErrors;
-   m_ImagePoints = src.m_ImagePoints;
-   m_Images = src.m_Images;
-   m_nGoodImages = src.m_nGoodImages;
-   m_bSaveImages = src.m_bSaveImages;
+   if ((m_ePattern == EPattern::eChessBoard) && (nCoarseWidth > 0)
+         && (GrayImage.cols >= 2 * nCoarseWidth))
+      {
+      return (FindChessboardCoarseToFine(GrayImage, Points, nCoarseWidth));
+      } // end if
 
-   return;
+   // Find feature points on the input format
+   bool bFound = false;
+   switch (m_ePattern)
+      {
+      case EPattern::eChessBoard:
+         bFound = cv::findChessboardCorners(Image, m_BoardSize,
+               Points, CV_CALIB_CB_ADAPTIVE_THRESH |
+               CV_CALIB_CB_FAST_CHECK | CV_CALIB_CB_NORMALIZE_IMAGE);
+         break;
 
-   } // end of method CameraCalibration::CameraCalibration
+      case EPattern::eCirclesGrid:
+         bFound = cv::findCirclesGrid(Image, m_BoardSize, Points);
+         break;
 
-/******************************************************************************
-*
-***  CameraCalibration::operator=
-*
-******************************************************************************/
+      case EPattern::eAsymmetricCirclesGrid:
+         bFound = cv::findCirclesGrid(Image, m_BoardSize,
+               Points, cv::CALIB_CB_ASYMMETRIC_GRID);
+         break;
 
-CameraCalibration& CameraCalibration::operator=(const CameraCalibration& rhs)
-   {
-   if (this != &rhs)
+      default:
+         break;
+      } // end switch
+
+   // improve the bFound corners' coordinate accuracy for chessboard
+   if (bFound && (m_ePattern == EPattern::eChessBoard))
       {
-      m_Board = rhs.m_Board;
-      m_bFixAspectRatio = rhs.m_bFixAspectRatio;
-      m_nFlag = rhs.m_nFlag;
-      m_ImageSize = rhs. m_ImageSize;
-      m_CameraMatrix = rhs.m_CameraMatrix;
-      m_DistortionCoeffs = rhs.m_DistortionCoeffs;
-      m_TVecs = rhs.m_TVecs;
-      m_RVecs = rhs.m_RVecs;
-      m_dRMS = rhs.m_dRMS;
-      m_dTotalAvgError = rhs. m_dTotalAvgError;
-      m_ReprojErrors = rhs.m_ReprojErrors;
-      m_ImagePoints = rhs.m_ImagePoints;
-      m_Images = rhs.m_Images;
-      m_nGoodImages = rhs.m_nGoodImages;
-      m_bSaveImages = rhs.m_bSaveImages;
+      cv::cornerSubPix(GrayImage, Points, cv::Size(11,11),
+            cv::Size(-1,-1),
+            cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1));
       } // end if
 
-   return (*this);
+   return (bFound);
 
-   } // end of method CameraCalibration::operator=
+   } // end of method CameraCalibrationBoard::FindPattern
 
 /******************************************************************************
 *
-***  CameraCalibration::Initialize
+***  MinCornerSpacing
 *
-* Initialize the control elements and clear the calculated members as a prep
-* for running a new calibration.
+* Smallest distance between neighboring chessboard corners.  Bounds the
+* cornerSubPix search window so it never reaches a neighboring corner.
 *
 ******************************************************************************/
 
-bool CameraCalibration::Initialize(const CameraCalibrationBoard& Board,
-      const cv::Size& ImageSize, bool bFixAspectRatio, int nFlag,
-      bool bSaveImages /* = false */)
+static float MinCornerSpacing(const std::vector<cv::Point2f>& Points,
+      const cv::Size& BoardSize)
    {
-   bool bRet = true;
-
-   m_nGoodImages = 0;
-   m_RVecs.clear();
-   m_TVecs.clear();
-   m_ReprojErrors.clear();
-   m_ImagePoints.clear();
-   m_Images.clear();
-   m_dRMS = 0.0;
-   m_dTotalAvgError = 0.0;
+   float fMin2 = std::numeric_limits<float>::max();
 
-   m_CameraMatrix = cv::Mat::eye(3, 3, CV_64F);
-   m_DistortionCoeffs = cv::Mat::zeros(8, 1, CV_64F);
+   for (int i = 0 ; i < BoardSize.height ; i++)
+      {
+      for (int j = 0 ; j < BoardSize.width ; j++)
+         {
+         const cv::Point2f& Pt = Points[i * BoardSize.width + j];
+         if (j + 1 < BoardSize.width)
+            {
+            cv::Point2f d = Points[i * BoardSize.width + j + 1] - Pt;
+            fMin2 = std::min(fMin2, d.dot(d));
+            } // end if
 
-   m_Board = Board;
-   m_bFixAspectRatio = bFixAspectRatio;
-   m_nFlag = nFlag;
-   m_ImageSize = ImageSize;
-   m_bSaveImages = bSaveImages;
+         if (i + 1 < BoardSize.height)
+            {
+            cv::Point2f d = Points[(i + 1) * BoardSize.width + j] - Pt;
+            fMin2 = std::min(fMin2, d.dot(d));
+            } // end if
+         } // end for
+      } // end for
 
-   return (bRet);
+   return (std::sqrt(fMin2));
 
-   } // end of method CameraCalibration::Initialize
+   } // end of function MinCornerSpacing
 
 /******************************************************************************
 *
-***  CameraCalibration::ProcessImage
+***  CameraCalibrationBoard::FindChessboardCoarseToFine
 *
-* Takes an "original" image and the gray conversion of that image.  Allows the
-* calling program to do any preprocessing desired on both images.
+* Find the chessboard on a reduced Gaussian pyramid level then carry the
+* corners back up a level at a time, refining with cornerSubPix at each.  The
+* full resolution refinement uses the same criteria as the direct search so
+* the sub-pixel accuracy is unchanged; only the expensive search is done on
+* the small image.
 *
-* bUseImage indicates whether to use the image in the calibration.  Some
-* programs may want to preview live images to the user with annotation.
+* CV_CALIB_CB_FAST_CHECK on the coarse level is the fast reject for frames
+* without a board; those never touch the full resolution image.
 *
 ******************************************************************************/
 
-bool CameraCalibration::ProcessImage(cv::Mat& Image, cv::Mat& GrayImage,
-      bool bAnnotateImage, bool bUseImage)
+bool CameraCalibrationBoard::FindChessboardCoarseToFine(
+      const cv::Mat& GrayImage, std::vector<cv::Point2f>& Points,
+      int nCoarseWidth) const
    {
-   std::vector<cv::Point2f> Points;
-
-   // Find feature points on the input format
-   bool bFound = false;
-   switch (m_Board.m_ePattern)
+   // Build the pyramid down to the first level no wider than nCoarseWidth * 2
+   std::vector<DCVImage> Pyramid(1, DCVImage(GrayImage));
+   while (Pyramid.back().cols >= 2 * nCoarseWidth)
       {
-      case CameraCalibrationBoard::EPattern::eChessBoard:
-         bFound = cv::findChessboardCorners(Image, m_Board.m_BoardSize,
-               Points, CV_CALIB_CB_ADAPTIVE_THRESH |
-               CV_CALIB_CB_FAST_CHECK | CV_CALIB_CB_NORMALIZE_IMAGE);
-         break;
-
-      case CameraCalibrationBoard::EPattern::eCirclesGrid:
-         bFound = cv::findCirclesGrid(Image, m_Board.m_BoardSize, Points);
-         break;
+      DCVImage Level;
+      Pyramid.back().PyramidDown(Level);
+      Pyramid.push_back(Level);
+      } // end while
 
-      case CameraCalibrationBoard::EPattern::eAsymmetricCirclesGrid:
-         bFound = cv::findCirclesGrid(Image, m_Board.m_BoardSize,
-               Points, cv::CALIB_CB_ASYMMETRIC_GRID);
-         break;
-
-      default:
-         break;
-      } // end switch
+   bool bFound = cv::findChessboardCorners(Pyramid.back(), m_BoardSize,
+         Points, CV_CALIB_CB_ADAPTIVE_THRESH |
+         CV_CALIB_CB_FAST_CHECK | CV_CALIB_CB_NORMALIZE_IMAGE);
 
    if (bFound)
       {
-      // improve the bFound corners' coordinate accuracy for chessboard
-      if (m_Board.m_ePattern == CameraCalibrationBoard::EPattern::eChessBoard)
+      for (int nLevel = static_cast<int>(Pyramid.size()) - 2 ; nLevel >= 0 ; nLevel--)
          {
-         cv::cornerSubPix(GrayImage, Points, cv::Size(11,11),
-               cv::Size(-1,-1),
-               cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1));
-         } // end if
+         // pyrDown keeps pixel 2x of the finer level at pixel x
+         for (auto& Pt : Points)
+            {
+            Pt *= 2.0f;
+            } // end for
 
-      if (bUseImage)
-         {
-         // Include this image in the calibration calculation
-         m_ImagePoints.push_back(Points);
-         m_nGoodImages++;
+         // Same window as the full resolution search unless the squares are
+         // too small for it at this level
+         int nWin = std::max(2, std::min(11,
+               static_cast<int>(MinCornerSpacing(Points, m_BoardSize) * 0.4f)));
 
-         // Save the images for future reprocessing before being annotated
-         if (m_bSaveImages)
-            {
-            m_Images.push_back(Image.clone());
-            } // end if
-         } // end if
+         // The intermediate levels only need to get close
+         cv::TermCriteria Criteria = (nLevel == 0)
+               ? cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1)
+               : cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 10, 0.25);
 
-      if (bAnnotateImage)
-         {
-         // Draw the corners.
-         cv::drawChessboardCorners(Image, m_Board.m_BoardSize,
-               cv::Mat(Points), bFound);
-         } // end if
+         cv::cornerSubPix(Pyramid[nLevel], Points, cv::Size(nWin, nWin),
+               cv::Size(-1,-1), Criteria);
+         } // end for
       } // end if
 
    return (bFound);
 
-   } // end of method CameraCalibration::ProcessImage
+   } // end of method CameraCalibrationBoard::FindChessboardCoarseToFine
 
 /******************************************************************************
 *
-***  CameraCalibration::CalcBoardCornerPositions
+***  CameraCalibrationBoard::GetObjectPoints
 *
-* Produce a vector of 3D point coordinates for the board corners based on the
-* pattern and specified size.
+* Produce the 3D point coordinates for the board corners based on the
+* pattern and specified size.  Written straight into a preallocated Mat.
 *
 ******************************************************************************/
 
-void CameraCalibration::CalcBoardCornerPositions(
-      std::vector<cv::Point3f>& Corners)
+const cv::Mat& CameraCalibrationBoard::GetObjectPoints() const
    {
-   Corners.clear();
-
-   switch (m_Board.m_ePattern)
+   std::lock_guard<std::mutex> Lock(m_CacheMutex);
+   if (m_ObjectPoints.empty() || (m_eCachedPattern != m_ePattern)
+         || (m_CachedBoardSize != m_BoardSize)
+         || (m_fCachedSquareSize != m_fSquareSize))
       {
-      case CameraCalibrationBoard::EPattern::eChessBoard:
-      case CameraCalibrationBoard::EPattern::eCirclesGrid:
-         for (int i = 0 ; i < m_Board.m_BoardSize.height ; i++)
-            {
-            for (int j = 0 ; j < m_Board.m_BoardSize.width ; j++)
-               {
-               Corners.push_back(cv::Point3f((j * m_Board.m_fSquareSize), (i * m_Board.m_fSquareSize), 0.0f));
-               } // end for
-            } // end for
-
-         break;
+      // A new Mat, never rewritten, so copies already handed out stay valid
+      cv::Mat Corners(m_BoardSize.area(), 1, CV_32FC3);
+      cv::Point3f* pCorner = Corners.ptr<cv::Point3f>();
 
-      case CameraCalibrationBoard::EPattern::eAsymmetricCirclesGrid:
-         for (int i = 0 ; i < m_Board.m_BoardSize.height ; i++)
+      for (int i = 0 ; i < m_BoardSize.height ; i++)
+         {
+         for (int j = 0 ; j < m_BoardSize.width ; j++)
             {
-            for (int j = 0 ; j < m_Board.m_BoardSize.width ; j++)
-               {
-               Corners.push_back(cv::Point3f((((2 * j) + (i % 2)) * m_Board.m_fSquareSize),
-                     (i * m_Board.m_fSquareSize), 0.0f));
-               } // end for
+            // The asymmetric grid's rows are offset by half a spacing
+            float fX = (m_ePattern == EPattern::eAsymmetricCirclesGrid)
+                  ? (((2 * j) + (i % 2)) * m_fSquareSize) : (j * m_fSquareSize);
+            *pCorner++ = cv::Point3f(fX, (i * m_fSquareSize), 0.0f);
             } // end for
+         } // end for
 
-         break;
-
-      default:
-         break;
-      }
+      m_ObjectPoints = Corners;
+      m_eCachedPattern = m_ePattern;
+      m_CachedBoardSize = m_BoardSize;
+      m_fCachedSquareSize = m_fSquareSize;
+      } // end if
 
-   return;
+   return (m_ObjectPoints);
 
-   } // end of method CameraCalibration::CalcBoardCornerPositions
+   } // end of method CameraCalibrationBoard::GetObjectPoints
 
 /******************************************************************************
 *
-***  CameraCalibration::RunCalibration
-*
-* Perform the actual calibration calculations.
+***  CameraCalibrationBoard::GetObjectPoints
 *
 ******************************************************************************/
 
-bool CameraCalibration::RunCalibration()
+cv::Mat CameraCalibrationBoard::GetObjectPoints(const std::vector<int>& Ids) const
    {
-   m_CameraMatrix = cv::Mat::eye(3, 3, CV_64F);
-   if (m_bFixAspectRatio)
+   const cv::Mat& AllPoints = GetObjectPoints();
+   const cv::Point3f* pAll = AllPoints.ptr<cv::Point3f>();
+
+   cv::Mat Subset(static_cast<int>(Ids.size()), 1, CV_32FC3);
+   cv::Point3f* pSubset = Subset.ptr<cv::Point3f>();
+   for (size_t i = 0 ; i < Ids.size() ; i++)
       {
-      m_CameraMatrix.at<double>(0,0) = 1.0;
-      } // end if
+      CV_Assert((Ids[i] >= 0) && (Ids[i] < AllPoints.rows));
+      pSubset[i] = pAll[Ids[i]];
+      } // end for
 
-   m_DistortionCoeffs = cv::Mat::zeros(8, 1, CV_64F);
+   return (Subset);
 
-   std::vector<std::vector<cv::Point3f>> ObjectPoints(1);
-   CalcBoardCornerPositions(ObjectPoints[0]);
+   } // end of method CameraCalibrationBoard::GetObjectPoints
 
-   ObjectPoints.resize(m_ImagePoints.size(), ObjectPoints[0]);
+/******************************************************************************
+*
+***  CameraCalibrationBoard::DrawPattern
+*
+* Annotate the image with the detected pattern points.
+*
+******************************************************************************/
 
-   //Find intrinsic and extrinsic camera parameters
-   m_dRMS = cv::calibrateCamera(ObjectPoints, m_ImagePoints, m_ImageSize,
-         m_CameraMatrix, m_DistortionCoeffs,
-         m_RVecs, m_TVecs, m_nFlag);
+void CameraCalibrationBoard::DrawPattern(cv::Mat& Image,
+      const std::vector<cv::Point2f>& Points, bool bFound) const
+   {
+   cv::drawChessboardCorners(Image, m_BoardSize, cv::Mat(Points), bFound);
 
-//   cout << "Re-projection error reported by calibrateCamera: "<< rms << endl;
+   return;
 
-   bool bGood = checkRange(m_CameraMatrix) && checkRange(m_DistortionCoeffs);
+   } // end of method CameraCalibrationBoard::DrawPattern
 
-   m_dTotalAvgError = ComputeReprojectionErrors(ObjectPoints);
+/*****************************************************************************
+ ***  class CameraCalibrationImageStore
+ ****************************************************************************/
 
-   return (bGood);
+/******************************************************************************
+*
+***  CameraCalibrationImageStore::CameraCalibrationImageStore
+*
+******************************************************************************/
 
-   } // end of method CameraCalibration::RunCalibration
+CameraCalibrationImageStore::CameraCalibrationImageStore() :
+      m_eStorage(EStorage::eRaw),
+      m_strFormat(".png"),
+      m_bCropToBoard(false),
+      m_nMargin(32)
+   {
+
+   return;
+
+   } // end of method CameraCalibrationImageStore::CameraCalibrationImageStore
 
 /******************************************************************************
 *
-***  CameraCalibration::ComputeReprojectionErrors
+***  CameraCalibrationImageStore::SetStorage
 *
 ******************************************************************************/
 
-double CameraCalibration::ComputeReprojectionErrors(
-      const std::vector<std::vector<cv::Point3f> >& ObjectPoints)
+void CameraCalibrationImageStore::SetStorage(EStorage eStorage,
+      const std::string& strFormat /* = std::string(".png") */,
+      const std::string& strDirectory /* = std::string() */)
    {
-   std::vector<cv::Point2f> ImagePoints2;
-   int nTotalPoints = 0;
-   double dTotalErr = 0.0;
-   m_ReprojErrors.resize(ObjectPoints.size());
+   m_eStorage = eStorage;
+   m_strFormat = strFormat;
+   m_strDirectory = strDirectory;
+   m_pTempDirectory.reset();
 
-   for (size_t i = 0 ; i < ObjectPoints.size() ; i++)
+   if ((m_eStorage == EStorage::eDisk) && m_strDirectory.empty())
       {
-      cv::projectPoints(cv::Mat(ObjectPoints[i]), m_RVecs[i], m_TVecs[i],
-            m_CameraMatrix, m_DistortionCoeffs, ImagePoints2);
-      double dErr = cv::norm(cv::Mat(m_ImagePoints[i]), cv::Mat(ImagePoints2), CV_L2);
-
-      int n = static_cast<int>(ObjectPoints[i].size());
-      double dErr2 = dErr * dErr;
-      m_ReprojErrors[i] = std::sqrt(dErr2 / n);
-      dTotalErr += dErr2;
-      nTotalPoints += n;
-      } // end for
+      boost::filesystem::path Dir = boost::filesystem::temp_directory_path()
+            / boost::filesystem::unique_path("calibration-%%%%-%%%%-%%%%");
+      m_strDirectory = Dir.string();
+      m_pTempDirectory = std::shared_ptr<const std::string>(
+            new std::string(m_strDirectory),
+            [](const std::string* pName)
+               {
+               boost::system::error_code Error;
+               boost::filesystem::remove_all(*pName, Error);
+               delete pName;
+               });
+      } // end if
 
-   return (std::sqrt(dTotalErr / nTotalPoints));
+   return;
 
-   } // end of method CameraCalibration::ComputeReprojectionErrors
+   } // end of method CameraCalibrationImageStore::SetStorage
 
 /******************************************************************************
 *
-***  CameraCalibration::Write
+***  CameraCalibrationImageStore::GetEncodeParams
 *
-* Write the calibration to file using OpenCV's FileStorage system.  Produces
-* either XML or YAML formats based on the supplied name extension (.xml, .yml).
+* Favor speed for PNG since the frames are only kept for the session.
 *
 ******************************************************************************/
 
-bool CameraCalibration::Write(const std::string& strFileName) const
+std::vector<int> CameraCalibrationImageStore::GetEncodeParams() const
    {
-   cv::FileStorage FS(strFileName, cv::FileStorage::WRITE);
-   bool bRet = FS.isOpened();
-   if (bRet)
-      {
-      bRet = Write(FS);
-      } // end if
+   std::vector<int> Params;
 
-   if (m_bSaveImages)
+   if (m_strFormat == ".png")
       {
-      // Strip off the extension
-      boost::filesystem::path Path(strFileName);
-      boost::filesystem::path Dir(Path.parent_path());
-      boost::filesystem::path File = Path.stem();
-      Dir /= File;
-
-      WriteImages(Dir.string());
+      Params.push_back(cv::IMWRITE_PNG_COMPRESSION);
+      Params.push_back(1);
       } // end if
+   else if ((m_strFormat == ".jpg") || (m_strFormat == ".jpeg"))
+      {
+      Params.push_back(cv::IMWRITE_JPEG_QUALITY);
+      Params.push_back(95);
+      } // end else if
 
-   return (bRet);
+   return (Params);
 
-   } // end of method CameraCalibration::Write
+   } // end of method CameraCalibrationImageStore::GetEncodeParams
 
 /******************************************************************************
 *
-***  CameraCalibration::Write
+***  CameraCalibrationImageStore::Add
 *
-* Actual OpenCV FileStage write file persistence.
+* Store a copy of the image, or of the region around the pattern points.
+*
+******************************************************************************/
+
+bool CameraCalibrationImageStore::Add(const cv::Mat& Image,
+      const std::vector<cv::Point2f>& Points)
+   {
+   DEntry Entry;
+   Entry.m_ROI = cv::Rect(0, 0, Image.cols, Image.rows);
+
+   if (m_bCropToBoard && !Points.empty())
+      {
+      cv::Rect Box = cv::boundingRect(Points);
+      Box.x -= m_nMargin;
+      Box.y -= m_nMargin;
+      Box.width += 2 * m_nMargin;
+      Box.height += 2 * m_nMargin;
+      Entry.m_ROI &= Box;
+      } // end if
+
+   cv::Mat Region = Image(Entry.m_ROI);
+
+   bool bRet = true;
+   switch (m_eStorage)
+      {
+      case EStorage::eRaw:
+         Entry.m_Image = Region.clone();
+         break;
+
+      case EStorage::eCompressed:
+         Entry.m_pEncoded = std::make_shared<std::vector<unsigned char>>();
+         bRet = cv::imencode(m_strFormat, Region, *Entry.m_pEncoded,
+               GetEncodeParams());
+         break;
+
+      case EStorage::eDisk:
+         {
+         boost::system::error_code Error;
+         boost::filesystem::create_directories(m_strDirectory, Error);
+
+         // Not a counter, copies of the store write to the same directory
+         boost::filesystem::path File(m_strDirectory);
+         File /= boost::filesystem::unique_path("frame-%%%%-%%%%-%%%%-%%%%");
+         File += m_strFormat;
+
+         bRet = cv::imwrite(File.string(), Region, GetEncodeParams());
+         if (bRet)
+            {
+            Entry.m_pTempDirectory = m_pTempDirectory;
+            Entry.m_pFileName = std::shared_ptr<const std::string>(
+                  new std::string(File.string()),
+                  [](const std::string* pName)
+                     {
+                     boost::system::error_code Error;
+                     boost::filesystem::remove(*pName, Error);
+                     delete pName;
+                     });
+            } // end if
+         }
+         break;
+
+      default:
+         bRet = false;
+         break;
+      } // end switch
+
+   if (bRet)
+      {
+      m_Entries.push_back(Entry);
+      } // end if
+
+   return (bRet);
+
+   } // end of method CameraCalibrationImageStore::Add
+
+/******************************************************************************
+*
+***  CameraCalibrationImageStore::Get
+*
+* The stored image (decoded if need be).  Raw frames are shared, not copied.
+*
+******************************************************************************/
+
+cv::Mat CameraCalibrationImageStore::Get(size_t nIndex) const
+   {
+   const DEntry& Entry = m_Entries[nIndex];
+
+   cv::Mat Image;
+   if (Entry.m_pEncoded)
+      {
+      Image = cv::imdecode(*Entry.m_pEncoded, cv::IMREAD_UNCHANGED);
+      } // end if
+   else if (Entry.m_pFileName)
+      {
+      Image = cv::imread(*Entry.m_pFileName, cv::IMREAD_UNCHANGED);
+      } // end else if
+   else
+      {
+      Image = Entry.m_Image;
+      } // end else
+
+   return (Image);
+
+   } // end of method CameraCalibrationImageStore::Get
+
+/******************************************************************************
+*
+***  CameraCalibrationImageStore::GetMemoryUsage
+*
+******************************************************************************/
+
+size_t CameraCalibrationImageStore::GetMemoryUsage() const
+   {
+   size_t nBytes = 0;
+
+   for (const auto& Entry : m_Entries)
+      {
+      nBytes += Entry.m_Image.total() * Entry.m_Image.elemSize();
+      if (Entry.m_pEncoded)
+         {
+         nBytes += Entry.m_pEncoded->size();
+         } // end if
+      } // end for
+
+   return (nBytes);
+
+   } // end of method CameraCalibrationImageStore::GetMemoryUsage
+
+/*****************************************************************************
+ ***  class CameraCalibration
+ ****************************************************************************/
+
+// Element serialization names
+const std::string CameraCalibration::m_strID("Calibration_Settings");
+const std::string CameraCalibration::m_strBoard("Chessboard");
+const std::string CameraCalibration::m_strFixAspectRatio("FixAspectRatio");
+const std::string CameraCalibration::m_strFlag("ControlFlags");
+const std::string CameraCalibration::m_strCameraMatrix("CameraMatrix");
+const std::string CameraCalibration::m_strDistortionCoeffs("DistortionCoefficents");
+const std::string CameraCalibration::m_strRVecs("RVecs");
+const std::string CameraCalibration::m_strTVecs("TVecs");
+const std::string CameraCalibration::m_strRMS("RMSError");
+const std::string CameraCalibration::m_strReprojErrors("ReprojectionErrors");
+const std::string CameraCalibration::m_strTotalAvgError("TotalAverageError");
+const std::string CameraCalibration::m_strImagePoints("ImagePoints");
+const std::string CameraCalibration::m_strGoodImages("NumberImagesUsed");
+const std::string CameraCalibration::m_strImageSize("ImageSize");
+const std::string CameraCalibration::m_strSaveImages("SaveImages");
+const std::string CameraCalibration::m_strIdCounts("IdCounts");
+const std::string CameraCalibration::m_strPointIds("PointIds");
+
+/******************************************************************************
+*
+***  struct CameraCalibration::DIncremental
+*
+* Background recalibration for the incremental mode.  One worker thread runs
+* cv::calibrateCamera on a snapshot of the image points.  A request made while
+* it is busy replaces any request still waiting, so the worker always moves
+* on to the newest data and never builds a backlog.
+*
+* The worker is detached and holds its own reference, so stopping it never
+* waits for a cv::calibrateCamera run, which can't be interrupted.  The run
+* finishes into a state nobody reads any more and the worker exits.
+*
+******************************************************************************/
+
+struct CameraCalibration::DIncremental
+   {
+   std::mutex m_Mutex;
+   std::condition_variable m_Wake;
+   bool m_bStop;
+   bool m_bPending;
+   bool m_bBusy;
+
+   // The waiting request
+   std::vector<std::vector<cv::Point2f>> m_ImagePoints;
+   std::vector<cv::Mat> m_ObjectPoints;
+   cv::Size m_ImageSize;
+   int m_nFlag;
+   bool m_bFixAspectRatio;
+
+   Estimate m_Estimate;
+
+   DIncremental() :
+         m_bStop(false),
+         m_bPending(false),
+         m_bBusy(false),
+         m_nFlag(0),
+         m_bFixAspectRatio(false)
+      {
+      m_Estimate.m_bValid = false;
+      m_Estimate.m_nImages = 0;
+      m_Estimate.m_dRMS = 0.0;
+      m_Estimate.m_dRMSChange = 0.0;
+
+      return;
+      }
+
+   void Stop()
+      {
+         {
+         std::lock_guard<std::mutex> Lock(m_Mutex);
+         m_bStop = true;
+         }
+
+      m_Wake.notify_one();
+
+      return;
+      }
+
+   void Request(const std::vector<std::vector<cv::Point2f>>& ImagePoints,
+         const std::vector<cv::Mat>& ObjectPoints, const cv::Size& ImageSize,
+         int nFlag, bool bFixAspectRatio)
+      {
+         {
+         std::lock_guard<std::mutex> Lock(m_Mutex);
+         m_ImagePoints = ImagePoints;
+         m_ObjectPoints = ObjectPoints;
+         m_ImageSize = ImageSize;
+         m_nFlag = nFlag;
+         m_bFixAspectRatio = bFixAspectRatio;
+         m_bPending = true;
+         }
+
+      m_Wake.notify_one();
+
+      return;
+      }
+
+   void Run();
+   };
+
+/******************************************************************************
+*
+***  CameraCalibration::DIncremental::Run
+*
+******************************************************************************/
+
+void CameraCalibration::DIncremental::Run()
+   {
+   // calibrateCamera needs a few views before the estimate means anything
+   const size_t nMinImages = 3;
+
+   for (;;)
+      {
+      std::vector<std::vector<cv::Point2f>> ImagePoints;
+      std::vector<cv::Mat> ObjectPoints;
+      cv::Size ImageSize;
+      int nFlag;
+      bool bFixAspectRatio;
+      Estimate Prev;
+
+         {
+         std::unique_lock<std::mutex> Lock(m_Mutex);
+         m_Wake.wait(Lock, [this] { return (m_bStop || m_bPending); });
+         if (m_bStop)
+            {
+            break;
+            } // end if
+
+         ImagePoints.swap(m_ImagePoints);
+         ObjectPoints.swap(m_ObjectPoints);
+         ImageSize = m_ImageSize;
+         nFlag = m_nFlag;
+         bFixAspectRatio = m_bFixAspectRatio;
+         Prev = m_Estimate;
+         m_bPending = false;
+         m_bBusy = true;
+         }
+
+      Estimate New = Prev;
+      if (ImagePoints.size() >= nMinImages)
+         {
+         cv::Mat CameraMatrix;
+         cv::Mat DistortionCoeffs;
+         if (Prev.m_bValid)
+            {
+            // Start from where the last estimate left off
+            CameraMatrix = Prev.m_CameraMatrix.clone();
+            DistortionCoeffs = Prev.m_DistortionCoeffs.clone();
+            nFlag |= cv::CALIB_USE_INTRINSIC_GUESS;
+            } // end if
+         else
+            {
+            CameraMatrix = cv::Mat::eye(3, 3, CV_64F);
+            DistortionCoeffs = cv::Mat::zeros(8, 1, CV_64F);
+            } // end else
+
+         if (bFixAspectRatio)
+            {
+            CameraMatrix.at<double>(0,0) = CameraMatrix.at<double>(1,1);
+            } // end if
+
+         std::vector<cv::Mat> RVecs;
+         std::vector<cv::Mat> TVecs;
+
+         try
+            {
+            double dRMS = cv::calibrateCamera(ObjectPoints, ImagePoints,
+                  ImageSize, CameraMatrix, DistortionCoeffs, RVecs, TVecs, nFlag);
+
+            if (cv::checkRange(CameraMatrix) && cv::checkRange(DistortionCoeffs))
+               {
+               New.m_dRMSChange = Prev.m_bValid ? (dRMS - Prev.m_dRMS) : 0.0;
+               New.m_bValid = true;
+               New.m_nImages = static_cast<int>(ImagePoints.size());
+               New.m_dRMS = dRMS;
+               New.m_CameraMatrix = CameraMatrix;
+               New.m_DistortionCoeffs = DistortionCoeffs;
+               } // end if
+            } // end try
+         catch (const cv::Exception&)
+            {
+            // Degenerate set of views, wait for more
+            } // end catch
+         } // end if
+
+         {
+         std::lock_guard<std::mutex> Lock(m_Mutex);
+         m_Estimate = New;
+         m_bBusy = false;
+         }
+      } // end for
+
+   return;
+
+   } // end of method CameraCalibration::DIncremental::Run
+
+/******************************************************************************
+*
+***  CameraCalibration::CameraCalibration
+*
+******************************************************************************/
+
+CameraCalibration::CameraCalibration() :
+      m_ImageSize(640, 480),
+      m_bFixAspectRatio(false),
+      m_nFlag(0),
+      m_dRMS(0.0),
+      m_dTotalAvgError(0.0),
+      m_nGoodImages(0),
+      m_bSaveImages(true),
+      m_nCoarseWidth(0)
+   {
+   m_CameraMatrix = cv::Mat::eye(3, 3, CV_64F);
+   m_DistortionCoeffs = cv::Mat::zeros(8, 1, CV_64F);
+   m_Coverage = cv::Mat::zeros(6, 8, CV_32S);
+
+   return;
+
+   } // end of method CameraCalibration::CameraCalibration
+
+/******************************************************************************
+*
+***  CameraCalibration::CameraCalibration
+*
+******************************************************************************/
+
+CameraCalibration::CameraCalibration(const CameraCalibration& src)
+   {
+   m_Board = src.m_Board;
+   m_bFixAspectRatio = src.m_bFixAspectRatio;
+   m_nFlag = src.m_nFlag;
+   m_ImageSize = src. m_ImageSize;
+   m_CameraMatrix = src.m_CameraMatrix;
+   m_DistortionCoeffs = src.m_DistortionCoeffs;
+   m_TVecs = src.m_TVecs;
+   m_RVecs = src.m_RVecs;
+   m_dRMS = src.m_dRMS;
+   m_dTotalAvgError = src. m_dTotalAvgError;
+   m_ReprojErrors = src.m_ReprojErrors;
+   m_Residuals = src.m_Residuals;
+   m_ImagePoints = src.m_ImagePoints;
+   m_PointIds = src.m_PointIds;
+   m_Images = src.m_Images;
+   m_nGoodImages = src.m_nGoodImages;
+   m_bSaveImages = src.m_bSaveImages;
+   m_nCoarseWidth = src.m_nCoarseWidth;
+   m_Coverage = src.m_Coverage.clone();
+   m_pMapping = src.m_pMapping;
+
+   return;
+
+   } // end of method CameraCalibration::CameraCalibration
+
+/******************************************************************************
+*
+***  CameraCalibration::~CameraCalibration
+*
+******************************************************************************/
+
+CameraCalibration::~CameraCalibration()
+   {
+
+   return;
+
+   } // end of method CameraCalibration::~CameraCalibration
+
+/******************************************************************************
+*
+***  CameraCalibration::operator=
+*
+******************************************************************************/
+
+CameraCalibration& CameraCalibration::operator=(const CameraCalibration& rhs)
+   {
+   if (this != &rhs)
+      {
+      m_Board = rhs.m_Board;
+      m_bFixAspectRatio = rhs.m_bFixAspectRatio;
+      m_nFlag = rhs.m_nFlag;
+      m_ImageSize = rhs. m_ImageSize;
+      m_CameraMatrix = rhs.m_CameraMatrix;
+      m_DistortionCoeffs = rhs.m_DistortionCoeffs;
+      m_TVecs = rhs.m_TVecs;
+      m_RVecs = rhs.m_RVecs;
+      m_dRMS = rhs.m_dRMS;
+      m_dTotalAvgError = rhs. m_dTotalAvgError;
+      m_ReprojErrors = rhs.m_ReprojErrors;
+      m_Residuals = rhs.m_Residuals;
+      m_ImagePoints = rhs.m_ImagePoints;
+      m_PointIds = rhs.m_PointIds;
+      m_Images = rhs.m_Images;
+      m_nGoodImages = rhs.m_nGoodImages;
+      m_bSaveImages = rhs.m_bSaveImages;
+      m_nCoarseWidth = rhs.m_nCoarseWidth;
+      m_Coverage = rhs.m_Coverage.clone();
+      m_pMapping = rhs.m_pMapping;
+      } // end if
+
+   return (*this);
+
+   } // end of method CameraCalibration::operator=
+
+/******************************************************************************
+*
+***  CameraCalibration::Initialize
+*
+* Initialize the control elements and clear the calculated members as a prep
+* for running a new calibration.
+*
+******************************************************************************/
+
+bool CameraCalibration::Initialize(const CameraCalibrationBoard& Board,
+      const cv::Size& ImageSize, bool bFixAspectRatio, int nFlag,
+      bool bSaveImages /* = false */)
+   {
+   bool bRet = true;
+
+   ClearViews();
+
+   m_CameraMatrix = cv::Mat::eye(3, 3, CV_64F);
+   m_DistortionCoeffs = cv::Mat::zeros(8, 1, CV_64F);
+
+   m_Board = Board;
+   m_bFixAspectRatio = bFixAspectRatio;
+   m_nFlag = nFlag;
+   m_ImageSize = ImageSize;
+   m_bSaveImages = bSaveImages;
+
+   return (bRet);
+
+   } // end of method CameraCalibration::Initialize
+
+/******************************************************************************
+*
+***  CameraCalibration::ClearViews
+*
+* Drop the accepted views and everything calculated from them.
+*
+******************************************************************************/
+
+void CameraCalibration::ClearViews()
+   {
+   m_nGoodImages = 0;
+   m_RVecs.clear();
+   m_TVecs.clear();
+   m_ReprojErrors.clear();
+   m_Residuals.clear();
+   m_ImagePoints.clear();
+   m_PointIds.clear();
+   m_Images.clear();
+   m_dRMS = 0.0;
+   m_dTotalAvgError = 0.0;
+   m_Coverage.setTo(0);
+
+   if (m_pIncremental)
+      {
+      // Start the running estimate over too
+      SetIncremental(false);
+      SetIncremental(true);
+      } // end if
+
+   return;
+
+   } // end of method CameraCalibration::ClearViews
+
+/******************************************************************************
+*
+***  CameraCalibration::SetIntrinsics
+*
+******************************************************************************/
+
+void CameraCalibration::SetIntrinsics(const cv::Mat& CameraMatrix,
+      const cv::Mat& DistortionCoeffs, const cv::Size& ImageSize)
+   {
+   m_CameraMatrix = CameraMatrix.clone();
+   m_DistortionCoeffs = DistortionCoeffs.clone();
+   m_ImageSize = ImageSize;
+
+   return;
+
+   } // end of method CameraCalibration::SetIntrinsics
+
+/******************************************************************************
+*
+***  CameraCalibration::ProcessImage
+*
+* Takes an "original" image and the gray conversion of that image.  Allows the
+* calling program to do any preprocessing desired on both images.
+*
+* bUseImage indicates whether to use the image in the calibration.  Some
+* programs may want to preview live images to the user with annotation.
+*
+******************************************************************************/
+
+bool CameraCalibration::ProcessImage(cv::Mat& Image, cv::Mat& GrayImage,
+      bool bAnnotateImage, bool bUseImage)
+   {
+   std::vector<cv::Point2f> Points;
+
+   bool bFound = m_Board.FindPattern(Image, GrayImage, Points, m_nCoarseWidth);
+
+   if (bFound)
+      {
+      if (bUseImage)
+         {
+         // Include this image in the calibration calculation
+         AddImagePoints(Points, Image);
+         } // end if
+
+      if (bAnnotateImage)
+         {
+         m_Board.DrawPattern(Image, Points, bFound);
+         } // end if
+      } // end if
+
+   return (bFound);
+
+   } // end of method CameraCalibration::ProcessImage
+
+/******************************************************************************
+*
+***  CameraCalibration::AddImagePoints
+*
+* Accept a detected set of pattern points into the calibration.  This is the
+* second half of ProcessImage for callers doing the detection elsewhere, e.g.
+* with a CameraCalibrationDetector.  Image should be unannotated.
+*
+******************************************************************************/
+
+bool CameraCalibration::AddImagePoints(const std::vector<cv::Point2f>& Points,
+      const cv::Mat& Image)
+   {
+   return (AddImagePoints(Points, std::vector<int>(), Image));
+
+   } // end of method CameraCalibration::AddImagePoints
+
+/******************************************************************************
+*
+***  CameraCalibration::AddImagePoints
+*
+* Ids gives the board corner of each point for views that only see part of
+* the board.  An empty Ids means Points covers the whole board in order.
+*
+* The image is saved first so a failure to store it (e.g. a full disk) leaves
+* the points out too and the saved images stay in step with the views.
+*
+******************************************************************************/
+
+bool CameraCalibration::AddImagePoints(const std::vector<cv::Point2f>& Points,
+      const std::vector<int>& Ids, const cv::Mat& Image)
+   {
+   if (!IsValidPointIds(Ids, Points.size()))
+      {
+      return (false);
+      } // end if
+
+   // Save the images for future reprocessing before being annotated
+   if (m_bSaveImages && !m_Images.Add(Image, Points))
+      {
+      return (false);
+      } // end if
+
+   m_ImagePoints.push_back(Points);
+   m_PointIds.resize(m_ImagePoints.size() - 1);
+   m_PointIds.push_back(Ids);
+   m_nGoodImages++;
+
+   UpdateCoverage(Points);
+
+   if (m_pIncremental)
+      {
+      // The Mats are never modified in place so the worker can share them
+      std::vector<cv::Mat> ObjectPoints;
+      GetObjectPoints(ObjectPoints);
+
+      m_pIncremental->Request(m_ImagePoints, ObjectPoints, m_ImageSize,
+            m_nFlag, m_bFixAspectRatio);
+      } // end if
+
+   return (true);
+
+   } // end of method CameraCalibration::AddImagePoints
+
+/******************************************************************************
+*
+***  CameraCalibration::IsValidPointIds
+*
+* Ids for a view of nPoints points: empty for a whole board view, otherwise
+* one board corner per point.
+*
+******************************************************************************/
+
+bool CameraCalibration::IsValidPointIds(const std::vector<int>& Ids,
+      size_t nPoints) const
+   {
+   return (Ids.empty()
+         || IsValidPointIds(Ids, nPoints, m_Board.GetObjectPoints().rows));
+
+   } // end of method CameraCalibration::IsValidPointIds
+
+/******************************************************************************
+*
+***  CameraCalibration::IsValidPointIds
+*
+* The same for a board with nCorners corners.
+*
+******************************************************************************/
+
+bool CameraCalibration::IsValidPointIds(const std::vector<int>& Ids,
+      size_t nPoints, int nCorners)
+   {
+   bool bRet = Ids.empty();
+   if (!bRet && (Ids.size() == nPoints))
+      {
+      bRet = std::all_of(Ids.begin(), Ids.end(),
+            [nCorners](int nId) { return ((nId >= 0) && (nId < nCorners)); });
+      } // end if
+
+   return (bRet);
+
+   } // end of method CameraCalibration::IsValidPointIds
+
+/******************************************************************************
+*
+***  CameraCalibration::PackPointIds
+*
+* The corner ids of every view back to back with a count per view for
+* storage.  A count of 0 is a whole board view.  Both are left empty when
+* there are no partial views.
+*
+******************************************************************************/
+
+void CameraCalibration::PackPointIds(std::vector<int>& IdCounts,
+      std::vector<int>& PointIds) const
+   {
+   IdCounts.assign(m_ImagePoints.size(), 0);
+   PointIds.clear();
+   for (size_t i = 0 ; (i < m_PointIds.size()) && (i < IdCounts.size()) ; i++)
+      {
+      IdCounts[i] = static_cast<int>(m_PointIds[i].size());
+      PointIds.insert(PointIds.end(), m_PointIds[i].begin(), m_PointIds[i].end());
+      } // end for
+
+   if (PointIds.empty())
+      {
+      IdCounts.clear();
+      } // end if
+
+   return;
+
+   } // end of method CameraCalibration::PackPointIds
+
+/******************************************************************************
+*
+***  CameraCalibration::UnpackPointIds
+*
+* PointIds from what PackPointIds() stored for the views ImagePoints of a
+* board with nCorners corners.  Fails, leaving no ids, if the counts don't
+* match the views or any id isn't a corner of the board.
+*
+******************************************************************************/
+
+bool CameraCalibration::UnpackPointIds(const int* pIdCounts, size_t nCounts,
+      const int* pIds, size_t nIds,
+      const std::vector<std::vector<cv::Point2f>>& ImagePoints, int nCorners,
+      std::vector<std::vector<int>>& PointIds)
+   {
+   PointIds.clear();
+   if ((nCounts == 0) && (nIds == 0))
+      {
+      return (true);
+      } // end if
+
+   bool bRet = (nCounts == ImagePoints.size());
+   std::vector<std::vector<int>> Ids(ImagePoints.size());
+   for (size_t i = 0 ; bRet && (i < nCounts) ; i++)
+      {
+      bRet = (pIdCounts[i] >= 0) && (static_cast<size_t>(pIdCounts[i]) <= nIds);
+      if (bRet)
+         {
+         Ids[i].assign(pIds, pIds + pIdCounts[i]);
+         pIds += pIdCounts[i];
+         nIds -= pIdCounts[i];
+         bRet = IsValidPointIds(Ids[i], ImagePoints[i].size(), nCorners);
+         } // end if
+      } // end for
+
+   if (bRet && (nIds == 0))
+      {
+      PointIds.swap(Ids);
+      } // end if
+   else
+      {
+      bRet = false;
+      } // end else
+
+   return (bRet);
+
+   } // end of method CameraCalibration::UnpackPointIds
+
+/******************************************************************************
+*
+***  CameraCalibration::RemoveView
+*
+* The per-view results are dropped too; they are recalculated by the next
+* calibration.  The coverage grid is recounted without the view's points.
+*
+******************************************************************************/
+
+void CameraCalibration::RemoveView(size_t nIndex)
+   {
+   if (nIndex >= m_ImagePoints.size())
+      {
+      return;
+      } // end if
+
+   m_ImagePoints.erase(m_ImagePoints.begin() + nIndex);
+   if (nIndex < m_PointIds.size())
+      {
+      m_PointIds.erase(m_PointIds.begin() + nIndex);
+      } // end if
+   if (nIndex < m_Images.size())
+      {
+      m_Images.erase(nIndex);
+      } // end if
+   if (nIndex < m_RVecs.size())
+      {
+      m_RVecs.erase(m_RVecs.begin() + nIndex);
+      } // end if
+   if (nIndex < m_TVecs.size())
+      {
+      m_TVecs.erase(m_TVecs.begin() + nIndex);
+      } // end if
+   if (nIndex < m_ReprojErrors.size())
+      {
+      m_ReprojErrors.erase(m_ReprojErrors.begin() + nIndex);
+      } // end if
+   if (nIndex < m_Residuals.size())
+      {
+      m_Residuals.erase(m_Residuals.begin() + nIndex);
+      } // end if
+   m_nGoodImages = static_cast<int>(m_ImagePoints.size());
+
+   // Recount the coverage from the views that are left
+   SetCoverageGrid(m_Coverage.size());
+
+   return;
+
+   } // end of method CameraCalibration::RemoveView
+
+/******************************************************************************
+*
+***  CameraCalibration::SetIncremental
+*
+* Turning the mode off, or ClearViews() restarting it, only signals the worker
+* to stop so the caller, usually the GUI thread, never waits on a
+* recalibration in progress.  The worker's own reference keeps its state alive
+* until it gets there; releasing ours runs Stop().
+*
+******************************************************************************/
+
+void CameraCalibration::SetIncremental(bool bIncremental)
+   {
+   if (bIncremental && !m_pIncremental)
+      {
+      std::shared_ptr<DIncremental> pState = std::make_shared<DIncremental>();
+      std::thread(&DIncremental::Run, pState).detach();
+      m_pIncremental.reset(pState.get(),
+            [pState](DIncremental* pIncremental) { pIncremental->Stop(); });
+      } // end if
+   else if (!bIncremental)
+      {
+      m_pIncremental.reset();
+      } // end else if
+
+   return;
+
+   } // end of method CameraCalibration::SetIncremental
+
+/******************************************************************************
+*
+***  CameraCalibration::GetEstimate
+*
+* The most recent finished background result.  m_bValid is false until enough
+* frames have been accepted.
+*
+******************************************************************************/
+
+CameraCalibration::Estimate CameraCalibration::GetEstimate() const
+   {
+   Estimate Ret;
+   Ret.m_bValid = false;
+   Ret.m_nImages = 0;
+   Ret.m_dRMS = 0.0;
+   Ret.m_dRMSChange = 0.0;
+
+   if (m_pIncremental)
+      {
+      std::lock_guard<std::mutex> Lock(m_pIncremental->m_Mutex);
+      Ret = m_pIncremental->m_Estimate;
+      } // end if
+
+   return (Ret);
+
+   } // end of method CameraCalibration::GetEstimate
+
+/******************************************************************************
+*
+***  CameraCalibration::IsRecalibrating
+*
+******************************************************************************/
+
+bool CameraCalibration::IsRecalibrating() const
+   {
+   bool bRet = false;
+
+   if (m_pIncremental)
+      {
+      std::lock_guard<std::mutex> Lock(m_pIncremental->m_Mutex);
+      bRet = m_pIncremental->m_bBusy || m_pIncremental->m_bPending;
+      } // end if
+
+   return (bRet);
+
+   } // end of method CameraCalibration::IsRecalibrating
+
+/******************************************************************************
+*
+***  CameraCalibration::SetCoverageGrid
+*
+* Change the coverage grid (columns x rows) and recount the accepted points.
+*
+******************************************************************************/
+
+void CameraCalibration::SetCoverageGrid(const cv::Size& GridSize)
+   {
+   m_Coverage = cv::Mat::zeros(GridSize.height, GridSize.width, CV_32S);
+
+   for (const auto& Points : m_ImagePoints)
+      {
+      UpdateCoverage(Points);
+      } // end for
+
+   return;
+
+   } // end of method CameraCalibration::SetCoverageGrid
+
+/******************************************************************************
+*
+***  CameraCalibration::UpdateCoverage
+*
+******************************************************************************/
+
+void CameraCalibration::UpdateCoverage(const std::vector<cv::Point2f>& Points)
+   {
+   if (m_Coverage.empty() || (m_ImageSize.area() == 0))
+      {
+      return;
+      } // end if
+
+   float fScaleX = static_cast<float>(m_Coverage.cols) / m_ImageSize.width;
+   float fScaleY = static_cast<float>(m_Coverage.rows) / m_ImageSize.height;
+
+   for (const auto& Pt : Points)
+      {
+      int nCol = std::min(std::max(static_cast<int>(Pt.x * fScaleX), 0), m_Coverage.cols - 1);
+      int nRow = std::min(std::max(static_cast<int>(Pt.y * fScaleY), 0), m_Coverage.rows - 1);
+      m_Coverage.at<int>(nRow, nCol)++;
+      } // end for
+
+   return;
+
+   } // end of method CameraCalibration::UpdateCoverage
+
+/******************************************************************************
+*
+***  CameraCalibration::GetCoverage
+*
+******************************************************************************/
+
+double CameraCalibration::GetCoverage() const
+   {
+   double dRet = 0.0;
+
+   if (!m_Coverage.empty())
+      {
+      dRet = static_cast<double>(cv::countNonZero(m_Coverage)) / m_Coverage.total();
+      } // end if
+
+   return (dRet);
+
+   } // end of method CameraCalibration::GetCoverage
+
+/******************************************************************************
+*
+***  CameraCalibration::GetObjectPoints
+*
+* One object point Mat per view.  Views of the whole board all get headers of
+* the board's shared Mat so no corner data is copied; only partial views get
+* their own subset.
+*
+******************************************************************************/
+
+void CameraCalibration::GetObjectPoints(std::vector<cv::Mat>& ObjectPoints) const
+   {
+   const cv::Mat& BoardPoints = m_Board.GetObjectPoints();
+
+   ObjectPoints.resize(m_ImagePoints.size());
+   for (size_t i = 0 ; i < m_ImagePoints.size() ; i++)
+      {
+      if ((i < m_PointIds.size()) && !m_PointIds[i].empty())
+         {
+         ObjectPoints[i] = m_Board.GetObjectPoints(m_PointIds[i]);
+         } // end if
+      else
+         {
+         ObjectPoints[i] = BoardPoints;
+         } // end else
+      } // end for
+
+   return;
+
+   } // end of method CameraCalibration::GetObjectPoints
+
+/******************************************************************************
+*
+***  CameraCalibration::RunCalibration
+*
+* Perform the actual calibration calculations.
+*
+******************************************************************************/
+
+bool CameraCalibration::RunCalibration()
+   {
+   return (Calibrate(false));
+
+   } // end of method CameraCalibration::RunCalibration
+
+/******************************************************************************
+*
+***  IsImageFile
+*
+* Whether the file extension is one of the image formats imread handles.
+*
+******************************************************************************/
+
+static bool IsImageFile(const boost::filesystem::path& Path)
+   {
+   static const char* const Extensions[] = { ".png", ".jpg", ".jpeg", ".bmp",
+         ".dib", ".tif", ".tiff", ".pbm", ".pgm", ".ppm", ".pnm", ".jp2",
+         ".webp", ".sr", ".ras" };
+
+   std::string strExt = Path.extension().string();
+   std::transform(strExt.begin(), strExt.end(), strExt.begin(),
+         [](unsigned char c) { return (static_cast<char>(std::tolower(c))); });
+
+   for (const char* pExt : Extensions)
+      {
+      if (strExt == pExt)
+         {
+         return (true);
+         } // end if
+      } // end for
+
+   return (false);
+
+   } // end of function IsImageFile
+
+/******************************************************************************
+*
+***  class DDetectFiles
+*
+* Parallel body for CalibrateFromDirectory.  Each file is read, converted and
+* searched independently; results go to the file's own slot so the order
+* doesn't depend on the thread scheduling.  Only the size and points are
+* kept so memory doesn't grow with the number of files.
+*
+******************************************************************************/
+
+class DDetectFiles : public cv::ParallelLoopBody
+   {
+   public:
+      DDetectFiles(const std::vector<std::string>& Files,
+            const CameraCalibrationBoard& Board, int nCoarseWidth,
+            std::vector<cv::Size>& Sizes,
+            std::vector<std::vector<cv::Point2f>>& Points,
+            std::vector<unsigned char>& Found) :
+            m_Files(Files),
+            m_Board(Board),
+            m_nCoarseWidth(nCoarseWidth),
+            m_Sizes(Sizes),
+            m_Points(Points),
+            m_Found(Found)
+         {
+         return;
+         }
+
+      virtual void operator()(const cv::Range& Range) const
+         {
+         for (int i = Range.start ; i < Range.end ; i++)
+            {
+            cv::Mat Image = cv::imread(m_Files[i], cv::IMREAD_COLOR);
+            if (Image.empty())
+               {
+               continue;
+               } // end if
+
+            cv::Mat GrayImage;
+            cv::cvtColor(Image, GrayImage, cv::COLOR_BGR2GRAY);
+
+            m_Found[i] = m_Board.FindPattern(Image, GrayImage, m_Points[i],
+                  m_nCoarseWidth);
+            m_Sizes[i] = Image.size();
+            } // end for
+
+         return;
+         }
+
+   protected:
+      const std::vector<std::string>& m_Files;
+      const CameraCalibrationBoard& m_Board;
+      int m_nCoarseWidth;
+      std::vector<cv::Size>& m_Sizes;
+      std::vector<std::vector<cv::Point2f>>& m_Points;
+      // Not vector<bool> so different threads can write neighboring slots
+      std::vector<unsigned char>& m_Found;
+
+   private:
+
+   }; // end of class DDetectFiles
+
+/******************************************************************************
+*
+***  CameraCalibration::CalibrateFromDirectory
+*
+* Run the calibration from the images in a directory, e.g. ones saved by
+* WriteImages().  Files are taken in name order and the reading and pattern
+* detection are spread over the OpenCV thread pool; the accepted images are
+* then added in that same order so the result is repeatable.
+*
+* The board and flags come from Initialize() which should be called first.
+* Any views already accepted are discarded, the directory replaces them.
+* The image size is taken from the first good image.  Files that can't be
+* read, have no pattern, or are a different size are returned in FailedFiles.
+* When images are being saved the accepted files are read a second time, one
+* at a time, rather than holding every decoded image until the end.
+*
+******************************************************************************/
+
+bool CameraCalibration::CalibrateFromDirectory(const std::string& strDirectory,
+      std::vector<std::string>& FailedFiles)
+   {
+   FailedFiles.clear();
+
+   boost::system::error_code Error;
+   if (!boost::filesystem::is_directory(strDirectory, Error))
+      {
+      return (false);
+      } // end if
+
+   std::vector<std::string> Files;
+   for (boost::filesystem::directory_iterator It(strDirectory, Error), End ;
+         !Error && (It != End) ; It.increment(Error))
+      {
+      if (boost::filesystem::is_regular_file(It->status()) && IsImageFile(It->path()))
+         {
+         Files.push_back(It->path().string());
+         } // end if
+      } // end for
+
+   std::sort(Files.begin(), Files.end());
+
+   int nFiles = static_cast<int>(Files.size());
+   std::vector<cv::Size> Sizes(nFiles);
+   std::vector<std::vector<cv::Point2f>> Points(nFiles);
+   std::vector<unsigned char> Found(nFiles, 0);
+
+   cv::parallel_for_(cv::Range(0, nFiles),
+         DDetectFiles(Files, m_Board, m_nCoarseWidth, Sizes, Points, Found));
+
+   ClearViews();
+
+   bool bHaveSize = false;
+   for (int i = 0 ; i < nFiles ; i++)
+      {
+      if (Found[i] && !bHaveSize)
+         {
+         m_ImageSize = Sizes[i];
+         bHaveSize = true;
+         } // end if
+
+      bool bAccepted = Found[i] && (Sizes[i] == m_ImageSize);
+      if (bAccepted)
+         {
+         // AddImagePoints only looks at the image if it's saving it
+         cv::Mat Image;
+         if (m_bSaveImages)
+            {
+            Image = cv::imread(Files[i], cv::IMREAD_COLOR);
+            bAccepted = (Image.size() == m_ImageSize);
+            } // end if
+
+         if (bAccepted)
+            {
+            AddImagePoints(Points[i], Image);
+            } // end if
+         } // end if
+
+      if (!bAccepted)
+         {
+         FailedFiles.push_back(Files[i]);
+         } // end if
+      } // end for
+
+   bool bRet = !m_ImagePoints.empty();
+   if (bRet)
+      {
+      bRet = RunCalibration();
+      } // end if
+
+   return (bRet);
+
+   } // end of method CameraCalibration::CalibrateFromDirectory
+
+/******************************************************************************
+*
+***  CameraCalibration::Calibrate
+*
+* Run cv::calibrateCamera over the accepted views.  bUseIntrinsicGuess starts
+* from the current camera matrix and distortion which converges much faster
+* when only a few views have changed.
+*
+******************************************************************************/
+
+bool CameraCalibration::Calibrate(bool bUseIntrinsicGuess)
+   {
+   int nFlag = m_nFlag;
+   if (bUseIntrinsicGuess)
+      {
+      nFlag |= cv::CALIB_USE_INTRINSIC_GUESS;
+      } // end if
+   else
+      {
+      m_CameraMatrix = cv::Mat::eye(3, 3, CV_64F);
+      if (m_bFixAspectRatio)
+         {
+         m_CameraMatrix.at<double>(0,0) = 1.0;
+         } // end if
+
+      m_DistortionCoeffs = cv::Mat::zeros(8, 1, CV_64F);
+      } // end else
+
+   std::vector<cv::Mat> ObjectPoints;
+   GetObjectPoints(ObjectPoints);
+
+   //Find intrinsic and extrinsic camera parameters
+   m_dRMS = cv::calibrateCamera(ObjectPoints, m_ImagePoints, m_ImageSize,
+         m_CameraMatrix, m_DistortionCoeffs,
+         m_RVecs, m_TVecs, nFlag);
+
+//   cout << "Re-projection error reported by calibrateCamera: "<< rms << endl;
+
+   bool bGood = checkRange(m_CameraMatrix) && checkRange(m_DistortionCoeffs);
+
+   m_dTotalAvgError = ComputeReprojectionErrors(ObjectPoints);
+
+   return (bGood);
+
+   } // end of method CameraCalibration::Calibrate
+
+/******************************************************************************
+*
+***  CameraCalibration::RunCalibrationRejectOutliers
+*
+* One view is dropped per pass since the fit, and so every other view's error,
+* changes once the worst one is gone.  Each recalibration starts from the
+* previous solution.  Saved images are dropped along with their views.
+*
+******************************************************************************/
+
+bool CameraCalibration::RunCalibrationRejectOutliers(std::vector<int>& Rejected,
+      double dFactor /* = 2.0 */, int nMaxRejected /* = 10 */)
+   {
+   // Keep enough views for calibrateCamera to be well posed
+   const size_t nMinImages = 3;
+
+   Rejected.clear();
+
+   // Original index of each remaining view
+   std::vector<int> Index(m_ImagePoints.size());
+   for (size_t i = 0 ; i < Index.size() ; i++)
+      {
+      Index[i] = static_cast<int>(i);
+      } // end for
+
+   bool bRet = !m_ImagePoints.empty() && Calibrate(false);
+
+   while (bRet && (static_cast<int>(Rejected.size()) < nMaxRejected)
+         && (m_ImagePoints.size() > nMinImages))
+      {
+      std::vector<double> Errors(m_ReprojErrors);
+      std::nth_element(Errors.begin(), Errors.begin() + Errors.size() / 2,
+            Errors.end());
+      double dMedian = Errors[Errors.size() / 2];
+
+      size_t nWorst = std::max_element(m_ReprojErrors.begin(),
+            m_ReprojErrors.end()) - m_ReprojErrors.begin();
+      if (m_ReprojErrors[nWorst] <= dFactor * dMedian)
+         {
+         break;
+         } // end if
+
+      Rejected.push_back(Index[nWorst]);
+      Index.erase(Index.begin() + nWorst);
+      RemoveView(nWorst);
+
+      bRet = Calibrate(true);
+      } // end while
+
+   return (bRet);
+
+   } // end of method CameraCalibration::RunCalibrationRejectOutliers
+
+/******************************************************************************
+*
+***  class DReprojectViews
+*
+* Parallel body for ComputeReprojectionErrors.  Each view is independent and
+* only writes its own slots.
+*
+******************************************************************************/
+
+class DReprojectViews : public cv::ParallelLoopBody
+   {
+   public:
+      DReprojectViews(const std::vector<cv::Mat>& ObjectPoints,
+            const std::vector<std::vector<cv::Point2f>>& ImagePoints,
+            const std::vector<cv::Mat>& RVecs, const std::vector<cv::Mat>& TVecs,
+            const cv::Mat& CameraMatrix, const cv::Mat& DistortionCoeffs,
+            std::vector<std::vector<cv::Point2f>>& Residuals,
+            std::vector<double>& SumSquares) :
+            m_ObjectPoints(ObjectPoints),
+            m_ImagePoints(ImagePoints),
+            m_RVecs(RVecs),
+            m_TVecs(TVecs),
+            m_CameraMatrix(CameraMatrix),
+            m_DistortionCoeffs(DistortionCoeffs),
+            m_Residuals(Residuals),
+            m_SumSquares(SumSquares)
+         {
+         return;
+         }
+
+      virtual void operator()(const cv::Range& Range) const
+         {
+         for (int i = Range.start ; i < Range.end ; i++)
+            {
+            std::vector<cv::Point2f>& Residuals = m_Residuals[i];
+            cv::projectPoints(m_ObjectPoints[i], m_RVecs[i], m_TVecs[i],
+                  m_CameraMatrix, m_DistortionCoeffs, Residuals);
+
+            // Plain loop over float pairs, vectorizes
+            const cv::Point2f* pDetected = m_ImagePoints[i].data();
+            cv::Point2f* pResidual = Residuals.data();
+            size_t n = Residuals.size();
+            double dSum = 0.0;
+            for (size_t j = 0 ; j < n ; j++)
+               {
+               float fX = pResidual[j].x - pDetected[j].x;
+               float fY = pResidual[j].y - pDetected[j].y;
+               pResidual[j].x = fX;
+               pResidual[j].y = fY;
+               dSum += static_cast<double>(fX * fX + fY * fY);
+               } // end for
+
+            m_SumSquares[i] = dSum;
+            } // end for
+
+         return;
+         }
+
+   protected:
+      const std::vector<cv::Mat>& m_ObjectPoints;
+      const std::vector<std::vector<cv::Point2f>>& m_ImagePoints;
+      const std::vector<cv::Mat>& m_RVecs;
+      const std::vector<cv::Mat>& m_TVecs;
+      const cv::Mat& m_CameraMatrix;
+      const cv::Mat& m_DistortionCoeffs;
+      std::vector<std::vector<cv::Point2f>>& m_Residuals;
+      std::vector<double>& m_SumSquares;
+
+   private:
+
+   }; // end of class DReprojectViews
+
+/******************************************************************************
+*
+***  CameraCalibration::ComputeReprojectionErrors
+*
+* Reproject every view in parallel keeping the per point residuals as well as
+* the per view RMS.  The total is summed afterwards in view order so it
+* doesn't vary with the thread scheduling.
+*
+******************************************************************************/
+
+double CameraCalibration::ComputeReprojectionErrors(
+      const std::vector<cv::Mat>& ObjectPoints)
+   {
+   int nViews = static_cast<int>(ObjectPoints.size());
+   std::vector<double> SumSquares(nViews, 0.0);
+   m_Residuals.resize(nViews);
+   m_ReprojErrors.resize(nViews);
+
+   cv::parallel_for_(cv::Range(0, nViews),
+         DReprojectViews(ObjectPoints, m_ImagePoints, m_RVecs, m_TVecs,
+               m_CameraMatrix, m_DistortionCoeffs, m_Residuals, SumSquares));
+
+   int nTotalPoints = 0;
+   double dTotalErr = 0.0;
+   for (int i = 0 ; i < nViews ; i++)
+      {
+      int n = static_cast<int>(ObjectPoints[i].total());
+      m_ReprojErrors[i] = std::sqrt(SumSquares[i] / n);
+      dTotalErr += SumSquares[i];
+      nTotalPoints += n;
+      } // end for
+
+   return (std::sqrt(dTotalErr / nTotalPoints));
+
+   } // end of method CameraCalibration::ComputeReprojectionErrors
+
+/******************************************************************************
+*
+***  CameraCalibration::Write
+*
+* Write the calibration to file using OpenCV's FileStorage system.  Produces
+* either XML or YAML formats based on the supplied name extension (.xml, .yml).
+*
+******************************************************************************/
+
+bool CameraCalibration::Write(const std::string& strFileName) const
+   {
+   bool bRet;
+   if (IsBinaryFileName(strFileName))
+      {
+      bRet = WriteBinary(strFileName);
+      } // end if
+   else
+      {
+      cv::FileStorage FS(strFileName, cv::FileStorage::WRITE);
+      bRet = FS.isOpened();
+      if (bRet)
+         {
+         bRet = Write(FS);
+         } // end if
+      } // end else
+
+   if (m_bSaveImages)
+      {
+      // Strip off the extension
+      boost::filesystem::path Path(strFileName);
+      boost::filesystem::path Dir(Path.parent_path());
+      boost::filesystem::path File = Path.stem();
+      Dir /= File;
+
+      WriteImages(Dir.string());
+      } // end if
+
+   return (bRet);
+
+   } // end of method CameraCalibration::Write
+
+/******************************************************************************
+*
+***  CameraCalibration::Write
+*
+* Actual OpenCV FileStage write file persistence.
 *
 ******************************************************************************/
 
 bool CameraCalibration::Write(cv::FileStorage& FS) const
    {
-   bool bRet = true;
+   bool bRet = true;
+
+   std::vector<int> IdCounts;
+   std::vector<int> PointIds;
+   PackPointIds(IdCounts, PointIds);
+
+   FS << m_strID << "{"
+      << m_strBoard << m_Board
+      << m_strFixAspectRatio << m_bFixAspectRatio
+      << m_strFlag << m_nFlag
+      << m_strImageSize << m_ImageSize
+      << m_strCameraMatrix << m_CameraMatrix
+      << m_strDistortionCoeffs << m_DistortionCoeffs
+      << m_strRVecs << m_RVecs
+      << m_strTVecs << m_TVecs
+      << m_strRMS << m_dRMS
+      << m_strReprojErrors << m_ReprojErrors
+      << m_strTotalAvgError << m_dTotalAvgError
+      << m_strImagePoints << m_ImagePoints
+      << m_strGoodImages << m_nGoodImages;
+
+   // Corner ids of the partial views, the same as the binary format
+   if (!PointIds.empty())
+      {
+      FS << m_strIdCounts << IdCounts
+         << m_strPointIds << PointIds;
+      } // end if
+
+   FS << "}";
+
+   return (bRet);
+
+   } // end of method CameraCalibration::Write
+
+/******************************************************************************
+*
+***  CameraCalibration::Read
+*
+* Read calibration data from file into memory using OpenCV's FileStorage
+* mechanism.
+*
+******************************************************************************/
+
+bool CameraCalibration::Read(const cv::FileNode& Node)
+   {
+   bool bRet = true;
+
+   Node[m_strBoard] >> m_Board;
+   Node[m_strFixAspectRatio] >> m_bFixAspectRatio;
+   Node[m_strFlag] >> m_nFlag;
+   Node[m_strImageSize] >> m_ImageSize;
+   Node[m_strCameraMatrix] >> m_CameraMatrix;
+   Node[m_strDistortionCoeffs] >> m_DistortionCoeffs;
+   Node[m_strRVecs] >> m_RVecs;
+   Node[m_strTVecs] >> m_TVecs;
+   Node[m_strRMS] >> m_dRMS;
+   Node[m_strReprojErrors] >> m_ReprojErrors;
+   Node[m_strTotalAvgError] >> m_dTotalAvgError;
+   Node[m_strImagePoints] >> m_ImagePoints;
+   Node[m_strGoodImages] >> m_nGoodImages;
+
+   std::vector<int> IdCounts;
+   std::vector<int> PointIds;
+   Node[m_strIdCounts] >> IdCounts;
+   Node[m_strPointIds] >> PointIds;
+   bRet = UnpackPointIds(IdCounts.data(), IdCounts.size(), PointIds.data(),
+         PointIds.size(), m_ImagePoints, m_Board.GetObjectPoints().rows,
+         m_PointIds);
+
+   return (bRet);
+
+   } // end of method CameraCalibration::Read
+
+/******************************************************************************
+*
+***  CameraCalibration::IsBinaryFileName
+*
+******************************************************************************/
+
+bool CameraCalibration::IsBinaryFileName(const std::string& strFileName)
+   {
+   std::string strExt = boost::filesystem::path(strFileName).extension().string();
+   std::transform(strExt.begin(), strExt.end(), strExt.begin(),
+         [](unsigned char c) { return (static_cast<char>(std::tolower(c))); });
+
+   return (strExt == ".dcal");
+
+   } // end of method CameraCalibration::IsBinaryFileName
+
+/******************************************************************************
+*
+***  CameraCalibration::IsCameraMatrix
+*
+******************************************************************************/
+
+bool CameraCalibration::IsCameraMatrix(const cv::Mat& CameraMatrix)
+   {
+   return ((CameraMatrix.type() == CV_64F) && (CameraMatrix.rows == 3)
+         && (CameraMatrix.cols == 3));
+
+   } // end of method CameraCalibration::IsCameraMatrix
+
+/******************************************************************************
+*
+***  CameraCalibration::IsDistortionCoeffs
+*
+* The coefficient counts cv::calibrateCamera() produces.
+*
+******************************************************************************/
+
+bool CameraCalibration::IsDistortionCoeffs(const cv::Mat& DistortionCoeffs)
+   {
+   const size_t nCoeffs = DistortionCoeffs.total();
+
+   return ((DistortionCoeffs.type() == CV_64F)
+         && ((DistortionCoeffs.rows == 1) || (DistortionCoeffs.cols == 1))
+         && ((nCoeffs == 4) || (nCoeffs == 5) || (nCoeffs == 8)
+               || (nCoeffs == 12) || (nCoeffs == 14)));
+
+   } // end of method CameraCalibration::IsDistortionCoeffs
+
+/******************************************************************************
+*
+***  PackVecs
+*
+* Rotation/translation vectors as the rows of one N x 3 matrix.
+*
+******************************************************************************/
+
+static cv::Mat PackVecs(const std::vector<cv::Mat>& Vecs)
+   {
+   cv::Mat Packed(static_cast<int>(Vecs.size()), 3, CV_64F);
+
+   for (size_t i = 0 ; i < Vecs.size() ; i++)
+      {
+      Vecs[i].reshape(1, 1).convertTo(Packed.row(static_cast<int>(i)), CV_64F);
+      } // end for
+
+   return (Packed);
+
+   } // end of function PackVecs
+
+/******************************************************************************
+*
+***  UnpackVecs
+*
+******************************************************************************/
+
+static void UnpackVecs(const cv::Mat& Packed, std::vector<cv::Mat>& Vecs)
+   {
+   Vecs.resize(Packed.rows);
+
+   // Headers of the rows, no copy
+   for (int i = 0 ; i < Packed.rows ; i++)
+      {
+      Vecs[i] = Packed.row(i).reshape(1, 3);
+      } // end for
+
+   return;
+
+   } // end of function UnpackVecs
+
+/******************************************************************************
+*
+***  IsPackedVecs
+*
+* Packed is nViews rotation or translation vectors, or empty.
+*
+******************************************************************************/
+
+static bool IsPackedVecs(const cv::Mat& Packed, size_t nViews)
+   {
+   return (Packed.empty() || ((Packed.type() == CV_64F) && (Packed.cols == 3)
+         && (static_cast<size_t>(Packed.rows) == nViews)));
+
+   } // end of function IsPackedVecs
+
+/******************************************************************************
+*
+***  IsCountsSection
+*
+* Counts is one non-negative CV_32S count per view adding up to nTotal.  No
+* views at all is an empty section.
+*
+******************************************************************************/
+
+static bool IsCountsSection(const cv::Mat& Counts, size_t nTotal)
+   {
+   if (Counts.empty())
+      {
+      return (nTotal == 0);
+      } // end if
 
-   FS << m_strID << "{"
-      << m_strBoard << m_Board
-      << m_strFixAspectRatio << m_bFixAspectRatio
-      << m_strFlag << m_nFlag
-      << m_strImageSize << m_ImageSize
-      << m_strCameraMatrix << m_CameraMatrix
-      << m_strDistortionCoeffs << m_DistortionCoeffs
-      << m_strRVecs << m_RVecs
-      << m_strTVecs << m_TVecs
-      << m_strRMS << m_dRMS
-      << m_strReprojErrors << m_ReprojErrors
-      << m_strTotalAvgError << m_dTotalAvgError
-      << m_strImagePoints << m_ImagePoints
-      << m_strGoodImages << m_nGoodImages
-      << "}";
+   bool bRet = (Counts.type() == CV_32S) && Counts.isContinuous();
+   size_t nSum = 0;
+   const int* pCounts = Counts.ptr<int>();
+   for (size_t i = 0 ; bRet && (i < Counts.total()) ; i++)
+      {
+      bRet = (pCounts[i] >= 0) && (static_cast<size_t>(pCounts[i]) <= nTotal - nSum);
+      if (bRet)
+         {
+         nSum += pCounts[i];
+         } // end if
+      } // end for
 
-   return (bRet);
+   return (bRet && (nSum == nTotal));
 
-   } // end of method CameraCalibration::Write
+   } // end of function IsCountsSection
 
 /******************************************************************************
 *
-***  CameraCalibration::Read
+***  CameraCalibration::WriteBinary
 *
-* Read calibration data from file into memory using OpenCV's FileStorage
-* mechanism.
+* Write the same data as Write(cv::FileStorage&) to a binary .dcal file.  The
+* image points of all the views are stored back to back with a separate
+* count per view.
 *
 ******************************************************************************/
 
-bool CameraCalibration::Read(const cv::FileNode& Node)
+bool CameraCalibration::WriteBinary(const std::string& strFileName) const
    {
-   bool bRet = true;
+   cv::Mat Params = (cv::Mat_<double>(1, 11) <<
+         static_cast<int>(m_Board.m_ePattern),
+         m_Board.m_BoardSize.width, m_Board.m_BoardSize.height,
+         m_Board.m_fSquareSize,
+         m_bFixAspectRatio ? 1.0 : 0.0,
+         m_nFlag,
+         m_ImageSize.width, m_ImageSize.height,
+         m_dRMS, m_dTotalAvgError, m_nGoodImages);
+
+   size_t nTotalPoints = 0;
+   cv::Mat PointCounts(static_cast<int>(m_ImagePoints.size()), 1, CV_32S);
+   for (size_t i = 0 ; i < m_ImagePoints.size() ; i++)
+      {
+      PointCounts.at<int>(static_cast<int>(i)) = static_cast<int>(m_ImagePoints[i].size());
+      nTotalPoints += m_ImagePoints[i].size();
+      } // end for
 
-   Node[m_strBoard] >> m_Board;
-   Node[m_strFixAspectRatio] >> m_bFixAspectRatio;
-   Node[m_strFlag] >> m_nFlag;
-   Node[m_strImageSize] >> m_ImageSize;
-   Node[m_strCameraMatrix] >> m_CameraMatrix;
-   Node[m_strDistortionCoeffs] >> m_DistortionCoeffs;
-   Node[m_strRVecs] >> m_RVecs;
-   Node[m_strTVecs] >> m_TVecs;
-   Node[m_strRMS] >> m_dRMS;
-   Node[m_strReprojErrors] >> m_ReprojErrors;
-   Node[m_strTotalAvgError] >> m_dTotalAvgError;
-   Node[m_strImagePoints] >> m_ImagePoints;
-   Node[m_strGoodImages] >> m_nGoodImages;
+   cv::Mat ImagePoints(static_cast<int>(nTotalPoints), 1, CV_32FC2);
+   cv::Point2f* pDst = ImagePoints.ptr<cv::Point2f>();
+   for (const auto& Points : m_ImagePoints)
+      {
+      pDst = std::copy(Points.begin(), Points.end(), pDst);
+      } // end for
+
+   // Corner ids of the partial views
+   std::vector<int> IdCounts;
+   std::vector<int> PointIds;
+   PackPointIds(IdCounts, PointIds);
+
+   CameraCalibrationFileWriter Writer;
+   Writer.AddSection("Params", Params);
+   Writer.AddSection(m_strCameraMatrix, m_CameraMatrix);
+   Writer.AddSection("Distortion", m_DistortionCoeffs);
+   // Results of the last calibration, only if they are for the current views
+   bool bResults = (m_RVecs.size() == m_ImagePoints.size())
+         && (m_TVecs.size() == m_ImagePoints.size())
+         && (m_ReprojErrors.size() == m_ImagePoints.size());
+   Writer.AddSection(m_strRVecs, bResults ? PackVecs(m_RVecs) : cv::Mat());
+   Writer.AddSection(m_strTVecs, bResults ? PackVecs(m_TVecs) : cv::Mat());
+   Writer.AddSection("ReprojErrors", bResults ? cv::Mat(m_ReprojErrors, false) : cv::Mat());
+   Writer.AddSection("PointCounts", PointCounts);
+   Writer.AddSection(m_strImagePoints, ImagePoints);
+   if (!PointIds.empty())
+      {
+      Writer.AddSection(m_strIdCounts, cv::Mat(IdCounts, false));
+      Writer.AddSection(m_strPointIds, cv::Mat(PointIds, false));
+      } // end if
+
+   return (Writer.Write(strFileName));
+
+   } // end of method CameraCalibration::WriteBinary
+
+/******************************************************************************
+*
+***  CameraCalibration::ReadBinary
+*
+* Read a .dcal file written by WriteBinary.  The file is memory mapped and
+* the per-view rotation and translation vectors are used in place, the
+* mapping being kept in m_pMapping.  The small camera matrix and distortion
+* coefficients are cloned so the intrinsics, which are what gets copied
+* around and written back, never depend on the file.  The point lists,
+* which are vectors, are copied out.  Every count is checked against the
+* data it indexes before it is used.  Every section is checked before any
+* member is changed, so a bad file leaves the calibration as it was.  The
+* residuals and saved images belong to the views being replaced and are
+* dropped, and the coverage is recounted for the new views.
+*
+******************************************************************************/
+
+bool CameraCalibration::ReadBinary(const std::string& strFileName)
+   {
+   CameraCalibrationMappedFile File;
+   bool bRet = File.Open(strFileName);
+
+   cv::Mat Params;
+   cv::Mat CameraMatrix;
+   cv::Mat DistortionCoeffs;
+   cv::Mat PointCounts;
+   cv::Mat ImagePoints;
+   cv::Mat RVecs;
+   cv::Mat TVecs;
+   cv::Mat ReprojErrors;
+   cv::Mat IdCounts;
+   cv::Mat PointIds;
+   size_t nViews = 0;
+   if (bRet)
+      {
+      Params = File.GetSection("Params");
+      CameraMatrix = File.GetSection(m_strCameraMatrix);
+      DistortionCoeffs = File.GetSection("Distortion");
+      PointCounts = File.GetSection("PointCounts");
+      ImagePoints = File.GetSection(m_strImagePoints);
+      RVecs = File.GetSection(m_strRVecs);
+      TVecs = File.GetSection(m_strTVecs);
+      ReprojErrors = File.GetSection("ReprojErrors");
+      IdCounts = File.GetSection(m_strIdCounts);
+      PointIds = File.GetSection(m_strPointIds);
+
+      nViews = PointCounts.total();
+      bRet = (Params.type() == CV_64F) && (Params.total() >= 11)
+            && IsCameraMatrix(CameraMatrix)
+            && IsDistortionCoeffs(DistortionCoeffs)
+            && (ImagePoints.empty() || (ImagePoints.type() == CV_32FC2))
+            && IsCountsSection(PointCounts, ImagePoints.total())
+            && IsPackedVecs(RVecs, nViews) && IsPackedVecs(TVecs, nViews)
+            && (RVecs.rows == TVecs.rows)
+            && (ReprojErrors.empty() || ((ReprojErrors.type() == CV_64F)
+                  && (ReprojErrors.total() == nViews)))
+            && (IdCounts.empty() || ((IdCounts.type() == CV_32S) && IdCounts.isContinuous()))
+            && (PointIds.empty() || ((PointIds.type() == CV_32S) && PointIds.isContinuous()));
+      } // end if
+
+   CameraCalibrationBoard Board(m_Board);
+   cv::Size ImageSize;
+   const double* pParams = nullptr;
+   if (bRet)
+      {
+      pParams = Params.ptr<double>();
+      const int nPattern = static_cast<int>(pParams[0]);
+      Board.m_ePattern = static_cast<CameraCalibrationBoard::EPattern>(nPattern);
+      Board.m_BoardSize = cv::Size(static_cast<int>(pParams[1]), static_cast<int>(pParams[2]));
+      Board.m_fSquareSize = static_cast<float>(pParams[3]);
+      ImageSize = cv::Size(static_cast<int>(pParams[6]), static_cast<int>(pParams[7]));
+
+      bRet = (nPattern >= static_cast<int>(CameraCalibrationBoard::EPattern::eChessBoard))
+            && (nPattern <= static_cast<int>(CameraCalibrationBoard::EPattern::eAsymmetricCirclesGrid))
+            && (Board.m_BoardSize.width > 0) && (Board.m_BoardSize.height > 0)
+            && (ImageSize.width > 0) && (ImageSize.height > 0);
+      } // end if
+
+   // The point lists are copied out and the corner ids checked against them
+   // and the board
+   std::vector<std::vector<cv::Point2f>> Points;
+   std::vector<std::vector<int>> Ids;
+   if (bRet)
+      {
+      Points.resize(nViews);
+      const cv::Point2f* pSrc = ImagePoints.empty() ? nullptr : ImagePoints.ptr<cv::Point2f>();
+      for (size_t i = 0 ; i < Points.size() ; i++)
+         {
+         int nPoints = PointCounts.at<int>(static_cast<int>(i));
+         Points[i].assign(pSrc, pSrc + nPoints);
+         pSrc += nPoints;
+         } // end for
+
+      bRet = UnpackPointIds(IdCounts.empty() ? nullptr : IdCounts.ptr<int>(), IdCounts.total(),
+            PointIds.empty() ? nullptr : PointIds.ptr<int>(), PointIds.total(),
+            Points, Board.GetObjectPoints().rows, Ids);
+      } // end if
+
+   if (bRet)
+      {
+      m_Board = Board;
+      m_bFixAspectRatio = (pParams[4] != 0.0);
+      m_nFlag = static_cast<int>(pParams[5]);
+      m_ImageSize = ImageSize;
+      m_dRMS = pParams[8];
+      m_dTotalAvgError = pParams[9];
+      m_nGoodImages = static_cast<int>(pParams[10]);
+
+      m_CameraMatrix = CameraMatrix.clone();
+      m_DistortionCoeffs = DistortionCoeffs.clone();
+      UnpackVecs(RVecs, m_RVecs);
+      UnpackVecs(TVecs, m_TVecs);
+      m_pMapping = File.GetMapping();
+
+      m_ReprojErrors.clear();
+      if (!ReprojErrors.empty())
+         {
+         m_ReprojErrors.assign(ReprojErrors.ptr<double>(),
+               ReprojErrors.ptr<double>() + ReprojErrors.total());
+         } // end if
+
+      m_ImagePoints.swap(Points);
+      m_PointIds.swap(Ids);
+      m_Residuals.clear();
+      m_Images.clear();
+      SetCoverageGrid(m_Coverage.size());
+      } // end if
 
    return (bRet);
 
-   } // end of method CameraCalibration::Read
+   } // end of method CameraCalibration::ReadBinary
 
 /******************************************************************************
 *
@@ -602,16 +2335,13 @@ bool CameraCalibration::WriteImages(const std::string& strBaseFileName,
    {
    bool bRet = true;
 
-   int i = 0;
-   for (const auto& Image : m_Images)
+   for (size_t i = 0 ; i < m_Images.size() ; i++)
       {
       std::string strCounter(boost::lexical_cast<std::string>(i));
       std::string strImageFile = strBaseFileName + "-" + strCounter + "."
             + strExtension;
 
-      cv::imwrite(strImageFile, Image);
-
-      i++;
+      cv::imwrite(strImageFile, m_Images.Get(i));
       } // end for
 
    return (bRet);
@@ -656,3 +2386,339 @@ bool CameraCalibration::ReadDistortionCoeffs(const cv::FileNode& Node,
    return (bRet);
 
    } // end of method CameraCalibration::ReadDistortionCoeffs
+
+/*****************************************************************************
+ ***  class CameraCalibrationDetector
+ ****************************************************************************/
+
+/******************************************************************************
+*
+***  CameraCalibrationDetector::CameraCalibrationDetector
+*
+******************************************************************************/
+
+CameraCalibrationDetector::CameraCalibrationDetector(
+      const CameraCalibrationBoard& Board, int nThreads /* = 0 */) :
+      m_Board(Board),
+      m_nInFlight(0),
+      m_bStop(false),
+      m_nCoarseWidth(0),
+      m_nSubmitted(0),
+      m_nDropped(0)
+   {
+   if (nThreads <= 0)
+      {
+      nThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+      } // end if
+
+   try
+      {
+      for (int i = 0 ; i < nThreads ; i++)
+         {
+         m_Workers.emplace_back(&CameraCalibrationDetector::WorkerThread, this);
+         } // end for
+      } // end try
+   catch (...)
+      {
+      // The destructor won't run so stop the workers that did start
+         {
+         std::lock_guard<std::mutex> Lock(m_Mutex);
+         m_bStop = true;
+         }
+
+      m_JobReady.notify_all();
+
+      for (auto& Worker : m_Workers)
+         {
+         Worker.join();
+         } // end for
+
+      throw;
+      } // end catch
+
+   return;
+
+   } // end of method CameraCalibrationDetector::CameraCalibrationDetector
+
+/******************************************************************************
+*
+***  CameraCalibrationDetector::~CameraCalibrationDetector
+*
+* Frames already accepted are finished before the workers exit so no future
+* is left without a value.
+*
+******************************************************************************/
+
+CameraCalibrationDetector::~CameraCalibrationDetector()
+   {
+      {
+      std::lock_guard<std::mutex> Lock(m_Mutex);
+      m_bStop = true;
+      }
+
+   m_JobReady.notify_all();
+
+   for (auto& Worker : m_Workers)
+      {
+      Worker.join();
+      } // end for
+
+   return;
+
+   } // end of method CameraCalibrationDetector::~CameraCalibrationDetector
+
+/******************************************************************************
+*
+***  CameraCalibrationDetector::SetCallback
+*
+******************************************************************************/
+
+void CameraCalibrationDetector::SetCallback(const Callback& Fn)
+   {
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+   m_Callback = Fn;
+
+   return;
+
+   } // end of method CameraCalibrationDetector::SetCallback
+
+/******************************************************************************
+*
+***  CameraCalibrationDetector::SetCoarseWidth
+*
+******************************************************************************/
+
+void CameraCalibrationDetector::SetCoarseWidth(int nWidth)
+   {
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+   m_nCoarseWidth = nWidth;
+
+   return;
+
+   } // end of method CameraCalibrationDetector::SetCoarseWidth
+
+/******************************************************************************
+*
+***  CameraCalibrationDetector::Submit
+*
+* Queue a frame for detection if a worker is free.  Returns an invalid future
+* (valid() == false) when the frame was dropped.
+*
+******************************************************************************/
+
+std::future<CameraCalibrationDetector::Result> CameraCalibrationDetector::Submit(
+      const cv::Mat& Image, const cv::Mat& GrayImage /* = cv::Mat() */)
+   {
+   unsigned long nFrame;
+
+      {
+      std::lock_guard<std::mutex> Lock(m_Mutex);
+      nFrame = m_nSubmitted++;
+      if (m_bStop || (m_nInFlight >= GetNumThreads()))
+         {
+         m_nDropped++;
+         return (std::future<Result>());
+         } // end if
+
+      // Reserve the worker before copying so a concurrent Submit can't
+      // over commit the pool
+      m_nInFlight++;
+      }
+
+   // Copy outside the lock, only for frames that will actually be processed.
+   // The reserved worker is given back if a copy throws or the detector was
+   // stopped meanwhile, since no worker would take the job and Wait() would
+   // never return.
+   std::future<Result> Future;
+   bool bQueued = false;
+   try
+      {
+      Job NewJob;
+      NewJob.m_Image = Image.clone();
+      if (!GrayImage.empty())
+         {
+         NewJob.m_GrayImage = GrayImage.clone();
+         } // end if
+      NewJob.m_nFrame = nFrame;
+      Future = NewJob.m_Promise.get_future();
+
+      std::lock_guard<std::mutex> Lock(m_Mutex);
+      if (m_bStop)
+         {
+         m_nDropped++;
+         } // end if
+      else
+         {
+         m_Jobs.push_back(std::move(NewJob));
+         bQueued = true;
+         } // end else
+      } // end try
+   catch (...)
+      {
+      ReleaseSlot();
+      throw;
+      } // end catch
+
+   if (!bQueued)
+      {
+      ReleaseSlot();
+      return (std::future<Result>());
+      } // end if
+
+   m_JobReady.notify_one();
+
+   return (Future);
+
+   } // end of method CameraCalibrationDetector::Submit
+
+/******************************************************************************
+*
+***  CameraCalibrationDetector::Wait
+*
+******************************************************************************/
+
+void CameraCalibrationDetector::Wait()
+   {
+   std::unique_lock<std::mutex> Lock(m_Mutex);
+   m_JobDone.wait(Lock, [this] { return (m_nInFlight == 0); });
+
+   return;
+
+   } // end of method CameraCalibrationDetector::Wait
+
+/******************************************************************************
+*
+***  CameraCalibrationDetector::IsBusy
+*
+* True when the next Submit() would be dropped.
+*
+******************************************************************************/
+
+bool CameraCalibrationDetector::IsBusy() const
+   {
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+
+   return (m_nInFlight >= GetNumThreads());
+
+   } // end of method CameraCalibrationDetector::IsBusy
+
+/******************************************************************************
+*
+***  CameraCalibrationDetector::GetNumSubmitted
+*
+******************************************************************************/
+
+unsigned long CameraCalibrationDetector::GetNumSubmitted() const
+   {
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+
+   return (m_nSubmitted);
+
+   } // end of method CameraCalibrationDetector::GetNumSubmitted
+
+/******************************************************************************
+*
+***  CameraCalibrationDetector::GetNumDropped
+*
+******************************************************************************/
+
+unsigned long CameraCalibrationDetector::GetNumDropped() const
+   {
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+
+   return (m_nDropped);
+
+   } // end of method CameraCalibrationDetector::GetNumDropped
+
+/******************************************************************************
+*
+***  CameraCalibrationDetector::WorkerThread
+*
+* Pull frames off the queue, detect the pattern and publish the result.
+*
+******************************************************************************/
+
+void CameraCalibrationDetector::WorkerThread()
+   {
+   for (;;)
+      {
+      Job CurJob;
+      Callback Fn;
+      int nCoarseWidth;
+
+         {
+         std::unique_lock<std::mutex> Lock(m_Mutex);
+         m_JobReady.wait(Lock, [this] { return (m_bStop || !m_Jobs.empty()); });
+         if (m_Jobs.empty())
+            {
+            break;
+            } // end if
+
+         CurJob = std::move(m_Jobs.front());
+         m_Jobs.pop_front();
+         Fn = m_Callback;
+         nCoarseWidth = m_nCoarseWidth;
+         }
+
+      Result Res;
+      Res.m_nFrame = CurJob.m_nFrame;
+      Res.m_Image = CurJob.m_Image;
+
+      // Anything thrown here must go to the future, an exception leaving
+      // the thread would terminate the program
+      try
+         {
+         cv::Mat GrayImage = CurJob.m_GrayImage;
+         if (GrayImage.empty())
+            {
+            if (CurJob.m_Image.channels() == 1)
+               {
+               GrayImage = CurJob.m_Image;
+               } // end if
+            else
+               {
+               cv::cvtColor(CurJob.m_Image, GrayImage,
+                     (CurJob.m_Image.channels() == 4) ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+               } // end else
+            } // end if
+
+         Res.m_bFound = m_Board.FindPattern(CurJob.m_Image, GrayImage, Res.m_Points,
+               nCoarseWidth);
+         if (Fn)
+            {
+            Fn(Res);
+            } // end if
+         CurJob.m_Promise.set_value(std::move(Res));
+         } // end try
+      catch (...)
+         {
+         CurJob.m_Promise.set_exception(std::current_exception());
+         } // end catch
+
+      ReleaseSlot();
+      } // end for
+
+   return;
+
+   } // end of method CameraCalibrationDetector::WorkerThread
+
+/******************************************************************************
+*
+***  CameraCalibrationDetector::ReleaseSlot
+*
+* Give back a worker reserved by Submit() and wake Wait().
+*
+******************************************************************************/
+
+void CameraCalibrationDetector::ReleaseSlot()
+   {
+      {
+      std::lock_guard<std::mutex> Lock(m_Mutex);
+      m_nInFlight--;
+      }
+
+   m_JobDone.notify_all();
+
+   return;
+
+   } // end of method CameraCalibrationDetector::ReleaseSlot
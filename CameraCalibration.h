@@ -14,6 +14,13 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 #include <opencv2/core.hpp>
 #include <opencv2/calib3d.hpp>
@@ -55,7 +62,36 @@ class CameraCalibrationBoard
          return (Read(Node));
          }
 
+      // Pattern detection.  Only reads the board so it is safe to call from
+      // several threads at once.  A nonzero nCoarseWidth searches for a
+      // chessboard on a Gaussian pyramid level about that wide and refines
+      // the corners back up to full resolution.
+      bool FindPattern(const cv::Mat& Image, const cv::Mat& GrayImage,
+            std::vector<cv::Point2f>& Points, int nCoarseWidth = 0) const;
+      void DrawPattern(cv::Mat& Image, const std::vector<cv::Point2f>& Points,
+            bool bFound) const;
+
+      // 3D positions of every corner, row major, as an N x 1 CV_32FC3 Mat.
+      // Built once and shared (not copied) by everything that uses it; it is
+      // rebuilt if the public pattern members have been changed since.  Safe
+      // to call from several threads at once, the cache being guarded by
+      // m_CacheMutex, but not against changes to those members from another
+      // thread.
+      const cv::Mat& GetObjectPoints() const;
+      // The corners with the given ids (indices into GetObjectPoints())
+      cv::Mat GetObjectPoints(const std::vector<int>& Ids) const;
+
    protected:
+      // Cached object points and the pattern they were built for
+      mutable cv::Mat m_ObjectPoints;
+      mutable EPattern m_eCachedPattern;
+      mutable cv::Size m_CachedBoardSize;
+      mutable float m_fCachedSquareSize;
+      mutable std::mutex m_CacheMutex;
+
+      bool FindChessboardCoarseToFine(const cv::Mat& GrayImage,
+            std::vector<cv::Point2f>& Points, int nCoarseWidth) const;
+
       // Storage Names for serialization
       static const std::string m_strID;
       static const std::string m_strBoardSize;
@@ -71,6 +107,125 @@ void write(cv::FileStorage& FS, cv::String&, const CameraCalibrationBoard& X);
 void read(const cv::FileNode& Node, CameraCalibrationBoard& X,
           CameraCalibrationBoard Default = CameraCalibrationBoard());
 
+/*****************************************************************************
+ *
+ ***  class CameraCalibrationImageStore
+ *
+ * Holds the frames accepted into a calibration for later reprocessing.  Full
+ * resolution frames add up quickly so the storage can be
+ *
+ *   eRaw         - uncompressed in memory (the original behavior)
+ *   eCompressed  - encoded in memory (PNG by default, which is lossless)
+ *   eDisk        - encoded to files in a directory, only the names in memory
+ *
+ * and independently cropped to the detected board plus a margin.  GetROI()
+ * gives the location of a cropped frame in the original image.
+ *
+ * Files written by eDisk belong to the store and are deleted when the last
+ * copy of the store referring to them goes away (copies share them).  Each
+ * file gets a unique name so copies adding to the same directory can't
+ * overwrite one another.  A directory made under the temp directory is
+ * removed along with the last store or file that uses it.
+ *
+ *****************************************************************************/
+
+class CameraCalibrationImageStore
+   {
+   public:
+      enum class EStorage { eRaw, eCompressed, eDisk };
+
+      CameraCalibrationImageStore();
+      CameraCalibrationImageStore(const CameraCalibrationImageStore& src) = default;
+
+      ~CameraCalibrationImageStore() = default;
+
+      CameraCalibrationImageStore& operator=(
+            const CameraCalibrationImageStore& rhs) = default;
+
+      // strFormat is an imencode extension (".png", ".jpg", ...).  An empty
+      // strDirectory for eDisk makes a unique one under the temp directory.
+      // Only affects frames added afterwards.
+      void SetStorage(EStorage eStorage,
+            const std::string& strFormat = std::string(".png"),
+            const std::string& strDirectory = std::string());
+
+      EStorage GetStorage() const
+         {
+         return (m_eStorage);
+         }
+
+      // Keep only the bounding box of the pattern points grown by nMargin
+      void SetCropToBoard(bool bCrop, int nMargin = 32)
+         {
+         m_bCropToBoard = bCrop;
+         m_nMargin = nMargin;
+
+         return;
+         }
+
+      bool Add(const cv::Mat& Image, const std::vector<cv::Point2f>& Points);
+
+      cv::Mat Get(size_t nIndex) const;
+
+      cv::Rect GetROI(size_t nIndex) const
+         {
+         return (m_Entries[nIndex].m_ROI);
+         }
+
+      size_t size() const
+         {
+         return (m_Entries.size());
+         }
+
+      bool empty() const
+         {
+         return (m_Entries.empty());
+         }
+
+      void clear()
+         {
+         m_Entries.clear();
+
+         return;
+         }
+
+      void erase(size_t nIndex)
+         {
+         m_Entries.erase(m_Entries.begin() + nIndex);
+
+         return;
+         }
+
+      // Bytes of image data held in memory
+      size_t GetMemoryUsage() const;
+
+   protected:
+      struct DEntry
+         {
+         cv::Mat m_Image;
+         std::shared_ptr<std::vector<unsigned char>> m_pEncoded;
+         // Keeps a temporary directory alive while the file is in it
+         std::shared_ptr<const std::string> m_pTempDirectory;
+         // Deleter removes the file
+         std::shared_ptr<const std::string> m_pFileName;
+         cv::Rect m_ROI;
+         };
+
+      EStorage m_eStorage;
+      std::string m_strFormat;
+      std::string m_strDirectory;
+      // Set when m_strDirectory was made by the store, deleter removes it
+      std::shared_ptr<const std::string> m_pTempDirectory;
+      bool m_bCropToBoard;
+      int m_nMargin;
+      std::vector<DEntry> m_Entries;
+
+      std::vector<int> GetEncodeParams() const;
+
+   private:
+
+   }; // end of class CameraCalibrationImageStore
+
 /*****************************************************************************
  *
  ***  class CameraCalibration
@@ -88,10 +243,22 @@ class CameraCalibration
       CameraCalibration();
       CameraCalibration(const CameraCalibration& src);
 
-      ~CameraCalibration() = default;
+      ~CameraCalibration();
 
       CameraCalibration& operator=(const CameraCalibration& rhs);
 
+      // Running estimate published by the incremental mode
+      struct Estimate
+         {
+         bool m_bValid;
+         int m_nImages;
+         double m_dRMS;
+         // Change in RMS from the previous estimate (0 for the first)
+         double m_dRMSChange;
+         cv::Mat m_CameraMatrix;
+         cv::Mat m_DistortionCoeffs;
+         };
+
       int GetNumGoodImages() const
          {
          return (m_nGoodImages);
@@ -101,16 +268,139 @@ class CameraCalibration
             const cv::Size& ImageSize, bool bFixAspectRatio,
             int nFlag,bool bSaveImages = false);
 
+      const CameraCalibrationBoard& GetBoard() const
+         {
+         return (m_Board);
+         }
+
+      const cv::Size& GetImageSize() const
+         {
+         return (m_ImageSize);
+         }
+
+      const cv::Mat& GetCameraMatrix() const
+         {
+         return (m_CameraMatrix);
+         }
+
+      const cv::Mat& GetDistortionCoeffs() const
+         {
+         return (m_DistortionCoeffs);
+         }
+
+      // Intrinsics from elsewhere, e.g. a stereo calibration file.  The
+      // Mats are copied.
+      void SetIntrinsics(const cv::Mat& CameraMatrix,
+            const cv::Mat& DistortionCoeffs, const cv::Size& ImageSize);
+
+      double GetRMS() const
+         {
+         return (m_dRMS);
+         }
+
+      const std::vector<std::vector<cv::Point2f>>& GetImagePoints() const
+         {
+         return (m_ImagePoints);
+         }
+
+      const std::vector<std::vector<int>>& GetPointIds() const
+         {
+         return (m_PointIds);
+         }
+
+      // Storage policy for the saved frames (see m_bSaveImages)
+      CameraCalibrationImageStore& GetImageStore()
+         {
+         return (m_Images);
+         }
+
+      const CameraCalibrationImageStore& GetImageStore() const
+         {
+         return (m_Images);
+         }
+
+      // Incremental mode.  Every accepted frame queues a recalibration on a
+      // background thread, seeded with the last estimate.  Only the newest
+      // request is kept if one is already running.  Not carried by copies.
+      void SetIncremental(bool bIncremental);
+      bool IsIncremental() const
+         {
+         return (static_cast<bool>(m_pIncremental));
+         }
+
+      Estimate GetEstimate() const;
+      bool IsRecalibrating() const;
+
+      // Board coverage of the image.  The grid counts the corners accepted in
+      // each cell; the coverage is the fraction of cells with at least one.
+      void SetCoverageGrid(const cv::Size& GridSize);
+      const cv::Mat& GetCoverageGrid() const
+         {
+         return (m_Coverage);
+         }
+
+      double GetCoverage() const;
+
+      // Detect chessboards on a pyramid level about nWidth pixels wide
+      // (0 searches at full resolution)
+      void SetCoarseWidth(int nWidth)
+         {
+         m_nCoarseWidth = nWidth;
+
+         return;
+         }
+
+      int GetCoarseWidth() const
+         {
+         return (m_nCoarseWidth);
+         }
+
       bool ProcessImage(cv::Mat &Image, cv::Mat& GrayImage,
             bool bAnnotateImage, bool bUseImage);
+      // False, leaving the views as they were, if the ids aren't corners of
+      // the board or the image should have been saved and couldn't be
+      bool AddImagePoints(const std::vector<cv::Point2f>& Points,
+            const cv::Mat& Image);
+      // Partial view (e.g. ChArUco) where Points[i] is board corner Ids[i]
+      bool AddImagePoints(const std::vector<cv::Point2f>& Points,
+            const std::vector<int>& Ids, const cv::Mat& Image);
+      // Drop an accepted view along with its saved image
+      void RemoveView(size_t nIndex);
       bool RunCalibration();
+      // Calibrate then repeatedly drop the worst view and recalibrate while
+      // its error exceeds dFactor times the median view error.  The indices
+      // (as of the call) of the dropped views are returned in Rejected.
+      bool RunCalibrationRejectOutliers(std::vector<int>& Rejected,
+            double dFactor = 2.0, int nMaxRejected = 10);
+
+      const std::vector<double>& GetReprojectionErrors() const
+         {
+         return (m_ReprojErrors);
+         }
+
+      // Projected minus detected position for every point of every view
+      const std::vector<std::vector<cv::Point2f>>& GetResiduals() const
+         {
+         return (m_Residuals);
+         }
 
-      // Serialization functions
+      // Offline calibration from a directory of saved frames.  Replaces any
+      // views already accepted.
+      bool CalibrateFromDirectory(const std::string& strDirectory,
+            std::vector<std::string>& FailedFiles);
+
+      // Serialization functions.  File names ending in .dcal use the binary
+      // format (see CameraCalibrationFile.h), anything else cv::FileStorage.
       bool Write(cv::FileStorage& FS) const;
       bool Write(const std::string& strFileName) const;
       bool Read(const cv::FileNode& Node);
       bool Read(const std::string& strFileName)
          {
+         if (IsBinaryFileName(strFileName))
+            {
+            return (ReadBinary(strFileName));
+            } // end if
+
          cv::FileStorage FS(strFileName, cv::FileStorage::READ);
          bool bRet = FS.isOpened();
          if (bRet)
@@ -120,6 +410,15 @@ class CameraCalibration
          return (bRet);
          }
 
+      bool WriteBinary(const std::string& strFileName) const;
+      bool ReadBinary(const std::string& strFileName);
+      static bool IsBinaryFileName(const std::string& strFileName);
+
+      // Shapes the calibration is stored in: a 3x3 CV_64F camera matrix and
+      // a row or column of 4, 5, 8, 12 or 14 CV_64F distortion coefficients
+      static bool IsCameraMatrix(const cv::Mat& CameraMatrix);
+      static bool IsDistortionCoeffs(const cv::Mat& DistortionCoeffs);
+
       bool Read(const cv::FileStorage& FS)
          {
          cv::FileNode Node = FS[m_strID];
@@ -161,11 +460,22 @@ class CameraCalibration
       std::vector<cv::Mat> m_TVecs;
       double m_dRMS;
       std::vector<double> m_ReprojErrors;
+      std::vector<std::vector<cv::Point2f>> m_Residuals;
       double m_dTotalAvgError;
       std::vector<std::vector<cv::Point2f>> m_ImagePoints;
-      std::vector<cv::Mat> m_Images;
+      // Board corner ids of each view, empty for views of the whole board
+      std::vector<std::vector<int>> m_PointIds;
+      CameraCalibrationImageStore m_Images;
       int m_nGoodImages;
       bool m_bSaveImages;
+      int m_nCoarseWidth;
+      cv::Mat m_Coverage;
+      // Mapped .dcal file the view vectors read by ReadBinary() point into
+      std::shared_ptr<const void> m_pMapping;
+
+      // Background recalibration state (incremental mode only)
+      struct DIncremental;
+      std::shared_ptr<DIncremental> m_pIncremental;
 
       // Storage names
       static const std::string m_strID;
@@ -183,14 +493,121 @@ class CameraCalibration
       static const std::string m_strGoodImages;
       static const std::string m_strImageSize;
       static const std::string m_strSaveImages;
-
-      void CalcBoardCornerPositions(std::vector<cv::Point3f>& Corners);
+      static const std::string m_strIdCounts;
+      static const std::string m_strPointIds;
+
+      void ClearViews();
+      bool IsValidPointIds(const std::vector<int>& Ids, size_t nPoints) const;
+      static bool IsValidPointIds(const std::vector<int>& Ids, size_t nPoints,
+            int nCorners);
+      void PackPointIds(std::vector<int>& IdCounts, std::vector<int>& PointIds) const;
+      static bool UnpackPointIds(const int* pIdCounts, size_t nCounts,
+            const int* pIds, size_t nIds,
+            const std::vector<std::vector<cv::Point2f>>& ImagePoints,
+            int nCorners, std::vector<std::vector<int>>& PointIds);
+      void GetObjectPoints(std::vector<cv::Mat>& ObjectPoints) const;
+      bool Calibrate(bool bUseIntrinsicGuess);
       double ComputeReprojectionErrors(
-            const std::vector<std::vector<cv::Point3f>>& ObjectPoints);
+            const std::vector<cv::Mat>& ObjectPoints);
+      void UpdateCoverage(const std::vector<cv::Point2f>& Points);
 
    private:
 
    }; // end of class CameraCalibration
 
+/*****************************************************************************
+ *
+ ***  class CameraCalibrationDetector
+ *
+ * Runs the calibration pattern detection on a pool of worker threads so a
+ * live view (GUI) thread never blocks on it.  Frames are submitted with
+ * Submit() and the result is delivered through the returned future and/or
+ * the optional callback.  The callback runs on the worker thread; Qt users
+ * should forward it to the GUI with a queued signal or
+ * QMetaObject::invokeMethod.
+ *
+ * There is no backlog.  A frame submitted while every worker is busy is
+ * dropped and Submit() returns an invalid future, which is what a live
+ * camera feed wants: the next frame is newer anyway.
+ *
+ *****************************************************************************/
+
+class CameraCalibrationDetector
+   {
+   public:
+      struct Result
+         {
+         bool m_bFound;
+         std::vector<cv::Point2f> m_Points;
+         // The submitted (unannotated) image
+         cv::Mat m_Image;
+         // Sequence number of the frame as assigned by Submit()
+         unsigned long m_nFrame;
+         };
+
+      using Callback = std::function<void (const Result&)>;
+
+      // nThreads <= 0 uses the number of hardware threads
+      explicit CameraCalibrationDetector(const CameraCalibrationBoard& Board,
+            int nThreads = 0);
+      CameraCalibrationDetector(const CameraCalibrationDetector& src) = delete;
+
+      ~CameraCalibrationDetector();
+
+      CameraCalibrationDetector& operator=(
+            const CameraCalibrationDetector& rhs) = delete;
+
+      void SetCallback(const Callback& Fn);
+      // See CameraCalibration::SetCoarseWidth()
+      void SetCoarseWidth(int nWidth);
+
+      // GrayImage may be empty in which case the worker does the conversion.
+      // The images are copied so the caller is free to reuse its buffers.
+      std::future<Result> Submit(const cv::Mat& Image,
+            const cv::Mat& GrayImage = cv::Mat());
+
+      // Block until every accepted frame has been processed
+      void Wait();
+
+      bool IsBusy() const;
+
+      int GetNumThreads() const
+         {
+         return (static_cast<int>(m_Workers.size()));
+         }
+
+      unsigned long GetNumSubmitted() const;
+      unsigned long GetNumDropped() const;
+
+   protected:
+      struct Job
+         {
+         cv::Mat m_Image;
+         cv::Mat m_GrayImage;
+         unsigned long m_nFrame;
+         std::promise<Result> m_Promise;
+         };
+
+      CameraCalibrationBoard m_Board;
+      std::vector<std::thread> m_Workers;
+      std::deque<Job> m_Jobs;
+      mutable std::mutex m_Mutex;
+      std::condition_variable m_JobReady;
+      std::condition_variable m_JobDone;
+      // Accepted frames that have not finished yet (queued or running)
+      int m_nInFlight;
+      bool m_bStop;
+      int m_nCoarseWidth;
+      unsigned long m_nSubmitted;
+      unsigned long m_nDropped;
+      Callback m_Callback;
+
+      void WorkerThread();
+      void ReleaseSlot();
+
+   private:
+
+   }; // end of class CameraCalibrationDetector
+
 #endif // CAMERACALIBRATION_H
 
@@ -0,0 +1,337 @@
+/*****************************************************************************
+ ******************************  I N C L U D E  ******************************
+ ****************************************************************************/
+
+#include <cstring>
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "CameraCalibrationFile.h"
+
+/*****************************************************************************
+ ***  File layout
+ ****************************************************************************/
+
+namespace
+   {
+   const char szMagic[4] = { 'D', 'C', 'A', 'L' };
+   const std::uint32_t nByteOrderMark = 0x01020304;
+   const std::uint64_t nAlignment = 64;
+   const size_t nMaxTagLength = 15;
+
+   struct DHeader
+      {
+      char m_szMagic[4];
+      std::uint32_t m_nByteOrder;
+      std::uint32_t m_nVersion;
+      std::uint32_t m_nSections;
+      };
+
+   struct DSection
+      {
+      char m_szTag[nMaxTagLength + 1];
+      std::uint64_t m_nOffset;
+      std::uint64_t m_nBytes;
+      std::int32_t m_nType;
+      std::int32_t m_nRows;
+      std::int32_t m_nCols;
+      std::int32_t m_nReserved;
+      };
+
+   std::uint64_t AlignUp(std::uint64_t nPos)
+      {
+      return ((nPos + nAlignment - 1) & ~(nAlignment - 1));
+      }
+   }
+
+/*****************************************************************************
+ ***  class CameraCalibrationFileWriter
+ ****************************************************************************/
+
+/******************************************************************************
+*
+***  CameraCalibrationFileWriter::AddSection
+*
+******************************************************************************/
+
+void CameraCalibrationFileWriter::AddSection(const std::string& strTag,
+      const cv::Mat& Data)
+   {
+   CV_Assert(!strTag.empty() && (strTag.size() <= nMaxTagLength));
+   CV_Assert(Data.empty() || (Data.dims == 2));
+
+   m_Sections.push_back(std::make_pair(strTag,
+         Data.isContinuous() ? Data : Data.clone()));
+
+   return;
+
+   } // end of method CameraCalibrationFileWriter::AddSection
+
+/******************************************************************************
+*
+***  CameraCalibrationFileWriter::Write
+*
+* The file is written under a temporary name and renamed over strFileName
+* once it is complete.  The file being replaced is never truncated, which
+* matters because its sections may still be mapped, by a reader in this
+* process or another one, and are often what is being written.  Those
+* mappings keep the old contents and new readers never see a partial file.
+* The temporary name is unique so writers racing to save the same file, such
+* as two undistorters filling one map cache, don't write into each other's
+* file; the last rename wins.
+*
+******************************************************************************/
+
+bool CameraCalibrationFileWriter::Write(const std::string& strFileName) const
+   {
+   boost::system::error_code Error;
+   std::string strTempName = strFileName
+         + boost::filesystem::unique_path(".%%%%-%%%%-%%%%.tmp", Error).string();
+   bool bRet = !Error && WriteFile(strTempName);
+
+   if (bRet)
+      {
+      boost::filesystem::rename(strTempName, strFileName, Error);
+      bRet = !Error;
+      } // end if
+
+   if (!bRet)
+      {
+      boost::filesystem::remove(strTempName, Error);
+      } // end if
+
+   return (bRet);
+
+   } // end of method CameraCalibrationFileWriter::Write
+
+/******************************************************************************
+*
+***  CameraCalibrationFileWriter::WriteFile
+*
+******************************************************************************/
+
+bool CameraCalibrationFileWriter::WriteFile(const std::string& strFileName) const
+   {
+   std::ofstream File(strFileName, std::ios::binary | std::ios::trunc);
+   bool bRet = File.is_open();
+   if (bRet)
+      {
+      DHeader Header;
+      std::memcpy(Header.m_szMagic, szMagic, sizeof(szMagic));
+      Header.m_nByteOrder = nByteOrderMark;
+      Header.m_nVersion = CameraCalibrationMappedFile::m_nVersion;
+      Header.m_nSections = static_cast<std::uint32_t>(m_Sections.size());
+
+      // Lay out the table then the aligned section data
+      std::vector<DSection> Table(m_Sections.size());
+      std::uint64_t nPos = sizeof(DHeader) + Table.size() * sizeof(DSection);
+      for (size_t i = 0 ; i < m_Sections.size() ; i++)
+         {
+         const cv::Mat& Data = m_Sections[i].second;
+         DSection& Section = Table[i];
+         std::memset(&Section, 0, sizeof(Section));
+         std::strncpy(Section.m_szTag, m_Sections[i].first.c_str(), nMaxTagLength);
+         nPos = AlignUp(nPos);
+         Section.m_nOffset = nPos;
+         Section.m_nBytes = Data.total() * Data.elemSize();
+         Section.m_nType = Data.type();
+         Section.m_nRows = Data.rows;
+         Section.m_nCols = Data.cols;
+         nPos += Section.m_nBytes;
+         } // end for
+
+      File.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+      if (!Table.empty())
+         {
+         File.write(reinterpret_cast<const char*>(Table.data()),
+               Table.size() * sizeof(DSection));
+         } // end if
+
+      static const char Padding[nAlignment] = { 0 };
+      nPos = sizeof(DHeader) + Table.size() * sizeof(DSection);
+      for (size_t i = 0 ; i < m_Sections.size() ; i++)
+         {
+         File.write(Padding, static_cast<std::streamsize>(Table[i].m_nOffset - nPos));
+         File.write(reinterpret_cast<const char*>(m_Sections[i].second.data),
+               static_cast<std::streamsize>(Table[i].m_nBytes));
+         nPos = Table[i].m_nOffset + Table[i].m_nBytes;
+         } // end for
+
+      File.close();
+      bRet = File.good();
+      } // end if
+
+   return (bRet);
+
+   } // end of method CameraCalibrationFileWriter::WriteFile
+
+/*****************************************************************************
+ ***  class CameraCalibrationMappedFile
+ ****************************************************************************/
+
+/******************************************************************************
+*
+***  CameraCalibrationMappedFile::CameraCalibrationMappedFile
+*
+******************************************************************************/
+
+CameraCalibrationMappedFile::CameraCalibrationMappedFile() :
+      m_nFileVersion(0)
+   {
+
+   return;
+
+   } // end of method CameraCalibrationMappedFile::CameraCalibrationMappedFile
+
+/******************************************************************************
+*
+***  CameraCalibrationMappedFile::~CameraCalibrationMappedFile
+*
+******************************************************************************/
+
+CameraCalibrationMappedFile::~CameraCalibrationMappedFile()
+   {
+   Close();
+
+   return;
+
+   } // end of method CameraCalibrationMappedFile::~CameraCalibrationMappedFile
+
+/******************************************************************************
+*
+***  CameraCalibrationMappedFile::Open
+*
+* Map the file and validate the header and section table.  Nothing is copied.
+* Pages are only copied if a section is written to.
+*
+******************************************************************************/
+
+bool CameraCalibrationMappedFile::Open(const std::string& strFileName)
+   {
+   Close();
+
+   try
+      {
+      boost::interprocess::file_mapping Mapping(strFileName.c_str(),
+            boost::interprocess::read_only);
+      m_pRegion = std::make_shared<boost::interprocess::mapped_region>(Mapping,
+            boost::interprocess::copy_on_write);
+      } // end try
+   catch (const boost::interprocess::interprocess_exception&)
+      {
+      Close();
+      return (false);
+      } // end catch
+
+   unsigned char* pBase = static_cast<unsigned char*>(m_pRegion->get_address());
+   std::uint64_t nSize = m_pRegion->get_size();
+
+   bool bRet = (nSize >= sizeof(DHeader));
+   DHeader Header;
+   if (bRet)
+      {
+      std::memcpy(&Header, pBase, sizeof(Header));
+      bRet = (std::memcmp(Header.m_szMagic, szMagic, sizeof(szMagic)) == 0)
+            && (Header.m_nByteOrder == nByteOrderMark)
+            && (Header.m_nVersion >= 1) && (Header.m_nVersion <= m_nVersion)
+            && (nSize >= sizeof(DHeader) + std::uint64_t(Header.m_nSections) * sizeof(DSection));
+      } // end if
+
+   for (std::uint32_t i = 0 ; bRet && (i < Header.m_nSections) ; i++)
+      {
+      DSection Section;
+      std::memcpy(&Section, pBase + sizeof(DHeader) + i * sizeof(DSection),
+            sizeof(Section));
+      Section.m_szTag[nMaxTagLength] = '\0';
+
+      cv::Mat Data;
+      if (Section.m_nBytes != 0)
+         {
+         bRet = (Section.m_nOffset % nAlignment == 0)
+               && (Section.m_nOffset <= nSize) && (Section.m_nBytes <= nSize - Section.m_nOffset)
+               && (Section.m_nRows > 0) && (Section.m_nCols > 0)
+               && (Section.m_nType == CV_MAT_TYPE(Section.m_nType));
+         if (bRet)
+            {
+            Data = cv::Mat(Section.m_nRows, Section.m_nCols, Section.m_nType,
+                  pBase + Section.m_nOffset);
+            bRet = (Data.total() * Data.elemSize() == Section.m_nBytes);
+            } // end if
+         } // end if
+
+      if (bRet)
+         {
+         m_Sections[Section.m_szTag] = Data;
+         } // end if
+      } // end for
+
+   if (bRet)
+      {
+      m_nFileVersion = Header.m_nVersion;
+      } // end if
+   else
+      {
+      Close();
+      } // end else
+
+   return (bRet);
+
+   } // end of method CameraCalibrationMappedFile::Open
+
+/******************************************************************************
+*
+***  CameraCalibrationMappedFile::Close
+*
+******************************************************************************/
+
+void CameraCalibrationMappedFile::Close()
+   {
+   m_Sections.clear();
+   m_pRegion.reset();
+   m_nFileVersion = 0;
+
+   return;
+
+   } // end of method CameraCalibrationMappedFile::Close
+
+/******************************************************************************
+*
+***  CameraCalibrationMappedFile::GetSection
+*
+******************************************************************************/
+
+cv::Mat CameraCalibrationMappedFile::GetSection(const std::string& strTag) const
+   {
+   cv::Mat Ret;
+
+   auto It = m_Sections.find(strTag);
+   if (It != m_Sections.end())
+      {
+      Ret = It->second;
+      } // end if
+
+   return (Ret);
+
+   } // end of method CameraCalibrationMappedFile::GetSection
+
+/******************************************************************************
+*
+***  CameraCalibrationMappedFile::GetSectionTags
+*
+******************************************************************************/
+
+std::vector<std::string> CameraCalibrationMappedFile::GetSectionTags() const
+   {
+   std::vector<std::string> Tags;
+
+   for (const auto& Section : m_Sections)
+      {
+      Tags.push_back(Section.first);
+      } // end for
+
+   return (Tags);
+
+   } // end of method CameraCalibrationMappedFile::GetSectionTags
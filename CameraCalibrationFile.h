@@ -0,0 +1,135 @@
+#ifndef CAMERACALIBRATIONFILE_H
+#define CAMERACALIBRATIONFILE_H
+
+/* Compact, versioned binary container for calibration data (.dcal files).
+ * The file is a table of named sections each holding one dense cv::Mat.  It
+ * is read by memory mapping so opening is just validating the table and the
+ * sections are used in place, which matters for large arrays such as the
+ * undistortion maps.  XML/YML through cv::FileStorage remains the format for
+ * inspection and interchange.
+ *
+ * Layout (native byte order, checked when opened):
+ *
+ *   DHeader           magic "DCAL", byte order mark, version, section count
+ *   DSection[count]   tag, offset, size and cv::Mat shape of each section
+ *   section data      each section starts on a 64 byte boundary
+ *
+ */
+
+/*****************************************************************************
+******************************  I N C L U D E  ******************************
+****************************************************************************/
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+namespace boost
+   {
+   namespace interprocess
+      {
+      class mapped_region;
+      }
+   }
+
+/*****************************************************************************
+ *
+ ***  class CameraCalibrationFileWriter
+ *
+ * Collects the sections and writes the file in one pass.
+ *
+ *****************************************************************************/
+
+class CameraCalibrationFileWriter
+   {
+   public:
+      CameraCalibrationFileWriter() = default;
+      ~CameraCalibrationFileWriter() = default;
+
+      // Tags are at most 15 characters.  Empty Mats are stored as empty
+      // sections.  Non-continuous Mats are copied.
+      void AddSection(const std::string& strTag, const cv::Mat& Data);
+
+      // Replaces strFileName only once the whole file has been written, so
+      // it is safe to write over a file whose sections are still mapped
+      bool Write(const std::string& strFileName) const;
+
+   protected:
+      std::vector<std::pair<std::string, cv::Mat>> m_Sections;
+
+      bool WriteFile(const std::string& strFileName) const;
+
+   private:
+
+   }; // end of class CameraCalibrationFileWriter
+
+/*****************************************************************************
+ *
+ ***  class CameraCalibrationMappedFile
+ *
+ * Read side.  The Mats handed out by GetSection() point straight into the
+ * mapping.  It is mapped copy on write so they can be modified in place
+ * without touching the file.  They are valid while the file stays open or
+ * while a reference from GetMapping() is held, so keep that next to any Mat
+ * that has to outlive the file object rather than cloning it.
+ *
+ *****************************************************************************/
+
+class CameraCalibrationMappedFile
+   {
+   public:
+      // Version written by this code.  Readers accept this and older.
+      static const std::uint32_t m_nVersion = 1;
+
+      CameraCalibrationMappedFile();
+      CameraCalibrationMappedFile(const CameraCalibrationMappedFile& src) = delete;
+
+      ~CameraCalibrationMappedFile();
+
+      CameraCalibrationMappedFile& operator=(
+            const CameraCalibrationMappedFile& rhs) = delete;
+
+      bool Open(const std::string& strFileName);
+      void Close();
+
+      bool IsOpen() const
+         {
+         return (static_cast<bool>(m_pRegion));
+         }
+
+      std::uint32_t GetFileVersion() const
+         {
+         return (m_nFileVersion);
+         }
+
+      bool HasSection(const std::string& strTag) const
+         {
+         return (m_Sections.count(strTag) != 0);
+         }
+
+      // Empty Mat if there is no such section
+      cv::Mat GetSection(const std::string& strTag) const;
+
+      // Shared ownership of the mapping, empty if the file isn't open
+      std::shared_ptr<const void> GetMapping() const
+         {
+         return (m_pRegion);
+         }
+
+      std::vector<std::string> GetSectionTags() const;
+
+   protected:
+      std::shared_ptr<boost::interprocess::mapped_region> m_pRegion;
+      std::uint32_t m_nFileVersion;
+      std::map<std::string, cv::Mat> m_Sections;
+
+   private:
+
+   }; // end of class CameraCalibrationMappedFile
+
+#endif // CAMERACALIBRATIONFILE_H
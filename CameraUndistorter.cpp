@@ -0,0 +1,456 @@
+/*****************************************************************************
+ ******************************  I N C L U D E  ******************************
+ ****************************************************************************/
+
+#include <algorithm>
+
+#include "CameraUndistorter.h"
+#include "CameraCalibration.h"
+#include "CameraCalibrationFile.h"
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+
+// Maximum number of idle frame buffers kept by the pool
+static const size_t nMaxPoolSize = 8;
+
+/******************************************************************************
+*
+***  class DRemapRows
+*
+* Parallel body for the banded remap.  The maps hold absolute source
+* coordinates so each band of the destination only needs the same rows of the
+* maps and reads the whole source.
+*
+******************************************************************************/
+
+class DRemapRows : public cv::ParallelLoopBody
+   {
+   public:
+      DRemapRows(const cv::Mat& Src, cv::Mat& Dst, const cv::Mat& Map1,
+            const cv::Mat& Map2, int nInterpolation, int nBands) :
+            m_Src(Src),
+            m_Dst(Dst),
+            m_Map1(Map1),
+            m_Map2(Map2),
+            m_nInterpolation(nInterpolation),
+            m_nBands(nBands)
+         {
+         return;
+         }
+
+      virtual void operator()(const cv::Range& Range) const
+         {
+         int nStart = (m_Dst.rows * Range.start) / m_nBands;
+         int nEnd = (m_Dst.rows * Range.end) / m_nBands;
+         cv::Range Rows(nStart, nEnd);
+
+         cv::Mat DstBand = m_Dst.rowRange(Rows);
+         cv::remap(m_Src, DstBand, m_Map1.rowRange(Rows), m_Map2.rowRange(Rows),
+               m_nInterpolation, cv::BORDER_CONSTANT);
+
+         return;
+         }
+
+   protected:
+      const cv::Mat& m_Src;
+      cv::Mat& m_Dst;
+      const cv::Mat& m_Map1;
+      const cv::Mat& m_Map2;
+      int m_nInterpolation;
+      int m_nBands;
+
+   private:
+
+   }; // end of class DRemapRows
+
+/*****************************************************************************
+ ***  class CameraUndistorter
+ ****************************************************************************/
+
+/******************************************************************************
+*
+***  CameraUndistorter::CameraUndistorter
+*
+******************************************************************************/
+
+CameraUndistorter::CameraUndistorter() :
+      m_dAlpha(0.0),
+      m_nInterpolation(cv::INTER_LINEAR)
+   {
+
+   return;
+
+   } // end of method CameraUndistorter::CameraUndistorter
+
+/******************************************************************************
+*
+***  CameraUndistorter::CameraUndistorter
+*
+******************************************************************************/
+
+CameraUndistorter::CameraUndistorter(const CameraCalibration& Calibration,
+      double dAlpha /* = 0.0 */) :
+      m_dAlpha(0.0),
+      m_nInterpolation(cv::INTER_LINEAR)
+   {
+   SetCalibration(Calibration, dAlpha);
+
+   return;
+
+   } // end of method CameraUndistorter::CameraUndistorter
+
+/******************************************************************************
+*
+***  CameraUndistorter::SetCalibration
+*
+******************************************************************************/
+
+void CameraUndistorter::SetCalibration(const cv::Mat& CameraMatrix,
+      const cv::Mat& DistortionCoeffs, const cv::Size& CalibratedSize,
+      double dAlpha /* = 0.0 */)
+   {
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+
+   m_CameraMatrix = CameraMatrix.clone();
+   m_DistortionCoeffs = DistortionCoeffs.clone();
+   m_CalibratedSize = CalibratedSize;
+   m_dAlpha = dAlpha;
+   m_Maps.clear();
+
+   return;
+
+   } // end of method CameraUndistorter::SetCalibration
+
+/******************************************************************************
+*
+***  CameraUndistorter::SetCalibration
+*
+******************************************************************************/
+
+void CameraUndistorter::SetCalibration(const CameraCalibration& Calibration,
+      double dAlpha /* = 0.0 */)
+   {
+   SetCalibration(Calibration.GetCameraMatrix(),
+         Calibration.GetDistortionCoeffs(), Calibration.GetImageSize(), dAlpha);
+
+   return;
+
+   } // end of method CameraUndistorter::SetCalibration
+
+/******************************************************************************
+*
+***  CameraUndistorter::SetCacheBaseName
+*
+******************************************************************************/
+
+void CameraUndistorter::SetCacheBaseName(const std::string& strBaseName)
+   {
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+   m_strCacheBaseName = strBaseName;
+
+   return;
+
+   } // end of method CameraUndistorter::SetCacheBaseName
+
+/******************************************************************************
+*
+***  CameraUndistorter::ClearCache
+*
+* Drop the in memory maps and pooled buffers.  Files on disk are kept.
+*
+******************************************************************************/
+
+void CameraUndistorter::ClearCache()
+   {
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+   m_Maps.clear();
+   m_Pool.clear();
+
+   return;
+
+   } // end of method CameraUndistorter::ClearCache
+
+/******************************************************************************
+*
+***  CameraUndistorter::GetCacheFileName
+*
+******************************************************************************/
+
+std::string CameraUndistorter::GetCacheFileName(const cv::Size& Size) const
+   {
+   std::string strRet;
+
+   if (!m_strCacheBaseName.empty())
+      {
+      strRet = m_strCacheBaseName + "-maps-" + std::to_string(Size.width)
+            + "x" + std::to_string(Size.height) + ".dcal";
+      } // end if
+
+   return (strRet);
+
+   } // end of method CameraUndistorter::GetCacheFileName
+
+/******************************************************************************
+*
+***  CameraUndistorter::BuildMaps
+*
+* Scale the calibration to the frame size and build the fixed-point maps.
+*
+******************************************************************************/
+
+void CameraUndistorter::BuildMaps(const cv::Size& Size, DMaps& Maps) const
+   {
+   cv::Mat CameraMatrix = m_CameraMatrix.clone();
+   if ((m_CalibratedSize.area() > 0) && (Size != m_CalibratedSize))
+      {
+      double dScaleX = static_cast<double>(Size.width) / m_CalibratedSize.width;
+      double dScaleY = static_cast<double>(Size.height) / m_CalibratedSize.height;
+      // fx, skew, cx scale with the width and fy, cy with the height
+      cv::Mat Row = CameraMatrix.row(0);
+      Row *= dScaleX;
+      Row = CameraMatrix.row(1);
+      Row *= dScaleY;
+      } // end if
+
+   Maps.m_NewCameraMatrix = cv::getOptimalNewCameraMatrix(CameraMatrix,
+         m_DistortionCoeffs, Size, m_dAlpha, Size);
+
+   cv::initUndistortRectifyMap(CameraMatrix, m_DistortionCoeffs, cv::Mat(),
+         Maps.m_NewCameraMatrix, Size, CV_16SC2, Maps.m_Map1, Maps.m_Map2);
+
+   return;
+
+   } // end of method CameraUndistorter::BuildMaps
+
+/******************************************************************************
+*
+***  CameraUndistorter::LoadMaps
+*
+* Only accepts a file built from the same calibration.  The maps are used
+* straight from the mapped file, which is held open by the DMaps.
+*
+******************************************************************************/
+
+bool CameraUndistorter::LoadMaps(const std::string& strFileName,
+      const cv::Size& Size, DMaps& Maps) const
+   {
+   CameraCalibrationMappedFile File;
+   bool bRet = File.Open(strFileName);
+   if (bRet)
+      {
+      cv::Mat CameraMatrix = File.GetSection("CameraMatrix");
+      cv::Mat DistortionCoeffs = File.GetSection("Distortion");
+      cv::Mat Alpha = File.GetSection("Alpha");
+      cv::Mat NewCameraMatrix = File.GetSection("NewCameraMatrix");
+      cv::Mat Map1 = File.GetSection("Map1");
+      cv::Mat Map2 = File.GetSection("Map2");
+
+      bRet = (Alpha.total() == 1) && (Alpha.type() == CV_64F)
+            && (Alpha.at<double>(0) == m_dAlpha)
+            && (CameraMatrix.size() == m_CameraMatrix.size())
+            && (CameraMatrix.type() == m_CameraMatrix.type())
+            && (cv::norm(CameraMatrix, m_CameraMatrix, cv::NORM_INF) == 0.0)
+            && (DistortionCoeffs.size() == m_DistortionCoeffs.size())
+            && (DistortionCoeffs.type() == m_DistortionCoeffs.type())
+            && (cv::norm(DistortionCoeffs, m_DistortionCoeffs, cv::NORM_INF) == 0.0)
+            && (NewCameraMatrix.rows == 3) && (NewCameraMatrix.cols == 3)
+            && (NewCameraMatrix.type() == CV_64F)
+            && (Map1.size() == Size) && (Map1.type() == CV_16SC2)
+            && (Map2.size() == Size) && (Map2.type() == CV_16UC1);
+      if (bRet)
+         {
+         Maps.m_NewCameraMatrix = NewCameraMatrix.clone();
+         Maps.m_Map1 = Map1;
+         Maps.m_Map2 = Map2;
+         Maps.m_pMapping = File.GetMapping();
+         } // end if
+      } // end if
+
+   return (bRet);
+
+   } // end of method CameraUndistorter::LoadMaps
+
+/******************************************************************************
+*
+***  CameraUndistorter::SaveMaps
+*
+* The writer replaces the file by renaming a finished copy over it, so a
+* LoadMaps() in this or another process that has the old file mapped keeps
+* its maps and never sees a partly written one.
+*
+******************************************************************************/
+
+bool CameraUndistorter::SaveMaps(const std::string& strFileName,
+      const DMaps& Maps) const
+   {
+   CameraCalibrationFileWriter Writer;
+   Writer.AddSection("CameraMatrix", m_CameraMatrix);
+   Writer.AddSection("Distortion", m_DistortionCoeffs);
+   Writer.AddSection("Alpha", cv::Mat(1, 1, CV_64F, cv::Scalar(m_dAlpha)));
+   Writer.AddSection("NewCameraMatrix", Maps.m_NewCameraMatrix);
+   Writer.AddSection("Map1", Maps.m_Map1);
+   Writer.AddSection("Map2", Maps.m_Map2);
+
+   return (Writer.Write(strFileName));
+
+   } // end of method CameraUndistorter::SaveMaps
+
+/******************************************************************************
+*
+***  CameraUndistorter::GetMaps
+*
+* Maps for the frame size from the memory cache, then the disk cache, then
+* built.  Called with m_Mutex held.  std::map never moves its elements so the
+* reference stays good after the lock is released.
+*
+******************************************************************************/
+
+const CameraUndistorter::DMaps& CameraUndistorter::GetMaps(const cv::Size& Size)
+   {
+   auto Key = std::make_pair(Size.width, Size.height);
+   auto It = m_Maps.find(Key);
+   if (It == m_Maps.end())
+      {
+      DMaps Maps;
+      std::string strFileName = GetCacheFileName(Size);
+      if (strFileName.empty() || !LoadMaps(strFileName, Size, Maps))
+         {
+         BuildMaps(Size, Maps);
+         if (!strFileName.empty())
+            {
+            SaveMaps(strFileName, Maps);
+            } // end if
+         } // end if
+
+      It = m_Maps.insert(std::make_pair(Key, Maps)).first;
+      } // end if
+
+   return (It->second);
+
+   } // end of method CameraUndistorter::GetMaps
+
+/******************************************************************************
+*
+***  CameraUndistorter::GetNewCameraMatrix
+*
+******************************************************************************/
+
+cv::Mat CameraUndistorter::GetNewCameraMatrix(const cv::Size& Size)
+   {
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+
+   return (GetMaps(Size).m_NewCameraMatrix.clone());
+
+   } // end of method CameraUndistorter::GetNewCameraMatrix
+
+/******************************************************************************
+*
+***  CameraUndistorter::GetPoolBuffer
+*
+* A buffer nobody outside the pool references any more, or a new one.  Called
+* with m_Mutex held.
+*
+******************************************************************************/
+
+cv::Mat CameraUndistorter::GetPoolBuffer(const cv::Size& Size, int nType)
+   {
+   for (auto& Buffer : m_Pool)
+      {
+      if ((Buffer.u != nullptr) && (CV_XADD(&Buffer.u->refcount, 0) == 1)
+            && (Buffer.size() == Size) && (Buffer.type() == nType))
+         {
+         return (Buffer);
+         } // end if
+      } // end for
+
+   // Forget idle buffers of the wrong size before growing
+   m_Pool.erase(std::remove_if(m_Pool.begin(), m_Pool.end(),
+         [&](const cv::Mat& Buffer)
+            {
+            return ((Buffer.u == nullptr) || ((CV_XADD(&Buffer.u->refcount, 0) == 1)
+                  && ((Buffer.size() != Size) || (Buffer.type() != nType))));
+            }), m_Pool.end());
+
+   cv::Mat Buffer(Size, nType);
+   if (m_Pool.size() < nMaxPoolSize)
+      {
+      m_Pool.push_back(Buffer);
+      } // end if
+
+   return (Buffer);
+
+   } // end of method CameraUndistorter::GetPoolBuffer
+
+/******************************************************************************
+*
+***  CameraUndistorter::Undistort
+*
+* Remap Src into Dst (reallocated only if its size or type is wrong).  Dst
+* must not share data with Src.
+*
+******************************************************************************/
+
+bool CameraUndistorter::Undistort(const cv::Mat& Src, cv::Mat& Dst)
+   {
+   cv::Mat Map1;
+   cv::Mat Map2;
+   std::shared_ptr<const void> pMapping;
+   int nInterpolation = cv::INTER_LINEAR;
+   bool bRet = !Src.empty();
+   if (bRet)
+      {
+      // The calibration can be replaced from another thread
+      std::lock_guard<std::mutex> Lock(m_Mutex);
+      bRet = !m_CameraMatrix.empty();
+      if (bRet)
+         {
+         const DMaps& Maps = GetMaps(Src.size());
+         // Headers (and the mapping of maps loaded from the disk cache) hold
+         // references so a concurrent ClearCache is harmless
+         Map1 = Maps.m_Map1;
+         Map2 = Maps.m_Map2;
+         pMapping = Maps.m_pMapping;
+         nInterpolation = m_nInterpolation;
+         } // end if
+      } // end if
+
+   if (bRet)
+      {
+      Dst.create(Src.size(), Src.type());
+
+      // Bands of about 64 rows, enough to keep every thread busy
+      int nBands = std::max(1, Src.rows / 64);
+      cv::parallel_for_(cv::Range(0, nBands),
+            DRemapRows(Src, Dst, Map1, Map2, nInterpolation, nBands));
+      } // end if
+
+   return (bRet);
+
+   } // end of method CameraUndistorter::Undistort
+
+/******************************************************************************
+*
+***  CameraUndistorter::Undistort
+*
+* Undistort into a pooled buffer.  Returns an empty Mat on failure.
+*
+******************************************************************************/
+
+cv::Mat CameraUndistorter::Undistort(const cv::Mat& Src)
+   {
+   cv::Mat Dst;
+
+      {
+      std::lock_guard<std::mutex> Lock(m_Mutex);
+      Dst = GetPoolBuffer(Src.size(), Src.type());
+      }
+
+   if (!Undistort(Src, Dst))
+      {
+      Dst.release();
+      } // end if
+
+   return (Dst);
+
+   } // end of method CameraUndistorter::Undistort
@@ -0,0 +1,119 @@
+#ifndef CAMERAUNDISTORTER_H
+#define CAMERAUNDISTORTER_H
+
+/* Applies a camera calibration to live frames.  The undistortion is a remap
+ * through fixed-point lookup maps that are built once per frame size and
+ * cached (optionally on disk) so the per-frame cost is just the remap.
+ *
+ */
+
+/*****************************************************************************
+******************************  I N C L U D E  ******************************
+****************************************************************************/
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+class CameraCalibration;
+
+/*****************************************************************************
+ *
+ ***  class CameraUndistorter
+ *
+ * Builds initUndistortRectifyMap maps in the fast CV_16SC2/CV_16UC1 format
+ * for each frame size it sees.  The calibration is scaled to frame sizes
+ * other than the calibrated one (binned or decimated modes of the same
+ * sensor).  With a cache base name set, maps are saved as binary
+ * <base>-maps-<width>x<height>.dcal files (see CameraCalibrationFile.h) and
+ * reloaded instead of rebuilt.
+ *
+ * Undistort() remaps in horizontal bands on the OpenCV thread pool.  The
+ * version returning a cv::Mat hands out buffers from a pool; a buffer goes
+ * back into the pool once the caller releases every reference to it, so a
+ * steady stream of frames allocates nothing.
+ *
+ * Safe to use from several pipeline threads at once.
+ *
+ *****************************************************************************/
+
+class CameraUndistorter
+   {
+   public:
+      CameraUndistorter();
+      explicit CameraUndistorter(const CameraCalibration& Calibration,
+            double dAlpha = 0.0);
+      CameraUndistorter(const CameraUndistorter& src) = delete;
+
+      ~CameraUndistorter() = default;
+
+      CameraUndistorter& operator=(const CameraUndistorter& rhs) = delete;
+
+      // dAlpha is as for cv::getOptimalNewCameraMatrix: 0 crops to valid
+      // pixels only, 1 keeps every source pixel.  Clears the map cache.
+      void SetCalibration(const cv::Mat& CameraMatrix,
+            const cv::Mat& DistortionCoeffs, const cv::Size& CalibratedSize,
+            double dAlpha = 0.0);
+      void SetCalibration(const CameraCalibration& Calibration,
+            double dAlpha = 0.0);
+
+      // Persist maps next to the calibration file, e.g. the calibration file
+      // name without its extension.  Empty turns the disk cache off.
+      void SetCacheBaseName(const std::string& strBaseName);
+
+      void SetInterpolation(int nInterpolation)
+         {
+         std::lock_guard<std::mutex> Lock(m_Mutex);
+         m_nInterpolation = nInterpolation;
+
+         return;
+         }
+
+      bool Undistort(const cv::Mat& Src, cv::Mat& Dst);
+      cv::Mat Undistort(const cv::Mat& Src);
+
+      // Camera matrix of the undistorted frames at the given size
+      cv::Mat GetNewCameraMatrix(const cv::Size& Size);
+
+      void ClearCache();
+
+   protected:
+      struct DMaps
+         {
+         cv::Mat m_Map1;
+         cv::Mat m_Map2;
+         cv::Mat m_NewCameraMatrix;
+         // Keeps the file alive when the Mats above point into its mapping
+         std::shared_ptr<const void> m_pMapping;
+         };
+
+      cv::Mat m_CameraMatrix;
+      cv::Mat m_DistortionCoeffs;
+      cv::Size m_CalibratedSize;
+      double m_dAlpha;
+      int m_nInterpolation;
+      std::string m_strCacheBaseName;
+
+      std::mutex m_Mutex;
+      std::map<std::pair<int, int>, DMaps> m_Maps;
+      std::vector<cv::Mat> m_Pool;
+
+      const DMaps& GetMaps(const cv::Size& Size);
+      void BuildMaps(const cv::Size& Size, DMaps& Maps) const;
+      std::string GetCacheFileName(const cv::Size& Size) const;
+      bool LoadMaps(const std::string& strFileName, const cv::Size& Size,
+            DMaps& Maps) const;
+      bool SaveMaps(const std::string& strFileName, const DMaps& Maps) const;
+      cv::Mat GetPoolBuffer(const cv::Size& Size, int nType);
+
+   private:
+
+   }; // end of class CameraUndistorter
+
+#endif // CAMERAUNDISTORTER_H
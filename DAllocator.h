@@ -0,0 +1,475 @@
+/*****************************************************************************
+******************************** DAllocator.h ********************************
+*****************************************************************************/
+
+#if !defined(__DALLOCATOR_H__)
+#define __DALLOCATOR_H__
+
+/*
+   Allocators for the numeric containers.
+
+      DAlignedAllocator  heap storage aligned to a cache line (64 bytes by
+                         default) so vectorized kernels start on an aligned
+                         boundary.  The default storage of DArray2D.
+      DArena             a bump allocator for short lived temporaries.
+      DArenaScope        makes an arena current on this thread and rewinds
+                         it when the scope closes.
+      DArenaAllocator    allocates from the arena that was current when the
+                         allocator was made while its scope is the innermost
+                         one, and from the aligned heap otherwise.
+
+   The arena is meant for solver loops that build the same temporaries over
+   and over:
+
+      DArena Arena;
+      for (...)
+         {
+         DArenaScope Scope(Arena);
+         DMatrix<double, DArray2D<double, DArenaAllocator<double> > > Tmp;
+         ...
+         }
+
+   After the first pass the arena's blocks are reused and the temporaries
+   never touch the heap.  Anything allocated inside a scope must be
+   destroyed before the scope closes.  Freeing the most recent allocation
+   hands its space straight back so a container that grows by reallocating
+   stays compact.
+
+   An allocator remembers the scope it was made in and only takes arena
+   space while that scope is the innermost one.  A container from an outer
+   scope that grows inside an inner one gets heap storage, since the inner
+   scope's rewind would reclaim anything bumped from the arena.
+
+   Allocators only compare equal within a scope and never propagate on
+   assignment or swap, so move or copy assigning a temporary into a
+   container from outside its scope copies the elements into that
+   container's own storage.  Move construction can't be caught that way:
+   a container move constructed from a temporary takes the temporary's
+   storage, and with it the scope's lifetime, and must not outlive the
+   scope either.  Freeing arena storage after its scope has closed
+   asserts.
+*/
+
+/*****************************************************************************
+******************************  I N C L U D E  *******************************
+*****************************************************************************/
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+/*****************************************************************************
+************************** class DAlignedAllocator ***************************
+*****************************************************************************/
+
+template <typename T, size_t ALIGN = 64>
+class DAlignedAllocator
+   {
+   public :
+      typedef T value_type;
+      typedef std::true_type propagate_on_container_move_assignment;
+      typedef std::true_type is_always_equal;
+
+      static_assert((ALIGN & (ALIGN - 1)) == 0,
+            "DAlignedAllocator alignment must be a power of 2");
+
+      template <typename U>
+      struct rebind
+         {
+         typedef DAlignedAllocator<U, ALIGN> other;
+         };
+
+      DAlignedAllocator()
+         {
+         return;
+         }
+
+      template <typename U>
+      DAlignedAllocator(const DAlignedAllocator<U, ALIGN>&)
+         {
+         return;
+         }
+
+      T* allocate(size_t n)
+         {
+         return (static_cast<T*>(Allocate(n * sizeof(T))));
+         }
+
+      void deallocate(T* p, size_t)
+         {
+         Free(p);
+         return;
+         }
+
+      // Raw aligned blocks.  The pointer ::operator new returned is kept
+      // just below the aligned block.
+      static void* Allocate(size_t nBytes)
+         {
+         void* pRaw = ::operator new(nBytes + ALIGN + sizeof(void*));
+         const uintptr_t nAddr = reinterpret_cast<uintptr_t>(pRaw) +
+               sizeof(void*);
+         void* p = reinterpret_cast<void*>((nAddr + ALIGN - 1) &
+               ~static_cast<uintptr_t>(ALIGN - 1));
+         static_cast<void**>(p)[-1] = pRaw;
+         return (p);
+         }
+
+      static void Free(void* p)
+         {
+         if (p != nullptr)
+            {
+            ::operator delete(static_cast<void**>(p)[-1]);
+            } // end if
+         return;
+         }
+
+   protected :
+   private :
+   };  // End of class DAlignedAllocator
+
+template <typename T, typename U, size_t ALIGN>
+inline bool operator==(const DAlignedAllocator<T, ALIGN>&,
+      const DAlignedAllocator<U, ALIGN>&)
+   {
+   return (true);
+   }
+
+template <typename T, typename U, size_t ALIGN>
+inline bool operator!=(const DAlignedAllocator<T, ALIGN>&,
+      const DAlignedAllocator<U, ALIGN>&)
+   {
+   return (false);
+   }
+
+/*****************************************************************************
+******************************** class DArena ********************************
+*****************************************************************************/
+
+class DArena
+   {
+   public :
+      // Every allocation is aligned to this many bytes
+      static const size_t Align = 64;
+
+      // A position to rewind to
+      struct Mark
+         {
+         size_t nBlock;
+         size_t nUsed;
+         };
+
+      explicit DArena(size_t nBlockSize = 1 << 20)
+            : m_nBlockSize(nBlockSize), m_nBlock(0), m_nUsed(0),
+            m_nScopes(0)
+         {
+         return;
+         }
+
+      ~DArena()
+         {
+         for (size_t i = 0 ; i < m_Blocks.size() ; i++)
+            {
+            DAlignedAllocator<char, Align>::Free(m_Blocks[i].pData);
+            } // end for
+         return;
+         }
+
+      void* Allocate(size_t nBytes);
+
+      // Give the space back if p is the most recent allocation
+      void Deallocate(void* p, size_t nBytes)
+         {
+         char* pc = static_cast<char*>(p);
+         if ((m_nBlock < m_Blocks.size()) &&
+               (pc + RoundUp(nBytes) == m_Blocks[m_nBlock].pData + m_nUsed))
+            {
+            m_nUsed = pc - m_Blocks[m_nBlock].pData;
+            } // end if
+         return;
+         }
+
+      Mark GetMark() const
+         {
+         Mark M;
+         M.nBlock = m_nBlock;
+         M.nUsed = m_nUsed;
+         return (M);
+         }
+
+      // Release everything allocated since M.  The blocks are kept.
+      void Rewind(const Mark& M)
+         {
+         m_nBlock = M.nBlock;
+         m_nUsed = M.nUsed;
+         return;
+         }
+
+      void Reset()
+         {
+         m_nBlock = 0;
+         m_nUsed = 0;
+         return;
+         }
+
+      // Scopes are numbered from 1 in the order they open.  Zero stands for
+      // allocations made outside any scope.
+      size_t OpenScope()
+         {
+         m_Scopes.push_back(++m_nScopes);
+         return (m_Scopes.back());
+         }
+
+      void CloseScope()
+         {
+         m_Scopes.pop_back();
+         return;
+         }
+
+      size_t CurrentScope() const
+         {
+         return (m_Scopes.empty() ? 0 : m_Scopes.back());
+         }
+
+      bool IsOpen(size_t nScope) const
+         {
+         return ((nScope == 0) || (std::find(m_Scopes.rbegin(),
+               m_Scopes.rend(), nScope) != m_Scopes.rend()));
+         }
+
+      // True if p lies in one of the arena's blocks
+      bool Owns(const void* p) const
+         {
+         const char* pc = static_cast<const char*>(p);
+         for (size_t i = 0 ; i < m_Blocks.size() ; i++)
+            {
+            if ((pc >= m_Blocks[i].pData) &&
+                  (pc < m_Blocks[i].pData + m_Blocks[i].nSize))
+               {
+               return (true);
+               } // end if
+            } // end for
+         return (false);
+         }
+
+      // The arena allocations on this thread come from, or nullptr
+      static DArena*& Current()
+         {
+         static thread_local DArena* pCurrent = nullptr;
+         return (pCurrent);
+         }
+
+   protected :
+      struct Block
+         {
+         char* pData;
+         size_t nSize;
+         };
+
+      size_t m_nBlockSize;
+      std::vector<Block> m_Blocks;
+      size_t m_nBlock;  // Block being allocated from
+      size_t m_nUsed;   // Bytes used in that block
+      std::vector<size_t> m_Scopes;  // Open scopes, innermost last
+      size_t m_nScopes; // Scopes opened so far
+
+      static size_t RoundUp(size_t nBytes)
+         {
+         return ((nBytes + Align - 1) & ~(Align - 1));
+         }
+
+   private :
+      DArena(const DArena&);
+      DArena& operator=(const DArena&);
+   };  // End of class DArena
+
+/*****************************************************************************
+*
+*  DArena::Allocate
+*
+*  Bump the current block, moving on to the next block that's big enough
+*  when it's full.  A new block is only made when no kept block fits.
+*
+*****************************************************************************/
+
+inline void* DArena::Allocate(size_t nBytes)
+   {
+   nBytes = RoundUp(std::max<size_t>(nBytes, 1));
+
+   while ((m_nBlock < m_Blocks.size()) &&
+         (m_nUsed + nBytes > m_Blocks[m_nBlock].nSize))
+      {
+      m_nBlock++;
+      m_nUsed = 0;
+      } // end while
+
+   if (m_nBlock == m_Blocks.size())
+      {
+      Block B;
+      B.nSize = std::max(m_nBlockSize, nBytes);
+      B.pData = static_cast<char*>(
+            DAlignedAllocator<char, Align>::Allocate(B.nSize));
+      m_Blocks.push_back(B);
+      m_nUsed = 0;
+      } // end if
+
+   void* p = m_Blocks[m_nBlock].pData + m_nUsed;
+   m_nUsed += nBytes;
+
+   return (p);
+
+   } // End of function DArena::Allocate
+
+/*****************************************************************************
+***************************** class DArenaScope ******************************
+*****************************************************************************/
+
+class DArenaScope
+   {
+   public :
+      explicit DArenaScope(DArena& Arena)
+            : m_Arena(Arena), m_Mark(Arena.GetMark()),
+            m_pPrevious(DArena::Current())
+         {
+         DArena::Current() = &m_Arena;
+         m_Arena.OpenScope();
+         return;
+         }
+
+      ~DArenaScope()
+         {
+         m_Arena.CloseScope();
+         m_Arena.Rewind(m_Mark);
+         DArena::Current() = m_pPrevious;
+         return;
+         }
+
+   protected :
+      DArena& m_Arena;
+      DArena::Mark m_Mark;
+      DArena* m_pPrevious;
+
+   private :
+      DArenaScope(const DArenaScope&);
+      DArenaScope& operator=(const DArenaScope&);
+   };  // End of class DArenaScope
+
+/*****************************************************************************
+*************************** class DArenaAllocator ****************************
+*****************************************************************************/
+
+template <typename T>
+class DArenaAllocator
+   {
+   public :
+      typedef T value_type;
+
+      // A container keeps the allocator it was made with so storage from a
+      // scope never leaks into a container that outlives it
+      typedef std::false_type propagate_on_container_move_assignment;
+      typedef std::false_type propagate_on_container_copy_assignment;
+      typedef std::false_type propagate_on_container_swap;
+
+      DArenaAllocator() : m_pArena(DArena::Current()),
+            m_nScope(ScopeOf(m_pArena))
+         {
+         return;
+         }
+
+      explicit DArenaAllocator(DArena* pArena) : m_pArena(pArena),
+            m_nScope(ScopeOf(pArena))
+         {
+         return;
+         }
+
+      template <typename U>
+      DArenaAllocator(const DArenaAllocator<U>& src)
+            : m_pArena(src.GetArena()), m_nScope(src.GetScope())
+         {
+         return;
+         }
+
+      // Storage from an outer scope's allocator would be reclaimed by the
+      // rewind of the inner scope that is open now, so it comes from the
+      // heap instead
+      T* allocate(size_t n)
+         {
+         void* p;
+         if (IsCurrent())
+            {
+            p = m_pArena->Allocate(n * sizeof(T));
+            } // end if
+         else
+            {
+            assert((m_pArena == nullptr) || m_pArena->IsOpen(m_nScope));
+            p = DAlignedAllocator<T>::Allocate(n * sizeof(T));
+            } // end else
+         return (static_cast<T*>(p));
+         }
+
+      void deallocate(T* p, size_t n)
+         {
+         if ((m_pArena != nullptr) && m_pArena->Owns(p))
+            {
+            // Storage moved out of its scope has already been reused
+            assert(m_pArena->IsOpen(m_nScope));
+
+            // Space is only handed back to the scope it was taken in
+            if (IsCurrent())
+               {
+               m_pArena->Deallocate(p, n * sizeof(T));
+               } // end if
+            } // end if
+         else
+            {
+            DAlignedAllocator<T>::Free(p);
+            } // end else
+         return;
+         }
+
+      DArena* GetArena() const
+         {
+         return (m_pArena);
+         }
+
+      size_t GetScope() const
+         {
+         return (m_nScope);
+         }
+
+   protected :
+      DArena* m_pArena;
+      size_t m_nScope;
+
+      bool IsCurrent() const
+         {
+         return ((m_pArena != nullptr) &&
+               (m_nScope == m_pArena->CurrentScope()));
+         }
+
+      static size_t ScopeOf(const DArena* pArena)
+         {
+         return ((pArena != nullptr) ? pArena->CurrentScope() : 0);
+         }
+
+   private :
+   };  // End of class DArenaAllocator
+
+template <typename T, typename U>
+inline bool operator==(const DArenaAllocator<T>& a,
+      const DArenaAllocator<U>& b)
+   {
+   return ((a.GetArena() == b.GetArena()) && (a.GetScope() == b.GetScope()));
+   }
+
+template <typename T, typename U>
+inline bool operator!=(const DArenaAllocator<T>& a,
+      const DArenaAllocator<U>& b)
+   {
+   return (!(a == b));
+   }
+
+#endif // __DALLOCATOR_H__
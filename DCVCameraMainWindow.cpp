@@ -440,7 +440,7 @@ void DCVCameraMainWindow::ProcessImage(DCVImage& Image)
    {
    QImage Display = cvMatToQImage(Image);
    m_pInputImageWidget->SetImage(Display);
-   m_pOutputImageWidget->SetImage(Display);
+   m_pOutputImageWidget->SetImage(std::move(Display));
 
    return;
 
@@ -0,0 +1,98 @@
+/*****************************************************************************
+******************************** DCVThreshold.h ******************************
+*****************************************************************************/
+
+#if !defined(__DCVTHRESHOLD_H__)
+#define __DCVTHRESHOLD_H__
+
+/*
+   Apply the DMath.h threshold and range tests to whole images, producing a
+   DCVBinaryImage mask that is 255 where the test passes and 0 elsewhere.
+
+   The test's virtual Apply(DSpan, DSpan) is called once per row, or once
+   for the whole image when the rows are contiguous, and runs the
+   vectorized kernels from DMath.h.  So segmenting on hue across red is
+
+      DCVImage HSV;
+      cv::cvtColor(Image, HSV, cv::COLOR_BGR2HSV);
+      DRangeTest<unsigned char> Red(170, 10, true);
+      DCVBinaryImage Mask;
+      ApplyToImage(Red, HSV, Mask, 0);
+
+   The image's depth must match T.  For multichannel images nChannel picks
+   the channel to test, which is copied out first.
+*/
+
+/*****************************************************************************
+******************************  I N C L U D E  *******************************
+*****************************************************************************/
+
+#include <opencv2/core.hpp>
+#include "CVImage.h"
+#include "DMath.h"
+#include "DSpan.h"
+
+/*****************************************************************************
+*
+*  ApplyMaskTest
+*
+*  Run Test over one channel of Image a row at a time.
+*
+*****************************************************************************/
+
+template <typename T, typename TEST>
+bool ApplyMaskTest(const TEST& Test, const cv::Mat& Image,
+      DCVBinaryImage& Mask, int nChannel)
+   {
+   bool bRet = (Image.dims == 2) && (Image.depth() == cv::DataType<T>::depth)
+         && (nChannel >= 0) && (nChannel < Image.channels());
+   if (bRet)
+      {
+      cv::Mat Plane = Image;
+      if (Image.channels() > 1)
+         {
+         cv::extractChannel(Image, Plane, nChannel);
+         } // end if
+
+      Mask.create(Plane.rows, Plane.cols, CV_8UC1);
+
+      int nRows = Plane.rows;
+      int nCols = Plane.cols;
+      if (Plane.isContinuous() && Mask.isContinuous())
+         {
+         nCols *= nRows;
+         nRows = 1;
+         } // end if
+
+      for (int r = 0 ; r < nRows ; r++)
+         {
+         Test.Apply(DSpan<const T>(Plane.ptr<T>(r), nCols),
+               DSpan<unsigned char>(Mask.ptr<unsigned char>(r), nCols));
+         } // end for
+      } // end if
+
+   return (bRet);
+
+   } // End of function ApplyMaskTest
+
+/*****************************************************************************
+*
+*  ApplyToImage
+*
+*****************************************************************************/
+
+template <typename T>
+bool ApplyToImage(const DThreshold<T>& Threshold, const cv::Mat& Image,
+      DCVBinaryImage& Mask, int nChannel = 0)
+   {
+   return (ApplyMaskTest<T>(Threshold, Image, Mask, nChannel));
+   }
+
+template <typename T>
+bool ApplyToImage(const DRangeTest<T>& Range, const cv::Mat& Image,
+      DCVBinaryImage& Mask, int nChannel = 0)
+   {
+   return (ApplyMaskTest<T>(Range, Image, Mask, nChannel));
+   }
+
+#endif // __DCVTHRESHOLD_H__
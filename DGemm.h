@@ -0,0 +1,518 @@
+/*****************************************************************************
+********************************** DGemm.h ***********************************
+*****************************************************************************/
+
+#if !defined(__DGEMM_H__)
+#define __DGEMM_H__
+
+/*
+   Blocked general matrix multiply used by the DMatrix multiplication
+   methods.  Computes C = Alpha * op(A) * op(B) (+ C) where op() is
+   optionally a transpose.
+
+   The classic Goto/BLIS arrangement is used.  The K dimension is split into
+   KC deep slabs and the N dimension into NC wide slabs.  Each slab of op(B)
+   is packed once into NR wide column panels and each MC x KC block of op(A)
+   is packed into MR tall row panels so the micro-kernel streams through
+   contiguous memory regardless of how the source matrices are stored or
+   transposed.  The micro-kernel keeps an MR x NR block of C in local
+   accumulators and its inner loop is a unit stride multiply-add over NR
+   elements that the compiler turns into SIMD instructions.
+
+   Matrices are described by DGemmRows which is either a base pointer and
+   row stride (the fast path for contiguous storage) or a table of row
+   pointers (DArray2D after rows have been swapped).  Only packing and the
+   final store touch the source and destination so the row pointer case
+   costs one extra indirection per row, not per element.
+
+   Large products are split across threads by bands of C rows.  Each thread
+   packs its own panels so no synchronization is needed beyond the join.
+*/
+
+/*****************************************************************************
+******************************  I N C L U D E  *******************************
+*****************************************************************************/
+
+#include <vector>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+
+/*****************************************************************************
+****************************** class DGemmRows *******************************
+*****************************************************************************/
+
+template <typename T>
+class DGemmRows
+   {
+   public :
+      // Contiguous storage with a fixed distance between rows
+      DGemmRows(T* pData, size_t nStride)
+            : m_pData(pData), m_nStride(nStride), m_ppRows(nullptr),
+            m_nCol0(0)
+         {
+         return;
+         }
+
+      // Arbitrary rows reached through a row pointer table
+      explicit DGemmRows(T* const* ppRows, size_t nCol0 = 0)
+            : m_pData(nullptr), m_nStride(0), m_ppRows(ppRows),
+            m_nCol0(nCol0)
+         {
+         return;
+         }
+
+      T* operator[](size_t nRow) const
+         {
+         return (m_ppRows ? m_ppRows[nRow] + m_nCol0 :
+               m_pData + nRow * m_nStride);
+         }
+
+      // The sub-block whose top left element is (nRow0, nCol0)
+      DGemmRows<T> Block(size_t nRow0, size_t nCol0) const
+         {
+         if (m_ppRows)
+            {
+            return (DGemmRows<T>(m_ppRows + nRow0, m_nCol0 + nCol0));
+            } // end if
+         return (DGemmRows<T>(m_pData + nRow0 * m_nStride + nCol0,
+               m_nStride));
+         }
+
+   protected :
+      T* m_pData;
+      size_t m_nStride;
+      T* const* m_ppRows;
+      size_t m_nCol0;
+
+   private :
+   };  // End of class DGemmRows
+
+/*****************************************************************************
+******************************** class DGemm *********************************
+*****************************************************************************/
+
+template <typename T>
+class DGemm
+   {
+   public :
+      // Register block of C held by the micro-kernel
+      static const size_t MR = 4;
+      static const size_t NR = 8;
+
+      // Cache blocking.  KC x NR of B plus MR x KC of A stay in L1, the
+      // packed A block (MC x KC) in L2 and the packed B slab (KC x NC) in L3.
+      static const size_t MC = 96;
+      static const size_t KC = 256;
+      static const size_t NC = 1024;
+
+      // Below this many multiply-adds the packing overhead isn't worth it
+      static const size_t SmallWork = 32 * 32 * 32;
+
+      // Below this many multiply-adds a single thread is used
+      static const size_t ThreadWork = 128 * 128 * 128;
+
+      // C (M x N) = Alpha * op(A) (M x K) * op(B) (K x N), added to the
+      // existing contents of C when bAccumulate is set.  C must not alias A
+      // or B.
+      static void Multiply(size_t M, size_t N, size_t K,
+            const DGemmRows<const T>& A, bool bTransA,
+            const DGemmRows<const T>& B, bool bTransB,
+            const DGemmRows<T>& C, T Alpha = 1, bool bAccumulate = false,
+            size_t nMaxThreads = 0);
+
+   protected :
+      static void Simple(size_t M, size_t N, size_t K,
+            const DGemmRows<const T>& A, bool bTransA,
+            const DGemmRows<const T>& B, bool bTransB,
+            const DGemmRows<T>& C, T Alpha, bool bAccumulate);
+
+      static void Blocked(size_t nRow0, size_t nRow1, size_t N, size_t K,
+            const DGemmRows<const T>& A, bool bTransA,
+            const DGemmRows<const T>& B, bool bTransB,
+            const DGemmRows<T>& C, T Alpha, bool bAccumulate);
+
+      static void PackA(size_t nRow0, size_t mc, size_t k0, size_t kc,
+            const DGemmRows<const T>& A, bool bTransA, T* pPack);
+
+      static void PackB(size_t k0, size_t kc, size_t nCol0, size_t nc,
+            const DGemmRows<const T>& B, bool bTransB, T* pPack);
+
+      static void MicroKernel(size_t kc, const T* pA, const T* pB,
+            const DGemmRows<T>& C, size_t nRow, size_t nCol, size_t mr,
+            size_t nr, T Alpha, bool bAccumulate);
+
+   private :
+   };  // End of class DGemm
+
+template <typename T> const size_t DGemm<T>::MR;
+template <typename T> const size_t DGemm<T>::NR;
+template <typename T> const size_t DGemm<T>::MC;
+template <typename T> const size_t DGemm<T>::KC;
+template <typename T> const size_t DGemm<T>::NC;
+template <typename T> const size_t DGemm<T>::SmallWork;
+template <typename T> const size_t DGemm<T>::ThreadWork;
+
+/*****************************************************************************
+************************** Class DGemm Implementation ************************
+*****************************************************************************/
+
+/*****************************************************************************
+*
+*  DGemm::Multiply
+*
+*  Pick the simple, blocked, or threaded blocked product based on the amount
+*  of work.  nMaxThreads of zero uses the hardware concurrency.
+*
+*****************************************************************************/
+
+template <typename T>
+void DGemm<T>::Multiply(size_t M, size_t N, size_t K,
+      const DGemmRows<const T>& A, bool bTransA,
+      const DGemmRows<const T>& B, bool bTransB,
+      const DGemmRows<T>& C, T Alpha, bool bAccumulate, size_t nMaxThreads)
+   {
+   if ((M == 0) || (N == 0))
+      {
+      return;
+      } // end if
+
+   const double dWork = static_cast<double>(M) * N * K;
+   if ((K == 0) || (dWork < SmallWork))
+      {
+      Simple(M, N, K, A, bTransA, B, bTransB, C, Alpha, bAccumulate);
+      return;
+      } // end if
+
+   size_t nThreads = nMaxThreads;
+   if (nThreads == 0)
+      {
+      nThreads = std::max(1u, std::thread::hardware_concurrency());
+      } // end if
+
+   // Give each thread at least one MR tall band and enough work to pay for
+   // its own packing
+   nThreads = std::min(nThreads, (M + MR - 1) / MR);
+   if (dWork < ThreadWork)
+      {
+      nThreads = 1;
+      } // end if
+
+   if (nThreads <= 1)
+      {
+      Blocked(0, M, N, K, A, bTransA, B, bTransB, C, Alpha, bAccumulate);
+      } // end if
+   else
+      {
+      // Bands are multiples of MR so only the last one has ragged panels
+      size_t nBand = (M + nThreads - 1) / nThreads;
+      nBand = ((nBand + MR - 1) / MR) * MR;
+
+      std::vector<std::thread> Threads;
+      Threads.reserve(nThreads);
+      for (size_t nRow0 = nBand ; nRow0 < M ; nRow0 += nBand)
+         {
+         const size_t nRow1 = std::min(M, nRow0 + nBand);
+         Threads.push_back(std::thread(&DGemm<T>::Blocked, nRow0, nRow1, N,
+               K, std::cref(A), bTransA, std::cref(B), bTransB,
+               std::cref(C), Alpha, bAccumulate));
+         } // end for
+
+      // This thread takes the first band
+      Blocked(0, std::min(M, nBand), N, K, A, bTransA, B, bTransB, C,
+            Alpha, bAccumulate);
+
+      for (size_t i = 0 ; i < Threads.size() ; i++)
+         {
+         Threads[i].join();
+         } // end for
+      } // end else
+
+   return;
+
+   } // End of function DGemm::Multiply
+
+/*****************************************************************************
+*
+*  DGemm::Simple
+*
+*  Unblocked product for small matrices.  The loops are ordered i-k-j so the
+*  inner loop runs along rows of B and C instead of down columns of B.
+*
+*****************************************************************************/
+
+template <typename T>
+void DGemm<T>::Simple(size_t M, size_t N, size_t K,
+      const DGemmRows<const T>& A, bool bTransA,
+      const DGemmRows<const T>& B, bool bTransB,
+      const DGemmRows<T>& C, T Alpha, bool bAccumulate)
+   {
+   for (size_t i = 0 ; i < M ; i++)
+      {
+      T* RC = C[i];
+      if (!bAccumulate)
+         {
+         std::fill(RC, RC + N, T(0));
+         } // end if
+      for (size_t k = 0 ; k < K ; k++)
+         {
+         const T a = Alpha * (bTransA ? A[k][i] : A[i][k]);
+         if (bTransB)
+            {
+            for (size_t j = 0 ; j < N ; j++)
+               {
+               RC[j] += a * B[j][k];
+               } // end for
+            } // end if
+         else
+            {
+            const T* RB = B[k];
+            for (size_t j = 0 ; j < N ; j++)
+               {
+               RC[j] += a * RB[j];
+               } // end for
+            } // end else
+         } // end for
+      } // end for
+
+   return;
+
+   } // End of function DGemm::Simple
+
+/*****************************************************************************
+*
+*  DGemm::Blocked
+*
+*  Cache blocked product for rows [nRow0, nRow1) of C.
+*
+*****************************************************************************/
+
+template <typename T>
+void DGemm<T>::Blocked(size_t nRow0, size_t nRow1, size_t N, size_t K,
+      const DGemmRows<const T>& A, bool bTransA,
+      const DGemmRows<const T>& B, bool bTransB,
+      const DGemmRows<T>& C, T Alpha, bool bAccumulate)
+   {
+   std::vector<T> PackedA(MC * KC);
+   std::vector<T> PackedB(KC * ((std::min(N, NC) + NR - 1) / NR) * NR);
+
+   for (size_t j0 = 0 ; j0 < N ; j0 += NC)
+      {
+      const size_t nc = std::min(NC, N - j0);
+      for (size_t k0 = 0 ; k0 < K ; k0 += KC)
+         {
+         const size_t kc = std::min(KC, K - k0);
+         PackB(k0, kc, j0, nc, B, bTransB, &PackedB[0]);
+
+         for (size_t i0 = nRow0 ; i0 < nRow1 ; i0 += MC)
+            {
+            const size_t mc = std::min(MC, nRow1 - i0);
+            PackA(i0, mc, k0, kc, A, bTransA, &PackedA[0]);
+
+            // Walk the register blocks of this C block
+            for (size_t jr = 0 ; jr < nc ; jr += NR)
+               {
+               const T* pB = &PackedB[(jr / NR) * kc * NR];
+               for (size_t ir = 0 ; ir < mc ; ir += MR)
+                  {
+                  const T* pA = &PackedA[(ir / MR) * kc * MR];
+                  MicroKernel(kc, pA, pB, C, i0 + ir, j0 + jr,
+                        std::min(MR, mc - ir), std::min(NR, nc - jr), Alpha,
+                        bAccumulate || (k0 != 0));
+                  } // end for
+               } // end for
+            } // end for
+         } // end for
+      } // end for
+
+   return;
+
+   } // End of function DGemm::Blocked
+
+/*****************************************************************************
+*
+*  DGemm::PackA
+*
+*  Copy the mc x kc block of op(A) starting at (nRow0, k0) into MR tall
+*  panels stored k-major: panel[k * MR + i].  Ragged panels are zero padded
+*  so the micro-kernel never needs edge handling on its inputs.
+*
+*****************************************************************************/
+
+template <typename T>
+void DGemm<T>::PackA(size_t nRow0, size_t mc, size_t k0, size_t kc,
+      const DGemmRows<const T>& A, bool bTransA, T* pPack)
+   {
+   for (size_t ir = 0 ; ir < mc ; ir += MR)
+      {
+      const size_t mr = std::min(MR, mc - ir);
+      T* pPanel = pPack + (ir / MR) * kc * MR;
+      if (bTransA)
+         {
+         // op(A)(i, k) = A[k][i], rows of A run along the panel width
+         for (size_t k = 0 ; k < kc ; k++)
+            {
+            const T* RA = A[k0 + k] + nRow0 + ir;
+            T* pDst = pPanel + k * MR;
+            for (size_t i = 0 ; i < mr ; i++)
+               {
+               pDst[i] = RA[i];
+               } // end for
+            for (size_t i = mr ; i < MR ; i++)
+               {
+               pDst[i] = 0;
+               } // end for
+            } // end for
+         } // end if
+      else
+         {
+         for (size_t i = 0 ; i < MR ; i++)
+            {
+            if (i < mr)
+               {
+               const T* RA = A[nRow0 + ir + i] + k0;
+               for (size_t k = 0 ; k < kc ; k++)
+                  {
+                  pPanel[k * MR + i] = RA[k];
+                  } // end for
+               } // end if
+            else
+               {
+               for (size_t k = 0 ; k < kc ; k++)
+                  {
+                  pPanel[k * MR + i] = 0;
+                  } // end for
+               } // end else
+            } // end for
+         } // end else
+      } // end for
+
+   return;
+
+   } // End of function DGemm::PackA
+
+/*****************************************************************************
+*
+*  DGemm::PackB
+*
+*  Copy the kc x nc block of op(B) starting at (k0, nCol0) into NR wide
+*  panels stored k-major: panel[k * NR + j].  Ragged panels are zero padded.
+*
+*****************************************************************************/
+
+template <typename T>
+void DGemm<T>::PackB(size_t k0, size_t kc, size_t nCol0, size_t nc,
+      const DGemmRows<const T>& B, bool bTransB, T* pPack)
+   {
+   for (size_t jr = 0 ; jr < nc ; jr += NR)
+      {
+      const size_t nr = std::min(NR, nc - jr);
+      T* pPanel = pPack + (jr / NR) * kc * NR;
+      if (bTransB)
+         {
+         // op(B)(k, j) = B[j][k], rows of B run down the panel
+         for (size_t j = 0 ; j < NR ; j++)
+            {
+            if (j < nr)
+               {
+               const T* RB = B[nCol0 + jr + j] + k0;
+               for (size_t k = 0 ; k < kc ; k++)
+                  {
+                  pPanel[k * NR + j] = RB[k];
+                  } // end for
+               } // end if
+            else
+               {
+               for (size_t k = 0 ; k < kc ; k++)
+                  {
+                  pPanel[k * NR + j] = 0;
+                  } // end for
+               } // end else
+            } // end for
+         } // end if
+      else
+         {
+         for (size_t k = 0 ; k < kc ; k++)
+            {
+            const T* RB = B[k0 + k] + nCol0 + jr;
+            T* pDst = pPanel + k * NR;
+            for (size_t j = 0 ; j < nr ; j++)
+               {
+               pDst[j] = RB[j];
+               } // end for
+            for (size_t j = nr ; j < NR ; j++)
+               {
+               pDst[j] = 0;
+               } // end for
+            } // end for
+         } // end else
+      } // end for
+
+   return;
+
+   } // End of function DGemm::PackB
+
+/*****************************************************************************
+*
+*  DGemm::MicroKernel
+*
+*  Multiply an MR tall packed A panel by an NR wide packed B panel over kc
+*  and store (or accumulate) Alpha times the mr x nr valid part into C at
+*  (nRow, nCol).
+*  The fixed trip count inner loop over NR is what gets vectorized.
+*
+*****************************************************************************/
+
+template <typename T>
+void DGemm<T>::MicroKernel(size_t kc, const T* pA, const T* pB,
+      const DGemmRows<T>& C, size_t nRow, size_t nCol, size_t mr, size_t nr,
+      T Alpha, bool bAccumulate)
+   {
+   T Acc[MR][NR];
+   for (size_t i = 0 ; i < MR ; i++)
+      {
+      for (size_t j = 0 ; j < NR ; j++)
+         {
+         Acc[i][j] = 0;
+         } // end for
+      } // end for
+
+   for (size_t k = 0 ; k < kc ; k++)
+      {
+      const T* a = pA + k * MR;
+      const T* b = pB + k * NR;
+      for (size_t i = 0 ; i < MR ; i++)
+         {
+         const T ai = a[i];
+         for (size_t j = 0 ; j < NR ; j++)
+            {
+            Acc[i][j] += ai * b[j];
+            } // end for
+         } // end for
+      } // end for
+
+   for (size_t i = 0 ; i < mr ; i++)
+      {
+      T* RC = C[nRow + i] + nCol;
+      if (bAccumulate)
+         {
+         for (size_t j = 0 ; j < nr ; j++)
+            {
+            RC[j] += Alpha * Acc[i][j];
+            } // end for
+         } // end if
+      else
+         {
+         for (size_t j = 0 ; j < nr ; j++)
+            {
+            RC[j] = Alpha * Acc[i][j];
+            } // end for
+         } // end else
+      } // end for
+
+   return;
+
+   } // End of function DGemm::MicroKernel
+
+#endif // __DGEMM_H__
@@ -10,11 +10,15 @@
 *****************************************************************************/
 
 #include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <type_traits>
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/version.hpp>
 #include <boost/serialization/serialization.hpp>
 #include <boost/archive/xml_iarchive.hpp>
 #include <boost/archive/xml_oarchive.hpp>
+#include "DSpan.h"
 
 //#include "DConfig.h"
 
@@ -57,6 +61,117 @@ inline float DegToRad(float fDeg)
    return (fDeg * fDegToRad);
    }
 
+/*****************************************************************************
+******************************** Mask Kernels ********************************
+*****************************************************************************/
+
+/*
+   Bulk versions of the threshold and range tests.  Each writes 255 to the
+   mask where the test passes and 0 where it fails, matching OpenCV's binary
+   images.  The comparison is a functor inlined into a plain loop so the
+   compiler vectorizes it, which is where the speed comes from; the virtual
+   Apply(DSpan, DSpan) overloads below cost one call per span, not one per
+   element.
+*/
+
+const unsigned char nMaskPass = 255;
+
+// Elements per block in the mask kernel.  Each block is loaded into a
+// local array first so the compiler needn't worry about the mask
+// overwriting the input, and the fixed trip count loops get vectorized
+// even at the cheapest vectorization setting (-O2).
+const size_t nMaskBlock = 16;
+
+template <typename T, typename TEST>
+inline void DMaskKernel(const T* pIn, unsigned char* pMask, size_t nCount,
+      const TEST& Test)
+   {
+   const size_t nBulk = nCount - (nCount % nMaskBlock);
+   for (size_t i = 0 ; i < nBulk ; i += nMaskBlock)
+      {
+      T Block[nMaskBlock];
+      for (size_t j = 0 ; j < nMaskBlock ; j++)
+         {
+         Block[j] = pIn[i + j];
+         } // end for
+      for (size_t j = 0 ; j < nMaskBlock ; j++)
+         {
+         pMask[i + j] = static_cast<unsigned char>(
+               -static_cast<int>(Test(Block[j])));
+         } // end for
+      } // end for
+
+   for (size_t i = nBulk ; i < nCount ; i++)
+      {
+      pMask[i] = static_cast<unsigned char>(-static_cast<int>(Test(pIn[i])));
+      } // end for
+
+   return;
+   }
+
+/*
+   Range test kernels.  bWrap means the range runs from Lower up past the
+   top of the type's range and around to Upper, as a hue range across red
+   does.  Integers use modular arithmetic for a single compare per element
+   that covers both the plain and the wrapped case:  Test is in range when
+   (Test - Lower) <= (Upper - Lower) in the unsigned type of the same size.
+   Floating point types take the two compares.
+*/
+
+template <typename T>
+inline void DRangeKernel(const T* pIn, unsigned char* pMask, size_t nCount,
+      T Lower, T Upper, bool bWrap, std::true_type /* Integral */)
+   {
+   typedef typename std::make_unsigned<T>::type U;
+
+   if (!bWrap && (Lower > Upper))
+      {
+      std::fill(pMask, pMask + nCount, static_cast<unsigned char>(0));
+      } // end if
+   else
+      {
+      const U uLower = static_cast<U>(Lower);
+      const U uWidth = static_cast<U>(static_cast<U>(Upper) - uLower);
+      DMaskKernel(pIn, pMask, nCount, [uLower, uWidth](T Test)
+            {
+            return (static_cast<U>(static_cast<U>(Test) - uLower) <= uWidth);
+            });
+      } // end else
+
+   return;
+   }
+
+template <typename T>
+inline void DRangeKernel(const T* pIn, unsigned char* pMask, size_t nCount,
+      T Lower, T Upper, bool bWrap, std::false_type /* Integral */)
+   {
+   if (bWrap)
+      {
+      DMaskKernel(pIn, pMask, nCount, [Lower, Upper](T Test)
+            {
+            return ((Test >= Lower) | (Test <= Upper));
+            });
+      } // end if
+   else
+      {
+      DMaskKernel(pIn, pMask, nCount, [Lower, Upper](T Test)
+            {
+            return ((Test >= Lower) & (Test <= Upper));
+            });
+      } // end else
+
+   return;
+   }
+
+template <typename T>
+inline void DRangeKernel(const T* pIn, unsigned char* pMask, size_t nCount,
+      T Lower, T Upper, bool bWrap)
+   {
+   DRangeKernel(pIn, pMask, nCount, Lower, Upper, bWrap,
+         typename std::is_integral<T>::type());
+   return;
+   }
+
 /*****************************************************************************
 ****************************** class DThreshold ******************************
 *****************************************************************************/
@@ -136,6 +251,19 @@ class DThreshold
       
       virtual bool Apply(T Test) const = 0;
 
+      // Set Mask to nMaskPass where the test passes and 0 elsewhere.  The
+      // derived classes replace this per element loop with a vectorized
+      // kernel.
+      virtual void Apply(DSpan<const T> In, DSpan<unsigned char> Mask) const
+         {
+         assert(In.size() == Mask.size());
+         for (size_t i = 0 ; i < In.size() ; i++)
+            {
+            Mask[i] = Apply(In[i]) ? nMaskPass : 0;
+            } // end for
+         return;
+         }
+
       template<class Archive>
       void serialize(Archive& ar, const unsigned int /* nVersion */)
          {
@@ -211,6 +339,17 @@ class DThresholdLT : public DThreshold<T>
          return (Test < this->m_Threshold);
          }
 
+      virtual void Apply(DSpan<const T> In, DSpan<unsigned char> Mask) const
+         {
+         assert(In.size() == Mask.size());
+         const T Threshold = this->m_Threshold;
+         DMaskKernel(In.data(), Mask.data(), In.size(), [Threshold](T Test)
+               {
+               return (Test < Threshold);
+               });
+         return;
+         }
+
       template<class Archive>
       void serialize(Archive& ar, const unsigned int /* nVersion */)
          {
@@ -279,6 +418,17 @@ class DThresholdLE : public DThreshold<T>
          return (Test <= this->m_Threshold);
          }
 
+      virtual void Apply(DSpan<const T> In, DSpan<unsigned char> Mask) const
+         {
+         assert(In.size() == Mask.size());
+         const T Threshold = this->m_Threshold;
+         DMaskKernel(In.data(), Mask.data(), In.size(), [Threshold](T Test)
+               {
+               return (Test <= Threshold);
+               });
+         return;
+         }
+
       template<class Archive>
       void serialize(Archive& ar, const unsigned int /* nVersion */)
          {
@@ -355,6 +505,17 @@ class DThresholdGE : public DThreshold<T>
          return (Test >= this->m_Threshold);
          }
 
+      virtual void Apply(DSpan<const T> In, DSpan<unsigned char> Mask) const
+         {
+         assert(In.size() == Mask.size());
+         const T Threshold = this->m_Threshold;
+         DMaskKernel(In.data(), Mask.data(), In.size(), [Threshold](T Test)
+               {
+               return (Test >= Threshold);
+               });
+         return;
+         }
+
       template<class Archive>
       void serialize(Archive& ar, const unsigned int /* nVersion */)
          {
@@ -431,6 +592,17 @@ class DThresholdGT : public DThreshold<T>
          return (Test > this->m_Threshold);
          }
 
+      virtual void Apply(DSpan<const T> In, DSpan<unsigned char> Mask) const
+         {
+         assert(In.size() == Mask.size());
+         const T Threshold = this->m_Threshold;
+         DMaskKernel(In.data(), Mask.data(), In.size(), [Threshold](T Test)
+               {
+               return (Test > Threshold);
+               });
+         return;
+         }
+
       template<class Archive>
       void serialize(Archive& ar, const unsigned int /* nVersion */)
          {
@@ -569,6 +741,14 @@ class DRangeTest
          return (bRet);
          }
 
+      virtual void Apply(DSpan<const T> In, DSpan<unsigned char> Mask) const
+         {
+         assert(In.size() == Mask.size());
+         DRangeKernel(In.data(), Mask.data(), In.size(), GetLower(),
+               GetUpper(), m_bCircular && (m_Lower > m_Upper));
+         return;
+         }
+
       template<class Archive>
       void serialize(Archive& ar, const unsigned int /* nVersion */)
          {
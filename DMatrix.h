@@ -28,7 +28,13 @@
 #include <algorithm>
 #include <cmath>
 #include <cassert>
+#include <utility>
+#include <memory>
 #include "DVector.h"
+#include "DAllocator.h"
+#include "DGemm.h"
+#include "DMatrixExpr.h"
+#include "DMatrixFixed.h"
 
 /*****************************************************************************
 ******************************* class DArray2D *******************************
@@ -41,43 +47,101 @@
    arrangment change, and a bit of structural complexity.  However, access
    efficiency is increased since the row offset need not be computed every
    time an element is accessed.
+
+   The elements come from ALLOC, by default a 64 byte aligned heap block.
+   With PAD each row is padded out to a multiple of PadBytes so every row
+   starts on an aligned boundary and vector loops over a row never straddle
+   into the next one.  The padding is zero and RowStride() includes it.
+
+   Attach() turns the array into a view of someone else's row major memory,
+   such as a cv::Mat, with an arbitrary row stride.  A view reads and writes
+   the external elements in place and never frees them.  Resizing a view to
+   a different size detaches it onto storage of its own, and copies of a
+   view own their elements.
 */
 
-#define DArray2DTemplate template <typename T>
+template <typename T, typename ALLOC = DAlignedAllocator<T>, bool PAD = false>
+class DArray2D;
+
+#define DArray2DTemplate template <typename T, typename ALLOC, bool PAD>
 
 DArray2DTemplate
 class DArray2D
    {
    public :
-      DArray2D()
+      // Rows are padded to a multiple of this many bytes when PAD is set
+      static const size_t PadBytes = 64;
+
+      DArray2D() : m_nRows(0), m_nCols(0), m_nStride(0), m_pBase(nullptr),
+            m_bView(false)
          {
          m_bRowsSwapped = false;
          return;
          }
 
       DArray2D(size_t nRows, size_t nCols) : m_nRows(nRows), m_nCols(nCols),
-            m_E(nRows * nCols), m_R(nRows)
+            m_nStride(Stride(nCols)), m_E(nRows * Stride(nCols)), m_R(nRows),
+            m_pBase(nullptr), m_bView(false)
          {
          InitRowPtrs();
          return;
          }
       
-      DArray2D(const DArray2D& src)
+      DArray2D(const DArray2D& src) : m_nRows(0), m_nCols(0), m_nStride(0),
+            m_pBase(nullptr), m_bRowsSwapped(false), m_bView(false)
          {
          Copy(src);
          return;
          }
+
+      // Moving the element vector keeps its buffer so the row pointers stay
+      // valid.  Move assignment only takes the buffer when the allocators
+      // are equal and otherwise copies the elements into this array's own
+      // storage, so arena memory never moves into an array from an outer
+      // scope that way.  A move constructed array takes the buffer along
+      // with its arena scope and must not outlive that scope.
+      DArray2D(DArray2D&& src) : m_nRows(src.m_nRows), m_nCols(src.m_nCols),
+            m_nStride(src.m_nStride), m_E(std::move(src.m_E)),
+            m_R(std::move(src.m_R)), m_pBase(src.m_pBase),
+            m_bRowsSwapped(src.m_bRowsSwapped), m_bView(src.m_bView)
+         {
+         src.Release();
+         return;
+         }
       
       ~DArray2D()
          {
          return;
          }
 
-      DArray2D<T>& operator=(const DArray2D<T>& rhs)
+      DArray2D& operator=(const DArray2D& rhs)
          {
          Copy(rhs);
          return (*this);
          }
+
+      DArray2D& operator=(DArray2D&& rhs)
+         {
+         if ((this != &rhs) &&
+               (m_E.get_allocator() != rhs.m_E.get_allocator()))
+            {
+            Copy(rhs);
+            rhs.Release();
+            } // end if
+         else if (this != &rhs)
+            {
+            m_nRows = rhs.m_nRows;
+            m_nCols = rhs.m_nCols;
+            m_nStride = rhs.m_nStride;
+            m_E = std::move(rhs.m_E);
+            m_R = std::move(rhs.m_R);
+            m_pBase = rhs.m_pBase;
+            m_bRowsSwapped = rhs.m_bRowsSwapped;
+            m_bView = rhs.m_bView;
+            rhs.Release();
+            } // end else if
+         return (*this);
+         }
       
       size_t NumRows() const
          {
@@ -102,57 +166,134 @@ class DArray2D
       // Initialize with a native array trusting it's large enough
       void Initialize(const T Init[])
          {
-         for (size_t i = 0 ; i < NumRows() * NumCols() ; i++)
+         for (size_t r = 0 ; r < NumRows() ; r++)
             {
-            m_E[i] = Init[i];
+            std::copy(Init + r * NumCols(), Init + (r + 1) * NumCols(),
+                  m_R[r]);
             } // end for
          return;
          }
    
       void Resize(size_t nRows, size_t nCols);      
 
-      // Exchange two rows
+      // Exchange two rows.  An attached buffer belongs to the caller and
+      // has to end up in row order, so a view swaps the elements themselves.
       void SwapRows(size_t r1, size_t r2)
          {
-         // Just exchange the row pointers
-         std::swap(m_R[r1], m_R[r2]);
-         m_bRowsSwapped = true;
+         if (m_bView)
+            {
+            std::swap_ranges(m_R[r1], m_R[r1] + m_nCols, m_R[r2]);
+            } // end if
+         else
+            {
+            // Just exchange the row pointers
+            std::swap(m_R[r1], m_R[r2]);
+            m_bRowsSwapped = true;
+            } // end else
          return;
          }
+
+      // True when row r starts at Data() + r * RowStride()
+      bool IsContiguous() const
+         {
+         return (!m_bRowsSwapped);
+         }
+
+      T* Data()
+         {
+         return (m_pBase);
+         }
+
+      const T* Data() const
+         {
+         return (m_pBase);
+         }
+
+      size_t RowStride() const
+         {
+         return (m_nStride);
+         }
+
+      // Wrap nRows x nCols of external memory with rows nStride elements
+      // apart.  The memory must outlive the view.
+      void Attach(T* pData, size_t nRows, size_t nCols, size_t nStride);
+
+      // True when the elements belong to someone else
+      bool IsView() const
+         {
+         return (m_bView);
+         }
        
    protected :
+      typedef typename std::allocator_traits<ALLOC>::template
+            rebind_alloc<T*> PTR_ALLOC;
+
       // Array size information
       size_t m_nRows;
       size_t m_nCols;
+      size_t m_nStride;
       
       // Storage vector for the individual elements
-      DVector<T> m_E;
+      std::vector<T, ALLOC> m_E;
       
       // Vector of pointers to each row of the matrix
-      std::vector<T*> m_R;
+      std::vector<T*, PTR_ALLOC> m_R;
+
+      // First element, in m_E or the external memory of a view
+      T* m_pBase;
       
       // A flag indicating of any of the rows of the array have been swapped
       // by exchanging row pointers such that the element vector cannot be
       // considered continuous
       bool m_bRowsSwapped;
+
+      bool m_bView;
       
       // Initialize the row pointers
       void InitRowPtrs()
          {
+         if (!m_bView)
+            {
+            m_pBase = m_E.empty() ? nullptr : &m_E[0];
+            } // end if
          for (size_t r = 0 ; r < NumRows() ; r++)
             {
-            m_R[r] = &m_E[r * NumCols()];
+            m_R[r] = m_pBase + r * m_nStride;
             } // end for
          m_bRowsSwapped = false;
          return;      
          }
 
+      // Elements per row including any padding
+      static size_t Stride(size_t nCols)
+         {
+         const size_t nPad = std::max<size_t>(1, PadBytes / sizeof(T));
+         return (PAD ? ((nCols + nPad - 1) / nPad) * nPad : nCols);
+         }
+
       // Make a copy
-      void Copy(const DArray2D<T>& src);
+      void Copy(const DArray2D& src);
+
+      // Leave a moved from array empty
+      void Release()
+         {
+         m_nRows = 0;
+         m_nCols = 0;
+         m_nStride = 0;
+         m_E.clear();
+         m_R.clear();
+         m_pBase = nullptr;
+         m_bRowsSwapped = false;
+         m_bView = false;
+         return;
+         }
      
    private :
    };  // End of class DArray2D
 
+DArray2DTemplate
+const size_t DArray2D<T, ALLOC, PAD>::PadBytes;
+
 /*****************************************************************************
 *********************** Class DArray2D Implementation ************************
 *****************************************************************************/
@@ -168,11 +309,14 @@ class DArray2D
 *****************************************************************************/
 
 DArray2DTemplate
-void DArray2D<T>::Resize(size_t nRows, size_t nCols)
+void DArray2D<T, ALLOC, PAD>::Resize(size_t nRows, size_t nCols)
    {
    if ((nRows != NumRows()) || (nCols != NumCols()))
       {
-      m_E.resize(nRows * nCols);
+      // A view can't grow the memory it wraps so it takes its own
+      m_bView = false;
+      m_nStride = Stride(nCols);
+      m_E.resize(nRows * m_nStride);
       m_nCols = nCols;
       if (nRows != NumRows())
          {
@@ -181,12 +325,49 @@ void DArray2D<T>::Resize(size_t nRows, size_t nCols)
          } // end if
          
       InitRowPtrs();   
+
+      // Old elements may have shifted into the padding
+      if (m_nStride > m_nCols)
+         {
+         for (size_t r = 0 ; r < NumRows() ; r++)
+            {
+            std::fill(m_R[r] + m_nCols, m_R[r] + m_nStride, T(0));
+            } // end for
+         } // end if
       } // end if
    
    return;
 
    } // End of function DArray2D::Resize 
 
+/*****************************************************************************
+*
+*  DArray2D::Attach
+*
+*  Drop any storage of our own and point the rows into the external memory.
+*
+*****************************************************************************/
+
+DArray2DTemplate
+void DArray2D<T, ALLOC, PAD>::Attach(T* pData, size_t nRows, size_t nCols,
+      size_t nStride)
+   {
+   assert((nRows == 0) || (pData != nullptr));
+   assert(nStride >= nCols);
+
+   std::vector<T, ALLOC>(m_E.get_allocator()).swap(m_E);
+   m_R.resize(nRows);
+   m_nRows = nRows;
+   m_nCols = nCols;
+   m_nStride = nStride;
+   m_pBase = pData;
+   m_bView = true;
+   InitRowPtrs();
+
+   return;
+
+   } // End of function DArray2D::Attach
+
 /*****************************************************************************
 *
 *  DArray2D::Copy
@@ -198,12 +379,15 @@ void DArray2D<T>::Resize(size_t nRows, size_t nCols)
 *****************************************************************************/
 
 DArray2DTemplate
-void DArray2D<T>::Copy(const DArray2D<T>& src)
+void DArray2D<T, ALLOC, PAD>::Copy(const DArray2D& src)
    {
-   m_bRowsSwapped = src.m_bRowsSwapped;
-   
-   // Allocate storage and initialize row pointers
+   // Allocate storage and initialize row pointers.  The elements are copied
+   // in logical row order so the copy's own rows always end up contiguous.
    Resize(src.NumRows(), src.NumCols());
+   if (m_bRowsSwapped)
+      {
+      InitRowPtrs();
+      } // end if
    
    // Now copy the elements
    for (size_t r = 0 ; r < NumRows() ; r++)
@@ -321,6 +505,44 @@ class DFixedArray2D
             } // end for
          return;
          }
+
+      // Rows are always physically swapped so the storage stays contiguous
+      bool IsContiguous() const
+         {
+         return (true);
+         }
+
+      // The elements are always held in place
+      bool IsView() const
+         {
+         return (false);
+         }
+
+      // The native array for the fixed size kernels in DMatrixFixed.h
+      T (&GetElements())[ROWS][COLS]
+         {
+         return (m_E);
+         }
+
+      const T (&GetElements() const)[ROWS][COLS]
+         {
+         return (m_E);
+         }
+
+      T* Data()
+         {
+         return (&m_E[0][0]);
+         }
+
+      const T* Data() const
+         {
+         return (&m_E[0][0]);
+         }
+
+      size_t RowStride() const
+         {
+         return (COLS);
+         }
       
    protected :
       T m_E[ROWS][COLS];
@@ -383,9 +605,12 @@ void DFixedArray2D<T, ROWS, COLS>::Copy(
 #define DMatrixTemplate template <typename T, typename ARRAY>
 
 DMatrixTemplate
-class DMatrix
+class DMatrix : public DMatrixExpr<DMatrix<T, ARRAY> >
    {
    public :
+      typedef T T_numtype;
+      typedef DMatrix<T, ARRAY> MatrixType;
+
       DMatrix(T ZeroTest = 100 * std::numeric_limits<T>::epsilon())
          {
          m_ZeroTest = ZeroTest;
@@ -406,6 +631,30 @@ class DMatrix
          Copy(src);
          return;
          }
+
+      DMatrix(DMatrix<T, ARRAY>&& src)
+            : m_A(std::move(src.m_A)), m_ZeroTest(src.m_ZeroTest)
+         {
+         return;
+         }
+
+      // Evaluate an expression (see DMatrixExpr.h).  Mismatched operands
+      // give a zero matrix of the expression's size.
+      template <typename E>
+      DMatrix(const DMatrixExpr<E>& Expr)
+         {
+         m_ZeroTest = 100 * std::numeric_limits<T>::epsilon();
+         if (Expr.Self().IsConformant())
+            {
+            Expr.Self().AssignTo(*this, 1);
+            } // end if
+         else
+            {
+            Resize(Expr.Self().NumRows(), Expr.Self().NumCols());
+            Set(0);
+            } // end else
+         return;
+         }
       
       ~DMatrix()
          {
@@ -417,6 +666,28 @@ class DMatrix
          Copy(rhs);
          return (*this);
          }
+
+      DMatrix<T, ARRAY>& operator=(DMatrix<T, ARRAY>&& rhs)
+         {
+         m_ZeroTest = rhs.m_ZeroTest;
+         Take(rhs);
+         return (*this);
+         }
+
+      template <typename E>
+      DMatrix<T, ARRAY>& operator=(const DMatrixExpr<E>& Expr)
+         {
+         if (Expr.Self().Aliases(this) || !Expr.Self().IsConformant())
+            {
+            DMatrix<T, ARRAY> Temp(Expr);
+            Take(Temp);
+            } // end if
+         else
+            {
+            Expr.Self().AssignTo(*this, 1);
+            } // end else
+         return (*this);
+         }
       
       bool operator==(const DMatrix<T, ARRAY>& rhs);
 
@@ -435,6 +706,41 @@ class DMatrix
          m_A.Resize(nRows, nCols);
          return;
          }
+
+      // Make this matrix a view of external row major memory with rows
+      // nStride elements apart (see DArray2D::Attach)
+      void Attach(T* pData, size_t nRows, size_t nCols, size_t nStride)
+         {
+         m_A.Attach(pData, nRows, nCols, nStride);
+         return;
+         }
+
+      bool IsView() const
+         {
+         return (m_A.IsView());
+         }
+
+      // Raw storage.  Row r starts at Data() + r * RowStride() only while
+      // IsContiguous().
+      T* Data()
+         {
+         return (m_A.Data());
+         }
+
+      const T* Data() const
+         {
+         return (m_A.Data());
+         }
+
+      size_t RowStride() const
+         {
+         return (m_A.RowStride());
+         }
+
+      bool IsContiguous() const
+         {
+         return (m_A.IsContiguous());
+         }
        
       // Initialize with a native array trusting it's large enough
       void Initialize(const T Init[])
@@ -494,9 +800,9 @@ class DMatrix
       
       void Set(T v = 0)
          {
-         for (size_t i = 0 ; i < m_A.size() ; i++)
+         for (size_t r = 0 ; r < NumRows() ; r++)
             {
-            m_A[i] = v;
+            std::fill(m_A[r], m_A[r] + NumCols(), v);
             } // end for
          return;
          }
@@ -574,33 +880,20 @@ class DMatrix
       bool MulATransposexB(const DMatrix<T, ARRAY>& A,
             const DMatrix<T, ARRAY>& B);
       
-      // Arithmetic operators
-      // Possibly introduces temporaries, copy ops, & exceptions)
-      
-      DMatrix<T, ARRAY> operator+(DMatrix<T, ARRAY>& rhs) const
-         {
-         DMatrix<T, ARRAY> C(NumRows(), NumCols());
-         if (!DMatrix<T, ARRAY>::Add(C, (*this), rhs))
-            {
-            // Throw
-            } // end if
-         return (C);
-         }
+      // Arithmetic operators.  The binary operators are free functions in
+      // DMatrixExpr.h that build expressions evaluated on assignment.
 
       void operator+=(const DMatrix<T, ARRAY>& rhs)
          {
          Add(*this, rhs);
          return;
          }
-      
-      DMatrix<T, ARRAY> operator+(T rhs) const
+
+      template <typename E>
+      void operator+=(const DMatrixExpr<E>& Expr)
          {
-         DMatrix<T, ARRAY> C(NumRows(), NumCols());
-         if (!DMatrix<T, ARRAY>::Add(C, (*this), rhs))
-            {
-            // Throw
-            } // end if
-         return (C);
+         Accumulate(Expr.Self(), 1);
+         return;
          }
 
       void operator+=(T s)
@@ -608,31 +901,18 @@ class DMatrix
          Add(s);
          return;
          }
-      
-      DMatrix<T, ARRAY> operator-(DMatrix<T, ARRAY>& rhs) const
-         {
-         DMatrix<T, ARRAY> C(NumRows(), NumCols());
-         if (!DMatrix<T, ARRAY>::Sub(C, (*this), rhs))
-            {
-            // Throw
-            } // end if
-         return (C);
-         }
 
       void operator-=(const DMatrix<T, ARRAY>& rhs)
          {
          Sub(*this, rhs);
          return;
          }
- 
-      DMatrix<T, ARRAY> operator-(T rhs) const
+
+      template <typename E>
+      void operator-=(const DMatrixExpr<E>& Expr)
          {
-         DMatrix<T, ARRAY> C(NumRows(), NumCols());
-         if (!DMatrix<T, ARRAY>::Sub(C, (*this), rhs))
-            {
-            // Throw
-            } // end if
-         return (C);
+         Accumulate(Expr.Self(), -1);
+         return;
          }
 
       void operator-=(T s)
@@ -640,32 +920,30 @@ class DMatrix
          Sub(s);
          return;
          }
- 
-      DMatrix<T, ARRAY> operator*(DMatrix<T, ARRAY>& rhs) const
-         {
-         DMatrix<T, ARRAY> C(NumRows(), rhs.NumCols());
-         if (!DMatrix<T, ARRAY>::Mul(C, (*this), rhs))
-            {
-            // Throw
-            } // end if
-         return (C);
-         }
-        
-      DMatrix<T, ARRAY> operator*(T rhs) const
-         {
-         DMatrix<T, ARRAY> C(NumRows(), NumCols());
-         if (!DMatrix<T, ARRAY>::Mul(C, (*this), rhs))
-            {
-            // Throw
-            } // end if
-         return (C);
-         }
 
       void operator*=(T s)
          {
          Mul(s);
          return;
          }
+
+      // Expression evaluation interface (see DMatrixExpr.h)
+      void AssignTo(DMatrix<T, ARRAY>& Dest, T s) const;
+      void AccumulateTo(DMatrix<T, ARRAY>& Dest, T s) const;
+      bool Aliases(const void* p) const
+         {
+         return (p == this);
+         }
+      bool IsConformant() const
+         {
+         return (true);
+         }
+
+      // Result = Alpha * op(A) * op(B), added to Result if bAccumulate.  op()
+      // is an optional transpose.  Result may be A or B.
+      static bool Gemm(DMatrix<T, ARRAY>& Result, const DMatrix<T, ARRAY>& A,
+            bool bTransA, const DMatrix<T, ARRAY>& B, bool bTransB,
+            T Alpha = 1, bool bAccumulate = false);
          
       // Transpose this matrix in place
       void Transpose();
@@ -683,6 +961,11 @@ class DMatrix
       // Solve simultaneous equations
       static bool GaussElim(DMatrix<T, ARRAY>& A, std::vector<T>& b,
             std::vector<T>& x);
+
+      // Solve A x = b leaving this matrix and b untouched
+      bool Solve(const std::vector<T>& b, std::vector<T>& x) const;
+
+      T Determinant() const;
       // Given an upper triangular matix, back solve equations      
       static bool SolveTriangular(DMatrix<T, ARRAY>& A, std::vector<T>& b,
             std::vector<T>& x);
@@ -713,6 +996,32 @@ class DMatrix
    protected :
       ARRAY m_A;  // Elements
       T m_ZeroTest;
+
+      // Describe the rows of a matrix to the GEMM kernel.  Contiguous storage
+      // is passed as base and stride, otherwise Rows is filled with the row
+      // pointers.
+      static DGemmRows<const T> GemmRows(const DMatrix<T, ARRAY>& A,
+            std::vector<const T*>& Rows);
+      static DGemmRows<T> GemmRows(DMatrix<T, ARRAY>& A,
+            std::vector<T*>& Rows);
+
+      // this += s * Expr.  Like Add(), a mismatch leaves this untouched.
+      template <typename E>
+      bool Accumulate(const E& Expr, T s)
+         {
+         bool bRet = (Expr.NumRows() == NumRows()) &&
+               (Expr.NumCols() == NumCols()) && Expr.IsConformant();
+         if (bRet && Expr.Aliases(this))
+            {
+            DMatrix<T, ARRAY> Temp(Expr);
+            Temp.AccumulateTo(*this, s);
+            } // end if
+         else if (bRet)
+            {
+            Expr.AccumulateTo(*this, s);
+            } // end else if
+         return (bRet);
+         }
       
       // Make a copy
       void Copy(const DMatrix<T, ARRAY>& src)
@@ -721,6 +1030,21 @@ class DMatrix
          m_A = src.m_A;
          return;
          }
+
+      // Steal src's elements, except that a view has them copied in so the
+      // result lands in the memory it wraps
+      void Take(DMatrix<T, ARRAY>& src)
+         {
+         if (m_A.IsView())
+            {
+            m_A = src.m_A;
+            } // end if
+         else
+            {
+            m_A = std::move(src.m_A);
+            } // end else
+         return;
+         }
       
       // Find the largest column element to use as the pivot row
       size_t FindMaxPivot(size_t nCol, T& MaxPivot) const
@@ -1088,12 +1412,187 @@ void DMatrix<T, ARRAY>::Mul(DMatrix<T, ARRAY>& Result,
 
    } // End of function DMatrix::Mul 
  
+/*****************************************************************************
+*
+*  DMatrix::GemmRows
+*
+*  Describe the rows of A for DGemm.  Storage that hasn't had its rows
+*  swapped takes the base pointer and stride fast path.
+*
+*****************************************************************************/
+
+DMatrixTemplate
+DGemmRows<const T> DMatrix<T, ARRAY>::GemmRows(const DMatrix<T, ARRAY>& A,
+      std::vector<const T*>& Rows)
+   {
+   if (A.m_A.IsContiguous())
+      {
+      return (DGemmRows<const T>(A.m_A.Data(), A.m_A.RowStride()));
+      } // end if
+
+   Rows.resize(A.NumRows());
+   for (size_t r = 0 ; r < A.NumRows() ; r++)
+      {
+      Rows[r] = A[r];
+      } // end for
+
+   return (DGemmRows<const T>(Rows.empty() ? nullptr : &Rows[0]));
+
+   } // End of function DMatrix::GemmRows
+
+DMatrixTemplate
+DGemmRows<T> DMatrix<T, ARRAY>::GemmRows(DMatrix<T, ARRAY>& A,
+      std::vector<T*>& Rows)
+   {
+   if (A.m_A.IsContiguous())
+      {
+      return (DGemmRows<T>(A.m_A.Data(), A.m_A.RowStride()));
+      } // end if
+
+   Rows.resize(A.NumRows());
+   for (size_t r = 0 ; r < A.NumRows() ; r++)
+      {
+      Rows[r] = A[r];
+      } // end for
+
+   return (DGemmRows<T>(Rows.empty() ? nullptr : &Rows[0]));
+
+   } // End of function DMatrix::GemmRows
+
+/*****************************************************************************
+*
+*  DMatrix::Gemm
+*
+*  Result = Alpha * op(A) * op(B) where op() is an optional transpose.  When
+*  bAccumulate is set the product is added to Result, which must then already
+*  be the right size, otherwise Result is resized as needed.  Result may be
+*  the same matrix as A and/or B, in which case the product is formed in a
+*  temporary first.
+*
+*****************************************************************************/
+
+DMatrixTemplate
+bool DMatrix<T, ARRAY>::Gemm(DMatrix<T, ARRAY>& Result,
+      const DMatrix<T, ARRAY>& A, bool bTransA, const DMatrix<T, ARRAY>& B,
+      bool bTransB, T Alpha, bool bAccumulate)
+   {
+   const size_t M = bTransA ? A.NumCols() : A.NumRows();
+   const size_t K = bTransA ? A.NumRows() : A.NumCols();
+   const size_t N = bTransB ? B.NumRows() : B.NumCols();
+
+   bool bRet = (K == (bTransB ? B.NumCols() : B.NumRows()));
+   if (bRet && bAccumulate)
+      {
+      bRet = (Result.NumRows() == M) && (Result.NumCols() == N);
+      } // end if
+
+   if (bRet && DMatrixFixed<T, ARRAY>::bEnabled)
+      {
+      // Small fixed size matrices use the unrolled kernel, which also
+      // handles aliasing
+      DMatrixFixed<T, ARRAY>::Gemm(A.m_A, bTransA, B.m_A, bTransB, Result.m_A,
+            Alpha, bAccumulate);
+      } // end if
+   else if (bRet)
+      {
+      if ((&Result == &A) || (&Result == &B))
+         {
+         DMatrix<T, ARRAY> Temp(M, N, Result.m_ZeroTest);
+         Gemm(Temp, A, bTransA, B, bTransB, Alpha, false);
+         if (bAccumulate)
+            {
+            Add(Result, Result, Temp);
+            } // end if
+         else
+            {
+            Result.Take(Temp);
+            } // end else
+         } // end if
+      else
+         {
+         Result.Resize(M, N);
+
+         std::vector<const T*> RowsA;
+         std::vector<const T*> RowsB;
+         std::vector<T*> RowsC;
+         DGemm<T>::Multiply(M, N, K, GemmRows(A, RowsA), bTransA,
+               GemmRows(B, RowsB), bTransB, GemmRows(Result, RowsC), Alpha,
+               bAccumulate);
+         } // end else
+      } // end if
+
+   return (bRet);
+
+   } // End of function DMatrix::Gemm
+
+/*****************************************************************************
+*
+*  DMatrix::AssignTo
+*
+*  Dest = s * this.  The leaf case of expression evaluation.
+*
+*****************************************************************************/
+
+DMatrixTemplate
+void DMatrix<T, ARRAY>::AssignTo(DMatrix<T, ARRAY>& Dest, T s) const
+   {
+   if (&Dest == this)
+      {
+      if (s != 1)
+         {
+         Dest.Mul(s);
+         } // end if
+      } // end if
+   else
+      {
+      Dest.MakeSameSize(*this);
+      for (size_t r = 0 ; r < NumRows() ; r++)
+         {
+         T* R = Dest[r];
+         const T* RS = (*this)[r];
+         for (size_t c = 0 ; c < NumCols() ; c++)
+            {
+            R[c] = s * RS[c];
+            } // end for
+         } // end for
+      } // end else
+
+   return;
+
+   } // End of function DMatrix::AssignTo
+
+/*****************************************************************************
+*
+*  DMatrix::AccumulateTo
+*
+*  Dest += s * this.  Dest must be the same size.
+*
+*****************************************************************************/
+
+DMatrixTemplate
+void DMatrix<T, ARRAY>::AccumulateTo(DMatrix<T, ARRAY>& Dest, T s) const
+   {
+   assert(IsSameSize(Dest));
+   for (size_t r = 0 ; r < NumRows() ; r++)
+      {
+      T* R = Dest[r];
+      const T* RS = (*this)[r];
+      for (size_t c = 0 ; c < NumCols() ; c++)
+         {
+         R[c] += s * RS[c];
+         } // end for
+      } // end for
+
+   return;
+
+   } // End of function DMatrix::AccumulateTo
+
 /*****************************************************************************
 *
 *  DMatrix::Mul
 *
 *  Make the Result matrix the product of the matrices A & B.  The input
-*  matrices must be conformable.
+*  matrices must be conformable.  Result may be A or B.
 *
 *****************************************************************************/
 
@@ -1105,22 +1604,7 @@ bool DMatrix<T, ARRAY>::Mul(DMatrix<T, ARRAY>& Result,
    bool bRet = (A.NumCols() == B.NumRows());
    if (bRet)
       {
-      Result.Resize(A.NumRows(), B.NumCols());
-      
-      // Dot each row of A with each column of B  
-      for (size_t r = 0 ; r < Result.NumRows() ; r++)
-         {
-         T* R = Result[r];
-         const T* RA = A[r];
-         for (size_t c = 0 ; c < Result.NumCols() ; c++)
-            {
-            R[c] = 0;
-            for (size_t i = 0 ; i < A.NumCols() ; i++)
-               {
-               R[c] += RA[i] * B[i][c];
-               } // end for
-            } // end for
-         } // end for
+      Gemm(Result, A, false, B, false);
       } // end if
    
    return (bRet);
@@ -1133,7 +1617,8 @@ bool DMatrix<T, ARRAY>::Mul(DMatrix<T, ARRAY>& Result,
 *
 *  Make this matrix the product of the matrices A transpose & B.  The input
 *  matrices must be conformable.  Faster and less memory than taking the
-*  transpose and then multiplying.
+*  transpose and then multiplying since the transpose is folded into the
+*  packing of A.
 *
 *****************************************************************************/
 
@@ -1145,25 +1630,7 @@ bool DMatrix<T, ARRAY>::MulATransposexB(const DMatrix<T, ARRAY>& A,
    bool bRet = (A.NumRows() == B.NumRows());
    if (bRet)
       {
-      // Make sure dest is conformable
-      if ((NumRows() != A.NumCols()) || (NumCols() != B.NumCols()))
-         {
-         Resize(A.NumCols(), B.NumCols());
-         } // end if
-        
-      for (size_t r = 0 ; r < NumRows() ; r++)
-         {
-         T* R = (*this)[r];
-         for (size_t c = 0 ; c < NumCols() ; c++)
-            {
-            R[c] = 0;
-            for (size_t i = 0 ; i < B.NumRows() ; i++)
-               {
-               R[c] += A[i][r] * B[i][c];
-               } // end for
-            } // end for
-            
-         } // end for
+      Gemm(*this, A, true, B, false);
       } // end if
    
    return (bRet);
@@ -1176,7 +1643,8 @@ bool DMatrix<T, ARRAY>::MulATransposexB(const DMatrix<T, ARRAY>& A,
 *
 *  Make this matrix the product of the matrices A & B transpose.  The input
 *  matrices must be conformable.  Faster and less memory than taking the
-*  transpose and then multiplying.
+*  transpose and then multiplying since the transpose is folded into the
+*  packing of B.
 *
 *****************************************************************************/
 
@@ -1188,26 +1656,7 @@ bool DMatrix<T, ARRAY>::MulAxBTranspose(const DMatrix<T, ARRAY>& A,
    bool bRet = (A.NumCols() == B.NumCols());
    if (bRet)
       {
-      // Make sure dest is conformable
-      if ((NumRows() != A.NumRows()) || (NumCols() != B.NumRows()))
-         {
-         Resize(A.NumRows(), B.NumRows());
-         } // end if
-        
-      for (size_t r = 0 ; r < NumRows() ; r++)
-         {
-         T* R = (*this)[r];
-         const T* RA = A[r];
-         for (size_t c = 0 ; c < NumCols() ; c++)
-            {
-            R[c] = 0;
-            const T* RB = B[c];
-            for (size_t i = 0 ; i < A.NumCols() ; i++)
-               {
-               R[c] += RA[i] * RB[i];
-               } // end for
-            } // end for
-         } // end for
+      Gemm(*this, A, false, B, true);
       } // end if
    
    return (bRet);
@@ -1291,7 +1740,9 @@ void DMatrix<T, ARRAY>::Transpose(const DMatrix<T, ARRAY>& A)
 *  parallel.  For AI, a temporary vector of row pointers is made to track the
 *  pivot row exchanges which means the original vector in the matrix is
 *  intact and the row order doesn't need to be restored at the end of the
-*  process.
+*  process.  Fixed 2x2, 3x3, 4x4 and 6x6 matrices use the unrolled kernels
+*  in DMatrixFixed.h instead and then set A to the Identity to keep the same
+*  contract.
 *
 *****************************************************************************/
 
@@ -1300,7 +1751,15 @@ bool DMatrix<T, ARRAY>::Invert(DMatrix<T, ARRAY>& A, DMatrix<T, ARRAY>& AI)
    {
    // Matrix must be square and bigger than 0
    bool bRet = (A.NumRows() > 0) && A.IsSquare();
-   if (bRet)
+   if (bRet && DMatrixFixed<T, ARRAY>::bEnabled)
+      {
+      bRet = DMatrixFixed<T, ARRAY>::Invert(A.m_A, AI.m_A, A.m_ZeroTest);
+      if (bRet)
+         {
+         A.Identity();
+         } // end if
+      } // end if
+   else if (bRet)
       {
       AI.MakeSameSize(A);
 //      AI.InitRowPtrs();
@@ -1605,4 +2064,89 @@ bool DMatrix<T, ARRAY>::MulVector(DMatrix<T, ARRAY>& A, std::vector<T>& rhs,
 
    } // End of function DMatrix::MulVector 
 
+/*****************************************************************************
+*
+*  DMatrix::Solve
+*
+*  Solve Ax = b without disturbing A or b.  Fixed 2x2, 3x3, 4x4 and 6x6
+*  matrices use the unrolled kernels in DMatrixFixed.h, everything else runs
+*  GaussElim on copies.
+*
+*****************************************************************************/
+
+DMatrixTemplate
+bool DMatrix<T, ARRAY>::Solve(const std::vector<T>& b,
+      std::vector<T>& x) const
+   {
+   bool bRet = IsSquare() && (NumRows() > 0) && (NumCols() == b.size());
+   if (bRet && DMatrixFixed<T, ARRAY>::bEnabled)
+      {
+      x.resize(b.size());
+      bRet = DMatrixFixed<T, ARRAY>::Solve(m_A, &b[0], &x[0], m_ZeroTest);
+      } // end if
+   else if (bRet)
+      {
+      DMatrix<T, ARRAY> A(*this);
+      std::vector<T> bCopy(b);
+      bRet = GaussElim(A, bCopy, x);
+      } // end else
+
+   return (bRet);
+
+   } // End of function DMatrix::Solve
+
+/*****************************************************************************
+*
+*  DMatrix::Determinant
+*
+*  Determinant of a square matrix by elimination with partial pivoting on a
+*  copy, or a closed form for fixed 2x2, 3x3 and 4x4 matrices.  Returns 0 for
+*  matrices that aren't square.
+*
+*****************************************************************************/
+
+DMatrixTemplate
+T DMatrix<T, ARRAY>::Determinant() const
+   {
+   T Det = 0;
+   if (IsSquare() && DMatrixFixed<T, ARRAY>::bEnabled)
+      {
+      Det = DMatrixFixed<T, ARRAY>::Determinant(m_A);
+      } // end if
+   else if (IsSquare() && (NumRows() > 0))
+      {
+      DMatrix<T, ARRAY> A(*this);
+      const size_t n = A.NumRows();
+      Det = 1;
+      for (size_t c = 0 ; (c < n) && (Det != 0) ; c++)
+         {
+         T MaxP;
+         size_t p = A.FindMaxPivot(c, MaxP);
+         if (p != c)
+            {
+            A.SwapRows(c, p);
+            Det = -Det;
+            } // end if
+
+         Det *= MaxP;
+         if (MaxP != 0)
+            {
+            const T* C = A[c];
+            for (size_t r = c + 1 ; r < n ; r++)
+               {
+               T* R = A[r];
+               const T m = R[c] / MaxP;
+               for (size_t j = c ; j < n ; j++)
+                  {
+                  R[j] -= m * C[j];
+                  } // end for
+               } // end for
+            } // end if
+         } // end for
+      } // end else
+
+   return (Det);
+
+   } // End of function DMatrix::Determinant
+
 #endif // __DMATRIX_H__
@@ -0,0 +1,540 @@
+/*****************************************************************************
+******************************* DMatrixBatch.h *******************************
+*****************************************************************************/
+
+#if !defined(__DMATRIXBATCH_H__)
+#define __DMATRIXBATCH_H__
+
+/*
+   A batch of small fixed size matrices stored as a structure of arrays.
+
+   Element (r, c) of every matrix in the batch lives in its own contiguous
+   lane array, so matrix i's element (r, c) is Lane(r, c)[i].  Every kernel
+   is a loop over i doing the same scalar work on each matrix, which the
+   compiler vectorizes across the matrices (4 doubles or 8 floats per AVX
+   register) instead of fighting the tiny inner dimensions of a single 3x3.
+   The lane arrays are padded to a multiple of Lanes so the elementwise
+   loops can run over whole vectors with no scalar tail; the padding
+   matrices are zeros and stay zero.  The storage is cache line aligned so
+   for doubles every lane array starts on a 64 byte boundary.
+
+   The batch converts to and from DMatrix<T, DFixedArray2D<T, ROWS, COLS> >
+   one matrix at a time with Set()/Get() or a whole std::vector at a time
+   with Load()/Store().
+
+   Column vectors are just batches with one column, so a batch of 3x3
+   homographies times a batch of 3-vectors is
+   DMatrixBatch<T, 3, 3>::Mul(H, DMatrixBatch<T, 3, 1>, DMatrixBatch<T, 3, 1>).
+*/
+
+/*****************************************************************************
+******************************  I N C L U D E  *******************************
+*****************************************************************************/
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "DMatrix.h"
+
+/*****************************************************************************
+***************************** class DMatrixBatch *****************************
+*****************************************************************************/
+
+template <typename T, size_t ROWS, size_t COLS>
+class DMatrixBatch
+   {
+   public :
+      typedef DMatrix<T, DFixedArray2D<T, ROWS, COLS> > MatrixType;
+
+      // Lane arrays are padded to a multiple of this many matrices
+      static const size_t Lanes = 8;
+
+      DMatrixBatch() : m_nSize(0), m_nStride(0)
+         {
+         return;
+         }
+
+      explicit DMatrixBatch(size_t nSize) : m_nSize(0), m_nStride(0)
+         {
+         Resize(nSize);
+         return;
+         }
+
+      explicit DMatrixBatch(const std::vector<MatrixType>& Src)
+            : m_nSize(0), m_nStride(0)
+         {
+         Load(Src);
+         return;
+         }
+
+      size_t size() const
+         {
+         return (m_nSize);
+         }
+
+      bool empty() const
+         {
+         return (m_nSize == 0);
+         }
+
+      static size_t NumRows()
+         {
+         return (ROWS);
+         }
+
+      static size_t NumCols()
+         {
+         return (COLS);
+         }
+
+      // Change the number of matrices, keeping the ones that remain
+      void Resize(size_t nSize);
+
+      void clear()
+         {
+         Resize(0);
+         return;
+         }
+
+      // Element (r, c) of every matrix
+      T* Lane(size_t r, size_t c)
+         {
+         return (m_Data.empty() ? nullptr :
+               &m_Data[(r * COLS + c) * m_nStride]);
+         }
+
+      const T* Lane(size_t r, size_t c) const
+         {
+         return (m_Data.empty() ? nullptr :
+               &m_Data[(r * COLS + c) * m_nStride]);
+         }
+
+      // Copy one matrix in or out
+      void Set(size_t i, const MatrixType& M);
+      void Get(size_t i, MatrixType& M) const;
+
+      void Add(const MatrixType& M)
+         {
+         Resize(m_nSize + 1);
+         Set(m_nSize - 1, M);
+         return;
+         }
+
+      // Copy a whole vector of matrices in or out
+      void Load(const std::vector<MatrixType>& Src);
+      void Store(std::vector<MatrixType>& Dst) const;
+
+      // C[i] = A[i] * B[i].  C may be A or B.
+      template <size_t K>
+      static void Mul(const DMatrixBatch<T, ROWS, K>& A,
+            const DMatrixBatch<T, K, COLS>& B, DMatrixBatch<T, ROWS, COLS>& C);
+
+      // Inverse of every matrix.  Valid[i] is set to 0 for singular matrices,
+      // whose inverse is left as zeros.  Inv may be this batch.
+      void Invert(DMatrixBatch<T, ROWS, COLS>& Inv,
+            std::vector<unsigned char>& Valid,
+            T ZeroTest = 100 * std::numeric_limits<T>::epsilon()) const;
+
+      // Determinant of every matrix
+      void Determinant(std::vector<T>& Det) const;
+
+   protected :
+      size_t m_nSize;
+      size_t m_nStride;   // Padded lane length
+      std::vector<T, DAlignedAllocator<T> > m_Data;
+
+   private :
+   };  // End of class DMatrixBatch
+
+template <typename T, size_t ROWS, size_t COLS>
+const size_t DMatrixBatch<T, ROWS, COLS>::Lanes;
+
+/*****************************************************************************
+********************* Class DMatrixBatch Implementation **********************
+*****************************************************************************/
+
+/*****************************************************************************
+*
+*  DMatrixBatch::Resize
+*
+*****************************************************************************/
+
+template <typename T, size_t ROWS, size_t COLS>
+void DMatrixBatch<T, ROWS, COLS>::Resize(size_t nSize)
+   {
+   const size_t nStride = ((nSize + Lanes - 1) / Lanes) * Lanes;
+   if (nStride != m_nStride)
+      {
+      std::vector<T, DAlignedAllocator<T> > Data(ROWS * COLS * nStride,
+            T(0));
+      const size_t nKeep = std::min(nSize, m_nSize);
+      for (size_t e = 0 ; e < ROWS * COLS ; e++)
+         {
+         std::copy(m_Data.begin() + e * m_nStride,
+               m_Data.begin() + e * m_nStride + nKeep,
+               Data.begin() + e * nStride);
+         } // end for
+      m_Data.swap(Data);
+      m_nStride = nStride;
+      } // end if
+   else if (nSize < m_nSize)
+      {
+      // Keep the padding zero
+      for (size_t e = 0 ; e < ROWS * COLS ; e++)
+         {
+         std::fill(m_Data.begin() + e * m_nStride + nSize,
+               m_Data.begin() + e * m_nStride + m_nSize, T(0));
+         } // end for
+      } // end else if
+
+   m_nSize = nSize;
+
+   return;
+
+   } // End of function DMatrixBatch::Resize
+
+/*****************************************************************************
+*
+*  DMatrixBatch::Set / Get
+*
+*****************************************************************************/
+
+template <typename T, size_t ROWS, size_t COLS>
+void DMatrixBatch<T, ROWS, COLS>::Set(size_t i, const MatrixType& M)
+   {
+   for (size_t r = 0 ; r < ROWS ; r++)
+      {
+      const T* R = M[r];
+      for (size_t c = 0 ; c < COLS ; c++)
+         {
+         Lane(r, c)[i] = R[c];
+         } // end for
+      } // end for
+
+   return;
+
+   } // End of function DMatrixBatch::Set
+
+template <typename T, size_t ROWS, size_t COLS>
+void DMatrixBatch<T, ROWS, COLS>::Get(size_t i, MatrixType& M) const
+   {
+   for (size_t r = 0 ; r < ROWS ; r++)
+      {
+      T* R = M[r];
+      for (size_t c = 0 ; c < COLS ; c++)
+         {
+         R[c] = Lane(r, c)[i];
+         } // end for
+      } // end for
+
+   return;
+
+   } // End of function DMatrixBatch::Get
+
+/*****************************************************************************
+*
+*  DMatrixBatch::Load / Store
+*
+*****************************************************************************/
+
+template <typename T, size_t ROWS, size_t COLS>
+void DMatrixBatch<T, ROWS, COLS>::Load(const std::vector<MatrixType>& Src)
+   {
+   Resize(Src.size());
+   for (size_t i = 0 ; i < Src.size() ; i++)
+      {
+      Set(i, Src[i]);
+      } // end for
+
+   return;
+
+   } // End of function DMatrixBatch::Load
+
+template <typename T, size_t ROWS, size_t COLS>
+void DMatrixBatch<T, ROWS, COLS>::Store(std::vector<MatrixType>& Dst) const
+   {
+   Dst.resize(m_nSize);
+   for (size_t i = 0 ; i < m_nSize ; i++)
+      {
+      Get(i, Dst[i]);
+      } // end for
+
+   return;
+
+   } // End of function DMatrixBatch::Store
+
+/*****************************************************************************
+*
+*  DMatrixBatch::Mul
+*
+*  Each element of C is a sum of K lane products, accumulated a whole lane
+*  at a time.
+*
+*****************************************************************************/
+
+template <typename T, size_t ROWS, size_t COLS>
+template <size_t K>
+void DMatrixBatch<T, ROWS, COLS>::Mul(const DMatrixBatch<T, ROWS, K>& A,
+      const DMatrixBatch<T, K, COLS>& B, DMatrixBatch<T, ROWS, COLS>& C)
+   {
+   assert(A.size() == B.size());
+
+   // Write to a scratch batch when C is one of the inputs
+   const bool bAlias = (static_cast<const void*>(&C) ==
+         static_cast<const void*>(&A)) ||
+         (static_cast<const void*>(&C) == static_cast<const void*>(&B));
+   DMatrixBatch<T, ROWS, COLS> Temp;
+   DMatrixBatch<T, ROWS, COLS>& Out = bAlias ? Temp : C;
+   Out.Resize(A.size());
+
+   // Run over the padding too, the lanes are the same length for A, B & C
+   const size_t n = Out.m_nStride;
+   for (size_t r = 0 ; r < ROWS ; r++)
+      {
+      for (size_t c = 0 ; c < COLS ; c++)
+         {
+         T* pC = Out.Lane(r, c);
+         const T* pA = A.Lane(r, 0);
+         const T* pB = B.Lane(0, c);
+         for (size_t i = 0 ; i < n ; i++)
+            {
+            pC[i] = pA[i] * pB[i];
+            } // end for
+         for (size_t k = 1 ; k < K ; k++)
+            {
+            pA = A.Lane(r, k);
+            pB = B.Lane(k, c);
+            for (size_t i = 0 ; i < n ; i++)
+               {
+               pC[i] += pA[i] * pB[i];
+               } // end for
+            } // end for
+         } // end for
+      } // end for
+
+   if (bAlias)
+      {
+      C.m_Data.swap(Temp.m_Data);
+      C.m_nStride = Temp.m_nStride;
+      C.m_nSize = Temp.m_nSize;
+      } // end if
+
+   return;
+
+   } // End of function DMatrixBatch::Mul
+
+/*****************************************************************************
+*
+*  DMatrixBatch::Invert
+*
+*  2x2, 3x3 and 4x4 use the branch free adjugate from DMatrixFixed.h.  The
+*  batch is processed a tile of Lanes matrices at a time: the tile is copied
+*  into local lane arrays, every matrix in it is inverted with no data
+*  dependent branch, and the tile is copied back.  Working on local arrays
+*  means the compiler can prove nothing aliases and vectorizes the loop
+*  across the tile.  Matrices that fail the scale relative IsInvertible()
+*  test are given a zero scale in that loop and redone afterwards with
+*  pivoting, just as DMatrix::Invert would.  Other sizes invert one matrix
+*  at a time with pivoting.
+*
+*****************************************************************************/
+
+template <typename T, size_t ROWS, size_t COLS>
+void DMatrixBatch<T, ROWS, COLS>::Invert(DMatrixBatch<T, ROWS, COLS>& Inv,
+      std::vector<unsigned char>& Valid, T ZeroTest) const
+   {
+   static_assert(ROWS == COLS, "Only square matrices can be inverted");
+   typedef DFixedSquare<T, ROWS> Ops;
+   const size_t N = ROWS;
+
+   const size_t n = m_nSize;
+   Inv.Resize(n);
+   Valid.resize(n);
+
+   // Rows of the tile work array: the input elements, then the output
+   // elements, then 1 for each matrix inverted or 0 if it's still to be
+   // done.  Keeping them in one local array lets the vectorizer see that
+   // nothing overlaps.
+   const size_t nIn = 0;
+   const size_t nOut = N * N;
+   const size_t nDet = 2 * N * N;
+
+   for (size_t i0 = 0 ; i0 < n ; i0 += Lanes)
+      {
+      T Work[2 * ROWS * COLS + 1][Lanes];
+
+      // The lanes are padded so a whole tile can always be read
+      for (size_t e = 0 ; e < N * N ; e++)
+         {
+         const T* pLane = Lane(e / N, e % N) + i0;
+         for (size_t l = 0 ; l < Lanes ; l++)
+            {
+            Work[nIn + e][l] = pLane[l];
+            } // end for
+         } // end for
+
+      if (Ops::bClosedForm)
+         {
+         for (size_t l = 0 ; l < Lanes ; l++)
+            {
+            T A[ROWS][COLS];
+            T Adj[ROWS][COLS];
+            for (size_t r = 0 ; r < N ; r++)
+               {
+               for (size_t c = 0 ; c < N ; c++)
+                  {
+                  A[r][c] = Work[nIn + r * N + c][l];
+                  } // end for
+               } // end for
+
+            // Select before dividing so the division is never conditional
+            const T Det = Ops::Adjugate(A, Adj);
+            const bool bValid = Ops::IsInvertible(A, Det, ZeroTest);
+            const T Scale = (bValid ? T(1) : T(0)) / (bValid ? Det : T(1));
+            Work[nDet][l] = bValid ? T(1) : T(0);
+            for (size_t r = 0 ; r < N ; r++)
+               {
+               for (size_t c = 0 ; c < N ; c++)
+                  {
+                  Work[nOut + r * N + c][l] = Adj[r][c] * Scale;
+                  } // end for
+               } // end for
+            } // end for
+         } // end if
+      else
+         {
+         for (size_t l = 0 ; l < Lanes ; l++)
+            {
+            T A[ROWS][COLS];
+            T AI[ROWS][COLS];
+            for (size_t r = 0 ; r < N ; r++)
+               {
+               for (size_t c = 0 ; c < N ; c++)
+                  {
+                  A[r][c] = Work[nIn + r * N + c][l];
+                  } // end for
+               } // end for
+
+            const bool bValid = Ops::Invert(A, AI, ZeroTest);
+            Work[nDet][l] = bValid ? T(1) : T(0);
+            for (size_t r = 0 ; r < N ; r++)
+               {
+               for (size_t c = 0 ; c < N ; c++)
+                  {
+                  Work[nOut + r * N + c][l] = bValid ? AI[r][c] : T(0);
+                  } // end for
+               } // end for
+            } // end for
+         } // end else
+
+      const size_t nTile = std::min(Lanes, n - i0);
+      if (Ops::bClosedForm)
+         {
+         // Small scale or nearly singular matrices, usually none
+         for (size_t l = 0 ; l < nTile ; l++)
+            {
+            if (Work[nDet][l] == 0)
+               {
+               T A[ROWS][COLS];
+               T AI[ROWS][COLS];
+               for (size_t r = 0 ; r < N ; r++)
+                  {
+                  for (size_t c = 0 ; c < N ; c++)
+                     {
+                     A[r][c] = Work[nIn + r * N + c][l];
+                     } // end for
+                  } // end for
+
+               const bool bValid = Ops::Invert(A, AI, ZeroTest);
+               Work[nDet][l] = bValid ? T(1) : T(0);
+               for (size_t r = 0 ; r < N ; r++)
+                  {
+                  for (size_t c = 0 ; c < N ; c++)
+                     {
+                     Work[nOut + r * N + c][l] = bValid ? AI[r][c] : T(0);
+                     } // end for
+                  } // end for
+               } // end if
+            } // end for
+         } // end if
+
+      for (size_t e = 0 ; e < N * N ; e++)
+         {
+         T* pLane = Inv.Lane(e / N, e % N) + i0;
+         for (size_t l = 0 ; l < nTile ; l++)
+            {
+            pLane[l] = Work[nOut + e][l];
+            } // end for
+         } // end for
+      for (size_t l = 0 ; l < nTile ; l++)
+         {
+         // Singular matrices were given a zero inverse
+         Valid[i0 + l] = (Work[nDet][l] != 0) ? 1 : 0;
+         } // end for
+      } // end for
+
+   return;
+
+   } // End of function DMatrixBatch::Invert
+
+/*****************************************************************************
+*
+*  DMatrixBatch::Determinant
+*
+*  Tiled the same way as Invert() so the closed form determinants of a
+*  whole tile are computed in lockstep.  Other sizes pivot, which branches
+*  on the data, so the loop over the tile doesn't vectorize for them.
+*
+*****************************************************************************/
+
+template <typename T, size_t ROWS, size_t COLS>
+void DMatrixBatch<T, ROWS, COLS>::Determinant(std::vector<T>& Det) const
+   {
+   static_assert(ROWS == COLS, "Only square matrices have determinants");
+   typedef DFixedSquare<T, ROWS> Ops;
+   const size_t N = ROWS;
+
+   const size_t n = m_nSize;
+   Det.resize(n);
+
+   for (size_t i0 = 0 ; i0 < n ; i0 += Lanes)
+      {
+      T Work[ROWS * COLS][Lanes];
+      T TileDet[Lanes];
+
+      // The lanes are padded so a whole tile can always be read
+      for (size_t e = 0 ; e < N * N ; e++)
+         {
+         const T* pLane = Lane(e / N, e % N) + i0;
+         for (size_t l = 0 ; l < Lanes ; l++)
+            {
+            Work[e][l] = pLane[l];
+            } // end for
+         } // end for
+
+      for (size_t l = 0 ; l < Lanes ; l++)
+         {
+         T A[ROWS][COLS];
+         for (size_t r = 0 ; r < N ; r++)
+            {
+            for (size_t c = 0 ; c < N ; c++)
+               {
+               A[r][c] = Work[r * N + c][l];
+               } // end for
+            } // end for
+         TileDet[l] = Ops::Determinant(A);
+         } // end for
+
+      const size_t nTile = std::min(Lanes, n - i0);
+      for (size_t l = 0 ; l < nTile ; l++)
+         {
+         Det[i0 + l] = TileDet[l];
+         } // end for
+      } // end for
+
+   return;
+
+   } // End of function DMatrixBatch::Determinant
+
+#endif // __DMATRIXBATCH_H__
@@ -0,0 +1,159 @@
+/*****************************************************************************
+********************************* DMatrixCV.h ********************************
+*****************************************************************************/
+
+#if !defined(__DMATRIXCV_H__)
+#define __DMATRIXCV_H__
+
+/*
+   Moving matrices between DMatrix and OpenCV's cv::Mat.
+
+   cvMatToDMatrixView() and DMatrixToCvMat() share the elements rather than
+   copying them.  The DMatrix becomes a view of the cv::Mat's rows, stride
+   and all, or the cv::Mat header points at the DMatrix storage.  Neither
+   side keeps the other alive, so the owner of the elements must outlive
+   the view.  For example, to use a calibration's camera matrix without
+   copying it
+
+      DMatrix<double, DArray2D<double> > K;
+      cv::Mat CameraMatrix = Calibration.GetCameraMatrix();
+      cvMatToDMatrixView(CameraMatrix, K);
+
+   A DMatrix whose rows have been swapped by pointer, after GaussElim for
+   instance, has no single stride for OpenCV to use and DMatrixToCvMat()
+   falls back to a copy.  cvMatToDMatrix() always copies, a row at a time,
+   converting the element type if necessary, and works with any DMatrix
+   storage including the fixed size arrays.
+
+   Only single channel 2D cv::Mats are handled.
+*/
+
+/*****************************************************************************
+******************************  I N C L U D E  *******************************
+*****************************************************************************/
+
+#include <algorithm>
+#include <opencv2/core.hpp>
+#include "DMatrix.h"
+
+/*****************************************************************************
+*
+*  cvMatToDMatrixView
+*
+*  Make MatOut a view of MatIn's elements.  Fails, leaving MatOut alone, if
+*  MatIn isn't a single channel matrix of T.
+*
+*****************************************************************************/
+
+template <typename T, typename ALLOC, bool PAD>
+bool cvMatToDMatrixView(cv::Mat& MatIn,
+      DMatrix<T, DArray2D<T, ALLOC, PAD> >& MatOut)
+   {
+   bool bRet = (MatIn.dims == 2) && (MatIn.type() == cv::DataType<T>::type) &&
+         ((MatIn.step[0] % sizeof(T)) == 0);
+   if (bRet)
+      {
+      MatOut.Attach(MatIn.ptr<T>(0), MatIn.rows, MatIn.cols,
+            MatIn.step[0] / sizeof(T));
+      } // end if
+
+   return (bRet);
+
+   } // End of function cvMatToDMatrixView
+
+/*****************************************************************************
+*
+*  cvMatToDMatrix
+*
+*  Copy MatIn into MatOut.  The element type is converted by OpenCV first
+*  if it isn't T.
+*
+*****************************************************************************/
+
+template <typename T, typename ARRAY>
+bool cvMatToDMatrix(const cv::Mat& MatIn, DMatrix<T, ARRAY>& MatOut)
+   {
+   bool bRet = (MatIn.dims == 2) && (MatIn.channels() == 1);
+   if (bRet)
+      {
+      cv::Mat Converted;
+      const cv::Mat* pSrc = &MatIn;
+      if (MatIn.depth() != cv::DataType<T>::depth)
+         {
+         MatIn.convertTo(Converted, cv::DataType<T>::depth);
+         pSrc = &Converted;
+         } // end if
+
+      MatOut.Resize(pSrc->rows, pSrc->cols);
+      bRet = (MatOut.NumRows() == static_cast<size_t>(pSrc->rows)) &&
+            (MatOut.NumCols() == static_cast<size_t>(pSrc->cols));
+      for (int r = 0 ; bRet && (r < pSrc->rows) ; r++)
+         {
+         const T* pRow = pSrc->ptr<T>(r);
+         std::copy(pRow, pRow + pSrc->cols, MatOut[r]);
+         } // end for
+      } // end if
+
+   return (bRet);
+
+   } // End of function cvMatToDMatrix
+
+/*****************************************************************************
+*
+*  DMatrixToCvMat
+*
+*  A cv::Mat header over MatIn's storage, or a copy if bCloneData is set or
+*  MatIn's rows aren't laid out at a single stride.
+*
+*****************************************************************************/
+
+template <typename T, typename ARRAY>
+cv::Mat DMatrixToCvMat(DMatrix<T, ARRAY>& MatIn, bool bCloneData = false)
+   {
+   const int nRows = static_cast<int>(MatIn.NumRows());
+   const int nCols = static_cast<int>(MatIn.NumCols());
+
+   cv::Mat MatOut;
+   if (!bCloneData && MatIn.IsContiguous() && (MatIn.Data() != nullptr))
+      {
+      MatOut = cv::Mat(nRows, nCols, cv::DataType<T>::type, MatIn.Data(),
+            MatIn.RowStride() * sizeof(T));
+      } // end if
+   else
+      {
+      MatOut.create(nRows, nCols, cv::DataType<T>::type);
+      for (int r = 0 ; r < nRows ; r++)
+         {
+         std::copy(MatIn[r], MatIn[r] + nCols, MatOut.ptr<T>(r));
+         } // end for
+      } // end else
+
+   return (MatOut);
+
+   } // End of function DMatrixToCvMat
+
+/*****************************************************************************
+*
+*  DMatrixToCvMat
+*
+*  A const matrix can't be shared writably so it's always copied.
+*
+*****************************************************************************/
+
+template <typename T, typename ARRAY>
+cv::Mat DMatrixToCvMat(const DMatrix<T, ARRAY>& MatIn)
+   {
+   const int nRows = static_cast<int>(MatIn.NumRows());
+   const int nCols = static_cast<int>(MatIn.NumCols());
+
+   cv::Mat MatOut(nRows, nCols, cv::DataType<T>::type);
+   for (int r = 0 ; r < nRows ; r++)
+      {
+      std::copy(MatIn[r], MatIn[r] + nCols, MatOut.ptr<T>(r));
+      } // end for
+
+   return (MatOut);
+
+   } // End of function DMatrixToCvMat
+
+#endif // __DMATRIXCV_H__
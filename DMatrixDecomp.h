@@ -0,0 +1,950 @@
+/*****************************************************************************
+******************************* DMatrixDecomp.h ******************************
+*****************************************************************************/
+
+#if !defined(__DMATRIXDECOMP_H__)
+#define __DMATRIXDECOMP_H__
+
+/*
+   Matrix factorizations that are computed once and then reused to solve
+   any number of right hand sides.
+
+      DLUDecomp        PA = LU with partial pivoting, general square A
+      DCholeskyDecomp  A = LL' for symmetric positive definite A
+      DQRDecomp        A = QR by Householder reflections, m >= n, used for
+                       least squares
+
+   Unlike DMatrix::GaussElim and DMatrix::Invert the source matrix is left
+   untouched.  The factors are held in a private contiguous buffer so any
+   DMatrix storage type can be factored.
+
+   Right hand sides are the columns of a matrix B and are solved together.
+   The triangular solves are blocked: each NB x NB diagonal block is solved
+   directly with the inner loops running along the rows of X (all right
+   hand sides at once) and the remaining rows are updated with a single
+   DGemm call per block.  Solving thousands of right hand sides against the
+   same normal matrix is therefore one pass of GEMMs rather than thousands
+   of separate substitutions.
+*/
+
+/*****************************************************************************
+******************************  I N C L U D E  *******************************
+*****************************************************************************/
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "DMatrix.h"
+
+/*****************************************************************************
+***************************** class DTriangular ******************************
+*****************************************************************************/
+
+// Blocked triangular solves with multiple right hand sides.  X (n x m) holds
+// the right hand sides on entry and the solutions on exit.
+
+template <typename T>
+class DTriangular
+   {
+   public :
+      // Diagonal block size
+      static const size_t NB = 64;
+
+      // L X = B, L lower triangular
+      static void SolveLower(size_t n, size_t m, const DGemmRows<const T>& L,
+            bool bUnitDiagonal, const DGemmRows<T>& X);
+
+      // U X = B, U upper triangular.  With bLowerTranspose U is taken to be
+      // the transpose of the lower triangular matrix passed in.
+      static void SolveUpper(size_t n, size_t m, const DGemmRows<const T>& U,
+            bool bLowerTranspose, bool bUnitDiagonal, const DGemmRows<T>& X);
+
+   protected :
+   private :
+   };  // End of class DTriangular
+
+template <typename T> const size_t DTriangular<T>::NB;
+
+/*****************************************************************************
+*
+*  DTriangular::SolveLower
+*
+*  Forward substitution a diagonal block at a time.  After each block is
+*  solved its contribution is removed from all of the rows below it with one
+*  GEMM.
+*
+*****************************************************************************/
+
+template <typename T>
+void DTriangular<T>::SolveLower(size_t n, size_t m,
+      const DGemmRows<const T>& L, bool bUnitDiagonal, const DGemmRows<T>& X)
+   {
+   for (size_t i0 = 0 ; i0 < n ; i0 += NB)
+      {
+      const size_t i1 = std::min(n, i0 + NB);
+
+      for (size_t i = i0 ; i < i1 ; i++)
+         {
+         T* Xi = X[i];
+         const T* Li = L[i];
+         for (size_t k = i0 ; k < i ; k++)
+            {
+            const T l = Li[k];
+            const T* Xk = X[k];
+            for (size_t j = 0 ; j < m ; j++)
+               {
+               Xi[j] -= l * Xk[j];
+               } // end for
+            } // end for
+
+         if (!bUnitDiagonal)
+            {
+            const T d = 1 / Li[i];
+            for (size_t j = 0 ; j < m ; j++)
+               {
+               Xi[j] *= d;
+               } // end for
+            } // end if
+         } // end for
+
+      if (i1 < n)
+         {
+         // X[i1:n] -= L[i1:n, i0:i1] * X[i0:i1]
+         std::vector<const T*> Rows(i1 - i0);
+         for (size_t k = 0 ; k < Rows.size() ; k++)
+            {
+            Rows[k] = X[i0 + k];
+            } // end for
+         DGemm<T>::Multiply(n - i1, m, i1 - i0, L.Block(i1, i0), false,
+               DGemmRows<const T>(&Rows[0]), false, X.Block(i1, 0), -1,
+               true);
+         } // end if
+      } // end for
+
+   return;
+
+   } // End of function DTriangular::SolveLower
+
+/*****************************************************************************
+*
+*  DTriangular::SolveUpper
+*
+*  Back substitution a diagonal block at a time from the bottom up.
+*
+*****************************************************************************/
+
+template <typename T>
+void DTriangular<T>::SolveUpper(size_t n, size_t m,
+      const DGemmRows<const T>& U, bool bLowerTranspose, bool bUnitDiagonal,
+      const DGemmRows<T>& X)
+   {
+   for (size_t i1 = n ; i1 > 0 ; )
+      {
+      const size_t i0 = (i1 > NB) ? i1 - NB : 0;
+
+      for (size_t i = i1 ; i-- > i0 ; )
+         {
+         T* Xi = X[i];
+         for (size_t k = i + 1 ; k < i1 ; k++)
+            {
+            const T u = bLowerTranspose ? U[k][i] : U[i][k];
+            const T* Xk = X[k];
+            for (size_t j = 0 ; j < m ; j++)
+               {
+               Xi[j] -= u * Xk[j];
+               } // end for
+            } // end for
+
+         if (!bUnitDiagonal)
+            {
+            const T d = 1 / U[i][i];
+            for (size_t j = 0 ; j < m ; j++)
+               {
+               Xi[j] *= d;
+               } // end for
+            } // end if
+         } // end for
+
+      if (i0 > 0)
+         {
+         // X[0:i0] -= U[0:i0, i0:i1] * X[i0:i1].  For the transposed lower
+         // case that block of U is the transpose of L[i0:i1, 0:i0].
+         std::vector<const T*> Rows(i1 - i0);
+         for (size_t k = 0 ; k < Rows.size() ; k++)
+            {
+            Rows[k] = X[i0 + k];
+            } // end for
+         DGemm<T>::Multiply(i0, m, i1 - i0,
+               bLowerTranspose ? U.Block(i0, 0) : U.Block(0, i0),
+               bLowerTranspose, DGemmRows<const T>(&Rows[0]), false, X, -1,
+               true);
+         } // end if
+
+      i1 = i0;
+      } // end for
+
+   return;
+
+   } // End of function DTriangular::SolveUpper
+
+/*****************************************************************************
+****************************** class DDecompBase *****************************
+*****************************************************************************/
+
+// Storage and right hand side plumbing shared by the factorizations
+
+template <typename T>
+class DDecompBase
+   {
+   public :
+      DDecompBase() : m_nRows(0), m_nCols(0), m_bValid(false),
+            m_ZeroTest(100 * std::numeric_limits<T>::epsilon())
+         {
+         return;
+         }
+
+      // True if the last Factor() succeeded
+      bool IsValid() const
+         {
+         return (m_bValid);
+         }
+
+      size_t NumRows() const
+         {
+         return (m_nRows);
+         }
+
+      size_t NumCols() const
+         {
+         return (m_nCols);
+         }
+
+   protected :
+      size_t m_nRows;
+      size_t m_nCols;
+      std::vector<T> m_F;  // Factors, row major
+      bool m_bValid;
+      T m_ZeroTest;
+
+      T* Row(size_t r)
+         {
+         return (&m_F[r * m_nCols]);
+         }
+
+      const T* Row(size_t r) const
+         {
+         return (&m_F[r * m_nCols]);
+         }
+
+      DGemmRows<const T> Factors() const
+         {
+         return (DGemmRows<const T>(m_F.empty() ? nullptr : &m_F[0],
+               m_nCols));
+         }
+
+      // Copy A into the factor buffer
+      template <typename ARRAY>
+      void Load(const DMatrix<T, ARRAY>& A)
+         {
+         m_nRows = A.NumRows();
+         m_nCols = A.NumCols();
+         m_ZeroTest = A.GetZeroTest();
+         m_F.resize(m_nRows * m_nCols);
+         for (size_t r = 0 ; r < m_nRows ; r++)
+            {
+            std::copy(A[r], A[r] + m_nCols, Row(r));
+            } // end for
+         m_bValid = false;
+         return;
+         }
+
+      // Copy the rows of B into a contiguous work buffer, row r of the work
+      // coming from row pPerm[r] of B when a permutation is given
+      template <typename ARRAY>
+      static void LoadRHS(const DMatrix<T, ARRAY>& B, size_t nRows,
+            const size_t* pPerm, std::vector<T>& Work)
+         {
+         const size_t m = B.NumCols();
+         Work.resize(nRows * m);
+         for (size_t r = 0 ; r < B.NumRows() ; r++)
+            {
+            const T* RB = B[pPerm ? pPerm[r] : r];
+            std::copy(RB, RB + m, &Work[r * m]);
+            } // end for
+         return;
+         }
+
+      // Copy the first nRows rows of the work buffer into X
+      template <typename ARRAY>
+      static void StoreSolution(const std::vector<T>& Work, size_t nRows,
+            size_t m, DMatrix<T, ARRAY>& X)
+         {
+         X.Resize(nRows, m);
+         for (size_t r = 0 ; r < nRows ; r++)
+            {
+            std::copy(&Work[r * m], &Work[r * m] + m, X[r]);
+            } // end for
+         return;
+         }
+
+   private :
+   };  // End of class DDecompBase
+
+/*****************************************************************************
+****************************** class DLUDecomp *******************************
+*****************************************************************************/
+
+template <typename T>
+class DLUDecomp : public DDecompBase<T>
+   {
+   protected :
+      typedef DDecompBase<T> BASE;
+
+   public :
+      DLUDecomp() : m_nSign(1)
+         {
+         return;
+         }
+
+      template <typename ARRAY>
+      explicit DLUDecomp(const DMatrix<T, ARRAY>& A) : m_nSign(1)
+         {
+         Factor(A);
+         return;
+         }
+
+      // Factor a square matrix.  Fails if A is singular.
+      template <typename ARRAY>
+      bool Factor(const DMatrix<T, ARRAY>& A);
+
+      // Solve A X = B for every column of B
+      template <typename ARRAY>
+      bool Solve(const DMatrix<T, ARRAY>& B, DMatrix<T, ARRAY>& X) const;
+
+      // Solve A x = b
+      bool Solve(const std::vector<T>& b, std::vector<T>& x) const;
+
+      // AI = inverse of A
+      template <typename ARRAY>
+      bool Invert(DMatrix<T, ARRAY>& AI) const;
+
+      T Determinant() const;
+
+   protected :
+      // Row r of LU came from row m_Perm[r] of A
+      std::vector<size_t> m_Perm;
+      int m_nSign;
+
+      bool SolveWork(std::vector<T>& Work, size_t m) const;
+
+   private :
+   };  // End of class DLUDecomp
+
+/*****************************************************************************
+*
+*  DLUDecomp::Factor
+*
+*  Doolittle elimination with partial pivoting.  The multipliers overwrite
+*  the eliminated elements so L (unit diagonal) and U share the buffer.  Rows
+*  are exchanged physically to keep the storage contiguous for the solves.
+*
+*****************************************************************************/
+
+template <typename T>
+template <typename ARRAY>
+bool DLUDecomp<T>::Factor(const DMatrix<T, ARRAY>& A)
+   {
+   BASE::Load(A);
+   const size_t n = A.NumRows();
+   bool bRet = A.IsSquare() && (n > 0);
+
+   m_Perm.resize(n);
+   for (size_t i = 0 ; i < n ; i++)
+      {
+      m_Perm[i] = i;
+      } // end for
+   m_nSign = 1;
+
+   for (size_t c = 0 ; bRet && (c < n) ; c++)
+      {
+      // Find the pivot
+      size_t nPivotRow = c;
+      T MaxPivot = std::abs(BASE::Row(c)[c]);
+      for (size_t r = c + 1 ; r < n ; r++)
+         {
+         const T Test = std::abs(BASE::Row(r)[c]);
+         if (Test > MaxPivot)
+            {
+            MaxPivot = Test;
+            nPivotRow = r;
+            } // end if
+         } // end for
+
+      bRet = (MaxPivot > BASE::m_ZeroTest);
+      if (bRet)
+         {
+         if (nPivotRow != c)
+            {
+            std::swap_ranges(BASE::Row(c), BASE::Row(c) + n,
+                  BASE::Row(nPivotRow));
+            std::swap(m_Perm[c], m_Perm[nPivotRow]);
+            m_nSign = -m_nSign;
+            } // end if
+
+         // Eliminate below the pivot
+         const T* P = BASE::Row(c);
+         const T Inv = 1 / P[c];
+         for (size_t r = c + 1 ; r < n ; r++)
+            {
+            T* R = BASE::Row(r);
+            const T m = R[c] * Inv;
+            R[c] = m;
+            if (m != 0)
+               {
+               for (size_t j = c + 1 ; j < n ; j++)
+                  {
+                  R[j] -= m * P[j];
+                  } // end for
+               } // end if
+            } // end for
+         } // end if
+      } // end for
+
+   BASE::m_bValid = bRet;
+
+   return (bRet);
+
+   } // End of function DLUDecomp::Factor
+
+/*****************************************************************************
+*
+*  DLUDecomp::SolveWork
+*
+*  Solve in place on a permuted, contiguous n x m set of right hand sides.
+*
+*****************************************************************************/
+
+template <typename T>
+bool DLUDecomp<T>::SolveWork(std::vector<T>& Work, size_t m) const
+   {
+   const size_t n = BASE::m_nRows;
+   if (m > 0)
+      {
+      DGemmRows<T> X(&Work[0], m);
+      DTriangular<T>::SolveLower(n, m, BASE::Factors(), true, X);
+      DTriangular<T>::SolveUpper(n, m, BASE::Factors(), false, false, X);
+      } // end if
+
+   return (true);
+
+   } // End of function DLUDecomp::SolveWork
+
+/*****************************************************************************
+*
+*  DLUDecomp::Solve
+*
+*****************************************************************************/
+
+template <typename T>
+template <typename ARRAY>
+bool DLUDecomp<T>::Solve(const DMatrix<T, ARRAY>& B,
+      DMatrix<T, ARRAY>& X) const
+   {
+   bool bRet = BASE::m_bValid && (B.NumRows() == BASE::m_nRows);
+   if (bRet)
+      {
+      std::vector<T> Work;
+      BASE::LoadRHS(B, BASE::m_nRows, &m_Perm[0], Work);
+      bRet = SolveWork(Work, B.NumCols());
+      BASE::StoreSolution(Work, BASE::m_nRows, B.NumCols(), X);
+      } // end if
+
+   return (bRet);
+
+   } // End of function DLUDecomp::Solve
+
+template <typename T>
+bool DLUDecomp<T>::Solve(const std::vector<T>& b, std::vector<T>& x) const
+   {
+   bool bRet = BASE::m_bValid && (b.size() == BASE::m_nRows);
+   if (bRet)
+      {
+      std::vector<T> Work(b.size());
+      for (size_t r = 0 ; r < b.size() ; r++)
+         {
+         Work[r] = b[m_Perm[r]];
+         } // end for
+      bRet = SolveWork(Work, 1);
+      x.swap(Work);
+      } // end if
+
+   return (bRet);
+
+   } // End of function DLUDecomp::Solve
+
+/*****************************************************************************
+*
+*  DLUDecomp::Invert
+*
+*  Solve against the identity.
+*
+*****************************************************************************/
+
+template <typename T>
+template <typename ARRAY>
+bool DLUDecomp<T>::Invert(DMatrix<T, ARRAY>& AI) const
+   {
+   bool bRet = BASE::m_bValid;
+   if (bRet)
+      {
+      const size_t n = BASE::m_nRows;
+      std::vector<T> Work(n * n, T(0));
+      for (size_t r = 0 ; r < n ; r++)
+         {
+         Work[r * n + m_Perm[r]] = 1;
+         } // end for
+      bRet = SolveWork(Work, n);
+      BASE::StoreSolution(Work, n, n, AI);
+      } // end if
+
+   return (bRet);
+
+   } // End of function DLUDecomp::Invert
+
+/*****************************************************************************
+*
+*  DLUDecomp::Determinant
+*
+*****************************************************************************/
+
+template <typename T>
+T DLUDecomp<T>::Determinant() const
+   {
+   T Det = 0;
+   if (BASE::m_bValid)
+      {
+      Det = static_cast<T>(m_nSign);
+      for (size_t i = 0 ; i < BASE::m_nRows ; i++)
+         {
+         Det *= BASE::Row(i)[i];
+         } // end for
+      } // end if
+
+   return (Det);
+
+   } // End of function DLUDecomp::Determinant
+
+/*****************************************************************************
+*************************** class DCholeskyDecomp ****************************
+*****************************************************************************/
+
+template <typename T>
+class DCholeskyDecomp : public DDecompBase<T>
+   {
+   protected :
+      typedef DDecompBase<T> BASE;
+
+   public :
+      DCholeskyDecomp()
+         {
+         return;
+         }
+
+      template <typename ARRAY>
+      explicit DCholeskyDecomp(const DMatrix<T, ARRAY>& A)
+         {
+         Factor(A);
+         return;
+         }
+
+      // Factor a symmetric positive definite matrix.  Only the lower
+      // triangle of A is read.  Fails if A isn't positive definite.
+      template <typename ARRAY>
+      bool Factor(const DMatrix<T, ARRAY>& A);
+
+      // Solve A X = B for every column of B
+      template <typename ARRAY>
+      bool Solve(const DMatrix<T, ARRAY>& B, DMatrix<T, ARRAY>& X) const;
+
+      // Solve A x = b
+      bool Solve(const std::vector<T>& b, std::vector<T>& x) const;
+
+      // AI = inverse of A
+      template <typename ARRAY>
+      bool Invert(DMatrix<T, ARRAY>& AI) const;
+
+   protected :
+      bool SolveWork(std::vector<T>& Work, size_t m) const;
+
+   private :
+   };  // End of class DCholeskyDecomp
+
+/*****************************************************************************
+*
+*  DCholeskyDecomp::Factor
+*
+*  Row oriented Cholesky-Banachiewicz.  Every inner product runs along two
+*  rows of L.  The upper triangle is zeroed so the buffer holds exactly L.
+*
+*****************************************************************************/
+
+template <typename T>
+template <typename ARRAY>
+bool DCholeskyDecomp<T>::Factor(const DMatrix<T, ARRAY>& A)
+   {
+   BASE::Load(A);
+   const size_t n = A.NumRows();
+   bool bRet = A.IsSquare() && (n > 0);
+
+   for (size_t i = 0 ; bRet && (i < n) ; i++)
+      {
+      T* Li = BASE::Row(i);
+      for (size_t j = 0 ; j <= i ; j++)
+         {
+         const T* Lj = BASE::Row(j);
+         T Sum = Li[j];
+         for (size_t k = 0 ; k < j ; k++)
+            {
+            Sum -= Li[k] * Lj[k];
+            } // end for
+
+         if (j == i)
+            {
+            bRet = (Sum > BASE::m_ZeroTest);
+            Li[i] = bRet ? std::sqrt(Sum) : T(0);
+            } // end if
+         else
+            {
+            Li[j] = Sum / Lj[j];
+            } // end else
+         } // end for
+
+      std::fill(Li + i + 1, Li + n, T(0));
+      } // end for
+
+   BASE::m_bValid = bRet;
+
+   return (bRet);
+
+   } // End of function DCholeskyDecomp::Factor
+
+/*****************************************************************************
+*
+*  DCholeskyDecomp::SolveWork
+*
+*  L Y = B then L' X = Y, in place on an n x m set of right hand sides.
+*
+*****************************************************************************/
+
+template <typename T>
+bool DCholeskyDecomp<T>::SolveWork(std::vector<T>& Work, size_t m) const
+   {
+   const size_t n = BASE::m_nRows;
+   if (m > 0)
+      {
+      DGemmRows<T> X(&Work[0], m);
+      DTriangular<T>::SolveLower(n, m, BASE::Factors(), false, X);
+      DTriangular<T>::SolveUpper(n, m, BASE::Factors(), true, false, X);
+      } // end if
+
+   return (true);
+
+   } // End of function DCholeskyDecomp::SolveWork
+
+/*****************************************************************************
+*
+*  DCholeskyDecomp::Solve
+*
+*****************************************************************************/
+
+template <typename T>
+template <typename ARRAY>
+bool DCholeskyDecomp<T>::Solve(const DMatrix<T, ARRAY>& B,
+      DMatrix<T, ARRAY>& X) const
+   {
+   bool bRet = BASE::m_bValid && (B.NumRows() == BASE::m_nRows);
+   if (bRet)
+      {
+      std::vector<T> Work;
+      BASE::LoadRHS(B, BASE::m_nRows, nullptr, Work);
+      bRet = SolveWork(Work, B.NumCols());
+      BASE::StoreSolution(Work, BASE::m_nRows, B.NumCols(), X);
+      } // end if
+
+   return (bRet);
+
+   } // End of function DCholeskyDecomp::Solve
+
+template <typename T>
+bool DCholeskyDecomp<T>::Solve(const std::vector<T>& b,
+      std::vector<T>& x) const
+   {
+   bool bRet = BASE::m_bValid && (b.size() == BASE::m_nRows);
+   if (bRet)
+      {
+      std::vector<T> Work(b);
+      bRet = SolveWork(Work, 1);
+      x.swap(Work);
+      } // end if
+
+   return (bRet);
+
+   } // End of function DCholeskyDecomp::Solve
+
+/*****************************************************************************
+*
+*  DCholeskyDecomp::Invert
+*
+*****************************************************************************/
+
+template <typename T>
+template <typename ARRAY>
+bool DCholeskyDecomp<T>::Invert(DMatrix<T, ARRAY>& AI) const
+   {
+   bool bRet = BASE::m_bValid;
+   if (bRet)
+      {
+      const size_t n = BASE::m_nRows;
+      std::vector<T> Work(n * n, T(0));
+      for (size_t r = 0 ; r < n ; r++)
+         {
+         Work[r * n + r] = 1;
+         } // end for
+      bRet = SolveWork(Work, n);
+      BASE::StoreSolution(Work, n, n, AI);
+      } // end if
+
+   return (bRet);
+
+   } // End of function DCholeskyDecomp::Invert
+
+/*****************************************************************************
+****************************** class DQRDecomp *******************************
+*****************************************************************************/
+
+template <typename T>
+class DQRDecomp : public DDecompBase<T>
+   {
+   protected :
+      typedef DDecompBase<T> BASE;
+
+   public :
+      DQRDecomp()
+         {
+         return;
+         }
+
+      template <typename ARRAY>
+      explicit DQRDecomp(const DMatrix<T, ARRAY>& A)
+         {
+         Factor(A);
+         return;
+         }
+
+      // Factor an m x n matrix with m >= n.  Fails if A is rank deficient.
+      template <typename ARRAY>
+      bool Factor(const DMatrix<T, ARRAY>& A);
+
+      // Least squares solution of A X = B for every column of B.  X is
+      // n x B.NumCols().
+      template <typename ARRAY>
+      bool Solve(const DMatrix<T, ARRAY>& B, DMatrix<T, ARRAY>& X) const;
+
+      // Least squares solution of A x = b
+      bool Solve(const std::vector<T>& b, std::vector<T>& x) const;
+
+   protected :
+      // Householder scale factors, H(j) = I - tau v v'
+      std::vector<T> m_Tau;
+
+      bool SolveWork(std::vector<T>& Work, size_t m) const;
+
+   private :
+   };  // End of class DQRDecomp
+
+/*****************************************************************************
+*
+*  DQRDecomp::Factor
+*
+*  Householder QR stored LAPACK style: R on and above the diagonal and each
+*  reflector v below it with an implicit leading 1.  Reflectors are applied
+*  to the trailing columns a row at a time so the inner loops are unit
+*  stride.
+*
+*****************************************************************************/
+
+template <typename T>
+template <typename ARRAY>
+bool DQRDecomp<T>::Factor(const DMatrix<T, ARRAY>& A)
+   {
+   BASE::Load(A);
+   const size_t m = A.NumRows();
+   const size_t n = A.NumCols();
+   bool bRet = (m >= n) && (n > 0);
+
+   m_Tau.assign(n, T(0));
+   std::vector<T> w(n);
+
+   for (size_t j = 0 ; bRet && (j < n) ; j++)
+      {
+      T Norm = 0;
+      for (size_t i = j ; i < m ; i++)
+         {
+         const T x = BASE::Row(i)[j];
+         Norm += x * x;
+         } // end for
+      Norm = std::sqrt(Norm);
+
+      bRet = (Norm > BASE::m_ZeroTest);
+      if (bRet)
+         {
+         T* Rj = BASE::Row(j);
+         const T Alpha = (Rj[j] >= 0) ? -Norm : Norm;
+         const T v0 = Rj[j] - Alpha;
+         Rj[j] = Alpha;
+         for (size_t i = j + 1 ; i < m ; i++)
+            {
+            BASE::Row(i)[j] /= v0;
+            } // end for
+         const T Tau = -v0 / Alpha;
+         m_Tau[j] = Tau;
+
+         // w = v' A[j:m, j+1:n]
+         for (size_t c = j + 1 ; c < n ; c++)
+            {
+            w[c] = Rj[c];
+            } // end for
+         for (size_t i = j + 1 ; i < m ; i++)
+            {
+            const T* Ri = BASE::Row(i);
+            const T vi = Ri[j];
+            for (size_t c = j + 1 ; c < n ; c++)
+               {
+               w[c] += vi * Ri[c];
+               } // end for
+            } // end for
+
+         // A -= tau v w'
+         for (size_t c = j + 1 ; c < n ; c++)
+            {
+            w[c] *= Tau;
+            Rj[c] -= w[c];
+            } // end for
+         for (size_t i = j + 1 ; i < m ; i++)
+            {
+            T* Ri = BASE::Row(i);
+            const T vi = Ri[j];
+            for (size_t c = j + 1 ; c < n ; c++)
+               {
+               Ri[c] -= vi * w[c];
+               } // end for
+            } // end for
+         } // end if
+      } // end for
+
+   BASE::m_bValid = bRet;
+
+   return (bRet);
+
+   } // End of function DQRDecomp::Factor
+
+/*****************************************************************************
+*
+*  DQRDecomp::SolveWork
+*
+*  Apply Q' to the m x k right hand sides in place, then back solve the top
+*  n rows against R.
+*
+*****************************************************************************/
+
+template <typename T>
+bool DQRDecomp<T>::SolveWork(std::vector<T>& Work, size_t k) const
+   {
+   const size_t m = BASE::m_nRows;
+   const size_t n = BASE::m_nCols;
+   if (k > 0)
+      {
+      std::vector<T> w(k);
+      for (size_t j = 0 ; j < n ; j++)
+         {
+         // w = v' B[j:m]
+         T* Bj = &Work[j * k];
+         std::copy(Bj, Bj + k, w.begin());
+         for (size_t i = j + 1 ; i < m ; i++)
+            {
+            const T vi = BASE::Row(i)[j];
+            const T* Bi = &Work[i * k];
+            for (size_t c = 0 ; c < k ; c++)
+               {
+               w[c] += vi * Bi[c];
+               } // end for
+            } // end for
+
+         // B -= tau v w'
+         const T Tau = m_Tau[j];
+         for (size_t c = 0 ; c < k ; c++)
+            {
+            w[c] *= Tau;
+            Bj[c] -= w[c];
+            } // end for
+         for (size_t i = j + 1 ; i < m ; i++)
+            {
+            const T vi = BASE::Row(i)[j];
+            T* Bi = &Work[i * k];
+            for (size_t c = 0 ; c < k ; c++)
+               {
+               Bi[c] -= vi * w[c];
+               } // end for
+            } // end for
+         } // end for
+
+      DTriangular<T>::SolveUpper(n, k, BASE::Factors(), false, false,
+            DGemmRows<T>(&Work[0], k));
+      } // end if
+
+   return (true);
+
+   } // End of function DQRDecomp::SolveWork
+
+/*****************************************************************************
+*
+*  DQRDecomp::Solve
+*
+*****************************************************************************/
+
+template <typename T>
+template <typename ARRAY>
+bool DQRDecomp<T>::Solve(const DMatrix<T, ARRAY>& B,
+      DMatrix<T, ARRAY>& X) const
+   {
+   bool bRet = BASE::m_bValid && (B.NumRows() == BASE::m_nRows);
+   if (bRet)
+      {
+      std::vector<T> Work;
+      BASE::LoadRHS(B, BASE::m_nRows, nullptr, Work);
+      bRet = SolveWork(Work, B.NumCols());
+      BASE::StoreSolution(Work, BASE::m_nCols, B.NumCols(), X);
+      } // end if
+
+   return (bRet);
+
+   } // End of function DQRDecomp::Solve
+
+template <typename T>
+bool DQRDecomp<T>::Solve(const std::vector<T>& b, std::vector<T>& x) const
+   {
+   bool bRet = BASE::m_bValid && (b.size() == BASE::m_nRows);
+   if (bRet)
+      {
+      std::vector<T> Work(b);
+      bRet = SolveWork(Work, 1);
+      Work.resize(BASE::m_nCols);
+      x.swap(Work);
+      } // end if
+
+   return (bRet);
+
+   } // End of function DQRDecomp::Solve
+
+#endif // __DMATRIXDECOMP_H__
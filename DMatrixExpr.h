@@ -0,0 +1,455 @@
+/*****************************************************************************
+******************************** DMatrixExpr.h *******************************
+*****************************************************************************/
+
+#if !defined(__DMATRIXEXPR_H__)
+#define __DMATRIXEXPR_H__
+
+/*
+   Expression templates for DMatrix arithmetic.  The arithmetic operators
+   build a small tree of expression nodes instead of returning a new matrix,
+   and the tree is evaluated directly into the destination when it's assigned
+   to a DMatrix.  So
+
+      D = A * B + C * d;
+
+   runs one GEMM straight into D and then accumulates d * C into D in a
+   single pass, with no intermediate matrices.
+
+   Every node (and DMatrix itself, which is the leaf) provides
+
+      NumRows(), NumCols()
+      AssignTo(Dest, s)       Dest  = s * expression, resizing Dest
+      AccumulateTo(Dest, s)   Dest += s * expression, Dest already sized
+      Aliases(p)              true if matrix p is read by the expression
+      IsConformant()          true if the operand dimensions agree
+
+   Scalar factors are pushed down the tree so scaling never costs a pass of
+   its own.  A matrix product whose operand is itself an expression
+   evaluates that operand once into a temporary since GEMM needs real
+   storage.  Assignments whose destination appears in the expression are
+   evaluated into a temporary first.
+
+   The dimension asserts only catch mistakes in debug builds.  DMatrix checks
+   IsConformant() before evaluating, and a mismatched expression fails the
+   way the old Add() and Mul() did: the result is a zero matrix of the
+   expression's size and an accumulate leaves its destination untouched.
+
+   Nodes hold DMatrix leaves by reference and other nodes by value, so an
+   expression must be consumed within the statement that creates it.
+*/
+
+/*****************************************************************************
+******************************  I N C L U D E  *******************************
+*****************************************************************************/
+
+#include <cassert>
+#include <cstddef>
+
+template <typename T, typename ARRAY> class DMatrix;
+
+/*****************************************************************************
+****************************** class DMatrixExpr *****************************
+*****************************************************************************/
+
+// CRTP base marking a type as a matrix expression
+template <typename E>
+class DMatrixExpr
+   {
+   public :
+      const E& Self() const
+         {
+         return (static_cast<const E&>(*this));
+         }
+
+   protected :
+   private :
+   };  // End of class DMatrixExpr
+
+/*****************************************************************************
+**************************** class DMatrixExprRef ****************************
+*****************************************************************************/
+
+// How a node stores an operand: nodes by value, matrices by reference
+template <typename E>
+struct DMatrixExprRef
+   {
+   typedef const E Type;
+   };
+
+template <typename T, typename ARRAY>
+struct DMatrixExprRef<DMatrix<T, ARRAY> >
+   {
+   typedef const DMatrix<T, ARRAY>& Type;
+   };
+
+/*****************************************************************************
+************************** class DMatrixExprOperand **************************
+*****************************************************************************/
+
+// A product operand with real storage.  Matrices are used as is and any
+// other expression is evaluated once into a temporary.
+template <typename E>
+class DMatrixExprOperand
+   {
+   public :
+      typedef typename E::MatrixType MatrixType;
+
+      DMatrixExprOperand(const E& Expr)
+            : m_M(Expr), m_bConformant(Expr.IsConformant())
+         {
+         return;
+         }
+
+      const MatrixType& Get() const
+         {
+         return (m_M);
+         }
+
+      bool IsConformant() const
+         {
+         return (m_bConformant);
+         }
+
+   protected :
+      MatrixType m_M;
+      bool m_bConformant;
+
+   private :
+   };  // End of class DMatrixExprOperand
+
+template <typename T, typename ARRAY>
+class DMatrixExprOperand<DMatrix<T, ARRAY> >
+   {
+   public :
+      typedef DMatrix<T, ARRAY> MatrixType;
+
+      DMatrixExprOperand(const MatrixType& M) : m_M(M)
+         {
+         return;
+         }
+
+      const MatrixType& Get() const
+         {
+         return (m_M);
+         }
+
+      bool IsConformant() const
+         {
+         return (true);
+         }
+
+   protected :
+      const MatrixType& m_M;
+
+   private :
+   };  // End of class DMatrixExprOperand
+
+/*****************************************************************************
+****************************** class DMatrixSum ******************************
+*****************************************************************************/
+
+// L + R or L - R
+template <typename L, typename R>
+class DMatrixSum : public DMatrixExpr<DMatrixSum<L, R> >
+   {
+   public :
+      typedef typename L::MatrixType MatrixType;
+      typedef typename L::T_numtype T_numtype;
+
+      DMatrixSum(const L& Left, const R& Right, T_numtype Sign)
+            : m_L(Left), m_R(Right), m_Sign(Sign)
+         {
+         assert((m_L.NumRows() == m_R.NumRows()) &&
+               (m_L.NumCols() == m_R.NumCols()));
+         return;
+         }
+
+      size_t NumRows() const
+         {
+         return (m_L.NumRows());
+         }
+
+      size_t NumCols() const
+         {
+         return (m_L.NumCols());
+         }
+
+      void AssignTo(MatrixType& Dest, T_numtype s) const
+         {
+         m_L.AssignTo(Dest, s);
+         m_R.AccumulateTo(Dest, s * m_Sign);
+         return;
+         }
+
+      void AccumulateTo(MatrixType& Dest, T_numtype s) const
+         {
+         m_L.AccumulateTo(Dest, s);
+         m_R.AccumulateTo(Dest, s * m_Sign);
+         return;
+         }
+
+      bool Aliases(const void* p) const
+         {
+         return (m_L.Aliases(p) || m_R.Aliases(p));
+         }
+
+      bool IsConformant() const
+         {
+         return ((m_L.NumRows() == m_R.NumRows()) &&
+               (m_L.NumCols() == m_R.NumCols()) && m_L.IsConformant() &&
+               m_R.IsConformant());
+         }
+
+   protected :
+      typename DMatrixExprRef<L>::Type m_L;
+      typename DMatrixExprRef<R>::Type m_R;
+      T_numtype m_Sign;
+
+   private :
+   };  // End of class DMatrixSum
+
+/*****************************************************************************
+***************************** class DMatrixScaled ****************************
+*****************************************************************************/
+
+// E * s
+template <typename E>
+class DMatrixScaled : public DMatrixExpr<DMatrixScaled<E> >
+   {
+   public :
+      typedef typename E::MatrixType MatrixType;
+      typedef typename E::T_numtype T_numtype;
+
+      DMatrixScaled(const E& Expr, T_numtype Scale)
+            : m_E(Expr), m_Scale(Scale)
+         {
+         return;
+         }
+
+      size_t NumRows() const
+         {
+         return (m_E.NumRows());
+         }
+
+      size_t NumCols() const
+         {
+         return (m_E.NumCols());
+         }
+
+      void AssignTo(MatrixType& Dest, T_numtype s) const
+         {
+         m_E.AssignTo(Dest, s * m_Scale);
+         return;
+         }
+
+      void AccumulateTo(MatrixType& Dest, T_numtype s) const
+         {
+         m_E.AccumulateTo(Dest, s * m_Scale);
+         return;
+         }
+
+      bool Aliases(const void* p) const
+         {
+         return (m_E.Aliases(p));
+         }
+
+      bool IsConformant() const
+         {
+         return (m_E.IsConformant());
+         }
+
+   protected :
+      typename DMatrixExprRef<E>::Type m_E;
+      T_numtype m_Scale;
+
+   private :
+   };  // End of class DMatrixScaled
+
+/*****************************************************************************
+***************************** class DMatrixOffset ****************************
+*****************************************************************************/
+
+// E + c added to every element
+template <typename E>
+class DMatrixOffset : public DMatrixExpr<DMatrixOffset<E> >
+   {
+   public :
+      typedef typename E::MatrixType MatrixType;
+      typedef typename E::T_numtype T_numtype;
+
+      DMatrixOffset(const E& Expr, T_numtype Offset)
+            : m_E(Expr), m_Offset(Offset)
+         {
+         return;
+         }
+
+      size_t NumRows() const
+         {
+         return (m_E.NumRows());
+         }
+
+      size_t NumCols() const
+         {
+         return (m_E.NumCols());
+         }
+
+      void AssignTo(MatrixType& Dest, T_numtype s) const
+         {
+         m_E.AssignTo(Dest, s);
+         Dest.Add(s * m_Offset);
+         return;
+         }
+
+      void AccumulateTo(MatrixType& Dest, T_numtype s) const
+         {
+         m_E.AccumulateTo(Dest, s);
+         Dest.Add(s * m_Offset);
+         return;
+         }
+
+      bool Aliases(const void* p) const
+         {
+         return (m_E.Aliases(p));
+         }
+
+      bool IsConformant() const
+         {
+         return (m_E.IsConformant());
+         }
+
+   protected :
+      typename DMatrixExprRef<E>::Type m_E;
+      T_numtype m_Offset;
+
+   private :
+   };  // End of class DMatrixOffset
+
+/*****************************************************************************
+**************************** class DMatrixProduct ****************************
+*****************************************************************************/
+
+// L * R evaluated by the GEMM kernel straight into the destination
+template <typename L, typename R>
+class DMatrixProduct : public DMatrixExpr<DMatrixProduct<L, R> >
+   {
+   public :
+      typedef typename L::MatrixType MatrixType;
+      typedef typename L::T_numtype T_numtype;
+
+      DMatrixProduct(const L& Left, const R& Right)
+            : m_L(Left), m_R(Right)
+         {
+         assert(m_L.Get().NumCols() == m_R.Get().NumRows());
+         return;
+         }
+
+      size_t NumRows() const
+         {
+         return (m_L.Get().NumRows());
+         }
+
+      size_t NumCols() const
+         {
+         return (m_R.Get().NumCols());
+         }
+
+      void AssignTo(MatrixType& Dest, T_numtype s) const
+         {
+         MatrixType::Gemm(Dest, m_L.Get(), false, m_R.Get(), false, s,
+               false);
+         return;
+         }
+
+      void AccumulateTo(MatrixType& Dest, T_numtype s) const
+         {
+         MatrixType::Gemm(Dest, m_L.Get(), false, m_R.Get(), false, s,
+               true);
+         return;
+         }
+
+      bool Aliases(const void* p) const
+         {
+         return ((&m_L.Get() == p) || (&m_R.Get() == p));
+         }
+
+      bool IsConformant() const
+         {
+         return ((m_L.Get().NumCols() == m_R.Get().NumRows()) &&
+               m_L.IsConformant() && m_R.IsConformant());
+         }
+
+   protected :
+      DMatrixExprOperand<L> m_L;
+      DMatrixExprOperand<R> m_R;
+
+   private :
+   };  // End of class DMatrixProduct
+
+/*****************************************************************************
+********************************* Operators **********************************
+*****************************************************************************/
+
+template <typename L, typename R>
+inline DMatrixSum<L, R> operator+(const DMatrixExpr<L>& Left,
+      const DMatrixExpr<R>& Right)
+   {
+   return (DMatrixSum<L, R>(Left.Self(), Right.Self(), 1));
+   }
+
+template <typename L, typename R>
+inline DMatrixSum<L, R> operator-(const DMatrixExpr<L>& Left,
+      const DMatrixExpr<R>& Right)
+   {
+   return (DMatrixSum<L, R>(Left.Self(), Right.Self(), -1));
+   }
+
+template <typename L, typename R>
+inline DMatrixProduct<L, R> operator*(const DMatrixExpr<L>& Left,
+      const DMatrixExpr<R>& Right)
+   {
+   return (DMatrixProduct<L, R>(Left.Self(), Right.Self()));
+   }
+
+template <typename E>
+inline DMatrixScaled<E> operator*(const DMatrixExpr<E>& Expr,
+      typename E::T_numtype s)
+   {
+   return (DMatrixScaled<E>(Expr.Self(), s));
+   }
+
+template <typename E>
+inline DMatrixScaled<E> operator*(typename E::T_numtype s,
+      const DMatrixExpr<E>& Expr)
+   {
+   return (DMatrixScaled<E>(Expr.Self(), s));
+   }
+
+template <typename E>
+inline DMatrixScaled<E> operator/(const DMatrixExpr<E>& Expr,
+      typename E::T_numtype s)
+   {
+   return (DMatrixScaled<E>(Expr.Self(), 1 / s));
+   }
+
+template <typename E>
+inline DMatrixScaled<E> operator-(const DMatrixExpr<E>& Expr)
+   {
+   return (DMatrixScaled<E>(Expr.Self(), -1));
+   }
+
+template <typename E>
+inline DMatrixOffset<E> operator+(const DMatrixExpr<E>& Expr,
+      typename E::T_numtype c)
+   {
+   return (DMatrixOffset<E>(Expr.Self(), c));
+   }
+
+template <typename E>
+inline DMatrixOffset<E> operator-(const DMatrixExpr<E>& Expr,
+      typename E::T_numtype c)
+   {
+   return (DMatrixOffset<E>(Expr.Self(), -c));
+   }
+
+#endif // __DMATRIXEXPR_H__
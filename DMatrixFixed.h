@@ -0,0 +1,669 @@
+/*****************************************************************************
+******************************* DMatrixFixed.h *******************************
+*****************************************************************************/
+
+#if !defined(__DMATRIXFIXED_H__)
+#define __DMATRIXFIXED_H__
+
+/*
+   Small square matrix kernels for DMatrix over DFixedArray2D.
+
+   When the dimensions are compile time constants every loop bound below is a
+   constant so the compiler unrolls the loops completely and keeps the
+   elements in registers.  2x2, 3x3 and 4x4 determinants, inverses and solves
+   use closed forms (cofactor expansions) with no pivot searching at all.
+   Other sizes, 6x6 included, have no specialization: they run the generic
+   partial pivoting elimination in DFixedSquareBase, only with constant
+   bounds, and make the same pivot tests as the dynamic DMatrix code.
+
+   The determinant scales as the Nth power of the elements, so the closed
+   forms don't compare it against ZeroTest directly.  IsInvertible() scales
+   it by the product of the row norms (Hadamard's bound), which is 1 for any
+   multiple of an orthogonal matrix, and a matrix that fails that test goes
+   through the pivoted version instead.  Nearly singular matrices get
+   exactly the treatment they always did, with the pivots compared against
+   ZeroTest.
+
+   The two tests are deliberately different, so the 2x2, 3x3 and 4x4
+   kernels accept a superset of what DMatrix::Invert() and GaussElim()
+   accept.  A well conditioned matrix whose elements are all tiny, say the
+   identity times 1e-15, passes the relative test and is inverted, while
+   the dynamic code compares its pivots against the absolute ZeroTest and
+   calls it singular.  Everything the dynamic code accepts is still
+   accepted here, up to rounding, through the pivoted fallback if not the
+   closed form.
+
+   DMatrixFixed<T, ARRAY> is the switch DMatrix uses to pick these kernels.
+   It's enabled for square DFixedArray2D of size 2, 3, 4 and 6 and disabled
+   (with do nothing stubs) for every other storage type.
+*/
+
+/*****************************************************************************
+******************************  I N C L U D E  *******************************
+*****************************************************************************/
+
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+template <typename T, size_t ROWS, size_t COLS> class DFixedArray2D;
+
+/*****************************************************************************
+************************** class DFixedSquareBase ****************************
+*****************************************************************************/
+
+template <typename T, size_t N>
+class DFixedSquareBase
+   {
+   public :
+      typedef T Array[N][N];
+
+      // True when Adjugate() is a branch free closed form
+      static const bool bClosedForm = false;
+
+      // C = Alpha * op(A) * op(B) (+ C).  C may be A or B.
+      static void Gemm(const Array& A, bool bTransA, const Array& B,
+            bool bTransB, Array& C, T Alpha, bool bAccumulate)
+         {
+         T P[N][N];
+         for (size_t i = 0 ; i < N ; i++)
+            {
+            for (size_t j = 0 ; j < N ; j++)
+               {
+               P[i][j] = 0;
+               } // end for
+            for (size_t k = 0 ; k < N ; k++)
+               {
+               const T a = bTransA ? A[k][i] : A[i][k];
+               for (size_t j = 0 ; j < N ; j++)
+                  {
+                  P[i][j] += a * (bTransB ? B[j][k] : B[k][j]);
+                  } // end for
+               } // end for
+            } // end for
+
+         for (size_t i = 0 ; i < N ; i++)
+            {
+            for (size_t j = 0 ; j < N ; j++)
+               {
+               C[i][j] = Alpha * P[i][j] + (bAccumulate ? C[i][j] : T(0));
+               } // end for
+            } // end for
+         return;
+         }
+
+      static T Determinant(const Array& A)
+         {
+         T U[N][N];
+         Copy(A, U);
+         T Det = 1;
+         for (size_t c = 0 ; c < N ; c++)
+            {
+            const size_t p = Pivot(U, c);
+            if (p != c)
+               {
+               SwapRows(U, c, p);
+               Det = -Det;
+               } // end if
+            Det *= U[c][c];
+            if (U[c][c] == 0)
+               {
+               break;
+               } // end if
+            Eliminate(U, c, nullptr);
+            } // end for
+         return (Det);
+         }
+
+      // Gauss-Jordan with partial pivoting
+      static bool Invert(const Array& A, Array& AI, T ZeroTest)
+         {
+         T U[N][N];
+         T V[N][N];
+         Copy(A, U);
+         for (size_t i = 0 ; i < N ; i++)
+            {
+            for (size_t j = 0 ; j < N ; j++)
+               {
+               V[i][j] = (i == j) ? T(1) : T(0);
+               } // end for
+            } // end for
+
+         bool bRet = true;
+         for (size_t c = 0 ; bRet && (c < N) ; c++)
+            {
+            const size_t p = Pivot(U, c);
+            bRet = (std::abs(U[p][c]) > ZeroTest);
+            if (bRet)
+               {
+               SwapRows(U, c, p);
+               SwapRows(V, c, p);
+               const T Inv = 1 / U[c][c];
+               for (size_t j = 0 ; j < N ; j++)
+                  {
+                  U[c][j] *= Inv;
+                  V[c][j] *= Inv;
+                  } // end for
+               for (size_t r = 0 ; r < N ; r++)
+                  {
+                  if (r != c)
+                     {
+                     const T m = U[r][c];
+                     for (size_t j = 0 ; j < N ; j++)
+                        {
+                        U[r][j] -= m * U[c][j];
+                        V[r][j] -= m * V[c][j];
+                        } // end for
+                     } // end if
+                  } // end for
+               } // end if
+            } // end for
+
+         if (bRet)
+            {
+            Copy(V, AI);
+            } // end if
+         return (bRet);
+         }
+
+      // Adj = adjugate of A (det(A) * inverse(A)), returning det(A).  The
+      // generic version goes through the inverse and gives zero for
+      // singular matrices.
+      static T Adjugate(const Array& A, Array& Adj)
+         {
+         const T Det = Determinant(A);
+         T AI[N][N];
+         const bool bRet = Invert(A, AI, 0);
+         for (size_t i = 0 ; i < N ; i++)
+            {
+            for (size_t j = 0 ; j < N ; j++)
+               {
+               Adj[i][j] = bRet ? Det * AI[i][j] : T(0);
+               } // end for
+            } // end for
+         return (Det);
+         }
+
+      // Solve A x = b with partial pivoting.  x may be b.
+      static bool Solve(const Array& A, const T* b, T* x, T ZeroTest)
+         {
+         T U[N][N];
+         T y[N];
+         Copy(A, U);
+         for (size_t i = 0 ; i < N ; i++)
+            {
+            y[i] = b[i];
+            } // end for
+
+         bool bRet = true;
+         for (size_t c = 0 ; bRet && (c < N) ; c++)
+            {
+            const size_t p = Pivot(U, c);
+            bRet = (std::abs(U[p][c]) > ZeroTest);
+            if (bRet)
+               {
+               SwapRows(U, c, p);
+               std::swap(y[c], y[p]);
+               Eliminate(U, c, y);
+               } // end if
+            } // end for
+
+         if (bRet)
+            {
+            for (size_t i = N ; i-- > 0 ; )
+               {
+               T s = y[i];
+               for (size_t k = i + 1 ; k < N ; k++)
+                  {
+                  s -= U[i][k] * x[k];
+                  } // end for
+               x[i] = s / U[i][i];
+               } // end for
+            } // end if
+         return (bRet);
+         }
+
+      // True if Det = det(A) is large enough relative to the scale of A for
+      // the closed forms to be trusted.  Squared to keep sqrt() out of the
+      // batch loops, which it stops vectorizing.
+      static bool IsInvertible(const Array& A, T Det, T ZeroTest)
+         {
+         T Norms = 1;
+         for (size_t i = 0 ; i < N ; i++)
+            {
+            T Sum = 0;
+            for (size_t j = 0 ; j < N ; j++)
+               {
+               Sum += A[i][j] * A[i][j];
+               } // end for
+            Norms *= Sum;
+            } // end for
+         return (Det * Det > ZeroTest * ZeroTest * Norms);
+         }
+
+   protected :
+      // AI = Adj / Det if the closed form can be trusted, otherwise pivot
+      static bool InvertFromAdjugate(const Array& A, T Det, const Array& Adj,
+            Array& AI, T ZeroTest)
+         {
+         bool bRet = IsInvertible(A, Det, ZeroTest);
+         if (bRet)
+            {
+            const T Inv = 1 / Det;
+            for (size_t i = 0 ; i < N ; i++)
+               {
+               for (size_t j = 0 ; j < N ; j++)
+                  {
+                  AI[i][j] = Adj[i][j] * Inv;
+                  } // end for
+               } // end for
+            } // end if
+         else
+            {
+            bRet = Invert(A, AI, ZeroTest);
+            } // end else
+         return (bRet);
+         }
+
+      static void Copy(const Array& Src, Array& Dst)
+         {
+         for (size_t i = 0 ; i < N ; i++)
+            {
+            for (size_t j = 0 ; j < N ; j++)
+               {
+               Dst[i][j] = Src[i][j];
+               } // end for
+            } // end for
+         return;
+         }
+
+      static size_t Pivot(const Array& U, size_t c)
+         {
+         size_t p = c;
+         for (size_t r = c + 1 ; r < N ; r++)
+            {
+            if (std::abs(U[r][c]) > std::abs(U[p][c]))
+               {
+               p = r;
+               } // end if
+            } // end for
+         return (p);
+         }
+
+      static void SwapRows(Array& U, size_t r1, size_t r2)
+         {
+         if (r1 != r2)
+            {
+            for (size_t j = 0 ; j < N ; j++)
+               {
+               std::swap(U[r1][j], U[r2][j]);
+               } // end for
+            } // end if
+         return;
+         }
+
+      // Eliminate column c below the pivot, carrying y along if given
+      static void Eliminate(Array& U, size_t c, T* y)
+         {
+         const T Inv = 1 / U[c][c];
+         for (size_t r = c + 1 ; r < N ; r++)
+            {
+            const T m = U[r][c] * Inv;
+            for (size_t j = c ; j < N ; j++)
+               {
+               U[r][j] -= m * U[c][j];
+               } // end for
+            if (y)
+               {
+               y[r] -= m * y[c];
+               } // end if
+            } // end for
+         return;
+         }
+
+   private :
+   };  // End of class DFixedSquareBase
+
+/*****************************************************************************
+***************************** class DFixedSquare *****************************
+*****************************************************************************/
+
+template <typename T, size_t N>
+class DFixedSquare : public DFixedSquareBase<T, N>
+   {
+   };  // End of class DFixedSquare
+
+template <typename T, size_t N>
+const bool DFixedSquareBase<T, N>::bClosedForm;
+
+/*****************************************************************************
+*
+*  DFixedSquare<T, 2>
+*
+*****************************************************************************/
+
+template <typename T>
+class DFixedSquare<T, 2> : public DFixedSquareBase<T, 2>
+   {
+   public :
+      typedef T Array[2][2];
+
+      static const bool bClosedForm = true;
+
+      static T Determinant(const Array& A)
+         {
+         return (A[0][0] * A[1][1] - A[0][1] * A[1][0]);
+         }
+
+      static T Adjugate(const Array& A, Array& Adj)
+         {
+         const T a = A[0][0];
+         const T b = A[0][1];
+         const T c = A[1][0];
+         const T d = A[1][1];
+         Adj[0][0] = d;
+         Adj[0][1] = -b;
+         Adj[1][0] = -c;
+         Adj[1][1] = a;
+         return (a * d - b * c);
+         }
+
+      static bool Invert(const Array& A, Array& AI, T ZeroTest)
+         {
+         Array Adj;
+         const T Det = Adjugate(A, Adj);
+         return (DFixedSquareBase<T, 2>::InvertFromAdjugate(A, Det, Adj, AI,
+               ZeroTest));
+         }
+
+      static bool Solve(const Array& A, const T* b, T* x, T ZeroTest)
+         {
+         const T Det = Determinant(A);
+         bool bRet = DFixedSquareBase<T, 2>::IsInvertible(A, Det, ZeroTest);
+         if (bRet)
+            {
+            const T Inv = 1 / Det;
+            const T b0 = b[0];
+            const T b1 = b[1];
+            x[0] = (A[1][1] * b0 - A[0][1] * b1) * Inv;
+            x[1] = (A[0][0] * b1 - A[1][0] * b0) * Inv;
+            } // end if
+         else
+            {
+            bRet = DFixedSquareBase<T, 2>::Solve(A, b, x, ZeroTest);
+            } // end else
+         return (bRet);
+         }
+   };  // End of class DFixedSquare<T, 2>
+
+/*****************************************************************************
+*
+*  DFixedSquare<T, 3>
+*
+*****************************************************************************/
+
+template <typename T>
+class DFixedSquare<T, 3> : public DFixedSquareBase<T, 3>
+   {
+   public :
+      typedef T Array[3][3];
+
+      static const bool bClosedForm = true;
+
+      static T Determinant(const Array& A)
+         {
+         return (A[0][0] * (A[1][1] * A[2][2] - A[1][2] * A[2][1]) -
+               A[0][1] * (A[1][0] * A[2][2] - A[1][2] * A[2][0]) +
+               A[0][2] * (A[1][0] * A[2][1] - A[1][1] * A[2][0]));
+         }
+
+      // Transposed cofactors
+      static T Adjugate(const Array& A, Array& Adj)
+         {
+         const T c00 = A[1][1] * A[2][2] - A[1][2] * A[2][1];
+         const T c01 = A[1][2] * A[2][0] - A[1][0] * A[2][2];
+         const T c02 = A[1][0] * A[2][1] - A[1][1] * A[2][0];
+         const T c10 = A[0][2] * A[2][1] - A[0][1] * A[2][2];
+         const T c11 = A[0][0] * A[2][2] - A[0][2] * A[2][0];
+         const T c12 = A[0][1] * A[2][0] - A[0][0] * A[2][1];
+         const T c20 = A[0][1] * A[1][2] - A[0][2] * A[1][1];
+         const T c21 = A[0][2] * A[1][0] - A[0][0] * A[1][2];
+         const T c22 = A[0][0] * A[1][1] - A[0][1] * A[1][0];
+         const T Det = A[0][0] * c00 + A[0][1] * c01 + A[0][2] * c02;
+         Adj[0][0] = c00;
+         Adj[0][1] = c10;
+         Adj[0][2] = c20;
+         Adj[1][0] = c01;
+         Adj[1][1] = c11;
+         Adj[1][2] = c21;
+         Adj[2][0] = c02;
+         Adj[2][1] = c12;
+         Adj[2][2] = c22;
+         return (Det);
+         }
+
+      static bool Invert(const Array& A, Array& AI, T ZeroTest)
+         {
+         Array Adj;
+         const T Det = Adjugate(A, Adj);
+         return (DFixedSquareBase<T, 3>::InvertFromAdjugate(A, Det, Adj, AI,
+               ZeroTest));
+         }
+
+      // Cramer's rule
+      static bool Solve(const Array& A, const T* b, T* x, T ZeroTest)
+         {
+         const T Det = Determinant(A);
+         bool bRet = DFixedSquareBase<T, 3>::IsInvertible(A, Det, ZeroTest);
+         if (bRet)
+            {
+            const T Inv = 1 / Det;
+            const T b0 = b[0];
+            const T b1 = b[1];
+            const T b2 = b[2];
+            x[0] = Inv * (b0 * (A[1][1] * A[2][2] - A[1][2] * A[2][1]) -
+                  A[0][1] * (b1 * A[2][2] - A[1][2] * b2) +
+                  A[0][2] * (b1 * A[2][1] - A[1][1] * b2));
+            x[1] = Inv * (A[0][0] * (b1 * A[2][2] - A[1][2] * b2) -
+                  b0 * (A[1][0] * A[2][2] - A[1][2] * A[2][0]) +
+                  A[0][2] * (A[1][0] * b2 - b1 * A[2][0]));
+            x[2] = Inv * (A[0][0] * (A[1][1] * b2 - b1 * A[2][1]) -
+                  A[0][1] * (A[1][0] * b2 - b1 * A[2][0]) +
+                  b0 * (A[1][0] * A[2][1] - A[1][1] * A[2][0]));
+            } // end if
+         else
+            {
+            bRet = DFixedSquareBase<T, 3>::Solve(A, b, x, ZeroTest);
+            } // end else
+         return (bRet);
+         }
+   };  // End of class DFixedSquare<T, 3>
+
+/*****************************************************************************
+*
+*  DFixedSquare<T, 4>
+*
+*  The inverse and determinant are built from the six 2x2 minors of the top
+*  two rows and the six of the bottom two rows (Laplace expansion).
+*
+*****************************************************************************/
+
+template <typename T>
+class DFixedSquare<T, 4> : public DFixedSquareBase<T, 4>
+   {
+   public :
+      typedef T Array[4][4];
+
+      static const bool bClosedForm = true;
+
+      static T Determinant(const Array& A)
+         {
+         T s[6];
+         T c[6];
+         Minors(A, s, c);
+         return (s[0] * c[5] - s[1] * c[4] + s[2] * c[3] + s[3] * c[2] -
+               s[4] * c[1] + s[5] * c[0]);
+         }
+
+      static T Adjugate(const Array& A, Array& Adj)
+         {
+         T s[6];
+         T c[6];
+         Minors(A, s, c);
+         T R[4][4];
+         R[0][0] = ( A[1][1] * c[5] - A[1][2] * c[4] + A[1][3] * c[3]);
+         R[0][1] = (-A[0][1] * c[5] + A[0][2] * c[4] - A[0][3] * c[3]);
+         R[0][2] = ( A[3][1] * s[5] - A[3][2] * s[4] + A[3][3] * s[3]);
+         R[0][3] = (-A[2][1] * s[5] + A[2][2] * s[4] - A[2][3] * s[3]);
+
+         R[1][0] = (-A[1][0] * c[5] + A[1][2] * c[2] - A[1][3] * c[1]);
+         R[1][1] = ( A[0][0] * c[5] - A[0][2] * c[2] + A[0][3] * c[1]);
+         R[1][2] = (-A[3][0] * s[5] + A[3][2] * s[2] - A[3][3] * s[1]);
+         R[1][3] = ( A[2][0] * s[5] - A[2][2] * s[2] + A[2][3] * s[1]);
+
+         R[2][0] = ( A[1][0] * c[4] - A[1][1] * c[2] + A[1][3] * c[0]);
+         R[2][1] = (-A[0][0] * c[4] + A[0][1] * c[2] - A[0][3] * c[0]);
+         R[2][2] = ( A[3][0] * s[4] - A[3][1] * s[2] + A[3][3] * s[0]);
+         R[2][3] = (-A[2][0] * s[4] + A[2][1] * s[2] - A[2][3] * s[0]);
+
+         R[3][0] = (-A[1][0] * c[3] + A[1][1] * c[1] - A[1][2] * c[0]);
+         R[3][1] = ( A[0][0] * c[3] - A[0][1] * c[1] + A[0][2] * c[0]);
+         R[3][2] = (-A[3][0] * s[3] + A[3][1] * s[1] - A[3][2] * s[0]);
+         R[3][3] = ( A[2][0] * s[3] - A[2][1] * s[1] + A[2][2] * s[0]);
+
+         for (size_t i = 0 ; i < 4 ; i++)
+            {
+            for (size_t j = 0 ; j < 4 ; j++)
+               {
+               Adj[i][j] = R[i][j];
+               } // end for
+            } // end for
+         return (s[0] * c[5] - s[1] * c[4] + s[2] * c[3] + s[3] * c[2] -
+               s[4] * c[1] + s[5] * c[0]);
+         }
+
+      static bool Invert(const Array& A, Array& AI, T ZeroTest)
+         {
+         Array Adj;
+         const T Det = Adjugate(A, Adj);
+         return (DFixedSquareBase<T, 4>::InvertFromAdjugate(A, Det, Adj, AI,
+               ZeroTest));
+         }
+
+      // x = adj(A) b / det(A)
+      static bool Solve(const Array& A, const T* b, T* x, T ZeroTest)
+         {
+         Array Adj;
+         const T Det = Adjugate(A, Adj);
+         bool bRet = DFixedSquareBase<T, 4>::IsInvertible(A, Det, ZeroTest);
+         if (bRet)
+            {
+            const T Inv = 1 / Det;
+            const T b0 = b[0];
+            const T b1 = b[1];
+            const T b2 = b[2];
+            const T b3 = b[3];
+            for (size_t i = 0 ; i < 4 ; i++)
+               {
+               x[i] = Inv * (Adj[i][0] * b0 + Adj[i][1] * b1 +
+                     Adj[i][2] * b2 + Adj[i][3] * b3);
+               } // end for
+            } // end if
+         else
+            {
+            bRet = DFixedSquareBase<T, 4>::Solve(A, b, x, ZeroTest);
+            } // end else
+         return (bRet);
+         }
+
+   protected :
+      // s = 2x2 minors of rows 0 & 1, c = 2x2 minors of rows 2 & 3
+      static void Minors(const Array& A, T s[6], T c[6])
+         {
+         s[0] = A[0][0] * A[1][1] - A[1][0] * A[0][1];
+         s[1] = A[0][0] * A[1][2] - A[1][0] * A[0][2];
+         s[2] = A[0][0] * A[1][3] - A[1][0] * A[0][3];
+         s[3] = A[0][1] * A[1][2] - A[1][1] * A[0][2];
+         s[4] = A[0][1] * A[1][3] - A[1][1] * A[0][3];
+         s[5] = A[0][2] * A[1][3] - A[1][2] * A[0][3];
+
+         c[0] = A[2][0] * A[3][1] - A[3][0] * A[2][1];
+         c[1] = A[2][0] * A[3][2] - A[3][0] * A[2][2];
+         c[2] = A[2][0] * A[3][3] - A[3][0] * A[2][3];
+         c[3] = A[2][1] * A[3][2] - A[3][1] * A[2][2];
+         c[4] = A[2][1] * A[3][3] - A[3][1] * A[2][3];
+         c[5] = A[2][2] * A[3][3] - A[3][2] * A[2][3];
+         return;
+         }
+   };  // End of class DFixedSquare<T, 4>
+
+/*****************************************************************************
+***************************** class DMatrixFixed *****************************
+*****************************************************************************/
+
+// Storage types without compile time dimensions never use the fixed kernels
+template <typename T, typename ARRAY>
+struct DMatrixFixed
+   {
+   static const bool bEnabled = false;
+
+   static void Gemm(const ARRAY&, bool, const ARRAY&, bool, ARRAY&, T, bool)
+      {
+      return;
+      }
+
+   static T Determinant(const ARRAY&)
+      {
+      return (0);
+      }
+
+   static bool Invert(const ARRAY&, ARRAY&, T)
+      {
+      return (false);
+      }
+
+   static bool Solve(const ARRAY&, const T*, T*, T)
+      {
+      return (false);
+      }
+   };
+
+template <typename T, typename ARRAY>
+const bool DMatrixFixed<T, ARRAY>::bEnabled;
+
+template <typename T, size_t N>
+struct DMatrixFixed<T, DFixedArray2D<T, N, N> >
+   {
+   typedef DFixedArray2D<T, N, N> ARRAY;
+   typedef DFixedSquare<T, N> Ops;
+
+   static const bool bEnabled = (N == 2) || (N == 3) || (N == 4) || (N == 6);
+
+   static void Gemm(const ARRAY& A, bool bTransA, const ARRAY& B,
+         bool bTransB, ARRAY& C, T Alpha, bool bAccumulate)
+      {
+      Ops::Gemm(A.GetElements(), bTransA, B.GetElements(), bTransB,
+            C.GetElements(), Alpha, bAccumulate);
+      return;
+      }
+
+   static T Determinant(const ARRAY& A)
+      {
+      return (Ops::Determinant(A.GetElements()));
+      }
+
+   static bool Invert(const ARRAY& A, ARRAY& AI, T ZeroTest)
+      {
+      return (Ops::Invert(A.GetElements(), AI.GetElements(), ZeroTest));
+      }
+
+   static bool Solve(const ARRAY& A, const T* b, T* x, T ZeroTest)
+      {
+      return (Ops::Solve(A.GetElements(), b, x, ZeroTest));
+      }
+   };
+
+template <typename T, size_t N>
+const bool DMatrixFixed<T, DFixedArray2D<T, N, N> >::bEnabled;
+
+#endif // __DMATRIXFIXED_H__
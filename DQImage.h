@@ -12,6 +12,7 @@
  ******************************  I N C L U D E  *******************************
  *****************************************************************************/
 
+#include <utility>
 #include <QImage>
 #include <opencv2/core.hpp>
 
@@ -92,7 +93,12 @@ class DQImage : public QImage
          return;
          }
 
-      DQImage(DQImage&& Other) : QImage(Other), m_ROI(Other.m_ROI)
+      DQImage(QImage&& src) : QImage(std::move(src)), m_ROI(QRect())
+         {
+         return;
+         }
+
+      DQImage(DQImage&& Other) : QImage(std::move(Other)), m_ROI(Other.m_ROI)
          {
          return;
          }
@@ -122,23 +128,23 @@ class DQImage : public QImage
          return (*this);
          }
 
-      DQImage& operator=(const DQImage&& rhs)
+      DQImage& operator=(DQImage&& rhs)
          {
          if (this != &rhs)
             {
-            QImage::operator=(rhs);
             m_ROI = rhs.m_ROI;
+            QImage::operator=(std::move(rhs));
             } // end if
 
          return (*this);
          }
 
-      DQImage& operator=(const QImage&& rhs)
+      DQImage& operator=(QImage&& rhs)
          {
          if (this != &rhs)
             {
-            QImage::operator=(rhs);
             m_ROI = QRect();
+            QImage::operator=(std::move(rhs));
             } // end if
 
          return (*this);
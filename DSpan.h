@@ -0,0 +1,107 @@
+/*****************************************************************************
+*********************************** DSpan.h **********************************
+*****************************************************************************/
+
+#if !defined(__DSPAN_H__)
+#define __DSPAN_H__
+
+/*****************************************************************************
+******************************  I N C L U D E  *******************************
+*****************************************************************************/
+
+#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+/*****************************************************************************
+******************************** class DSpan *********************************
+*****************************************************************************/
+
+// A contiguous run of elements owned by someone else
+
+template <typename T>
+class DSpan
+   {
+   public :
+      typedef typename std::remove_const<T>::type value_type;
+
+      DSpan() : m_p(nullptr), m_nSize(0)
+         {
+         return;
+         }
+
+      DSpan(T* p, size_t nSize) : m_p(p), m_nSize(nSize)
+         {
+         return;
+         }
+
+      template <typename ALLOC>
+      DSpan(std::vector<value_type, ALLOC>& v)
+            : m_p(v.data()), m_nSize(v.size())
+         {
+         return;
+         }
+
+      // Only compiles for spans of const elements
+      template <typename ALLOC>
+      DSpan(const std::vector<value_type, ALLOC>& v)
+            : m_p(v.data()), m_nSize(v.size())
+         {
+         return;
+         }
+
+      // DSpan<T> to DSpan<const T>
+      template <typename U>
+      DSpan(const DSpan<U>& src, typename std::enable_if<
+            std::is_convertible<U*, T*>::value>::type* = nullptr)
+            : m_p(src.data()), m_nSize(src.size())
+         {
+         return;
+         }
+
+      T* data() const
+         {
+         return (m_p);
+         }
+
+      size_t size() const
+         {
+         return (m_nSize);
+         }
+
+      bool empty() const
+         {
+         return (m_nSize == 0);
+         }
+
+      T& operator[](size_t i) const
+         {
+         return (m_p[i]);
+         }
+
+      T* begin() const
+         {
+         return (m_p);
+         }
+
+      T* end() const
+         {
+         return (m_p + m_nSize);
+         }
+
+      // Elements nFirst to nFirst + nCount - 1
+      DSpan<T> Sub(size_t nFirst, size_t nCount) const
+         {
+         assert(nFirst + nCount <= m_nSize);
+         return (DSpan<T>(m_p + nFirst, nCount));
+         }
+
+   protected :
+      T* m_p;
+      size_t m_nSize;
+
+   private :
+   };  // End of class DSpan
+
+#endif // __DSPAN_H__
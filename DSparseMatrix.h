@@ -0,0 +1,996 @@
+/*****************************************************************************
+******************************* DSparseMatrix.h ******************************
+*****************************************************************************/
+
+#if !defined(__DSPARSEMATRIX_H__)
+#define __DSPARSEMATRIX_H__
+
+/*
+   Sparse matrices for problems too large to hold densely, such as the
+   normal equations of a multi-camera refinement.
+
+      DSparseMatrix        compressed sparse row (CSR) storage
+      DConjugateGradient   Jacobi preconditioned conjugate gradient solver
+
+   A DSparseMatrix is built from (row, column, value) triplets in any order;
+   duplicates are summed.  Each row's column indices are kept sorted.  The
+   compressed column (CSC) form of A is the CSR form of A' so Transpose()
+   serves for both.
+
+   Products with dense operands follow the DMatrix names: Mul() for A * B
+   and MulATransposexB() for A' * B.  A' * B is computed by scattering
+   the rows of A so A' is never formed.  MulATransposexA() forms the sparse
+   normal matrix J'J directly from a sparse Jacobian.
+
+   A * x is split across threads by bands of rows holding roughly equal
+   numbers of nonzeros once the matrix is large enough to pay for them.
+   The threads are started for each product, so every band is given at
+   least half of ThreadNonZeros nonzeros to keep the start up cost small
+   next to the work, as DVectorOps does for its chunks.
+*/
+
+/*****************************************************************************
+******************************  I N C L U D E  *******************************
+*****************************************************************************/
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <functional>
+#include "DMatrix.h"
+#include "DVectorOps.h"
+
+/*****************************************************************************
+***************************** struct DSparseTriplet **************************
+*****************************************************************************/
+
+template <typename T>
+struct DSparseTriplet
+   {
+   DSparseTriplet() : nRow(0), nCol(0), Value(0)
+      {
+      return;
+      }
+
+   DSparseTriplet(size_t r, size_t c, T v) : nRow(r), nCol(c), Value(v)
+      {
+      return;
+      }
+
+   size_t nRow;
+   size_t nCol;
+   T Value;
+   };
+
+/*****************************************************************************
+***************************** class DSparseMatrix ****************************
+*****************************************************************************/
+
+template <typename T>
+class DSparseMatrix
+   {
+   public :
+      typedef DSparseTriplet<T> Triplet;
+
+      // Below this many nonzeros A * x runs on one thread, and no thread
+      // gets fewer than half this many
+      static const size_t ThreadNonZeros = 1 << 18;
+
+      DSparseMatrix() : m_nRows(0), m_nCols(0), m_RowStart(1, 0)
+         {
+         return;
+         }
+
+      DSparseMatrix(size_t nRows, size_t nCols)
+            : m_nRows(nRows), m_nCols(nCols), m_RowStart(nRows + 1, 0)
+         {
+         return;
+         }
+
+      DSparseMatrix(size_t nRows, size_t nCols,
+            const std::vector<Triplet>& Triplets)
+            : m_nRows(0), m_nCols(0)
+         {
+         SetFromTriplets(nRows, nCols, Triplets);
+         return;
+         }
+
+      size_t NumRows() const
+         {
+         return (m_nRows);
+         }
+
+      size_t NumCols() const
+         {
+         return (m_nCols);
+         }
+
+      size_t NumNonZeros() const
+         {
+         return (m_Values.size());
+         }
+
+      bool IsSquare() const
+         {
+         return (m_nRows == m_nCols);
+         }
+
+      // Replace the contents with an nRows x nCols matrix of the triplets
+      void SetFromTriplets(size_t nRows, size_t nCols,
+            const std::vector<Triplet>& Triplets);
+
+      // Keep the elements of A whose magnitude exceeds ZeroTest
+      template <typename ARRAY>
+      void SetFromDense(const DMatrix<T, ARRAY>& A, T ZeroTest = 0);
+
+      template <typename ARRAY>
+      void ToDense(DMatrix<T, ARRAY>& A) const;
+
+      // Element (r, c), zero if not stored
+      T Get(size_t r, size_t c) const;
+
+      // The stored elements of row r are entries RowBegin(r) to RowEnd(r) - 1
+      size_t RowBegin(size_t r) const
+         {
+         return (m_RowStart[r]);
+         }
+
+      size_t RowEnd(size_t r) const
+         {
+         return (m_RowStart[r + 1]);
+         }
+
+      size_t Column(size_t k) const
+         {
+         return (m_ColIndex[k]);
+         }
+
+      T& Value(size_t k)
+         {
+         return (m_Values[k]);
+         }
+
+      const T& Value(size_t k) const
+         {
+         return (m_Values[k]);
+         }
+
+      void Mul(T s);
+
+      // AT = A'
+      void Transpose(DSparseMatrix<T>& AT) const;
+
+      // d = the main diagonal of A
+      void Diagonal(std::vector<T>& d) const;
+
+      // out = A * rhs.  nMaxThreads of zero uses the hardware concurrency.
+      bool MulVector(const std::vector<T>& rhs, std::vector<T>& out,
+            size_t nMaxThreads = 0) const;
+
+      // out = A' * rhs
+      bool MulTransposeVector(const std::vector<T>& rhs,
+            std::vector<T>& out) const;
+
+      // Result = A * B
+      template <typename ARRAY>
+      bool Mul(const DMatrix<T, ARRAY>& B, DMatrix<T, ARRAY>& Result) const;
+
+      // Result = A' * B
+      template <typename ARRAY>
+      bool MulATransposexB(const DMatrix<T, ARRAY>& B,
+            DMatrix<T, ARRAY>& Result) const;
+
+      // Result = A' * A
+      void MulATransposexA(DSparseMatrix<T>& Result) const;
+
+   protected :
+      size_t m_nRows;
+      size_t m_nCols;
+      std::vector<size_t> m_RowStart;  // nRows + 1 offsets into the entries
+      std::vector<size_t> m_ColIndex;
+      std::vector<T> m_Values;
+
+      void MulRows(size_t nRow0, size_t nRow1, const T* x, T* y) const;
+
+   private :
+   };  // End of class DSparseMatrix
+
+template <typename T>
+const size_t DSparseMatrix<T>::ThreadNonZeros;
+
+/*****************************************************************************
+*
+*  DSparseMatrix::SetFromTriplets
+*
+*  Bucket the triplets by row with a counting pass, then sort each row by
+*  column and merge duplicates in place.
+*
+*****************************************************************************/
+
+template <typename T>
+void DSparseMatrix<T>::SetFromTriplets(size_t nRows, size_t nCols,
+      const std::vector<Triplet>& Triplets)
+   {
+   m_nRows = nRows;
+   m_nCols = nCols;
+
+   std::vector<size_t> Start(nRows + 1, 0);
+   for (size_t i = 0 ; i < Triplets.size() ; i++)
+      {
+      assert((Triplets[i].nRow < nRows) && (Triplets[i].nCol < nCols));
+      Start[Triplets[i].nRow + 1]++;
+      } // end for
+   for (size_t r = 0 ; r < nRows ; r++)
+      {
+      Start[r + 1] += Start[r];
+      } // end for
+
+   std::vector<std::pair<size_t, T> > Entries(Triplets.size());
+   std::vector<size_t> Next(Start.begin(), Start.end() - 1);
+   for (size_t i = 0 ; i < Triplets.size() ; i++)
+      {
+      Entries[Next[Triplets[i].nRow]++] =
+            std::make_pair(Triplets[i].nCol, Triplets[i].Value);
+      } // end for
+
+   m_RowStart.assign(nRows + 1, 0);
+   m_ColIndex.clear();
+   m_Values.clear();
+   m_ColIndex.reserve(Entries.size());
+   m_Values.reserve(Entries.size());
+
+   for (size_t r = 0 ; r < nRows ; r++)
+      {
+      std::sort(Entries.begin() + Start[r], Entries.begin() + Start[r + 1],
+            [](const std::pair<size_t, T>& a, const std::pair<size_t, T>& b)
+               {
+               return (a.first < b.first);
+               });
+
+      for (size_t k = Start[r] ; k < Start[r + 1] ; k++)
+         {
+         if ((m_ColIndex.size() > m_RowStart[r]) &&
+               (m_ColIndex.back() == Entries[k].first))
+            {
+            m_Values.back() += Entries[k].second;
+            } // end if
+         else
+            {
+            m_ColIndex.push_back(Entries[k].first);
+            m_Values.push_back(Entries[k].second);
+            } // end else
+         } // end for
+      m_RowStart[r + 1] = m_ColIndex.size();
+      } // end for
+
+   return;
+
+   } // End of function DSparseMatrix::SetFromTriplets
+
+/*****************************************************************************
+*
+*  DSparseMatrix::SetFromDense
+*
+*****************************************************************************/
+
+template <typename T>
+template <typename ARRAY>
+void DSparseMatrix<T>::SetFromDense(const DMatrix<T, ARRAY>& A, T ZeroTest)
+   {
+   m_nRows = A.NumRows();
+   m_nCols = A.NumCols();
+   m_RowStart.assign(m_nRows + 1, 0);
+   m_ColIndex.clear();
+   m_Values.clear();
+
+   for (size_t r = 0 ; r < m_nRows ; r++)
+      {
+      const T* R = A[r];
+      for (size_t c = 0 ; c < m_nCols ; c++)
+         {
+         if (std::abs(R[c]) > ZeroTest)
+            {
+            m_ColIndex.push_back(c);
+            m_Values.push_back(R[c]);
+            } // end if
+         } // end for
+      m_RowStart[r + 1] = m_ColIndex.size();
+      } // end for
+
+   return;
+
+   } // End of function DSparseMatrix::SetFromDense
+
+/*****************************************************************************
+*
+*  DSparseMatrix::ToDense
+*
+*****************************************************************************/
+
+template <typename T>
+template <typename ARRAY>
+void DSparseMatrix<T>::ToDense(DMatrix<T, ARRAY>& A) const
+   {
+   A.Resize(m_nRows, m_nCols);
+   A.Zero();
+   for (size_t r = 0 ; r < m_nRows ; r++)
+      {
+      T* R = A[r];
+      for (size_t k = m_RowStart[r] ; k < m_RowStart[r + 1] ; k++)
+         {
+         R[m_ColIndex[k]] = m_Values[k];
+         } // end for
+      } // end for
+
+   return;
+
+   } // End of function DSparseMatrix::ToDense
+
+/*****************************************************************************
+*
+*  DSparseMatrix::Get
+*
+*  Binary search of the row's sorted column indices.
+*
+*****************************************************************************/
+
+template <typename T>
+T DSparseMatrix<T>::Get(size_t r, size_t c) const
+   {
+   T Ret = 0;
+   const size_t* pBegin = m_ColIndex.data() + m_RowStart[r];
+   const size_t* pEnd = m_ColIndex.data() + m_RowStart[r + 1];
+   const size_t* p = std::lower_bound(pBegin, pEnd, c);
+   if ((p != pEnd) && (*p == c))
+      {
+      Ret = m_Values[p - m_ColIndex.data()];
+      } // end if
+
+   return (Ret);
+
+   } // End of function DSparseMatrix::Get
+
+/*****************************************************************************
+*
+*  DSparseMatrix::Mul
+*
+*  Scale every element by s.
+*
+*****************************************************************************/
+
+template <typename T>
+void DSparseMatrix<T>::Mul(T s)
+   {
+   for (size_t k = 0 ; k < m_Values.size() ; k++)
+      {
+      m_Values[k] *= s;
+      } // end for
+
+   return;
+
+   } // End of function DSparseMatrix::Mul
+
+/*****************************************************************************
+*
+*  DSparseMatrix::Transpose
+*
+*  Count the entries in each column, then deal the rows out in order so each
+*  row of the transpose comes out already sorted.
+*
+*****************************************************************************/
+
+template <typename T>
+void DSparseMatrix<T>::Transpose(DSparseMatrix<T>& AT) const
+   {
+   assert(&AT != this);
+
+   AT.m_nRows = m_nCols;
+   AT.m_nCols = m_nRows;
+   AT.m_RowStart.assign(m_nCols + 1, 0);
+   AT.m_ColIndex.resize(m_ColIndex.size());
+   AT.m_Values.resize(m_Values.size());
+
+   for (size_t k = 0 ; k < m_ColIndex.size() ; k++)
+      {
+      AT.m_RowStart[m_ColIndex[k] + 1]++;
+      } // end for
+   for (size_t c = 0 ; c < m_nCols ; c++)
+      {
+      AT.m_RowStart[c + 1] += AT.m_RowStart[c];
+      } // end for
+
+   std::vector<size_t> Next(AT.m_RowStart.begin(), AT.m_RowStart.end() - 1);
+   for (size_t r = 0 ; r < m_nRows ; r++)
+      {
+      for (size_t k = m_RowStart[r] ; k < m_RowStart[r + 1] ; k++)
+         {
+         const size_t nDest = Next[m_ColIndex[k]]++;
+         AT.m_ColIndex[nDest] = r;
+         AT.m_Values[nDest] = m_Values[k];
+         } // end for
+      } // end for
+
+   return;
+
+   } // End of function DSparseMatrix::Transpose
+
+/*****************************************************************************
+*
+*  DSparseMatrix::Diagonal
+*
+*****************************************************************************/
+
+template <typename T>
+void DSparseMatrix<T>::Diagonal(std::vector<T>& d) const
+   {
+   const size_t n = std::min(m_nRows, m_nCols);
+   d.resize(n);
+   for (size_t i = 0 ; i < n ; i++)
+      {
+      d[i] = Get(i, i);
+      } // end for
+
+   return;
+
+   } // End of function DSparseMatrix::Diagonal
+
+/*****************************************************************************
+*
+*  DSparseMatrix::MulRows
+*
+*  y[r] = row r of A dotted with x for rows nRow0 to nRow1 - 1.
+*
+*****************************************************************************/
+
+template <typename T>
+void DSparseMatrix<T>::MulRows(size_t nRow0, size_t nRow1, const T* x,
+      T* y) const
+   {
+   const size_t* pCol = m_ColIndex.data();
+   const T* pVal = m_Values.data();
+   for (size_t r = nRow0 ; r < nRow1 ; r++)
+      {
+      T Sum = 0;
+      for (size_t k = m_RowStart[r] ; k < m_RowStart[r + 1] ; k++)
+         {
+         Sum += pVal[k] * x[pCol[k]];
+         } // end for
+      y[r] = Sum;
+      } // end for
+
+   return;
+
+   } // End of function DSparseMatrix::MulRows
+
+/*****************************************************************************
+*
+*  DSparseMatrix::MulVector
+*
+*  Rows are split into bands holding about the same number of nonzeros so
+*  a few dense rows don't leave the other threads idle.  Threads are only
+*  started for bands big enough to hide the cost of starting them.
+*
+*****************************************************************************/
+
+template <typename T>
+bool DSparseMatrix<T>::MulVector(const std::vector<T>& rhs,
+      std::vector<T>& out, size_t nMaxThreads) const
+   {
+   bool bRet = (rhs.size() == m_nCols) && (&rhs != &out);
+   if (bRet)
+      {
+      out.resize(m_nRows);
+      if (m_nRows == 0)
+         {
+         return (bRet);
+         } // end if
+
+      size_t nThreads = nMaxThreads;
+      if (nThreads == 0)
+         {
+         nThreads = std::max(1u, std::thread::hardware_concurrency());
+         } // end if
+      nThreads = std::min(nThreads, m_nRows);
+
+      // Every thread gets at least half of ThreadNonZeros nonzeros
+      nThreads = std::min(nThreads,
+            std::max<size_t>(1, 2 * NumNonZeros() / ThreadNonZeros));
+      if (NumNonZeros() < ThreadNonZeros)
+         {
+         nThreads = 1;
+         } // end if
+
+      if (nThreads <= 1)
+         {
+         MulRows(0, m_nRows, rhs.data(), out.data());
+         } // end if
+      else
+         {
+         const size_t nPerThread = (NumNonZeros() + nThreads - 1) / nThreads;
+         std::vector<std::thread> Threads;
+         Threads.reserve(nThreads);
+
+         // Band boundaries fall on the first row reaching each multiple of
+         // nPerThread nonzeros.  This thread takes the first band.
+         const size_t* pBegin = m_RowStart.data();
+         const size_t* pEnd = pBegin + m_nRows;
+         size_t nFirstEnd = m_nRows;
+         size_t nRow0 = 0;
+         for (size_t i = 1 ; (i <= nThreads) && (nRow0 < m_nRows) ; i++)
+            {
+            size_t nRow1 = m_nRows;
+            if (i < nThreads)
+               {
+               nRow1 = std::lower_bound(pBegin, pEnd, i * nPerThread) -
+                     pBegin;
+               nRow1 = std::max(nRow1, nRow0 + 1);
+               } // end if
+
+            if (nRow0 == 0)
+               {
+               nFirstEnd = nRow1;
+               } // end if
+            else
+               {
+               Threads.push_back(std::thread(&DSparseMatrix<T>::MulRows,
+                     this, nRow0, nRow1, rhs.data(), out.data()));
+               } // end else
+            nRow0 = nRow1;
+            } // end for
+
+         MulRows(0, nFirstEnd, rhs.data(), out.data());
+
+         for (size_t i = 0 ; i < Threads.size() ; i++)
+            {
+            Threads[i].join();
+            } // end for
+         } // end else
+      } // end if
+
+   return (bRet);
+
+   } // End of function DSparseMatrix::MulVector
+
+/*****************************************************************************
+*
+*  DSparseMatrix::MulTransposeVector
+*
+*  Scatter each row of A times its element of rhs into out.
+*
+*****************************************************************************/
+
+template <typename T>
+bool DSparseMatrix<T>::MulTransposeVector(const std::vector<T>& rhs,
+      std::vector<T>& out) const
+   {
+   bool bRet = (rhs.size() == m_nRows) && (&rhs != &out);
+   if (bRet)
+      {
+      out.assign(m_nCols, 0);
+      for (size_t r = 0 ; r < m_nRows ; r++)
+         {
+         const T x = rhs[r];
+         if (x != 0)
+            {
+            for (size_t k = m_RowStart[r] ; k < m_RowStart[r + 1] ; k++)
+               {
+               out[m_ColIndex[k]] += m_Values[k] * x;
+               } // end for
+            } // end if
+         } // end for
+      } // end if
+
+   return (bRet);
+
+   } // End of function DSparseMatrix::MulTransposeVector
+
+/*****************************************************************************
+*
+*  DSparseMatrix::Mul
+*
+*  Row r of the result is the sum of the rows of B selected by row r of A,
+*  so the inner loop runs along contiguous rows of B and Result.
+*
+*****************************************************************************/
+
+template <typename T>
+template <typename ARRAY>
+bool DSparseMatrix<T>::Mul(const DMatrix<T, ARRAY>& B,
+      DMatrix<T, ARRAY>& Result) const
+   {
+   bool bRet = (B.NumRows() == m_nCols) &&
+         (static_cast<const void*>(&B) != &Result);
+   if (bRet)
+      {
+      const size_t m = B.NumCols();
+      Result.Resize(m_nRows, m);
+      for (size_t r = 0 ; r < m_nRows ; r++)
+         {
+         T* R = Result[r];
+         std::fill(R, R + m, T(0));
+         for (size_t k = m_RowStart[r] ; k < m_RowStart[r + 1] ; k++)
+            {
+            const T a = m_Values[k];
+            const T* RB = B[m_ColIndex[k]];
+            for (size_t j = 0 ; j < m ; j++)
+               {
+               R[j] += a * RB[j];
+               } // end for
+            } // end for
+         } // end for
+      } // end if
+
+   return (bRet);
+
+   } // End of function DSparseMatrix::Mul
+
+/*****************************************************************************
+*
+*  DSparseMatrix::MulATransposexB
+*
+*  Row r of B scaled by each element of row r of A is added into the result
+*  row named by that element's column.
+*
+*****************************************************************************/
+
+template <typename T>
+template <typename ARRAY>
+bool DSparseMatrix<T>::MulATransposexB(const DMatrix<T, ARRAY>& B,
+      DMatrix<T, ARRAY>& Result) const
+   {
+   bool bRet = (B.NumRows() == m_nRows) &&
+         (static_cast<const void*>(&B) != &Result);
+   if (bRet)
+      {
+      const size_t m = B.NumCols();
+      Result.Resize(m_nCols, m);
+      Result.Zero();
+      for (size_t r = 0 ; r < m_nRows ; r++)
+         {
+         const T* RB = B[r];
+         for (size_t k = m_RowStart[r] ; k < m_RowStart[r + 1] ; k++)
+            {
+            const T a = m_Values[k];
+            T* R = Result[m_ColIndex[k]];
+            for (size_t j = 0 ; j < m ; j++)
+               {
+               R[j] += a * RB[j];
+               } // end for
+            } // end for
+         } // end for
+      } // end if
+
+   return (bRet);
+
+   } // End of function DSparseMatrix::MulATransposexB
+
+/*****************************************************************************
+*
+*  DSparseMatrix::MulATransposexA
+*
+*  Row i of A'A is the sum over the rows r of A that have an entry in
+*  column i of A(r, i) times row r of A.  A' supplies those rows and a dense
+*  accumulator with a list of touched columns builds each result row.
+*
+*****************************************************************************/
+
+template <typename T>
+void DSparseMatrix<T>::MulATransposexA(DSparseMatrix<T>& Result) const
+   {
+   assert(&Result != this);
+
+   DSparseMatrix<T> AT;
+   Transpose(AT);
+
+   Result.m_nRows = m_nCols;
+   Result.m_nCols = m_nCols;
+   Result.m_RowStart.assign(m_nCols + 1, 0);
+   Result.m_ColIndex.clear();
+   Result.m_Values.clear();
+
+   std::vector<T> Acc(m_nCols, 0);
+   std::vector<bool> Touched(m_nCols, false);
+   std::vector<size_t> Cols;
+
+   for (size_t i = 0 ; i < m_nCols ; i++)
+      {
+      Cols.clear();
+      for (size_t kt = AT.m_RowStart[i] ; kt < AT.m_RowStart[i + 1] ; kt++)
+         {
+         const size_t r = AT.m_ColIndex[kt];
+         const T a = AT.m_Values[kt];
+         for (size_t k = m_RowStart[r] ; k < m_RowStart[r + 1] ; k++)
+            {
+            const size_t j = m_ColIndex[k];
+            if (!Touched[j])
+               {
+               Touched[j] = true;
+               Cols.push_back(j);
+               } // end if
+            Acc[j] += a * m_Values[k];
+            } // end for
+         } // end for
+
+      std::sort(Cols.begin(), Cols.end());
+      for (size_t n = 0 ; n < Cols.size() ; n++)
+         {
+         const size_t j = Cols[n];
+         Result.m_ColIndex.push_back(j);
+         Result.m_Values.push_back(Acc[j]);
+         Acc[j] = 0;
+         Touched[j] = false;
+         } // end for
+      Result.m_RowStart[i + 1] = Result.m_ColIndex.size();
+      } // end for
+
+   return;
+
+   } // End of function DSparseMatrix::MulATransposexA
+
+/*****************************************************************************
+************************** class DConjugateGradient **************************
+*****************************************************************************/
+
+// Iterative solver for A x = b with A symmetric positive definite, or for
+// the normal equations J'J x = J'b given only J.  The preconditioner is the
+// inverse of the diagonal of A (or of J'J, the squared column norms of J).
+// Iteration stops once |r| <= Tolerance * |b| or after the iteration limit.
+
+template <typename T>
+class DConjugateGradient
+   {
+   public :
+      DConjugateGradient() : m_nMaxIterations(1000),
+            m_Tolerance(std::sqrt(std::numeric_limits<T>::epsilon())),
+            m_nMaxThreads(0), m_nIterations(0), m_Residual(0)
+         {
+         return;
+         }
+
+      void SetMaxIterations(size_t nMaxIterations)
+         {
+         m_nMaxIterations = nMaxIterations;
+         return;
+         }
+
+      size_t GetMaxIterations() const
+         {
+         return (m_nMaxIterations);
+         }
+
+      // Relative residual |r| / |b| at which to stop
+      void SetTolerance(T Tolerance)
+         {
+         m_Tolerance = Tolerance;
+         return;
+         }
+
+      T GetTolerance() const
+         {
+         return (m_Tolerance);
+         }
+
+      // Threads for A * x, zero uses the hardware concurrency
+      void SetMaxThreads(size_t nMaxThreads)
+         {
+         m_nMaxThreads = nMaxThreads;
+         return;
+         }
+
+      // Iterations and relative residual of the last solve
+      size_t GetIterations() const
+         {
+         return (m_nIterations);
+         }
+
+      T GetResidual() const
+         {
+         return (m_Residual);
+         }
+
+      // Solve A x = b.  If x has A's size on entry it's the starting guess,
+      // otherwise the iteration starts from zero.  Returns true if the
+      // tolerance was reached.
+      bool Solve(const DSparseMatrix<T>& A, const std::vector<T>& b,
+            std::vector<T>& x);
+
+      // Least squares solution of J x = b through J'J x = J'b without
+      // forming J'J
+      bool SolveNormal(const DSparseMatrix<T>& J, const std::vector<T>& b,
+            std::vector<T>& x);
+
+   protected :
+      typedef DVectorOps<T> Ops;
+
+      size_t m_nMaxIterations;
+      T m_Tolerance;
+      size_t m_nMaxThreads;
+      size_t m_nIterations;
+      T m_Residual;
+
+      // The preconditioned iteration with out = A * in supplied by Apply
+      bool Iterate(const std::function<void (const std::vector<T>&,
+            std::vector<T>&)>& Apply, const std::vector<T>& Diag,
+            const std::vector<T>& b, std::vector<T>& x);
+
+   private :
+   };  // End of class DConjugateGradient
+
+/*****************************************************************************
+*
+*  DConjugateGradient::Iterate
+*
+*  Standard preconditioned conjugate gradient.  Zero diagonal elements get
+*  a preconditioner of one so empty rows don't poison the iteration.
+*
+*****************************************************************************/
+
+template <typename T>
+bool DConjugateGradient<T>::Iterate(const std::function<void (
+      const std::vector<T>&, std::vector<T>&)>& Apply,
+      const std::vector<T>& Diag, const std::vector<T>& b, std::vector<T>& x)
+   {
+   const size_t n = b.size();
+   m_nIterations = 0;
+   m_Residual = 0;
+
+   std::vector<T> InvDiag(n);
+   for (size_t i = 0 ; i < n ; i++)
+      {
+      InvDiag[i] = (Diag[i] != 0) ? 1 / Diag[i] : 1;
+      } // end for
+
+   if (x.size() != n)
+      {
+      x.assign(n, 0);
+      } // end if
+
+   // r = b - A x
+   std::vector<T> r(n);
+   std::vector<T> q(n);
+   Apply(x, q);
+   for (size_t i = 0 ; i < n ; i++)
+      {
+      r[i] = b[i] - q[i];
+      } // end for
+
+   const T bNorm = Ops::Norm(b, Ops::ESummation::eFast, m_nMaxThreads);
+   if (bNorm == 0)
+      {
+      x.assign(n, 0);
+      return (true);
+      } // end if
+
+   const T Stop = m_Tolerance * bNorm;
+   T rNorm = Ops::Norm(r, Ops::ESummation::eFast, m_nMaxThreads);
+   bool bRet = (rNorm <= Stop);
+
+   std::vector<T> z(n);
+   std::vector<T> p(n);
+   for (size_t i = 0 ; i < n ; i++)
+      {
+      z[i] = InvDiag[i] * r[i];
+      } // end for
+   p = z;
+   T rz = Ops::Dot(r, z, Ops::ESummation::eFast, m_nMaxThreads);
+
+   while (!bRet && (m_nIterations < m_nMaxIterations))
+      {
+      Apply(p, q);
+      const T pq = Ops::Dot(p, q, Ops::ESummation::eFast,
+            m_nMaxThreads);
+      if (pq <= 0)
+         {
+         // A isn't positive definite along p
+         break;
+         } // end if
+
+      const T Alpha = rz / pq;
+      for (size_t i = 0 ; i < n ; i++)
+         {
+         x[i] += Alpha * p[i];
+         r[i] -= Alpha * q[i];
+         } // end for
+      m_nIterations++;
+
+      rNorm = Ops::Norm(r, Ops::ESummation::eFast, m_nMaxThreads);
+      bRet = (rNorm <= Stop);
+      if (!bRet)
+         {
+         for (size_t i = 0 ; i < n ; i++)
+            {
+            z[i] = InvDiag[i] * r[i];
+            } // end for
+         const T rzNew = Ops::Dot(r, z, Ops::ESummation::eFast,
+               m_nMaxThreads);
+         const T Beta = rzNew / rz;
+         rz = rzNew;
+         for (size_t i = 0 ; i < n ; i++)
+            {
+            p[i] = z[i] + Beta * p[i];
+            } // end for
+         } // end if
+      } // end while
+
+   m_Residual = rNorm / bNorm;
+
+   return (bRet);
+
+   } // End of function DConjugateGradient::Iterate
+
+/*****************************************************************************
+*
+*  DConjugateGradient::Solve
+*
+*****************************************************************************/
+
+template <typename T>
+bool DConjugateGradient<T>::Solve(const DSparseMatrix<T>& A,
+      const std::vector<T>& b, std::vector<T>& x)
+   {
+   bool bRet = A.IsSquare() && (b.size() == A.NumRows()) && (&b != &x);
+   if (bRet)
+      {
+      std::vector<T> Diag;
+      A.Diagonal(Diag);
+      const size_t nMaxThreads = m_nMaxThreads;
+      bRet = Iterate([&A, nMaxThreads](const std::vector<T>& in,
+            std::vector<T>& out)
+               {
+               A.MulVector(in, out, nMaxThreads);
+               }, Diag, b, x);
+      } // end if
+
+   return (bRet);
+
+   } // End of function DConjugateGradient::Solve
+
+/*****************************************************************************
+*
+*  DConjugateGradient::SolveNormal
+*
+*  J'J is applied as J' (J p).  J is transposed once up front so both
+*  products are row ordered gathers that thread the same way.
+*
+*****************************************************************************/
+
+template <typename T>
+bool DConjugateGradient<T>::SolveNormal(const DSparseMatrix<T>& J,
+      const std::vector<T>& b, std::vector<T>& x)
+   {
+   bool bRet = (b.size() == J.NumRows()) && (&b != &x);
+   if (bRet)
+      {
+      DSparseMatrix<T> JT;
+      J.Transpose(JT);
+
+      // Diagonal of J'J is the squared norm of each column of J
+      std::vector<T> Diag(J.NumCols(), 0);
+      for (size_t c = 0 ; c < JT.NumRows() ; c++)
+         {
+         for (size_t k = JT.RowBegin(c) ; k < JT.RowEnd(c) ; k++)
+            {
+            Diag[c] += JT.Value(k) * JT.Value(k);
+            } // end for
+         } // end for
+
+      std::vector<T> JTb;
+      JT.MulVector(b, JTb, m_nMaxThreads);
+
+      std::vector<T> Jp(J.NumRows());
+      const size_t nMaxThreads = m_nMaxThreads;
+      bRet = Iterate([&J, &JT, &Jp, nMaxThreads](const std::vector<T>& in,
+            std::vector<T>& out)
+               {
+               J.MulVector(in, Jp, nMaxThreads);
+               JT.MulVector(Jp, out, nMaxThreads);
+               }, Diag, JTb, x);
+      } // end if
+
+   return (bRet);
+
+   } // End of function DConjugateGradient::SolveNormal
+
+#endif // __DSPARSEMATRIX_H__
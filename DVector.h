@@ -13,16 +13,24 @@
 
 #include <vector>
 #include <cassert>
+#include <utility>
+#include <memory>
+#include "DAllocator.h"
+#include "DVectorOps.h"
 
 /*****************************************************************************
 ******************************* class DVector ********************************
 *****************************************************************************/
 
-template <typename T>
-class DVector : public std::vector<T>
+// ALLOC defaults to the standard allocator so a DVector still converts to
+// and from std::vector<T>.  DVector<T, DAlignedAllocator<T> > gives cache
+// line aligned storage.
+
+template <typename T, typename ALLOC = std::allocator<T> >
+class DVector : public std::vector<T, ALLOC>
    {
    protected :
-      typedef std::vector<T> BASE;
+      typedef std::vector<T, ALLOC> BASE;
    
    public :
       typedef T T_numtype;
@@ -46,44 +54,61 @@ class DVector : public std::vector<T>
          {
          return;
          }
+
+      DVector(DVector&& src) : BASE(std::move(src))
+         {
+         return;
+         }
+
+      DVector(BASE&& src) : BASE(std::move(src))
+         {
+         return;
+         }
       
       ~DVector()
          {
          return;
          }
       
-      DVector<T>& operator=(const DVector<T>& rhs)
+      DVector& operator=(const DVector& rhs)
          {
          BASE::operator=(rhs);
          return (*this);
          }
 
-      DVector<T>& operator=(const BASE& rhs)
+      DVector& operator=(const BASE& rhs)
          {
          BASE::operator=(rhs);
          return (*this);
          }
 
+      DVector& operator=(DVector&& rhs)
+         {
+         BASE::operator=(std::move(rhs));
+         return (*this);
+         }
+
+      DVector& operator=(BASE&& rhs)
+         {
+         BASE::operator=(std::move(rhs));
+         return (*this);
+         }
+
       // Return the length of this vector
       T Length() const
          {
-         return (sqrt(Dot(*this, *this)));
+         return (DVectorOps<T>::Norm(*this));
          }
       
       // Return the dot product of x and y
-      static T Dot(const DVector<T>& x, const DVector<T>& y)
+      static T Dot(const DVector& x, const DVector& y)
          {
          assert(x.size() == y.size());
-         T D = 0;
-         for (size_t i = 0 ; i < x.size() ; i++)
-            {
-            D += x[i] * y[i];
-            } // end for
-         return (D);
+         return (DVectorOps<T>::Dot(x, y));
          }
       
       // Take the dot product of this vector and x
-      T Dot(const DVector<T>& x) const
+      T Dot(const DVector& x) const
          {
          return (Dot(*this, x));
          }
@@ -91,20 +116,11 @@ class DVector : public std::vector<T>
       // Reduce this to a unit vector
       bool Normalize()
          {
-         T L = Length();
-         bool bRet = (L > 0);
-         if (bRet)
-            {
-            for (size_t i = 0 ; i < this->size() ; i++)
-               {
-               (*this)[i] /= L;
-               } // end for
-            } // end if
-         return (bRet);
+         return (DVectorOps<T>::Normalize(*this) > 0);
          }
 
       // Make this vector the cross product of a and b (a x b)
-      bool Cross(const DVector<T>& a, const DVector<T>& b);
+      bool Cross(const DVector& a, const DVector& b);
             
    protected :
    
@@ -127,8 +143,8 @@ class DVector : public std::vector<T>
 *
 *****************************************************************************/
 
-template <typename T>
-bool DVector<T>::Cross(const DVector<T>& a, const DVector<T>& b)
+template <typename T, typename ALLOC>
+bool DVector<T, ALLOC>::Cross(const DVector& a, const DVector& b)
    {
    // a and b must be the same size and have dimension 3
    bool bRet = (a.size() == b.size()) && (a.size() == 3);
@@ -0,0 +1,499 @@
+/*****************************************************************************
+******************************** DVectorOps.h ********************************
+*****************************************************************************/
+
+#if !defined(__DVECTOROPS_H__)
+#define __DVECTOROPS_H__
+
+/*
+   Reduction and update kernels for dense vectors.
+
+      Dot, SumSquares, Norm    reductions
+      Axpy                     y += a * x
+      Scale                    x *= a
+      Normalize                x /= |x|
+
+   The kernels take DSpan arguments, a pointer and a length, so they work on
+   borrowed memory such as a cv::Mat row as well as std::vector and DVector,
+   which convert implicitly:
+
+      DVectorOps<float>::Dot(DSpan<const float>(M.ptr<float>(r), M.cols), v);
+
+   Without -ffast-math the compiler won't reorder a floating point sum, so a
+   single accumulator loop runs at the latency of one add per element.  The
+   fast reductions keep Lanes independent partial sums instead, which the
+   compiler maps onto SIMD registers and which also hide the add latency.
+   The summation order, and so the last bits of the result, therefore
+   differ from a plain loop.
+
+   ESummation selects the accuracy:
+
+      eFast      Lanes partial sums
+      ePairwise  recursive halving down to Leaf elements summed with the fast
+                 kernel.  Error grows as log(n) rather than n.
+      eKahan     compensated summation in each lane.  Error is independent
+                 of n but costs about four times as much.
+
+   Vectors of ThreadSize or more elements are split into equal chunks across
+   threads.  nMaxThreads of zero uses the hardware concurrency and one keeps
+   everything on the calling thread.  The chunking depends on the thread
+   count so threaded reductions are only reproducible for a fixed count.
+*/
+
+/*****************************************************************************
+******************************  I N C L U D E  *******************************
+*****************************************************************************/
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include <thread>
+#include <type_traits>
+#include "DSpan.h"
+
+/*****************************************************************************
+****************************** class DVectorOps ******************************
+*****************************************************************************/
+
+template <typename T>
+class DVectorOps
+   {
+   public :
+      enum class ESummation { eFast, ePairwise, eKahan };
+
+      // Independent partial sums in the fast and Kahan kernels
+      static const size_t Lanes = 8;
+
+      // Pairwise summation stops halving at this many elements
+      static const size_t Leaf = 256;
+
+      // Below this many elements a single thread is used
+      static const size_t ThreadSize = 1 << 18;
+
+      static T Dot(DSpan<const T> x, DSpan<const T> y,
+            ESummation eSum = ESummation::eFast, size_t nMaxThreads = 1);
+
+      static T SumSquares(DSpan<const T> x,
+            ESummation eSum = ESummation::eFast, size_t nMaxThreads = 1)
+         {
+         return (Dot(x, x, eSum, nMaxThreads));
+         }
+
+      // Euclidean length of x
+      static T Norm(DSpan<const T> x, ESummation eSum = ESummation::eFast,
+            size_t nMaxThreads = 1)
+         {
+         return (std::sqrt(SumSquares(x, eSum, nMaxThreads)));
+         }
+
+      // y += a * x
+      static void Axpy(T a, DSpan<const T> x, DSpan<T> y,
+            size_t nMaxThreads = 1);
+
+      // x *= a
+      static void Scale(T a, DSpan<T> x, size_t nMaxThreads = 1);
+
+      // Scale x to unit length and return its original length.  x is left
+      // alone if its length is zero.
+      static T Normalize(DSpan<T> x, ESummation eSum = ESummation::eFast,
+            size_t nMaxThreads = 1);
+
+   protected :
+      static T DotFast(const T* x, const T* y, size_t n);
+      static T DotPairwise(const T* x, const T* y, size_t n);
+      static T DotKahan(const T* x, const T* y, size_t n);
+      static T DotRange(const T* x, const T* y, size_t n, ESummation eSum);
+
+      static void AxpyRange(T a, const T* x, T* y, size_t n);
+      static void ScaleRange(T a, T* x, size_t n);
+
+      static size_t NumThreads(size_t n, size_t nMaxThreads);
+
+      // Run Func(i0, i1, nPart) over nThreads equal chunks of [0, n)
+      template <typename FUNC>
+      static void ForChunks(size_t n, size_t nThreads, const FUNC& Func);
+
+   private :
+   };  // End of class DVectorOps
+
+template <typename T>
+const size_t DVectorOps<T>::Lanes;
+
+template <typename T>
+const size_t DVectorOps<T>::Leaf;
+
+template <typename T>
+const size_t DVectorOps<T>::ThreadSize;
+
+/*****************************************************************************
+*
+*  DVectorOps::NumThreads
+*
+*****************************************************************************/
+
+template <typename T>
+size_t DVectorOps<T>::NumThreads(size_t n, size_t nMaxThreads)
+   {
+   size_t nThreads = nMaxThreads;
+   if (nThreads == 0)
+      {
+      nThreads = std::max(1u, std::thread::hardware_concurrency());
+      } // end if
+
+   // Every thread gets at least half of ThreadSize elements
+   nThreads = std::min(nThreads, std::max<size_t>(1, 2 * n / ThreadSize));
+   if (n < ThreadSize)
+      {
+      nThreads = 1;
+      } // end if
+
+   return (nThreads);
+
+   } // End of function DVectorOps::NumThreads
+
+/*****************************************************************************
+*
+*  DVectorOps::ForChunks
+*
+*  The calling thread takes the first chunk.
+*
+*****************************************************************************/
+
+template <typename T>
+template <typename FUNC>
+void DVectorOps<T>::ForChunks(size_t n, size_t nThreads, const FUNC& Func)
+   {
+   const size_t nChunk = (n + nThreads - 1) / nThreads;
+
+   std::vector<std::thread> Threads;
+   Threads.reserve(nThreads);
+   size_t nPart = 1;
+   for (size_t i0 = nChunk ; i0 < n ; i0 += nChunk, nPart++)
+      {
+      Threads.push_back(std::thread(std::cref(Func), i0,
+            std::min(n, i0 + nChunk), nPart));
+      } // end for
+
+   Func(0, std::min(n, nChunk), 0);
+
+   for (size_t i = 0 ; i < Threads.size() ; i++)
+      {
+      Threads[i].join();
+      } // end for
+
+   return;
+
+   } // End of function DVectorOps::ForChunks
+
+/*****************************************************************************
+*
+*  DVectorOps::DotFast
+*
+*  Lanes independent partial sums over the bulk, a scalar tail, then the
+*  partial sums folded together.
+*
+*****************************************************************************/
+
+template <typename T>
+T DVectorOps<T>::DotFast(const T* x, const T* y, size_t n)
+   {
+   T Sum[Lanes] = {};
+
+   const size_t nBulk = n - (n % Lanes);
+   for (size_t i = 0 ; i < nBulk ; i += Lanes)
+      {
+      for (size_t j = 0 ; j < Lanes ; j++)
+         {
+         Sum[j] += x[i + j] * y[i + j];
+         } // end for
+      } // end for
+
+   for (size_t i = nBulk ; i < n ; i++)
+      {
+      Sum[i - nBulk] += x[i] * y[i];
+      } // end for
+
+   for (size_t nWidth = Lanes / 2 ; nWidth > 0 ; nWidth /= 2)
+      {
+      for (size_t j = 0 ; j < nWidth ; j++)
+         {
+         Sum[j] += Sum[j + nWidth];
+         } // end for
+      } // end for
+
+   return (Sum[0]);
+
+   } // End of function DVectorOps::DotFast
+
+/*****************************************************************************
+*
+*  DVectorOps::DotPairwise
+*
+*  The halves are split on a multiple of Lanes to keep the fast kernel on
+*  whole vectors.
+*
+*****************************************************************************/
+
+template <typename T>
+T DVectorOps<T>::DotPairwise(const T* x, const T* y, size_t n)
+   {
+   T Ret;
+   if (n <= Leaf)
+      {
+      Ret = DotFast(x, y, n);
+      } // end if
+   else
+      {
+      const size_t nHalf = ((n / 2) / Lanes) * Lanes;
+      Ret = DotPairwise(x, y, nHalf) +
+            DotPairwise(x + nHalf, y + nHalf, n - nHalf);
+      } // end else
+
+   return (Ret);
+
+   } // End of function DVectorOps::DotPairwise
+
+/*****************************************************************************
+*
+*  DVectorOps::DotKahan
+*
+*  Kahan summation in each lane, then the lanes and their compensations
+*  combined with one more compensated pass.
+*
+*****************************************************************************/
+
+template <typename T>
+T DVectorOps<T>::DotKahan(const T* x, const T* y, size_t n)
+   {
+   T Sum[Lanes] = {};
+   T Comp[Lanes] = {};
+
+   const size_t nBulk = n - (n % Lanes);
+   for (size_t i = 0 ; i < nBulk ; i += Lanes)
+      {
+      for (size_t j = 0 ; j < Lanes ; j++)
+         {
+         const T v = x[i + j] * y[i + j] - Comp[j];
+         const T t = Sum[j] + v;
+         Comp[j] = (t - Sum[j]) - v;
+         Sum[j] = t;
+         } // end for
+      } // end for
+
+   for (size_t i = nBulk ; i < n ; i++)
+      {
+      const size_t j = i - nBulk;
+      const T v = x[i] * y[i] - Comp[j];
+      const T t = Sum[j] + v;
+      Comp[j] = (t - Sum[j]) - v;
+      Sum[j] = t;
+      } // end for
+
+   T Total = 0;
+   T c = 0;
+   for (size_t j = 0 ; j < Lanes ; j++)
+      {
+      const T v = Sum[j] - (Comp[j] + c);
+      const T t = Total + v;
+      c = (t - Total) - v;
+      Total = t;
+      } // end for
+
+   return (Total);
+
+   } // End of function DVectorOps::DotKahan
+
+/*****************************************************************************
+*
+*  DVectorOps::DotRange
+*
+*****************************************************************************/
+
+template <typename T>
+T DVectorOps<T>::DotRange(const T* x, const T* y, size_t n, ESummation eSum)
+   {
+   T Ret;
+   switch (eSum)
+      {
+      case ESummation::ePairwise :
+         Ret = DotPairwise(x, y, n);
+         break;
+
+      case ESummation::eKahan :
+         Ret = DotKahan(x, y, n);
+         break;
+
+      default :
+         Ret = DotFast(x, y, n);
+         break;
+      } // end switch
+
+   return (Ret);
+
+   } // End of function DVectorOps::DotRange
+
+/*****************************************************************************
+*
+*  DVectorOps::Dot
+*
+*  Each thread reduces its own chunk and the chunk sums are combined with
+*  the same summation method, in chunk order.
+*
+*****************************************************************************/
+
+template <typename T>
+T DVectorOps<T>::Dot(DSpan<const T> x, DSpan<const T> y, ESummation eSum,
+      size_t nMaxThreads)
+   {
+   assert(x.size() == y.size());
+   const size_t n = x.size();
+   const size_t nThreads = NumThreads(n, nMaxThreads);
+
+   T Ret;
+   if (nThreads <= 1)
+      {
+      Ret = DotRange(x.data(), y.data(), n, eSum);
+      } // end if
+   else
+      {
+      std::vector<T> Partial(nThreads, 0);
+      ForChunks(n, nThreads, [&](size_t i0, size_t i1, size_t nPart)
+         {
+         Partial[nPart] = DotRange(x.data() + i0, y.data() + i0, i1 - i0,
+               eSum);
+         });
+
+      const std::vector<T> Ones(nThreads, 1);
+      Ret = DotRange(Partial.data(), Ones.data(), nThreads, eSum);
+      } // end else
+
+   return (Ret);
+
+   } // End of function DVectorOps::Dot
+
+/*****************************************************************************
+*
+*  DVectorOps::AxpyRange
+*
+*****************************************************************************/
+
+template <typename T>
+void DVectorOps<T>::AxpyRange(T a, const T* x, T* y, size_t n)
+   {
+   for (size_t i = 0 ; i < n ; i++)
+      {
+      y[i] += a * x[i];
+      } // end for
+
+   return;
+
+   } // End of function DVectorOps::AxpyRange
+
+/*****************************************************************************
+*
+*  DVectorOps::Axpy
+*
+*****************************************************************************/
+
+template <typename T>
+void DVectorOps<T>::Axpy(T a, DSpan<const T> x, DSpan<T> y,
+      size_t nMaxThreads)
+   {
+   assert(x.size() == y.size());
+   const size_t n = x.size();
+   const size_t nThreads = NumThreads(n, nMaxThreads);
+
+   if (nThreads <= 1)
+      {
+      AxpyRange(a, x.data(), y.data(), n);
+      } // end if
+   else
+      {
+      ForChunks(n, nThreads, [&](size_t i0, size_t i1, size_t)
+         {
+         AxpyRange(a, x.data() + i0, y.data() + i0, i1 - i0);
+         });
+      } // end else
+
+   return;
+
+   } // End of function DVectorOps::Axpy
+
+/*****************************************************************************
+*
+*  DVectorOps::ScaleRange
+*
+*****************************************************************************/
+
+template <typename T>
+void DVectorOps<T>::ScaleRange(T a, T* x, size_t n)
+   {
+   for (size_t i = 0 ; i < n ; i++)
+      {
+      x[i] *= a;
+      } // end for
+
+   return;
+
+   } // End of function DVectorOps::ScaleRange
+
+/*****************************************************************************
+*
+*  DVectorOps::Scale
+*
+*****************************************************************************/
+
+template <typename T>
+void DVectorOps<T>::Scale(T a, DSpan<T> x, size_t nMaxThreads)
+   {
+   const size_t n = x.size();
+   const size_t nThreads = NumThreads(n, nMaxThreads);
+
+   if (nThreads <= 1)
+      {
+      ScaleRange(a, x.data(), n);
+      } // end if
+   else
+      {
+      ForChunks(n, nThreads, [&](size_t i0, size_t i1, size_t)
+         {
+         ScaleRange(a, x.data() + i0, i1 - i0);
+         });
+      } // end else
+
+   return;
+
+   } // End of function DVectorOps::Scale
+
+/*****************************************************************************
+*
+*  DVectorOps::Normalize
+*
+*  One reduction pass for the length and one multiply by its reciprocal,
+*  rather than a divide per element.  The reciprocal of an integer length
+*  is zero, so integral types keep the divide.
+*
+*****************************************************************************/
+
+template <typename T>
+T DVectorOps<T>::Normalize(DSpan<T> x, ESummation eSum, size_t nMaxThreads)
+   {
+   const T L = Norm(x, eSum, nMaxThreads);
+   if ((L > 0) && std::is_integral<T>::value)
+      {
+      for (size_t i = 0 ; i < x.size() ; i++)
+         {
+         x[i] /= L;
+         } // end for
+      } // end if
+   else if (L > 0)
+      {
+      Scale(1 / L, x, nMaxThreads);
+      } // end else if
+
+   return (L);
+
+   } // End of function DVectorOps::Normalize
+
+#endif // __DVECTOROPS_H__
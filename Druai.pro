@@ -46,6 +46,9 @@ SOURCES += \
       CVImage.cpp \
       DQOpenCV.cpp \
       CameraCalibration.cpp \
+      CameraCalibrationFile.cpp \
+      CameraUndistorter.cpp \
+      StereoCameraCalibration.cpp \
       DPersistentMainWindow.cpp
 
 HEADERS += \
@@ -60,8 +63,12 @@ HEADERS += \
       DQRubberBand.h \
       DQCVImageUtils.h \
       CVImage.h \
+      CVImageExpr.h \
       DQOpenCV.h \
       CameraCalibration.h \
+      CameraCalibrationFile.h \
+      CameraUndistorter.h \
+      StereoCameraCalibration.h \
       DPersistentMainWindow.h
 
 
@@ -45,17 +45,23 @@ DImageWidget::DImageWidget(QWidget* pParent /* = nullptr */) :
 
 bool DImageWidget::SetImage(const QImage& Image)
    {
-   bool bRet = true;
+   m_Image = Image;
 
-   // Work with a copy until we figure out exactly how the copy on change works
-   m_Image = Image.copy();
+   return (NewImage());
 
-   // Keep the existing ROI between frames (make a setting?)
-   m_Image.SetROI(m_pRubberBand->geometry());
+   } // end of method DImageWidget::SetImage
 
-   update();
+/*****************************************************************************
+ *
+ ***  DImageWidget::SetImage
+ *
+ *****************************************************************************/
 
-   return (bRet);
+bool DImageWidget::SetImage(const DQImage& Image)
+   {
+   m_Image = Image;
+
+   return (NewImage());
 
    } // end of method DImageWidget::SetImage
 
@@ -65,12 +71,55 @@ bool DImageWidget::SetImage(const QImage& Image)
  *
  *****************************************************************************/
 
-bool DImageWidget::SetImage(const DQImage& Image)
+bool DImageWidget::SetImage(QImage&& Image)
    {
-   bool bRet = true;
+   m_Image = std::move(Image);
+
+   return (NewImage());
+
+   } // end of method DImageWidget::SetImage
+
+/*****************************************************************************
+ *
+ ***  DImageWidget::SetImage
+ *
+ *****************************************************************************/
 
-   // Work with a copy until we figure out exactly how the copy on change works
-   m_Image = Image.copy();
+bool DImageWidget::SetImage(DQImage&& Image)
+   {
+   m_Image = std::move(Image);
+
+   return (NewImage());
+
+   } // end of method DImageWidget::SetImage
+
+/*****************************************************************************
+ *
+ ***  DImageWidget::SetImage
+ *
+ * Wrap a pooled buffer.  QImage calls ReleaseFunction when the last image
+ * sharing it goes away, which hands the buffer back to the pool.
+ *
+ *****************************************************************************/
+
+bool DImageWidget::SetImage(const uchar* pData, int nWidth, int nHeight, int nBytesPerLine,
+      QImage::Format eFormat, QImageCleanupFunction ReleaseFunction, void* pReleaseInfo)
+   {
+   m_Image = DQImage(pData, nWidth, nHeight, nBytesPerLine, eFormat, ReleaseFunction, pReleaseInfo);
+
+   return (NewImage());
+
+   } // end of method DImageWidget::SetImage
+
+/*****************************************************************************
+ *
+ ***  DImageWidget::NewImage
+ *
+ *****************************************************************************/
+
+bool DImageWidget::NewImage()
+   {
+   bool bRet = !m_Image.isNull();
 
    // Keep the existing ROI between frames (make a setting?)
    m_Image.SetROI(m_pRubberBand->geometry());
@@ -79,7 +128,7 @@ bool DImageWidget::SetImage(const DQImage& Image)
 
    return (bRet);
 
-   } // end of method DImageWidget::SetImage
+   } // end of method DImageWidget::NewImage
 
 /*****************************************************************************
  *
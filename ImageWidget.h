@@ -41,8 +41,22 @@ class DImageWidget : public QWidget
 
       DImageWidget& operator=(const DImageWidget& rhs) = delete;
 
+      // The widget shares the image's pixels through QImage's implicit
+      // sharing rather than copying them, and only detaches if something
+      // writes to the image through GetImage().  An image wrapping memory it
+      // doesn't own (no cleanup function) must be copied by the caller.
       bool SetImage(const QImage& Image);
       bool SetImage(const DQImage& Image);
+      bool SetImage(QImage&& Image);
+      bool SetImage(DQImage&& Image);
+
+      // Display a buffer from a caller's pool without copying it.
+      // ReleaseFunction(pReleaseInfo) is called once the widget and any
+      // images sharing it are done with the buffer, normally on the GUI
+      // thread.  The buffer is treated as read only so a write detaches onto
+      // a copy.
+      bool SetImage(const uchar* pData, int nWidth, int nHeight, int nBytesPerLine,
+            QImage::Format eFormat, QImageCleanupFunction ReleaseFunction, void* pReleaseInfo);
 
       bool IsRubberBand() const
          {
@@ -93,6 +107,7 @@ class DImageWidget : public QWidget
       void mouseReleaseEvent(QMouseEvent *pEvent);
 
    private:
+      bool NewImage();
 
    }; // end of class DImageWidget
 
@@ -0,0 +1,580 @@
+/*****************************************************************************
+ ******************************  I N C L U D E  ******************************
+ ****************************************************************************/
+
+#include <algorithm>
+
+#include "StereoCameraCalibration.h"
+#include "CameraCalibrationFile.h"
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+
+/******************************************************************************
+*
+***  class DDetectPair
+*
+* Parallel body searching both images of a pair at the same time.
+*
+******************************************************************************/
+
+class DDetectPair : public cv::ParallelLoopBody
+   {
+   public:
+      DDetectPair(const CameraCalibrationBoard& Board, int nCoarseWidth,
+            const cv::Mat* pImages, const cv::Mat* pGrayImages,
+            std::vector<cv::Point2f>* pPoints, bool* pFound) :
+            m_Board(Board),
+            m_nCoarseWidth(nCoarseWidth),
+            m_pImages(pImages),
+            m_pGrayImages(pGrayImages),
+            m_pPoints(pPoints),
+            m_pFound(pFound)
+         {
+         return;
+         }
+
+      virtual void operator()(const cv::Range& Range) const
+         {
+         for (int i = Range.start ; i < Range.end ; i++)
+            {
+            m_pFound[i] = m_Board.FindPattern(m_pImages[i], m_pGrayImages[i],
+                  m_pPoints[i], m_nCoarseWidth);
+            } // end for
+
+         return;
+         }
+
+   protected:
+      const CameraCalibrationBoard& m_Board;
+      int m_nCoarseWidth;
+      const cv::Mat* m_pImages;
+      const cv::Mat* m_pGrayImages;
+      std::vector<cv::Point2f>* m_pPoints;
+      bool* m_pFound;
+
+   private:
+
+   }; // end of class DDetectPair
+
+/******************************************************************************
+*
+***  class DRemapPair
+*
+* Parallel body rectifying both images in horizontal bands.  Range indices
+* below nBands are left bands, the rest right.
+*
+******************************************************************************/
+
+class DRemapPair : public cv::ParallelLoopBody
+   {
+   public:
+      DRemapPair(const cv::Mat* pSrc, cv::Mat* pDst, const cv::Mat* pMap1,
+            const cv::Mat* pMap2, int nBands) :
+            m_pSrc(pSrc),
+            m_pDst(pDst),
+            m_pMap1(pMap1),
+            m_pMap2(pMap2),
+            m_nBands(nBands)
+         {
+         return;
+         }
+
+      virtual void operator()(const cv::Range& Range) const
+         {
+         for (int i = Range.start ; i < Range.end ; i++)
+            {
+            int nCamera = i / m_nBands;
+            int nBand = i % m_nBands;
+            int nRows = m_pDst[nCamera].rows;
+            cv::Range Rows((nRows * nBand) / m_nBands, (nRows * (nBand + 1)) / m_nBands);
+
+            cv::Mat DstBand = m_pDst[nCamera].rowRange(Rows);
+            cv::remap(m_pSrc[nCamera], DstBand, m_pMap1[nCamera].rowRange(Rows),
+                  m_pMap2[nCamera].rowRange(Rows), cv::INTER_LINEAR,
+                  cv::BORDER_CONSTANT);
+            } // end for
+
+         return;
+         }
+
+   protected:
+      const cv::Mat* m_pSrc;
+      cv::Mat* m_pDst;
+      const cv::Mat* m_pMap1;
+      const cv::Mat* m_pMap2;
+      int m_nBands;
+
+   private:
+
+   }; // end of class DRemapPair
+
+/*****************************************************************************
+ ***  class StereoCameraCalibration
+ ****************************************************************************/
+
+/******************************************************************************
+*
+***  StereoCameraCalibration::StereoCameraCalibration
+*
+******************************************************************************/
+
+StereoCameraCalibration::StereoCameraCalibration() :
+      m_nStereoFlag(cv::CALIB_FIX_INTRINSIC),
+      m_dAlpha(0.0),
+      m_ImageSize(640, 480),
+      m_dRMS(0.0)
+   {
+
+   return;
+
+   } // end of method StereoCameraCalibration::StereoCameraCalibration
+
+/******************************************************************************
+*
+***  StereoCameraCalibration::Initialize
+*
+******************************************************************************/
+
+bool StereoCameraCalibration::Initialize(const CameraCalibrationBoard& Board,
+      const cv::Size& ImageSize, bool bFixAspectRatio, int nFlag,
+      int nStereoFlag /* = cv::CALIB_FIX_INTRINSIC */,
+      double dAlpha /* = 0.0 */, bool bSaveImages /* = false */)
+   {
+   bool bRet = m_Left.Initialize(Board, ImageSize, bFixAspectRatio, nFlag, bSaveImages)
+         && m_Right.Initialize(Board, ImageSize, bFixAspectRatio, nFlag, bSaveImages);
+
+   m_nStereoFlag = nStereoFlag;
+   m_dAlpha = dAlpha;
+   m_ImageSize = ImageSize;
+   m_dRMS = 0.0;
+
+   for (int i = 0 ; i < 2 ; i++)
+      {
+      m_CameraMatrix[i].release();
+      m_DistortionCoeffs[i].release();
+      m_ValidROI[i] = cv::Rect();
+      m_Map1[i].release();
+      m_Map2[i].release();
+      } // end for
+
+   return (bRet);
+
+   } // end of method StereoCameraCalibration::Initialize
+
+/******************************************************************************
+*
+***  StereoCameraCalibration::ProcessImagePair
+*
+* Search both frames in parallel.  The pair is only used (and annotated) when
+* the board was found in both since stereoCalibrate needs the same points in
+* each view.
+*
+******************************************************************************/
+
+bool StereoCameraCalibration::ProcessImagePair(cv::Mat& LeftImage,
+      cv::Mat& LeftGrayImage, cv::Mat& RightImage, cv::Mat& RightGrayImage,
+      bool bAnnotateImages, bool bUseImages)
+   {
+   const cv::Mat Images[2] = { LeftImage, RightImage };
+   const cv::Mat GrayImages[2] = { LeftGrayImage, RightGrayImage };
+   std::vector<cv::Point2f> Points[2];
+   bool Found[2] = { false, false };
+
+   cv::parallel_for_(cv::Range(0, 2),
+         DDetectPair(m_Left.GetBoard(), m_Left.GetCoarseWidth(), Images,
+               GrayImages, Points, Found));
+
+   bool bFound = Found[eLeft] && Found[eRight];
+   if (bFound)
+      {
+      if (bUseImages && m_Left.AddImagePoints(Points[eLeft], LeftImage))
+         {
+         // Keep the two sides paired if the right image couldn't be saved
+         if (!m_Right.AddImagePoints(Points[eRight], RightImage))
+            {
+            m_Left.RemoveView(m_Left.GetImagePoints().size() - 1);
+            } // end if
+         } // end if
+
+      if (bAnnotateImages)
+         {
+         m_Left.GetBoard().DrawPattern(LeftImage, Points[eLeft], bFound);
+         m_Right.GetBoard().DrawPattern(RightImage, Points[eRight], bFound);
+         } // end if
+      } // end if
+
+   return (bFound);
+
+   } // end of method StereoCameraCalibration::ProcessImagePair
+
+/******************************************************************************
+*
+***  StereoCameraCalibration::RunCalibration
+*
+******************************************************************************/
+
+bool StereoCameraCalibration::RunCalibration()
+   {
+   const auto& LeftPoints = m_Left.GetImagePoints();
+   const auto& RightPoints = m_Right.GetImagePoints();
+
+   bool bRet = !LeftPoints.empty() && (LeftPoints.size() == RightPoints.size())
+         && m_Left.RunCalibration() && m_Right.RunCalibration();
+
+   if (bRet)
+      {
+      m_CameraMatrix[eLeft] = m_Left.GetCameraMatrix().clone();
+      m_DistortionCoeffs[eLeft] = m_Left.GetDistortionCoeffs().clone();
+      m_CameraMatrix[eRight] = m_Right.GetCameraMatrix().clone();
+      m_DistortionCoeffs[eRight] = m_Right.GetDistortionCoeffs().clone();
+      m_ImageSize = m_Left.GetImageSize();
+
+      // Every pair is a whole board view so they all share the board's points
+      std::vector<cv::Mat> ObjectPoints(LeftPoints.size(),
+            m_Left.GetBoard().GetObjectPoints());
+
+      m_dRMS = cv::stereoCalibrate(ObjectPoints, LeftPoints, RightPoints,
+            m_CameraMatrix[eLeft], m_DistortionCoeffs[eLeft],
+            m_CameraMatrix[eRight], m_DistortionCoeffs[eRight],
+            m_ImageSize, m_R, m_T, m_E, m_F, m_nStereoFlag,
+            cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 100, 1e-6));
+
+      bRet = cv::checkRange(m_R) && cv::checkRange(m_T) && Rectify();
+      } // end if
+
+   return (bRet);
+
+   } // end of method StereoCameraCalibration::RunCalibration
+
+/******************************************************************************
+*
+***  StereoCameraCalibration::Rectify
+*
+* Compute the rectification from the stereo calibration and build the maps.
+*
+******************************************************************************/
+
+bool StereoCameraCalibration::Rectify()
+   {
+   cv::stereoRectify(m_CameraMatrix[eLeft], m_DistortionCoeffs[eLeft],
+         m_CameraMatrix[eRight], m_DistortionCoeffs[eRight], m_ImageSize,
+         m_R, m_T, m_R1, m_R2, m_P1, m_P2, m_Q, cv::CALIB_ZERO_DISPARITY,
+         m_dAlpha, m_ImageSize, &m_ValidROI[eLeft], &m_ValidROI[eRight]);
+
+   BuildMaps();
+
+   return (cv::checkRange(m_Q));
+
+   } // end of method StereoCameraCalibration::Rectify
+
+/******************************************************************************
+*
+***  StereoCameraCalibration::BuildMaps
+*
+* Fixed-point maps, the fastest form for cv::remap.
+*
+******************************************************************************/
+
+void StereoCameraCalibration::BuildMaps()
+   {
+   cv::initUndistortRectifyMap(m_CameraMatrix[eLeft], m_DistortionCoeffs[eLeft],
+         m_R1, m_P1, m_ImageSize, CV_16SC2, m_Map1[eLeft], m_Map2[eLeft]);
+   cv::initUndistortRectifyMap(m_CameraMatrix[eRight], m_DistortionCoeffs[eRight],
+         m_R2, m_P2, m_ImageSize, CV_16SC2, m_Map1[eRight], m_Map2[eRight]);
+
+   return;
+
+   } // end of method StereoCameraCalibration::BuildMaps
+
+/******************************************************************************
+*
+***  StereoCameraCalibration::IsMapValid
+*
+* The camera's maps are the fixed-point pair BuildMaps() makes for the image
+* size.
+*
+******************************************************************************/
+
+bool StereoCameraCalibration::IsMapValid(ECamera eCamera) const
+   {
+   return ((m_Map1[eCamera].size() == m_ImageSize) && (m_Map1[eCamera].type() == CV_16SC2)
+         && (m_Map2[eCamera].size() == m_ImageSize) && (m_Map2[eCamera].type() == CV_16UC1));
+
+   } // end of method StereoCameraCalibration::IsMapValid
+
+/******************************************************************************
+*
+***  StereoCameraCalibration::SetCameras
+*
+* Give the single camera calibrations the intrinsics that were read.
+*
+******************************************************************************/
+
+void StereoCameraCalibration::SetCameras()
+   {
+   m_Left.SetIntrinsics(m_CameraMatrix[eLeft], m_DistortionCoeffs[eLeft], m_ImageSize);
+   m_Right.SetIntrinsics(m_CameraMatrix[eRight], m_DistortionCoeffs[eRight], m_ImageSize);
+
+   return;
+
+   } // end of method StereoCameraCalibration::SetCameras
+
+/******************************************************************************
+*
+***  StereoCameraCalibration::Rectify
+*
+* Remap both frames through the cached maps, both at once in row bands.
+*
+******************************************************************************/
+
+bool StereoCameraCalibration::Rectify(const cv::Mat& LeftImage,
+      const cv::Mat& RightImage, cv::Mat& LeftRectified,
+      cv::Mat& RightRectified) const
+   {
+   bool bRet = !m_Map1[eLeft].empty() && !m_Map1[eRight].empty()
+         && (LeftImage.size() == m_ImageSize) && (RightImage.size() == m_ImageSize);
+   if (bRet)
+      {
+      LeftRectified.create(m_ImageSize, LeftImage.type());
+      RightRectified.create(m_ImageSize, RightImage.type());
+
+      const cv::Mat Src[2] = { LeftImage, RightImage };
+      cv::Mat Dst[2] = { LeftRectified, RightRectified };
+
+      int nBands = std::max(1, m_ImageSize.height / 64);
+      cv::parallel_for_(cv::Range(0, 2 * nBands),
+            DRemapPair(Src, Dst, m_Map1, m_Map2, nBands));
+      } // end if
+
+   return (bRet);
+
+   } // end of method StereoCameraCalibration::Rectify
+
+/******************************************************************************
+*
+***  StereoCameraCalibration::Write
+*
+* The stereo result with both cameras' intrinsics.  The full single camera
+* calibrations (image points, etc.) can be written through GetCamera().
+*
+******************************************************************************/
+
+bool StereoCameraCalibration::Write(const std::string& strFileName) const
+   {
+   cv::Mat Params = (cv::Mat_<double>(1, 4) << m_ImageSize.width,
+         m_ImageSize.height, m_dRMS, m_dAlpha);
+
+   bool bRet;
+   if (CameraCalibration::IsBinaryFileName(strFileName))
+      {
+      CameraCalibrationFileWriter Writer;
+      Writer.AddSection("Params", Params);
+      Writer.AddSection("LeftCamera", m_CameraMatrix[eLeft]);
+      Writer.AddSection("LeftDistortion", m_DistortionCoeffs[eLeft]);
+      Writer.AddSection("RightCamera", m_CameraMatrix[eRight]);
+      Writer.AddSection("RightDistortion", m_DistortionCoeffs[eRight]);
+      Writer.AddSection("R", m_R);
+      Writer.AddSection("T", m_T);
+      Writer.AddSection("E", m_E);
+      Writer.AddSection("F", m_F);
+      Writer.AddSection("R1", m_R1);
+      Writer.AddSection("R2", m_R2);
+      Writer.AddSection("P1", m_P1);
+      Writer.AddSection("P2", m_P2);
+      Writer.AddSection("Q", m_Q);
+      Writer.AddSection("ValidROI", (cv::Mat_<int>(2, 4) <<
+            m_ValidROI[eLeft].x, m_ValidROI[eLeft].y, m_ValidROI[eLeft].width, m_ValidROI[eLeft].height,
+            m_ValidROI[eRight].x, m_ValidROI[eRight].y, m_ValidROI[eRight].width, m_ValidROI[eRight].height));
+      Writer.AddSection("LeftMap1", m_Map1[eLeft]);
+      Writer.AddSection("LeftMap2", m_Map2[eLeft]);
+      Writer.AddSection("RightMap1", m_Map1[eRight]);
+      Writer.AddSection("RightMap2", m_Map2[eRight]);
+
+      bRet = Writer.Write(strFileName);
+      } // end if
+   else
+      {
+      cv::FileStorage FS(strFileName, cv::FileStorage::WRITE);
+      bRet = FS.isOpened();
+      if (bRet)
+         {
+         FS << "Stereo_Calibration" << "{"
+            << "ImageSize" << m_ImageSize
+            << "RMSError" << m_dRMS
+            << "Alpha" << m_dAlpha
+            << "LeftCameraMatrix" << m_CameraMatrix[eLeft]
+            << "LeftDistortionCoefficents" << m_DistortionCoeffs[eLeft]
+            << "RightCameraMatrix" << m_CameraMatrix[eRight]
+            << "RightDistortionCoefficents" << m_DistortionCoeffs[eRight]
+            << "R" << m_R << "T" << m_T << "E" << m_E << "F" << m_F
+            << "R1" << m_R1 << "R2" << m_R2 << "P1" << m_P1 << "P2" << m_P2
+            << "Q" << m_Q
+            << "LeftValidROI" << m_ValidROI[eLeft]
+            << "RightValidROI" << m_ValidROI[eRight]
+            << "}";
+         } // end if
+      } // end else
+
+   return (bRet);
+
+   } // end of method StereoCameraCalibration::Write
+
+/******************************************************************************
+*
+***  IsMatrix
+*
+* M is an nRows x nCols CV_64F matrix.
+*
+******************************************************************************/
+
+static bool IsMatrix(const cv::Mat& M, int nRows, int nCols)
+   {
+   return ((M.type() == CV_64F) && (M.rows == nRows) && (M.cols == nCols));
+
+   } // end of function IsMatrix
+
+/******************************************************************************
+*
+***  StereoCameraCalibration::Read
+*
+* Binary files carry the rectification maps; for the others they are rebuilt.
+* Every section is checked for the type and shape stereoCalibrate() and
+* stereoRectify() produce before anything is changed.  The small matrices are
+* copied out of a binary file so the file can be rewritten, but its maps are
+* used in place, the mapping being kept in m_pMapping, and are only rebuilt if
+* they aren't CV_16SC2 and CV_16UC1 maps of the image size.
+*
+******************************************************************************/
+
+bool StereoCameraCalibration::Read(const std::string& strFileName)
+   {
+   bool bRet;
+   if (CameraCalibration::IsBinaryFileName(strFileName))
+      {
+      CameraCalibrationMappedFile File;
+      bRet = File.Open(strFileName);
+
+      struct DShape
+         {
+         const char* pszTag;
+         int nRows;
+         int nCols;
+         cv::Mat* pMember;
+         };
+
+      const DShape Shapes[] =
+         {
+            { "R", 3, 3, &m_R }, { "T", 3, 1, &m_T },
+            { "E", 3, 3, &m_E }, { "F", 3, 3, &m_F },
+            { "R1", 3, 3, &m_R1 }, { "R2", 3, 3, &m_R2 },
+            { "P1", 3, 4, &m_P1 }, { "P2", 3, 4, &m_P2 },
+            { "Q", 4, 4, &m_Q }
+         };
+
+      cv::Mat Params = File.GetSection("Params");
+      cv::Mat ROI = File.GetSection("ValidROI");
+      cv::Mat LeftCamera = File.GetSection("LeftCamera");
+      cv::Mat LeftDistortion = File.GetSection("LeftDistortion");
+      cv::Mat RightCamera = File.GetSection("RightCamera");
+      cv::Mat RightDistortion = File.GetSection("RightDistortion");
+      bRet = bRet && (Params.type() == CV_64F) && (Params.total() >= 4)
+            && (ROI.type() == CV_32S) && (ROI.total() == 8)
+            && CameraCalibration::IsCameraMatrix(LeftCamera)
+            && CameraCalibration::IsDistortionCoeffs(LeftDistortion)
+            && CameraCalibration::IsCameraMatrix(RightCamera)
+            && CameraCalibration::IsDistortionCoeffs(RightDistortion);
+      for (const DShape& Shape : Shapes)
+         {
+         bRet = bRet && IsMatrix(File.GetSection(Shape.pszTag), Shape.nRows, Shape.nCols);
+         } // end for
+
+      cv::Size ImageSize;
+      if (bRet)
+         {
+         ImageSize = cv::Size(static_cast<int>(Params.at<double>(0)),
+               static_cast<int>(Params.at<double>(1)));
+         bRet = (ImageSize.width > 0) && (ImageSize.height > 0);
+         } // end if
+
+      if (bRet)
+         {
+         m_ImageSize = ImageSize;
+         m_dRMS = Params.at<double>(2);
+         m_dAlpha = Params.at<double>(3);
+
+         const int* pROI = ROI.ptr<int>();
+         m_ValidROI[eLeft] = cv::Rect(pROI[0], pROI[1], pROI[2], pROI[3]);
+         m_ValidROI[eRight] = cv::Rect(pROI[4], pROI[5], pROI[6], pROI[7]);
+
+         m_CameraMatrix[eLeft] = LeftCamera.clone();
+         m_DistortionCoeffs[eLeft] = LeftDistortion.clone();
+         m_CameraMatrix[eRight] = RightCamera.clone();
+         m_DistortionCoeffs[eRight] = RightDistortion.clone();
+         for (const DShape& Shape : Shapes)
+            {
+            *Shape.pMember = File.GetSection(Shape.pszTag).clone();
+            } // end for
+
+         // The maps are used in place, the mapping is copy on write
+         m_Map1[eLeft] = File.GetSection("LeftMap1");
+         m_Map2[eLeft] = File.GetSection("LeftMap2");
+         m_Map1[eRight] = File.GetSection("RightMap1");
+         m_Map2[eRight] = File.GetSection("RightMap2");
+         m_pMapping = File.GetMapping();
+
+         if (!IsMapValid(eLeft) || !IsMapValid(eRight))
+            {
+            BuildMaps();
+            } // end if
+
+         SetCameras();
+         } // end if
+      } // end if
+   else
+      {
+      cv::FileStorage FS(strFileName, cv::FileStorage::READ);
+      bRet = FS.isOpened();
+      if (bRet)
+         {
+         cv::FileNode Node = FS["Stereo_Calibration"];
+         Node["ImageSize"] >> m_ImageSize;
+         Node["RMSError"] >> m_dRMS;
+         Node["Alpha"] >> m_dAlpha;
+         Node["LeftCameraMatrix"] >> m_CameraMatrix[eLeft];
+         Node["LeftDistortionCoefficents"] >> m_DistortionCoeffs[eLeft];
+         Node["RightCameraMatrix"] >> m_CameraMatrix[eRight];
+         Node["RightDistortionCoefficents"] >> m_DistortionCoeffs[eRight];
+         Node["R"] >> m_R;
+         Node["T"] >> m_T;
+         Node["E"] >> m_E;
+         Node["F"] >> m_F;
+         Node["R1"] >> m_R1;
+         Node["R2"] >> m_R2;
+         Node["P1"] >> m_P1;
+         Node["P2"] >> m_P2;
+         Node["Q"] >> m_Q;
+         Node["LeftValidROI"] >> m_ValidROI[eLeft];
+         Node["RightValidROI"] >> m_ValidROI[eRight];
+
+         bRet = CameraCalibration::IsCameraMatrix(m_CameraMatrix[eLeft])
+               && CameraCalibration::IsDistortionCoeffs(m_DistortionCoeffs[eLeft])
+               && CameraCalibration::IsCameraMatrix(m_CameraMatrix[eRight])
+               && CameraCalibration::IsDistortionCoeffs(m_DistortionCoeffs[eRight])
+               && IsMatrix(m_R, 3, 3) && IsMatrix(m_T, 3, 1)
+               && IsMatrix(m_E, 3, 3) && IsMatrix(m_F, 3, 3)
+               && IsMatrix(m_R1, 3, 3) && IsMatrix(m_R2, 3, 3)
+               && IsMatrix(m_P1, 3, 4) && IsMatrix(m_P2, 3, 4)
+               && IsMatrix(m_Q, 4, 4)
+               && (m_ImageSize.width > 0) && (m_ImageSize.height > 0);
+         if (bRet)
+            {
+            BuildMaps();
+            SetCameras();
+            } // end if
+         } // end if
+      } // end else
+
+   return (bRet);
+
+   } // end of method StereoCameraCalibration::Read
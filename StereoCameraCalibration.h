@@ -0,0 +1,155 @@
+#ifndef STEREOCAMERACALIBRATION_H
+#define STEREOCAMERACALIBRATION_H
+
+/* Stereo pair calibration and rectification built on CameraCalibration.  Each
+ * camera is calibrated on its own from the same synchronized views, then the
+ * pair with cv::stereoCalibrate and cv::stereoRectify.  The result, including
+ * the rectification maps, can be written to a single file for the stations
+ * that use it.
+ *
+ */
+
+/*****************************************************************************
+******************************  I N C L U D E  ******************************
+****************************************************************************/
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include "CameraCalibration.h"
+
+/*****************************************************************************
+ *
+ ***  class StereoCameraCalibration
+ *
+ * Frame pairs go through ProcessImagePair() which searches both images at the
+ * same time and only accepts the pair when the board is found in both.  The
+ * left and right CameraCalibration objects collect the accepted views so
+ * their own features (image storage, coverage, coarse detection settings of
+ * the left camera) apply.
+ *
+ * RunCalibration() calibrates each camera, then the pair with the
+ * intrinsics held fixed (unless nStereoFlag says otherwise), rectifies and
+ * builds the fixed-point rectification maps.  Rectify() then only remaps.
+ *
+ * Files ending in .dcal are binary and carry the maps, so loading one is
+ * enough to start rectifying.  Other extensions use cv::FileStorage and the
+ * maps are rebuilt after reading.  Either way the left and right
+ * CameraCalibration objects get the intrinsics that were read.
+ *
+ *****************************************************************************/
+
+class StereoCameraCalibration
+   {
+   public:
+      enum ECamera { eLeft, eRight };
+
+      StereoCameraCalibration();
+      StereoCameraCalibration(const StereoCameraCalibration& src) = default;
+
+      ~StereoCameraCalibration() = default;
+
+      StereoCameraCalibration& operator=(
+            const StereoCameraCalibration& rhs) = default;
+
+      // nFlag is for the single camera calibrations, nStereoFlag for
+      // cv::stereoCalibrate.  dAlpha is the cv::stereoRectify free scaling.
+      bool Initialize(const CameraCalibrationBoard& Board,
+            const cv::Size& ImageSize, bool bFixAspectRatio, int nFlag,
+            int nStereoFlag = cv::CALIB_FIX_INTRINSIC, double dAlpha = 0.0,
+            bool bSaveImages = false);
+
+      bool ProcessImagePair(cv::Mat& LeftImage, cv::Mat& LeftGrayImage,
+            cv::Mat& RightImage, cv::Mat& RightGrayImage,
+            bool bAnnotateImages, bool bUseImages);
+
+      int GetNumGoodPairs() const
+         {
+         return (m_Left.GetNumGoodImages());
+         }
+
+      CameraCalibration& GetCamera(ECamera eCamera)
+         {
+         return ((eCamera == eLeft) ? m_Left : m_Right);
+         }
+
+      const CameraCalibration& GetCamera(ECamera eCamera) const
+         {
+         return ((eCamera == eLeft) ? m_Left : m_Right);
+         }
+
+      bool RunCalibration();
+
+      // Rectify a frame pair.  The outputs must not share data with the inputs.
+      bool Rectify(const cv::Mat& LeftImage, const cv::Mat& RightImage,
+            cv::Mat& LeftRectified, cv::Mat& RightRectified) const;
+
+      double GetRMS() const
+         {
+         return (m_dRMS);
+         }
+
+      // Disparity to depth matrix for cv::reprojectImageTo3D
+      const cv::Mat& GetQ() const
+         {
+         return (m_Q);
+         }
+
+      const cv::Mat& GetRotation() const
+         {
+         return (m_R);
+         }
+
+      const cv::Mat& GetTranslation() const
+         {
+         return (m_T);
+         }
+
+      const cv::Rect& GetValidROI(ECamera eCamera) const
+         {
+         return (m_ValidROI[eCamera]);
+         }
+
+      bool Write(const std::string& strFileName) const;
+      bool Read(const std::string& strFileName);
+
+   protected:
+      CameraCalibration m_Left;
+      CameraCalibration m_Right;
+      int m_nStereoFlag;
+      double m_dAlpha;
+
+      // Results
+      cv::Size m_ImageSize;
+      cv::Mat m_CameraMatrix[2];
+      cv::Mat m_DistortionCoeffs[2];
+      cv::Mat m_R;
+      cv::Mat m_T;
+      cv::Mat m_E;
+      cv::Mat m_F;
+      double m_dRMS;
+      cv::Mat m_R1;
+      cv::Mat m_R2;
+      cv::Mat m_P1;
+      cv::Mat m_P2;
+      cv::Mat m_Q;
+      cv::Rect m_ValidROI[2];
+      cv::Mat m_Map1[2];
+      cv::Mat m_Map2[2];
+      // Mapped .dcal file the results read by Read() point into
+      std::shared_ptr<const void> m_pMapping;
+
+      bool Rectify();
+      void BuildMaps();
+      bool IsMapValid(ECamera eCamera) const;
+      void SetCameras();
+
+   private:
+
+   }; // end of class StereoCameraCalibration
+
+#endif // STEREOCAMERACALIBRATION_H